@@ -28,6 +28,13 @@
 // MulticolorGibbs with symmetric sweep
 // RUN: %cc %s -o %t %flags && %mpirun -np %NP %t -ksp_type richardson -pc_type mcgibbs -pc_mcgibbs_symmetric -skip_petscrc -samples 1000000 -burnin 10000
 
+// MulticolorGibbs and SORGibbs with node-aware (shared memory) ghost exchange
+// RUN: %cc %s -o %t %flags && %mpirun -np %NP %t -ksp_type richardson -pc_type mcgibbs -mc_sor_node_aware -skip_petscrc -samples 1000000 -burnin 10000
+// RUN: %cc %s -o %t %flags && %mpirun -np %NP %t -ksp_type richardson -pc_type sorgibbs -pc_sorgibbs_node_aware -skip_petscrc -samples 1000000 -burnin 10000
+
+// MulticolorGibbs with communication-avoiding sweeps (one ghost exchange per two colours)
+// RUN: %cc %s -o %t %flags && %mpirun -np %NP %t -ksp_type richardson -pc_type mcgibbs -pc_mcgibbs_symmetric -mc_sor_ca_depth 2 -skip_petscrc -samples 1000000 -burnin 10000
+
 // Cholesky
 // RUN: %cc %s -o %t %flags && %mpirun -np %NP %t -ksp_type richardson -pc_type cholsampler -skip_petscrc -burnin 1
 
@@ -0,0 +1,107 @@
+/*  ParMGMC - Implementation of the Multigrid Monte Carlo method in PETSc.
+    Copyright (C) 2024  Nils Friess
+
+    This file is part of ParMGMC which is released under the GNU LESSER GENERAL
+    PUBLIC LICENSE (LGPL). See file LICENSE in the project root folder for full
+    license details.
+*/
+
+/*  Description
+ *
+ *  Estimates the expected spatial average of a Gaussian random field with
+ *  Matern covariance using the MLMC estimator on the geometric multigrid
+ *  hierarchy and compares it with the exact value.
+ *
+ */
+
+/**************************** Test specification ****************************/
+// MLMC with exact samples on each level
+// RUN: %cc %s -o %t %flags && %mpirun -np %NP %t -pc_type gamgmc -pc_gamgmc_mg_type mg -box_faces 2 -dm_refine_hierarchy 3 -matern_kappa 5 -mlmc_sampler_pc_type cholsampler -mlmc_burnin 1 -mlmc_rmse 0.01 -tol 0.04 %opts
+
+// MLMC with MGMC chains on each level
+// RUN: %cc %s -o %t %flags && %mpirun -np %NP %t -pc_type gamgmc -pc_gamgmc_mg_type mg -box_faces 2 -dm_refine_hierarchy 3 -matern_kappa 5 -mlmc_rmse 0.01 -tol 0.04 %opts
+
+// All level pairs on one group of ranks
+// RUN: %cc %s -o %t %flags && %mpirun -np %NP %t -pc_type gamgmc -pc_gamgmc_mg_type mg -box_faces 2 -dm_refine_hierarchy 3 -matern_kappa 5 -mlmc_groups 1 -mlmc_rmse 0.01 -tol 0.04 %opts
+/****************************************************************************/
+
+#include <parmgmc/mlmc.h>
+#include <parmgmc/ms.h>
+#include <parmgmc/parmgmc.h>
+
+#include <petscdm.h>
+#include <petscksp.h>
+#include <petscmat.h>
+#include <petscoptions.h>
+#include <petscpc.h>
+#include <petscsys.h>
+#include <petscvec.h>
+
+int main(int argc, char *argv[])
+{
+  DM          dm;
+  MS          ms;
+  MLMC        mlmc;
+  Mat         A;
+  Vec         b, m, ones;
+  KSP         ksp;
+  PC          pc;
+  PetscInt    n;
+  PetscReal   tol = 0.05;
+  PetscScalar est, exact;
+
+  PetscCall(PetscInitialize(&argc, &argv, NULL, NULL));
+  PetscCall(ParMGMCInitialize());
+
+  PetscCall(MSCreate(MPI_COMM_WORLD, &ms));
+  PetscCall(MSSetFromOptions(ms));
+  PetscCall(MSSetAssemblyOnly(ms, PETSC_TRUE));
+  PetscCall(MSSetUp(ms));
+  PetscCall(MSGetPrecisionMatrix(ms, &A));
+  PetscCall(MSGetDM(ms, &dm));
+
+  /* Only used to build the multigrid hierarchy */
+  PetscCall(KSPCreate(MPI_COMM_WORLD, &ksp));
+  PetscCall(KSPSetDM(ksp, dm));
+#if PETSC_VERSION_GT(3, 24, 5)
+  PetscCall(KSPSetDMActive(ksp, KSP_DMACTIVE_OPERATOR, PETSC_FALSE));
+#else
+  PetscCall(KSPSetDMActive(ksp, PETSC_FALSE));
+#endif
+  PetscCall(KSPSetOperators(ksp, A, A));
+  PetscCall(KSPSetFromOptions(ksp));
+  PetscCall(KSPSetUp(ksp));
+  PetscCall(KSPGetPC(ksp, &pc));
+
+  /* Mean field is constant one, the QoI is the spatial average */
+  PetscCall(DMCreateGlobalVector(dm, &ones));
+  PetscCall(VecDuplicate(ones, &b));
+  PetscCall(VecDuplicate(ones, &m));
+  PetscCall(VecSet(ones, 1));
+  PetscCall(MatMult(A, ones, b));
+  PetscCall(VecGetSize(m, &n));
+  PetscCall(VecSet(m, 1. / n));
+  PetscCall(VecDot(ones, m, &exact));
+
+  PetscCall(MLMCCreate(MPI_COMM_WORLD, &mlmc));
+  PetscCall(MLMCSetHierarchyFromPC(mlmc, pc));
+  PetscCall(MLMCSetRHS(mlmc, b));
+  PetscCall(MLMCSetMeasurementVec(mlmc, m));
+  PetscCall(MLMCSetFromOptions(mlmc));
+  PetscCall(MLMCEstimate(mlmc, &est));
+  PetscCall(MLMCView(mlmc, PETSC_VIEWER_STDOUT_WORLD));
+
+  PetscCall(PetscOptionsGetReal(NULL, NULL, "-tol", &tol, NULL));
+  PetscCall(PetscPrintf(MPI_COMM_WORLD, "MLMC estimate: %.5f, exact: %.5f\n", (double)PetscRealPart(est), (double)PetscRealPart(exact)));
+  PetscCheck(PetscAbsScalar(est - exact) <= tol, MPI_COMM_WORLD, PETSC_ERR_NOT_CONVERGED, "MLMC estimate too far from exact value: got %.4f, expected %.4f", (double)PetscRealPart(est), (double)PetscRealPart(exact));
+
+  PetscCall(MLMCDestroy(&mlmc));
+  PetscCall(VecDestroy(&ones));
+  PetscCall(VecDestroy(&b));
+  PetscCall(VecDestroy(&m));
+  PetscCall(KSPDestroy(&ksp));
+  PetscCall(MSDestroy(&ms));
+  PetscCall(ParMGMCFinalize());
+  PetscCall(PetscFinalize());
+  return 0;
+}
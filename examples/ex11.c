@@ -0,0 +1,140 @@
+/*  ParMGMC - Implementation of the Multigrid Monte Carlo method in PETSc.
+    Copyright (C) 2024  Nils Friess
+
+    This file is part of ParMGMC which is released under the GNU LESSER GENERAL
+    PUBLIC LICENSE (LGPL). See file LICENSE in the project root folder for full
+    license details.
+*/
+
+/*  Description
+ *
+ *  Estimates the marginal variances of a Gaussian random field with Matern
+ *  covariance with the multilevel estimator of PCGAMGMC (exact coarse part
+ *  from selected inversion plus sampled fine remainder) and compares them
+ *  with the exact variances computed by selected inversion of the fine
+ *  Cholesky factor.
+ *
+ */
+
+/**************************** Test specification ****************************/
+// Sparse reference factor
+// RUN: %cc %s -o %t %flags && %mpirun -np %NP %t -pc_type gamgmc -pc_gamgmc_mg_type mg -gamgmc_mg_coarse_pc_type cholsampler -gamgmc_mg_coarse_pc_cholsampler_redundant -box_faces 2 -dm_refine_hierarchy 2 -matern_kappa 5 -nsamples 2000 -tol 0.05 %opts
+
+// Dense reference factor, low-rank update
+// RUN: %cc %s -o %t %flags && %mpirun -np %NP %t -pc_type gamgmc -pc_gamgmc_mg_type mg -gamgmc_mg_coarse_pc_type cholsampler -gamgmc_mg_coarse_pc_cholsampler_redundant -gamgmc_mg_coarse_pc_cholsampler_woodbury -ref_pc_cholsampler_dense_threshold 100000 -ref_pc_cholsampler_woodbury -box_faces 2 -dm_refine_hierarchy 2 -matern_kappa 5 -with_lr -nsamples 2000 -tol 0.05 %opts
+/****************************************************************************/
+
+#include <parmgmc/ms.h>
+#include <parmgmc/parmgmc.h>
+#include <parmgmc/pc/pc_chols.h>
+#include <parmgmc/pc/pc_gamgmc.h>
+
+#include <petscdm.h>
+#include <petscksp.h>
+#include <petscmat.h>
+#include <petscoptions.h>
+#include <petscpc.h>
+#include <petscsys.h>
+#include <petscvec.h>
+
+/* Low-rank update B S B^T from a few point observations of single unknowns
+   with noise variance 1e-2 */
+static PetscErrorCode CreateLowRankUpdate(Mat A, Mat *LRC)
+{
+  Mat      B;
+  Vec      S;
+  PetscInt N, rstart, rend, nobs = 5;
+
+  PetscFunctionBeginUser;
+  PetscCall(MatGetSize(A, &N, NULL));
+  PetscCall(MatGetOwnershipRange(A, &rstart, &rend));
+  PetscCall(MatCreateDense(PetscObjectComm((PetscObject)A), rend - rstart, PETSC_DECIDE, N, nobs, NULL, &B));
+  for (PetscInt j = 0; j < nobs; ++j) {
+    PetscInt i = (j + 1) * N / (nobs + 1);
+
+    if (i >= rstart && i < rend) PetscCall(MatSetValue(B, i, j, 1., INSERT_VALUES));
+  }
+  PetscCall(MatAssemblyBegin(B, MAT_FINAL_ASSEMBLY));
+  PetscCall(MatAssemblyEnd(B, MAT_FINAL_ASSEMBLY));
+  PetscCall(VecCreateSeq(PETSC_COMM_SELF, nobs, &S));
+  PetscCall(VecSet(S, 1e2));
+  PetscCall(MatCreateLRC(A, B, S, NULL, LRC));
+  PetscCall(MatDestroy(&B));
+  PetscCall(VecDestroy(&S));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+int main(int argc, char *argv[])
+{
+  DM        dm;
+  MS        ms;
+  Mat       A, Aop;
+  Vec       var, ref;
+  KSP       ksp;
+  PC        pc, refpc;
+  PetscInt  nburnin = 100, nsamples = 1000;
+  PetscReal tol = 0.05, err, nrm;
+  PetscBool with_lr = PETSC_FALSE;
+
+  PetscCall(PetscInitialize(&argc, &argv, NULL, NULL));
+  PetscCall(ParMGMCInitialize());
+
+  PetscCall(PetscOptionsGetInt(NULL, NULL, "-nburnin", &nburnin, NULL));
+  PetscCall(PetscOptionsGetInt(NULL, NULL, "-nsamples", &nsamples, NULL));
+  PetscCall(PetscOptionsGetReal(NULL, NULL, "-tol", &tol, NULL));
+  PetscCall(PetscOptionsGetBool(NULL, NULL, "-with_lr", &with_lr, NULL));
+
+  PetscCall(MSCreate(MPI_COMM_WORLD, &ms));
+  PetscCall(MSSetFromOptions(ms));
+  PetscCall(MSSetAssemblyOnly(ms, PETSC_TRUE));
+  PetscCall(MSSetUp(ms));
+  PetscCall(MSGetPrecisionMatrix(ms, &A));
+  PetscCall(MSGetDM(ms, &dm));
+  if (with_lr) PetscCall(CreateLowRankUpdate(A, &Aop));
+  else {
+    PetscCall(PetscObjectReference((PetscObject)A));
+    Aop = A;
+  }
+
+  PetscCall(KSPCreate(MPI_COMM_WORLD, &ksp));
+  PetscCall(KSPSetDM(ksp, dm));
+#if PETSC_VERSION_GT(3, 24, 5)
+  PetscCall(KSPSetDMActive(ksp, KSP_DMACTIVE_OPERATOR, PETSC_FALSE));
+#else
+  PetscCall(KSPSetDMActive(ksp, PETSC_FALSE));
+#endif
+  PetscCall(KSPSetOperators(ksp, Aop, Aop));
+  PetscCall(KSPSetFromOptions(ksp));
+  PetscCall(KSPSetUp(ksp));
+  PetscCall(KSPGetPC(ksp, &pc));
+
+  /* Exact variances from the fine Cholesky factor */
+  PetscCall(PCCreate(MPI_COMM_WORLD, &refpc));
+  PetscCall(PCSetOptionsPrefix(refpc, "ref_"));
+  PetscCall(PCSetType(refpc, PCCHOLSAMPLER));
+  PetscCall(PCCholSamplerSetRedundant(refpc, PETSC_TRUE));
+  PetscCall(PCCholSamplerSetLevelScheduling(refpc, PETSC_TRUE));
+  PetscCall(PCSetOperators(refpc, Aop, Aop));
+  PetscCall(PCSetFromOptions(refpc));
+  PetscCall(PCSetUp(refpc));
+  PetscCall(MatCreateVecs(A, &var, &ref));
+  PetscCall(PCCholSamplerGetVariance(refpc, ref));
+
+  PetscCall(PCGAMGMCEstimateVariance(pc, nburnin, nsamples, var));
+
+  PetscCall(VecAXPY(var, -1., ref));
+  PetscCall(VecNorm(var, NORM_1, &err));
+  PetscCall(VecNorm(ref, NORM_1, &nrm));
+  PetscCall(PetscPrintf(MPI_COMM_WORLD, "Relative error of the variances: %.4f\n", (double)(err / nrm)));
+  PetscCheck(err / nrm <= tol, MPI_COMM_WORLD, PETSC_ERR_NOT_CONVERGED, "Variance estimate too far from exact variances: relative error %.4f", (double)(err / nrm));
+
+  PetscCall(VecDestroy(&var));
+  PetscCall(VecDestroy(&ref));
+  PetscCall(PCDestroy(&refpc));
+  PetscCall(KSPDestroy(&ksp));
+  PetscCall(MatDestroy(&Aop));
+  PetscCall(MSDestroy(&ms));
+  PetscCall(ParMGMCFinalize());
+  PetscCall(PetscFinalize());
+  return 0;
+}
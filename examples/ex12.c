@@ -0,0 +1,152 @@
+/*  ParMGMC - Implementation of the Multigrid Monte Carlo method in PETSc.
+    Copyright (C) 2024  Nils Friess
+
+    This file is part of ParMGMC which is released under the GNU LESSER GENERAL
+    PUBLIC LICENSE (LGPL). See file LICENSE in the project root folder for full
+    license details.
+*/
+
+/*  Description
+ *
+ *  Checks the covariance of the samples of the patch Gibbs sampler. On a
+ *  small grid, the sample covariance is compared with the exact covariance
+ *  A^-1 computed with a direct solver. With a single patch that contains all
+ *  unknowns, every sweep is an exact draw from N(0, A_PP^-1) = N(0, A^-1);
+ *  with several (overlapping) patches the chain is still invariant with
+ *  respect to N(0, A^-1).
+ */
+
+/**************************** Test specification ****************************/
+// One patch that contains all unknowns
+// RUN: %cc %s -o %t %flags && %mpirun -np 1 %t -ksp_type richardson -pc_type patchgibbs -pc_patchgibbs_type block -pc_patchgibbs_block_size 16 -samples 200000 -skip_petscrc
+
+// Blocks of four unknowns
+// RUN: %cc %s -o %t %flags && %mpirun -np 1 %t -ksp_type richardson -pc_type patchgibbs -pc_patchgibbs_type block -pc_patchgibbs_block_size 4 -samples 200000 -skip_petscrc
+
+// Star patches
+// RUN: %cc %s -o %t %flags && %mpirun -np 1 %t -ksp_type richardson -pc_type patchgibbs -samples 200000 -skip_petscrc
+/****************************************************************************/
+
+#include <parmgmc/parmgmc.h>
+#include <parmgmc/problems.h>
+
+#include <petsc.h>
+#include <petscdm.h>
+#include <petscksp.h>
+#include <petscmath.h>
+#include <petscsystypes.h>
+#include <petscvec.h>
+
+typedef struct {
+  PetscInt     n;
+  PetscScalar *mean, *cov; // running sums of y and y y^T
+} *CovCtx;
+
+static PetscErrorCode SampleCallback(PetscInt it, Vec y, void *ctx)
+{
+  CovCtx             cc = ctx;
+  const PetscScalar *yarr;
+
+  PetscFunctionBeginUser;
+  (void)it;
+  PetscCall(VecGetArrayRead(y, &yarr));
+  for (PetscInt i = 0; i < cc->n; ++i) {
+    cc->mean[i] += yarr[i];
+    for (PetscInt j = 0; j < cc->n; ++j) cc->cov[i + j * cc->n] += yarr[i] * yarr[j];
+  }
+  PetscCall(VecRestoreArrayRead(y, &yarr));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+int main(int argc, char *argv[])
+{
+  DM                 da;
+  Mat                A;
+  Vec                b, x, e, col;
+  KSP                ksp, ksp2;
+  PC                 pc, pc2;
+  CovCtx             cc;
+  const PetscScalar *colarr;
+  PetscReal          err = 0, nrm = 0, tol = 0.05;
+  PetscInt           n_samples = 200000, n_burnin = 100;
+
+  PetscCall(PetscInitialize(&argc, &argv, NULL, NULL));
+  PetscCall(ParMGMCInitialize());
+
+  PetscCall(PetscOptionsGetInt(NULL, NULL, "-samples", &n_samples, NULL));
+  PetscCall(PetscOptionsGetInt(NULL, NULL, "-burnin", &n_burnin, NULL));
+  PetscCall(PetscOptionsGetReal(NULL, NULL, "-tol", &tol, NULL));
+
+  PetscCall(DMDACreate2d(MPI_COMM_SELF, DM_BOUNDARY_NONE, DM_BOUNDARY_NONE, DMDA_STENCIL_STAR, 4, 4, PETSC_DECIDE, PETSC_DECIDE, 1, 1, NULL, NULL, &da));
+  PetscCall(DMSetUp(da));
+  PetscCall(DMDASetUniformCoordinates(da, 0, 1, 0, 1, 0, 1));
+  PetscCall(DMCreateMatrix(da, &A));
+  PetscCall(MatAssembleShiftedLaplaceFD(da, 1, A));
+
+  PetscCall(KSPCreate(MPI_COMM_SELF, &ksp));
+  PetscCall(KSPSetOperators(ksp, A, A));
+  PetscCall(KSPSetNormType(ksp, KSP_NORM_NONE));
+  PetscCall(KSPSetInitialGuessNonzero(ksp, PETSC_TRUE));
+  PetscCall(KSPSetFromOptions(ksp));
+  PetscCall(KSPSetUp(ksp));
+  PetscCall(KSPGetPC(ksp, &pc));
+
+  PetscCall(DMCreateGlobalVector(da, &x));
+  PetscCall(VecDuplicate(x, &b));
+  PetscCall(VecZeroEntries(b));
+  PetscCall(VecZeroEntries(x));
+
+  PetscCall(PetscNew(&cc));
+  PetscCall(VecGetSize(x, &cc->n));
+  PetscCall(PetscCalloc2(cc->n, &cc->mean, cc->n * cc->n, &cc->cov));
+
+  // Burn-in phase: advance the chain without recording samples
+  PetscCall(KSPSetTolerances(ksp, 0, 0, 0, n_burnin));
+  PetscCall(KSPSolve(ksp, b, x));
+
+  // Sampling phase
+  PetscCall(PCSetSampleCallback(pc, SampleCallback, cc, NULL));
+  PetscCall(KSPSetTolerances(ksp, 0, 0, 0, n_samples));
+  PetscCall(KSPSolve(ksp, b, x));
+
+  // Compare the sample covariance with the columns of A^-1
+  PetscCall(KSPCreate(MPI_COMM_SELF, &ksp2));
+  PetscCall(KSPSetOperators(ksp2, A, A));
+  PetscCall(KSPSetType(ksp2, KSPPREONLY));
+  PetscCall(KSPGetPC(ksp2, &pc2));
+  PetscCall(PCSetType(pc2, PCCHOLESKY));
+  PetscCall(VecDuplicate(x, &e));
+  PetscCall(VecDuplicate(x, &col));
+  for (PetscInt j = 0; j < cc->n; ++j) {
+    PetscCall(VecZeroEntries(e));
+    PetscCall(VecSetValue(e, j, 1., INSERT_VALUES));
+    PetscCall(VecAssemblyBegin(e));
+    PetscCall(VecAssemblyEnd(e));
+    PetscCall(KSPSolve(ksp2, e, col));
+    PetscCall(VecGetArrayRead(col, &colarr));
+    for (PetscInt i = 0; i < cc->n; ++i) {
+      PetscScalar c = cc->cov[i + j * cc->n] / n_samples - cc->mean[i] * cc->mean[j] / ((PetscReal)n_samples * n_samples);
+
+      err += PetscSqr(PetscAbsScalar(c - colarr[i]));
+      nrm += PetscSqr(PetscAbsScalar(colarr[i]));
+    }
+    PetscCall(VecRestoreArrayRead(col, &colarr));
+  }
+  err = PetscSqrtReal(err / nrm);
+
+  PetscCheck(err < tol, MPI_COMM_WORLD, PETSC_ERR_NOT_CONVERGED, "Sample covariance has not converged: rel. error %.5f", (double)err);
+  PetscCall(PetscPrintf(MPI_COMM_WORLD, "Rel. covariance error: %.5f\n", (double)err));
+
+  PetscCall(PetscFree2(cc->mean, cc->cov));
+  PetscCall(PetscFree(cc));
+  PetscCall(VecDestroy(&col));
+  PetscCall(VecDestroy(&e));
+  PetscCall(VecDestroy(&x));
+  PetscCall(VecDestroy(&b));
+  PetscCall(KSPDestroy(&ksp2));
+  PetscCall(KSPDestroy(&ksp));
+  PetscCall(MatDestroy(&A));
+  PetscCall(DMDestroy(&da));
+  PetscCall(ParMGMCFinalize());
+  PetscCall(PetscFinalize());
+}
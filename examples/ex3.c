@@ -113,6 +113,7 @@ int main(int argc, char *argv[])
 
   PetscCall(PetscNew(&appctx));
   PetscCall(MCSORCreate(Aop, &appctx->mc));
+  PetscCall(MCSORSetFromOptions(appctx->mc));
   PetscCall(PetscOptionsGetBool(NULL, NULL, "-sor_symmetric", &sor_symmetric, NULL));
   if (sor_symmetric) PetscCall(MCSORSetSweepType(appctx->mc, SOR_SYMMETRIC_SWEEP));
   PetscCall(MCSORSetUp(appctx->mc));
@@ -12,10 +12,11 @@
  */
 
 /**************************** Test specification ****************************/
-// All samplers run with the low-rank update (-with_lr) except the Cholesky
-// reference: a direct factorisation of A + B Sigma^-1 B^T would assemble the
-// dense low-rank term, which is exactly what the LR machinery avoids, so that
-// combination is intentionally omitted.  -nburnin discards the initial
+// All samplers run with the low-rank update (-with_lr).  The Cholesky sampler
+// only factors A and applies the low-rank term with a Woodbury update
+// (-pc_cholsampler_woodbury, off by default); the plain Cholesky reference
+// without the update is kept as well, since assembling A + B Sigma^-1 B^T
+// would couple all unknowns near an observation.  -nburnin discards the initial
 // transient (the chain starts at x = 0); -tol is sized to the converged
 // sample-mean error at the given -ksp_max_it with some margin.
 //
@@ -30,8 +31,33 @@
 // Geometric MGMC, low-rank update, MulticolorGibbs coarse sampler
 // RUN: %cc %s -o %t %flags && %mpirun -np %NP %t -ksp_type richardson -pc_type gamgmc -pc_gamgmc_mg_type mg -gamgmc_mg_coarse_pc_type mcgibbs -box_faces 2 -dm_refine_hierarchy 2 -with_lr -nburnin 500 -ksp_max_it 2000 -tol 0.10 %opts -ksp_norm_type none -ksp_convergence_test skip
 
+// Same, with the low-rank update compressed to its numerical rank
+// RUN: %cc %s -o %t %flags && %mpirun -np %NP %t -ksp_type richardson -pc_type gamgmc -pc_gamgmc_mg_type mg -gamgmc_mg_coarse_pc_type mcgibbs -box_faces 2 -dm_refine_hierarchy 2 -with_lr -lr_compress_rtol 1e-6 -nburnin 500 -ksp_max_it 2000 -tol 0.10 %opts -ksp_norm_type none -ksp_convergence_test skip
+// Same, 100 overlapping observations whose update has a low numerical rank
+// RUN: %cc %s -o %t %flags && %mpirun -np %NP %t -ksp_type richardson -pc_type gamgmc -pc_gamgmc_mg_type mg -gamgmc_mg_coarse_pc_type mcgibbs -box_faces 2 -dm_refine_hierarchy 2 -with_lr -obs_grid 10 -lr_compress_rtol 1e-6 -nburnin 500 -ksp_max_it 2000 -tol 0.10 %opts -ksp_norm_type none -ksp_convergence_test skip
+
+// Geometric MGMC, low-rank update, MulticolorGibbs coarse sampler, cycle run on
+// the sample directly (fine-level residual only computed inside the cycle)
+// RUN: %cc %s -o %t %flags && %mpirun -np %NP %t -ksp_type richardson -pc_type gamgmc -pc_gamgmc_mg_type mg -pc_gamgmc_carry_residual -gamgmc_mg_coarse_pc_type mcgibbs -box_faces 2 -dm_refine_hierarchy 2 -with_lr -nburnin 500 -ksp_max_it 2000 -tol 0.10 %opts -ksp_norm_type none -ksp_convergence_test skip
+
+// Geometric MGMC, low-rank update, MulticolorGibbs smoothers that compute the
+// residual for the restriction during their last sweep
+// RUN: %cc %s -o %t %flags && %mpirun -np %NP %t -ksp_type richardson -pc_type gamgmc -pc_gamgmc_mg_type mg -pc_gamgmc_fused_residual -gamgmc_mg_levels_pc_type mcgibbs -gamgmc_mg_coarse_pc_type mcgibbs -box_faces 2 -dm_refine_hierarchy 2 -with_lr -nburnin 500 -ksp_max_it 2000 -tol 0.10 %opts -ksp_norm_type none -ksp_convergence_test skip
+
+// Same, sampler set up for kappa = 2 and then only numerically updated for the
+// matrix reassembled with kappa = 1 (-new_kappa)
+// RUN: %cc %s -o %t %flags && %mpirun -np %NP %t -ksp_type richardson -pc_type gamgmc -pc_gamgmc_mg_type mg -gamgmc_mg_coarse_pc_type mcgibbs -box_faces 2 -dm_refine_hierarchy 2 -matern_kappa 2 -new_kappa 1 -with_lr -nburnin 500 -ksp_max_it 2000 -tol 0.10 %opts -ksp_norm_type none -ksp_convergence_test skip
+
 // Geometric MGMC, low-rank update, Cholesky coarse sampler (coarse grid only -- cheap)
-// RUN: %cc %s -o %t %flags && %mpirun -np %NP %t -ksp_type richardson -pc_type gamgmc -pc_gamgmc_mg_type mg -gamgmc_mg_coarse_pc_type cholsampler -box_faces 2 -dm_refine_hierarchy 2 -with_lr -nburnin 500 -ksp_max_it 2000 -tol 0.10 %opts -ksp_norm_type none -ksp_convergence_test skip
+// RUN: %cc %s -o %t %flags && %mpirun -np %NP %t -ksp_type richardson -pc_type gamgmc -pc_gamgmc_mg_type mg -gamgmc_mg_coarse_pc_type cholsampler -gamgmc_mg_coarse_pc_cholsampler_woodbury -box_faces 2 -dm_refine_hierarchy 2 -with_lr -nburnin 500 -ksp_max_it 2000 -tol 0.10 %opts -ksp_norm_type none -ksp_convergence_test skip
+// Same, with the coarse sample computed redundantly on every rank
+// RUN: %cc %s -o %t %flags && %mpirun -np %NP %t -ksp_type richardson -pc_type gamgmc -pc_gamgmc_mg_type mg -gamgmc_mg_coarse_pc_type cholsampler -gamgmc_mg_coarse_pc_cholsampler_woodbury -gamgmc_mg_coarse_pc_cholsampler_redundant -box_faces 2 -dm_refine_hierarchy 2 -with_lr -nburnin 500 -ksp_max_it 2000 -tol 0.10 %opts -ksp_norm_type none -ksp_convergence_test skip
+
+// Geometric MGMC, low-rank update, exact mean computed on the sampling hierarchy
+// RUN: %cc %s -o %t %flags && %mpirun -np %NP %t -ksp_type richardson -pc_type gamgmc -pc_gamgmc_mg_type mg -gamgmc_mg_coarse_pc_type cholsampler -gamgmc_mg_coarse_pc_cholsampler_woodbury -gamgmc_mean -box_faces 2 -dm_refine_hierarchy 2 -with_lr -nburnin 500 -ksp_max_it 2000 -tol 0.10 %opts -ksp_norm_type none -ksp_convergence_test skip
+
+// Geometric MGMC, low-rank update, fused residuals, per-level timing
+// RUN: %cc %s -o %t %flags && %mpirun -np %NP %t -ksp_type richardson -pc_type gamgmc -pc_gamgmc_mg_type mg -pc_gamgmc_fused_residual -pc_gamgmc_view_timing -log_view -ksp_view -gamgmc_mg_levels_pc_type mcgibbs -gamgmc_mg_coarse_pc_type cholsampler -gamgmc_mg_coarse_pc_cholsampler_woodbury -box_faces 2 -dm_refine_hierarchy 2 -with_lr -nburnin 500 -ksp_max_it 2000 -tol 0.10 %opts -ksp_norm_type none -ksp_convergence_test skip
 
 // Geometric MGMC, NO low-rank update, SOR-Gibbs coarse sampler.  Without the LR
 // term (which conditions the operator) the kappa=1 Matern system mixes too slowly
@@ -44,18 +70,43 @@
 // via parallel CPARDISO.  ignore_dm is needed (telescope rejects the coarse DMPlex);
 // -with_lr is omitted as MATLRC has no MatCreateSubMatrices for telescope.
 // RUN: %cc %s -o %t %flags && %mpirun -np %NP %t -ksp_type richardson -pc_type gamgmc -pc_gamgmc_mg_type mg -gamgmc_mg_coarse_pc_type telescope -gamgmc_mg_coarse_pc_telescope_reduction_factor %NP -gamgmc_mg_coarse_pc_telescope_ignore_dm -gamgmc_mg_coarse_telescope_ksp_type richardson -gamgmc_mg_coarse_telescope_ksp_max_it 1 -gamgmc_mg_coarse_telescope_pc_type cholsampler -box_faces 2 -dm_refine_hierarchy 2 -matern_kappa 10 -nburnin 500 -ksp_max_it 2000 -tol 0.05 %opts -ksp_norm_type none -ksp_convergence_test skip
+// Same, with a batched star-patch Gibbs sampler on the reduced coarse level
+// RUN: %cc %s -o %t %flags && %mpirun -np %NP %t -ksp_type richardson -pc_type gamgmc -pc_gamgmc_mg_type mg -gamgmc_mg_coarse_pc_type telescope -gamgmc_mg_coarse_pc_telescope_reduction_factor %NP -gamgmc_mg_coarse_pc_telescope_ignore_dm -gamgmc_mg_coarse_telescope_ksp_type richardson -gamgmc_mg_coarse_telescope_ksp_max_it 2 -gamgmc_mg_coarse_telescope_pc_type patchgibbs -box_faces 2 -dm_refine_hierarchy 2 -matern_kappa 10 -nburnin 500 -ksp_max_it 2000 -tol 0.05 %opts -ksp_norm_type none -ksp_convergence_test skip
+
+// Geometric MGMC, NO low-rank update, SOR-Gibbs smoother with two pipelined
+// parallel SOR sweeps per level (the next sweep's ghost exchange overlaps the
+// tail of the current one)
+// RUN: %cc %s -o %t %flags && %mpirun -np %NP %t -ksp_type richardson -pc_type gamgmc -pc_gamgmc_mg_type mg -gamgmc_mg_levels_pc_type sorgibbs -gamgmc_mg_levels_pc_sorgibbs_pipelined -gamgmc_mg_levels_ksp_max_it 2 -gamgmc_mg_coarse_pc_type sorgibbs -box_faces 2 -dm_refine_hierarchy 2 -matern_kappa 10 -nburnin 500 -ksp_max_it 2000 -tol 0.05 %opts -ksp_norm_type none -ksp_convergence_test skip
+
+// Geometric MGMC, autotuned before sampling
+// RUN: %cc %s -o %t %flags && %mpirun -np %NP %t -ksp_type richardson -pc_type gamgmc -pc_gamgmc_mg_type mg -pc_gamgmc_autotune -pc_gamgmc_autotune_samples 50 -gamgmc_mg_coarse_pc_type mcgibbs -box_faces 2 -dm_refine_hierarchy 2 -matern_kappa 10 -nburnin 500 -ksp_max_it 2000 -tol 0.05 %opts -ksp_norm_type none -ksp_convergence_test skip
 
 // Algebraic MGMC (GAMG), low-rank update -- aggressive coarsening needs more smoothing to mix
 // RUN: %cc %s -o %t %flags && %mpirun -np %NP %t -ksp_type richardson -pc_type gamgmc -pc_gamgmc_mg_type gamg -gamgmc_mg_levels_ksp_max_it 10 -box_faces 2 -dm_refine_hierarchy 2 -with_lr -nburnin 500 -ksp_max_it 5000 -tol 0.05 %opts -ksp_norm_type none -ksp_convergence_test skip
 
+// Same, with the coarse levels smoothed on sub-communicators
+// RUN: %cc %s -o %t %flags && %mpirun -np %NP %t -ksp_type richardson -pc_type gamgmc -pc_gamgmc_mg_type gamg -pc_gamgmc_agglomerate_eq_limit 200 -gamgmc_mg_levels_ksp_max_it 10 -box_faces 2 -dm_refine_hierarchy 2 -with_lr -nburnin 500 -ksp_max_it 5000 -tol 0.05 %opts -ksp_norm_type none -ksp_convergence_test skip
+
 // MulticolorGibbs sampler with low-rank update
 // RUN: %cc %s -o %t %flags && %mpirun -np %NP %t -ksp_type richardson -pc_type mcgibbs -pc_mcgibbs_symmetric -box_faces 2 -dm_refine_hierarchy 2 -with_lr -nburnin 2000 -ksp_max_it 20000 -tol 0.05 %opts -ksp_norm_type none -ksp_convergence_test skip
 
 // SOR-Gibbs sampler with low-rank update
 // RUN: %cc %s -o %t %flags && %mpirun -np %NP %t -ksp_type richardson -pc_type sorgibbs -box_faces 2 -dm_refine_hierarchy 2 -with_lr -nburnin 2000 -ksp_max_it 20000 -tol 0.05 %opts -ksp_norm_type none -ksp_convergence_test skip
 
-// Cholesky sampler (exact reference, no low-rank update -- see note above)
+// Cholesky sampler (exact reference, no low-rank update)
 // RUN: %cc %s -o %t %flags && %mpirun -np %NP %t -ksp_type richardson -pc_type cholsampler -box_faces 2 -dm_refine 2 -nburnin 200 -ksp_max_it 5000 -tol 0.05 %opts -ksp_norm_type none -ksp_convergence_test skip
+// Same, redundant dense factor, samples computed in batches of 16
+// RUN: %cc %s -o %t %flags && %mpirun -np %NP %t -ksp_type richardson -pc_type cholsampler -pc_cholsampler_redundant -pc_cholsampler_dense_threshold 1000 -pc_cholsampler_batch_size 16 -box_faces 2 -dm_refine 2 -nburnin 200 -ksp_max_it 5000 -tol 0.05 %opts -ksp_norm_type none -ksp_convergence_test skip
+// Same, built-in factorization with level-scheduled triangular solves
+// RUN: %cc %s -o %t %flags && %mpirun -np %NP %t -ksp_type richardson -pc_type cholsampler -pc_cholsampler_redundant -pc_cholsampler_level_schedule -box_faces 2 -dm_refine 2 -nburnin 200 -ksp_max_it 5000 -tol 0.05 %opts -ksp_norm_type none -ksp_convergence_test skip
+// Same, level-scheduled factor, samples computed in batches of 16
+// RUN: %cc %s -o %t %flags && %mpirun -np %NP %t -ksp_type richardson -pc_type cholsampler -pc_cholsampler_redundant -pc_cholsampler_level_schedule -pc_cholsampler_batch_size 16 -box_faces 2 -dm_refine 2 -nburnin 200 -ksp_max_it 5000 -tol 0.05 %opts -ksp_norm_type none -ksp_convergence_test skip
+// GAMGMC, level-scheduled coarse sampler with four batched coarse samples per cycle
+// RUN: %cc %s -o %t %flags && %mpirun -np %NP %t -ksp_type richardson -pc_type gamgmc -gamgmc_mg_coarse_ksp_type richardson -gamgmc_mg_coarse_ksp_max_it 4 -gamgmc_mg_coarse_pc_type cholsampler -gamgmc_mg_coarse_pc_cholsampler_level_schedule -box_faces 2 -dm_refine 2 -nburnin 200 -ksp_max_it 5000 -tol 0.05 %opts -ksp_norm_type none -ksp_convergence_test skip
+// Cholesky sampler with low-rank update (factor of A, Woodbury correction)
+// RUN: %cc %s -o %t %flags && %mpirun -np %NP %t -ksp_type richardson -pc_type cholsampler -pc_cholsampler_woodbury -box_faces 2 -dm_refine 2 -with_lr -nburnin 200 -ksp_max_it 5000 -tol 0.05 %opts -ksp_norm_type none -ksp_convergence_test skip
+// Same, numeric refactorization after reassembling with a new kappa
+// RUN: %cc %s -o %t %flags && %mpirun -np %NP %t -ksp_type richardson -pc_type cholsampler -pc_cholsampler_woodbury -box_faces 2 -dm_refine 2 -matern_kappa 2 -new_kappa 1 -with_lr -nburnin 200 -ksp_max_it 5000 -tol 0.05 %opts -ksp_norm_type none -ksp_convergence_test skip
 /****************************************************************************/
 
 #include <parmgmc/mc_sor.h>
@@ -63,6 +114,7 @@
 #include <parmgmc/obs.h>
 #include <parmgmc/parmgmc.h>
 #include <parmgmc/problems.h>
+#include <parmgmc/pc/pc_gamgmc.h>
 
 #include <petsc.h>
 #include <petscdm.h>
@@ -139,10 +191,10 @@ int main(int argc, char *argv[])
   KSP            ksp;
   PC             pc;
   MS             ms;
-  PetscBool      with_lr = PETSC_FALSE;
+  PetscBool      with_lr = PETSC_FALSE, new_kappa_set, compress;
   const PetscInt nobs    = 3;
-  PetscInt       nburnin = 0;
-  PetscReal      tol     = 0.1;
+  PetscInt       nburnin = 0, ngrid = 0;
+  PetscReal      tol     = 0.1, new_kappa, compress_rtol;
   PetscScalar    obs[3 * nobs], radii[nobs], obsvals[nobs], err, exact_mean_norm;
 
   PetscCall(PetscInitialize(&argc, &argv, NULL, NULL));
@@ -174,7 +226,39 @@ int main(int argc, char *argv[])
     obsvals[2] = obsval;
     radii[2]   = 0.1;
 
-    PetscCall(MakeObservationMats(dm, nobs, 1e-4, obs, radii, obsvals, &B, &S, &f));
+    PetscCall(PetscOptionsGetInt(NULL, NULL, "-obs_grid", &ngrid, NULL));
+    if (ngrid > 0) {
+      /* Many overlapping sensors instead: ngrid x ngrid observations in
+         [0.3, 0.7]^2, the update has a low numerical rank */
+      PetscScalar *gobs, *gradii, *gvals;
+
+      PetscCall(PetscMalloc3(2 * ngrid * ngrid, &gobs, ngrid * ngrid, &gradii, ngrid * ngrid, &gvals));
+      for (PetscInt i = 0; i < ngrid; ++i) {
+        for (PetscInt j = 0; j < ngrid; ++j) {
+          PetscInt idx = i * ngrid + j;
+
+          gobs[2 * idx]     = 0.3 + 0.4 * i / PetscMax(ngrid - 1, 1);
+          gobs[2 * idx + 1] = 0.3 + 0.4 * j / PetscMax(ngrid - 1, 1);
+          gradii[idx]       = 0.1;
+          gvals[idx]        = obsval;
+        }
+      }
+      PetscCall(MakeObservationMats(dm, ngrid * ngrid, 1e-4, gobs, gradii, gvals, &B, &S, &f));
+      PetscCall(PetscFree3(gobs, gradii, gvals));
+    } else PetscCall(MakeObservationMats(dm, nobs, 1e-4, obs, radii, obsvals, &B, &S, &f));
+
+    /* Optionally replace B S B^T by its compression U D U^T */
+    PetscCall(PetscOptionsGetReal(NULL, NULL, "-lr_compress_rtol", &compress_rtol, &compress));
+    if (compress) {
+      Mat U;
+      Vec D;
+
+      PetscCall(CompressObservationMats(B, S, compress_rtol, &U, &D));
+      PetscCall(MatDestroy(&B));
+      PetscCall(VecDestroy(&S));
+      B = U;
+      S = D;
+    }
     PetscCall(MatCreateLRC(A, B, S, B, &Aop));
   } else Aop = A;
 
@@ -193,6 +277,14 @@ int main(int argc, char *argv[])
   PetscCall(KSPSetInitialGuessNonzero(ksp, PETSC_TRUE));
   PetscCall(DMCreateGlobalVector(dm, &x));
 
+  /* Change the values (but not the nonzero pattern) of the operator after the
+     sampler has been set up; the next solve only redoes the numeric setup */
+  PetscCall(PetscOptionsGetReal(NULL, NULL, "-new_kappa", &new_kappa, &new_kappa_set));
+  if (new_kappa_set) {
+    PetscCall(MSSetKappa(ms, new_kappa));
+    if (with_lr) PetscCall(PetscObjectStateIncrease((PetscObject)Aop));
+  }
+
   if (with_lr) {
     b = f;
   } else {
@@ -207,17 +299,25 @@ int main(int argc, char *argv[])
   PetscCall(PetscOptionsGetInt(NULL, NULL, "-nburnin", &nburnin, NULL));
   PetscCall(PetscOptionsGetReal(NULL, NULL, "-tol", &tol, NULL));
   samplectx->nburnin = nburnin;
+  PetscCall(KSPGetPC(ksp, &pc));
   {
-    KSP ksp2;
-
-    PetscCall(KSPCreate(MPI_COMM_WORLD, &ksp2));
-    PetscCall(KSPSetOperators(ksp2, Aop, Aop));
-    PetscCall(KSPSetTolerances(ksp2, 1e-12, 1e-12, PETSC_DEFAULT, PETSC_DEFAULT));
-    PetscCall(KSPSolve(ksp2, b, samplectx->mean_exact));
-    PetscCall(KSPDestroy(&ksp2));
+    PetscBool gamgmc_mean = PETSC_FALSE;
+
+    /* Either reuse the sampler's hierarchy for the exact mean or solve with an unpreconditioned KSP */
+    PetscCall(PetscOptionsGetBool(NULL, NULL, "-gamgmc_mean", &gamgmc_mean, NULL));
+    if (gamgmc_mean) {
+      PetscCall(PCGAMGMCComputeMean(pc, b, samplectx->mean_exact));
+    } else {
+      KSP ksp2;
+
+      PetscCall(KSPCreate(MPI_COMM_WORLD, &ksp2));
+      PetscCall(KSPSetOperators(ksp2, Aop, Aop));
+      PetscCall(KSPSetTolerances(ksp2, 1e-12, 1e-12, PETSC_DEFAULT, PETSC_DEFAULT));
+      PetscCall(KSPSolve(ksp2, b, samplectx->mean_exact));
+      PetscCall(KSPDestroy(&ksp2));
+    }
   }
 
-  PetscCall(KSPGetPC(ksp, &pc));
   PetscCall(PCSetSampleCallback(pc, SampleCallbackKSP, &samplectx, SampleCtxDestroy));
   PetscCall(KSPSolve(ksp, b, x));
 
@@ -34,6 +34,8 @@
 #include <mpi.h>
 
 // RUN: %cc %s -o %t %flags && %mpirun -np %NP %t  %opts -ksp_type richardson -pc_type gamgmc -gamgmc_mg_levels_pc_mcgibbs_forward -chains 1000 -ksp_max_it 200 -kappa 1e-4 -gamgmc_pc_gamg_coarse_eq_limit 10 -skip_petscrc
+// RUN: %cc %s -o %t %flags && %mpirun -np %NP %t  %opts -ksp_type richardson -pc_type gamgmc -gamgmc_mg_levels_pc_type mcgibbs -pc_gamgmc_single_precision_levels 2 -chains 1000 -ksp_max_it 200 -kappa 1e-4 -gamgmc_pc_gamg_coarse_eq_limit 10 -skip_petscrc
+// RUN: %cc %s -o %t %flags && %mpirun -np %NP %t  %opts -ksp_type richardson -pc_type gamgmc -gamgmc_mg_levels_pc_type mcgibbs -pc_gamgmc_setup_save %t.setup -chains 1000 -ksp_max_it 200 -kappa 1e-4 -gamgmc_pc_gamg_coarse_eq_limit 10 -skip_petscrc && %mpirun -np %NP %t  %opts -ksp_type richardson -pc_type gamgmc -gamgmc_mg_levels_pc_type mcgibbs -pc_gamgmc_setup_load %t.setup -chains 1000 -ksp_max_it 200 -kappa 1e-4 -gamgmc_pc_gamg_coarse_eq_limit 10 -skip_petscrc
 
 typedef struct {
   Vec            *samples;
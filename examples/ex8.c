@@ -15,6 +15,12 @@
 // Gibbs sampler
 // RUN: %cc %s -o %t %flags && %mpirun -np %NP %t -ksp_type richardson -pc_type sorgibbs -ksp_max_it 100
 
+// Asynchronous (Hogwild) Gibbs sampler with one-sided ghost updates
+// RUN: %cc %s -o %t %flags && %mpirun -np %NP %t -ksp_type richardson -pc_type sorgibbs -pc_sorgibbs_async -pc_sorgibbs_async_max_staleness 2 -ksp_max_it 100 -ksp_view
+
+// Asynchronous Gibbs sampler that always waits for the latest ghost values
+// RUN: %cc %s -o %t %flags && %mpirun -np %NP %t -ksp_type richardson -pc_type sorgibbs -pc_sorgibbs_async -pc_sorgibbs_async_max_staleness 0 -ksp_max_it 100
+
 // MGMC sampler, set up manually using GAMG
 // RUN: %cc %s -o %t %flags && %mpirun -np %NP %t -ksp_type richardson -ksp_max_it 100 -pc_type gamg -prefix_push mg_levels_ -ksp_type richardson -ksp_max_it 1 -pc_type sorgibbs -prefix_pop -prefix_push mg_coarse_ -ksp_type richardson -ksp_max_it 1 -pc_type cholsampler -prefix_pop
 
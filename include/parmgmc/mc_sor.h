@@ -13,18 +13,37 @@
 #include <petscmat.h>
 #include <petscsystypes.h>
 #include <petscvec.h>
+#include <petscviewer.h>
 
 typedef struct _MCSOR {
   void *ctx;
 } *MCSOR;
 
+typedef struct _LRCCorrection *LRCCorrection;
+
 PETSC_EXTERN PetscErrorCode MCSORCreate(Mat, MCSOR *);
+PETSC_EXTERN PetscErrorCode MCSORSetFromOptions(MCSOR);
 PETSC_EXTERN PetscErrorCode MCSORSetUp(MCSOR);
+PETSC_EXTERN PetscErrorCode MCSORUpdateValues(MCSOR);
 PETSC_EXTERN PetscErrorCode MCSORDestroy(MCSOR *);
 PETSC_EXTERN PetscErrorCode MCSORApply(MCSOR, Vec, Vec);
+PETSC_EXTERN PetscErrorCode MCSORApplyBegin(MCSOR, Vec, Vec, Vec);
+PETSC_EXTERN PetscErrorCode MCSORApplyEnd(MCSOR, Vec, Vec);
+PETSC_EXTERN PetscErrorCode MCSORSetResidual(MCSOR, Vec, Vec);
 PETSC_EXTERN PetscErrorCode MCSORSetOmega(MCSOR, PetscReal);
 PETSC_EXTERN PetscErrorCode MCSORSetSweepType(MCSOR, MatSORType);
 PETSC_EXTERN PetscErrorCode MCSORGetSweepType(MCSOR, MatSORType *);
 PETSC_EXTERN PetscErrorCode MCSORGetISColoring(MCSOR, ISColoring *);
+PETSC_EXTERN PetscErrorCode MCSORView(MCSOR, PetscViewer);
 PETSC_EXTERN PetscErrorCode MCSORGetNumColors(MCSOR, PetscInt *);
+PETSC_EXTERN PetscErrorCode MCSORSetNodeAware(MCSOR, PetscBool);
+PETSC_EXTERN PetscErrorCode MCSORSetCommunicationAvoidingDepth(MCSOR, PetscInt);
+PETSC_EXTERN PetscErrorCode MCSORSetSinglePrecision(MCSOR, PetscBool);
+PETSC_EXTERN PetscErrorCode MCSORSaveColoring(Mat, PetscViewer);
+PETSC_EXTERN PetscErrorCode MCSORLoadColoring(Mat, PetscViewer);
 PETSC_EXTERN PetscErrorCode MCSORBuildLRCCorrection(PetscErrorCode (*det_sor)(void *, Vec, Vec), void *, Mat, Mat, Vec, Mat *);
+
+PETSC_EXTERN PetscErrorCode LRCCorrectionCreate(Mat, LRCCorrection *);
+PETSC_EXTERN PetscErrorCode LRCCorrectionBegin(LRCCorrection, Vec, Vec);
+PETSC_EXTERN PetscErrorCode LRCCorrectionEnd(LRCCorrection, Mat, Vec, Vec);
+PETSC_EXTERN PetscErrorCode LRCCorrectionDestroy(LRCCorrection *);
@@ -0,0 +1,37 @@
+/*  ParMGMC - Implementation of the Multigrid Monte Carlo method in PETSc.
+    Copyright (C) 2024  Nils Friess
+
+    This file is part of ParMGMC which is released under the GNU LESSER GENERAL
+    PUBLIC LICENSE (LGPL). See file LICENSE in the project root folder for full
+    license details.
+*/
+
+#pragma once
+
+#include <mpi.h>
+#include <petscsys.h>
+#include <petscmacros.h>
+#include <petscmat.h>
+#include <petscpctypes.h>
+#include <petscvec.h>
+#include <petscviewer.h>
+
+typedef struct _p_MLMC {
+  void *ctx;
+} *MLMC;
+
+PETSC_EXTERN PetscErrorCode MLMCCreate(MPI_Comm, MLMC *);
+PETSC_EXTERN PetscErrorCode MLMCDestroy(MLMC *);
+PETSC_EXTERN PetscErrorCode MLMCSetFromOptions(MLMC);
+PETSC_EXTERN PetscErrorCode MLMCSetUp(MLMC);
+
+PETSC_EXTERN PetscErrorCode MLMCSetHierarchy(MLMC, PetscInt, const Mat[], const Mat[]);
+PETSC_EXTERN PetscErrorCode MLMCSetHierarchyFromPC(MLMC, PC);
+PETSC_EXTERN PetscErrorCode MLMCSetRHS(MLMC, Vec);
+PETSC_EXTERN PetscErrorCode MLMCSetMeasurementVec(MLMC, Vec);
+PETSC_EXTERN PetscErrorCode MLMCSetQOI(MLMC, PetscErrorCode (*)(PetscInt, Vec, PetscScalar *, void *), void *);
+PETSC_EXTERN PetscErrorCode MLMCSetRMSE(MLMC, PetscReal);
+
+PETSC_EXTERN PetscErrorCode MLMCEstimate(MLMC, PetscScalar *);
+PETSC_EXTERN PetscErrorCode MLMCGetLevelStatistics(MLMC, PetscInt, PetscInt *, PetscScalar *, PetscReal *, PetscReal *);
+PETSC_EXTERN PetscErrorCode MLMCView(MLMC, PetscViewer);
@@ -0,0 +1,29 @@
+/*  ParMGMC - Implementation of the Multigrid Monte Carlo method in PETSc.
+    Copyright (C) 2024  Nils Friess
+
+    This file is part of ParMGMC which is released under the GNU LESSER GENERAL
+    PUBLIC LICENSE (LGPL). See file LICENSE in the project root folder for full
+    license details.
+*/
+
+#pragma once
+
+#include <petscis.h>
+#include <petscmacros.h>
+#include <petscsystypes.h>
+#include <petscvec.h>
+
+typedef struct _NodeHalo     *NodeHalo;
+typedef struct _NodeHaloPlan *NodeHaloPlan;
+
+PETSC_EXTERN PetscErrorCode NodeHaloCreate(Vec, PetscInt, NodeHalo *);
+PETSC_EXTERN PetscErrorCode NodeHaloDestroy(NodeHalo *);
+PETSC_EXTERN PetscErrorCode NodeHaloGetNodeSize(NodeHalo, PetscMPIInt *);
+PETSC_EXTERN PetscErrorCode NodeHaloPublish(NodeHalo, PetscInt, Vec, IS);
+PETSC_EXTERN PetscErrorCode NodeHaloFence(NodeHalo);
+PETSC_EXTERN PetscErrorCode NodeHaloWait(NodeHalo);
+PETSC_EXTERN PetscErrorCode NodeHaloPlanCreate(NodeHalo, PetscInt, Vec, IS, Vec, IS, NodeHaloPlan *);
+PETSC_EXTERN PetscErrorCode NodeHaloPlanGetSizes(NodeHaloPlan, PetscInt *, PetscInt *);
+PETSC_EXTERN PetscErrorCode NodeHaloPlanBegin(NodeHaloPlan, Vec, Vec);
+PETSC_EXTERN PetscErrorCode NodeHaloPlanEnd(NodeHaloPlan, Vec, Vec);
+PETSC_EXTERN PetscErrorCode NodeHaloPlanDestroy(NodeHaloPlan *);
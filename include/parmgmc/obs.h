@@ -15,3 +15,4 @@
 #include <petscvec.h>
 
 PETSC_EXTERN PetscErrorCode MakeObservationMats(DM, PetscInt, PetscScalar, const PetscScalar *, PetscScalar *, const PetscScalar *, Mat *, Vec *, Vec *);
+PETSC_EXTERN PetscErrorCode CompressObservationMats(Mat, Vec, PetscReal, Mat *, Vec *);
@@ -10,10 +10,12 @@
 
 #include <petsclogtypes.h>
 #include <petscmacros.h>
+#include <petscmattypes.h>
 #include <petscpctypes.h>
 #include <petscsystypes.h>
 #include <petscvec.h>
 #include <petscversion.h>
+#include <petscviewertypes.h>
 
 /* In PETSc >= 3.23, PetscOptionItems became an opaque pointer typedef;
    before that it was a plain struct and callbacks received a pointer. */
@@ -29,6 +31,7 @@
 #define PCCHOLSAMPLER "cholsampler"
 #define PCPARSOR      "parsor"
 #define PCWOODBURY    "woodbury"
+#define PCPATCHGIBBS  "patchgibbs"
 
 PETSC_EXTERN PetscClassId  PARMGMC_CLASSID;
 PETSC_EXTERN PetscLogEvent MULTICOL_SOR;
@@ -39,6 +42,18 @@ PETSC_EXTERN PetscErrorCode ParMGMCFinalize(void);
 
 PETSC_EXTERN PetscErrorCode PCRegisterSetSampleCallback(PC, PetscErrorCode (*)(PC, PetscErrorCode (*)(PetscInt, Vec, void *), void *, PetscErrorCode (*)(void *)));
 PETSC_EXTERN PetscErrorCode PCSetSampleCallback(PC, PetscErrorCode (*)(PetscInt, Vec, void *), void *, PetscErrorCode (*)(void *));
+PETSC_EXTERN PetscErrorCode PCSetFusedResidual(PC, PetscBool);
+PETSC_EXTERN PetscErrorCode PCGetFusedResidual(PC, Vec, Vec, Vec, PetscBool *);
 
 PETSC_EXTERN PetscErrorCode ParMGMCGetPetscRandom(PetscRandom *);
 PETSC_EXTERN PetscErrorCode VecSetRandomStandardNormal(Vec, PetscRandom);
+PETSC_EXTERN PetscErrorCode VecSetRandomStandardNormalCounter(Vec, PetscInt64, PetscInt64);
+
+PETSC_EXTERN PetscErrorCode ParMGMCMatQueryCache(Mat, const char[], PetscObjectState, void **);
+PETSC_EXTERN PetscErrorCode ParMGMCMatComposeCache(Mat, const char[], PetscObjectState, void *, PetscErrorCode (*)(void *));
+PETSC_EXTERN PetscErrorCode ParMGMCMatComposeInterpolations(PC);
+PETSC_EXTERN PetscErrorCode ParMGMCMatQueryInterpolations(Mat, PetscInt *, Mat **);
+PETSC_EXTERN PetscErrorCode ParMGMCMatSaveSetup(Mat, PetscViewer);
+PETSC_EXTERN PetscErrorCode ParMGMCMatLoadSetup(Mat, PetscViewer, PetscBool *);
+PETSC_EXTERN PetscErrorCode ParMGMCVecRedistribute(Vec, MPI_Comm, PetscInt, Vec *);
+PETSC_EXTERN PetscErrorCode ParMGMCMatRedistribute(Mat, MPI_Comm, PetscInt, PetscInt, Mat *);
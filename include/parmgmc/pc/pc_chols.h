@@ -11,6 +11,15 @@
 #include <petscmacros.h>
 #include <petscpctypes.h>
 #include <petscsystypes.h>
+#include <petscvec.h>
 
 PETSC_EXTERN PetscErrorCode PCCreate_CholSampler(PC);
 PETSC_EXTERN PetscErrorCode PCCholSamplerSetIsCoarseGAMG(PC, PetscBool);
+PETSC_EXTERN PetscErrorCode PCCholSamplerSetRedundant(PC, PetscBool);
+PETSC_EXTERN PetscErrorCode PCCholSamplerSetBatchSize(PC, PetscInt);
+PETSC_EXTERN PetscErrorCode PCCholSamplerGetBatchSize(PC, PetscInt *);
+PETSC_EXTERN PetscErrorCode PCCholSamplerSetWoodbury(PC, PetscBool);
+PETSC_EXTERN PetscErrorCode PCCholSamplerSetLevelScheduling(PC, PetscBool);
+PETSC_EXTERN PetscErrorCode PCCholSamplerApplyInverse(PC, Vec, Vec);
+PETSC_EXTERN PetscErrorCode PCCholSamplerGetSelectedInverse(PC, Mat *, Mat *);
+PETSC_EXTERN PetscErrorCode PCCholSamplerGetVariance(PC, Vec);
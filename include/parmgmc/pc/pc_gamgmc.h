@@ -11,8 +11,30 @@
 #include <petscmacros.h>
 #include <petscpctypes.h>
 #include <petscsystypes.h>
+#include <petscvec.h>
+
+typedef enum {
+  PCGAMGMC_PHASE_SMOOTH,
+  PCGAMGMC_PHASE_RESIDUAL,
+  PCGAMGMC_PHASE_RESTRICT,
+  PCGAMGMC_PHASE_PROLONG,
+  PCGAMGMC_NPHASES
+} PCGAMGMCPhase;
 
 PETSC_EXTERN PetscErrorCode PCGAMGMCSetLevels(PC, PetscInt);
 PETSC_EXTERN PetscErrorCode PCCreate_GAMGMC(PC);
 PETSC_EXTERN PetscErrorCode PCGAMGMCGetInternalPC(PC, PC *);
 PETSC_EXTERN PetscErrorCode PCGAMGMCSetInternalPC(PC, PC);
+PETSC_EXTERN PetscErrorCode PCGAMGMCSetCarryResidual(PC, PetscBool);
+PETSC_EXTERN PetscErrorCode PCGAMGMCSetFusedResidual(PC, PetscBool);
+PETSC_EXTERN PetscErrorCode PCGAMGMCSetAgglomerationLimit(PC, PetscInt);
+PETSC_EXTERN PetscErrorCode PCGAMGMCSetSinglePrecisionLevels(PC, PetscInt);
+PETSC_EXTERN PetscErrorCode PCGAMGMCSetSolveMode(PC, PetscBool);
+PETSC_EXTERN PetscErrorCode PCGAMGMCGetSolverPC(PC, PC *);
+PETSC_EXTERN PetscErrorCode PCGAMGMCComputeMean(PC, Vec, Vec);
+PETSC_EXTERN PetscErrorCode PCGAMGMCSetTiming(PC, PetscBool);
+PETSC_EXTERN PetscErrorCode PCGAMGMCGetLevelStats(PC, PetscInt, PCGAMGMCPhase, PetscLogDouble *, PetscLogDouble *, PetscLogDouble *, PetscLogDouble *);
+PETSC_EXTERN PetscErrorCode PCGAMGMCSetAutotune(PC, PetscBool);
+PETSC_EXTERN PetscErrorCode PCGAMGMCSetAutotuneQOI(PC, PetscErrorCode (*)(PetscInt, Vec, PetscScalar *, void *), void *);
+PETSC_EXTERN PetscErrorCode PCGAMGMCGetAutotunedOptions(PC, const char **);
+PETSC_EXTERN PetscErrorCode PCGAMGMCEstimateVariance(PC, PetscInt, PetscInt, Vec);
@@ -16,3 +16,4 @@
 PETSC_EXTERN PetscErrorCode PCCreate_MulticolorGibbs(PC);
 PETSC_EXTERN PetscErrorCode PCMulticolorGibbsSetOmega(PC, PetscReal);
 PETSC_EXTERN PetscErrorCode PCMulticolorGibbsSetSweepType(PC, MatSORType);
+PETSC_EXTERN PetscErrorCode PCMulticolorGibbsSetSinglePrecision(PC, PetscBool);
@@ -17,5 +17,8 @@ PETSC_EXTERN PetscErrorCode PCCreate_PARSOR(PC);
 PETSC_EXTERN PetscErrorCode PCPARSORSetOmega(PC, PetscReal);
 PETSC_EXTERN PetscErrorCode PCPARSORSetIterations(PC, PetscInt);
 PETSC_EXTERN PetscErrorCode PCPARSORApplySOR(PC, Vec, PetscInt, PetscBool, Vec);
+PETSC_EXTERN PetscErrorCode PCPARSORApplySORWithHooks(PC, Vec, PetscInt, PetscBool, PetscErrorCode (*)(PetscInt, Vec, void *), PetscErrorCode (*)(PetscInt, Vec, void *), void *, Vec);
+PETSC_EXTERN PetscErrorCode PCPARSORSetPipelined(PC, PetscBool);
+PETSC_EXTERN PetscErrorCode PCPARSORSetNodeAware(PC, PetscBool);
 PETSC_EXTERN PetscErrorCode PCPARSORSetOmega(PC, PetscReal);
 PETSC_EXTERN PetscErrorCode PCPARSORSetIterations(PC, PetscInt);
@@ -0,0 +1,24 @@
+/*  ParMGMC - Implementation of the Multigrid Monte Carlo method in PETSc.
+    Copyright (C) 2024  Nils Friess
+
+    This file is part of ParMGMC which is released under the GNU LESSER GENERAL
+    PUBLIC LICENSE (LGPL). See file LICENSE in the project root folder for full
+    license details.
+*/
+
+#pragma once
+
+#include <petscis.h>
+#include <petscmacros.h>
+#include <petscpctypes.h>
+#include <petscsystypes.h>
+
+typedef enum {
+  PC_PATCHGIBBS_STAR,
+  PC_PATCHGIBBS_BLOCK
+} PCPatchGibbsType;
+
+PETSC_EXTERN PetscErrorCode PCCreate_PatchGibbs(PC);
+PETSC_EXTERN PetscErrorCode PCPatchGibbsSetType(PC, PCPatchGibbsType);
+PETSC_EXTERN PetscErrorCode PCPatchGibbsSetBlockSize(PC, PetscInt);
+PETSC_EXTERN PetscErrorCode PCPatchGibbsSetPatches(PC, PetscInt, const IS[]);
@@ -13,3 +13,7 @@
 #include <petscsystypes.h>
 
 PETSC_EXTERN PetscErrorCode PCCreate_SORGibbs(PC pc);
+PETSC_EXTERN PetscErrorCode PCSORGibbsSetAsync(PC, PetscBool, PetscInt);
+PETSC_EXTERN PetscErrorCode PCSORGibbsGetAsyncStats(PC, PetscInt *, PetscReal *, PetscInt *);
+PETSC_EXTERN PetscErrorCode PCSORGibbsSetPARSOROptions(PC, PetscBool, PetscBool);
+PETSC_EXTERN PetscErrorCode PCSORGibbsGetPARSOROptions(PC, PetscBool *, PetscBool *);
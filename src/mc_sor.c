@@ -7,6 +7,7 @@
 */
 
 #include "parmgmc/mc_sor.h"
+#include "parmgmc/nodehalo.h"
 #include "parmgmc/parmgmc.h"
 
 #include <petscerror.h>
@@ -15,10 +16,13 @@
 #include <petsclog.h>
 #include <petscmat.h>
 #include <petscoptions.h>
+#include <petscsf.h>
 #include <petscsftypes.h>
 #include <petscsys.h>
 #include <petscsystypes.h>
+#include <petsctime.h>
 #include <petscvec.h>
+#include <petscviewer.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
@@ -34,10 +38,75 @@
     Implemented for `MATAIJ` and `MATLRC` matrices (with `MATAIJ` as the base
     matrix type).
 
+    With `-mc_sor_node_aware` (or MCSORSetNodeAware()) the ghost values owned
+    by ranks on the same node are read directly from shared memory (see
+    nodehalo.c), only the remaining ghost values go through MPI messages.
+    After each colour every rank publishes the rows of that colour. There
+    is no barrier on the node; before reading its on-node ghost values, a
+    rank only waits until the on-node ranks it reads from have published
+    the previous colour (see NodeHaloWait()). These ranks can then be at
+    most one colour ahead, and since the colouring is a distance-1
+    colouring, no rank reads a value of the colour that is currently being
+    written.
+
+    With `-mc_sor_ca_depth s` (or MCSORSetCommunicationAvoidingDepth()) and
+    s > 1, each rank additionally stores the rows within distance s of its
+    own rows (found with `MatIncreaseOverlap`). One ghost exchange of depth s
+    then suffices for s consecutive colours: the k-th colour of such a block
+    (k = 0, ..., s-1) is updated on all rows within distance s-1-k, so the
+    values needed by the owned rows are computed redundantly instead of being
+    communicated. A sweep then needs ceil(ncolors / s) instead of ncolors
+    exchanges. The right hand side of the overlap rows is exchanged together
+    with the first ghost exchange of each sweep, so the result is the same as
+    in the standard mode (up to rounding). This mode is not supported for
+    `MATLRC` operators (the low-rank part is not fused into the redundant
+    updates of the overlap rows).
+
+    For `MATLRC` matrices, the local part of B^T y needed by the low-rank
+    correction is accumulated in the sweep kernels while the rows are updated
+    and reduced with a non-blocking `MPI_Iallreduce`. Use MCSORApplyBegin()
+    and MCSORApplyEnd() to overlap the reduction with other work; the
+    low-rank noise of the next sweep can be reduced in the same message.
+
+    With MCSORSetSinglePrecision() the sweeps read single precision copies
+    of the matrix values and of the scaled inverse diagonal, and the ghost
+    values are exchanged as single precision numbers (through the star
+    forests of the colour scatters). The iterate and the right hand side
+    stay in double precision. This halves the memory traffic for the matrix
+    and the size of the ghost messages, which is meant for the coarse levels
+    of Multigrid Monte Carlo, where the sweeps are latency and bandwidth
+    bound and only contribute smooth corrections. Not supported together
+    with the node-aware or communication-avoiding modes (an error is
+    raised at the first sweep), and the residual is not fused.
+
+    If only the values of the matrix change (e.g., a new parameter of the
+    prior or a new noise variance), MCSORUpdateValues() refreshes the
+    inverse diagonal, the low-rank corrections and the other value-dependent
+    data; the colouring and the ghost scatters are reused.
+
+    Components that are not needed by every sampler are set up on first use:
+    the ghost scatters at the first sweep, and for `MATLRC` operators the
+    low-rank correction of each sweep direction at the first sweep in that
+    direction (a forward-only sampler never pays for the backward one).
+    MCSORView() lists the time spent on setting up each component.
+
     ## Developer notes
     Should this be a PC?
 */
 
+/* Components whose setup time is reported by MCSORView */
+typedef enum {
+  MCSOR_SETUP_COLORING,
+  MCSOR_SETUP_SCATTERS,
+  MCSOR_SETUP_FORWARD,
+  MCSOR_SETUP_BACKWARD,
+  MCSOR_SETUP_RESIDUAL,
+  MCSOR_SETUP_SINGLE,
+  MCSOR_SETUP_NCOMPONENTS
+} MCSORSetupComponent;
+
+static const char *const MCSORSetupComponentNames[] = {"colouring", "ghost exchange", "forward low-rank correction", "backward low-rank correction", "fused residual", "single precision copies"};
+
 typedef struct _MCSOR_Ctx {
   Mat         A, Asor;
   PetscInt   *diagptrs;
@@ -50,13 +119,69 @@ typedef struct _MCSOR_Ctx {
   ISColoring  isc;
   MatSORType  type;
 
-  Mat B, Bb, Bb_bk;
-  Vec z, w, u;
+  PetscObjectState nnzstate; // Nonzero state of Asor at setup, see MCSORUpdateValues
+
+  Mat           B, Bb, Bb_bk; // Bb and Bb_bk are built at the first sweep in their direction
+  MCSOR         det; // Deterministic sweeps with the base matrix, used to build Bb and Bb_bk
+  Vec           u;
+  LRCCorrection lrc;
+  Mat           lrc_Bb; // Bb or Bb_bk, depending on the direction of the pending correction
+
+  /* Fused residual r = b - A y, requested with MCSORSetResidual */
+  Vec                res_b, res_r;
+  PetscBool          res_fused;
+  PetscInt          *res_color; // colour of each local row
+  const PetscScalar *res_barr;
+  PetscScalar       *res_arr;
+  Vec                res_ghost;
+  VecScatter         res_sct;
+  PetscScalar       *res_ABb[2], *res_BtBb[2], *res_S; // MATLRC: A_d Bb, B^T Bb (forward, backward) and S
+
+  PetscBool     node_aware;
+  NodeHalo      nh;
+  NodeHaloPlan *plans;
+
+  /* Communication-avoiding mode (ca_depth > 1) */
+  PetscInt     ca_depth, ca_nrows, ca_off;
+  Mat         *ca_subs; // rows at distance < ca_depth, columns at distance <= ca_depth
+  IS           ca_isrow, ca_iscol;
+  PetscInt    *ca_pos, *ca_diag, *ca_ptr, *ca_rows;
+  PetscScalar *ca_idiag;
+  Vec          ca_y, ca_b;
+  VecScatter   ca_ysct, ca_bsct;
+
+  /* Single precision mode (MCSORSetSinglePrecision), set up at the first sweep */
+  PetscBool sp;
+  float    *sp_vals, *sp_bvals, *sp_idiag, *sp_y;
+  float   **sp_ghost;
+  PetscInt *sp_nghost;
+
+  PetscLogDouble flops; // Per sweep
+  PetscLogDouble setup_time[MCSOR_SETUP_NCOMPONENTS];
 
   PetscErrorCode (*sor)(struct _MCSOR_Ctx *, Vec, Vec);
-  PetscErrorCode (*postsor)(MCSOR, Vec);
 } *MCSOR_Ctx;
 
+struct _LRCCorrection {
+  MPI_Comm           comm;
+  Mat                B;
+  PetscInt           n, k, lda;
+  const PetscScalar *barr;     // local rows of B
+  PetscScalar       *loc, *red; // [B^T y, eta] before and after the reduction
+  PetscBool          fused, hasy, haseta, pending;
+  MPI_Request        req;
+};
+
+static PetscErrorCode MCSORFreeSingle(MCSOR_Ctx ctx)
+{
+  PetscFunctionBeginUser;
+  if (ctx->sp_ghost)
+    for (PetscInt i = 0; i < ctx->ncolors; ++i) PetscCall(PetscFree(ctx->sp_ghost[i]));
+  PetscCall(PetscFree2(ctx->sp_ghost, ctx->sp_nghost));
+  PetscCall(PetscFree4(ctx->sp_vals, ctx->sp_bvals, ctx->sp_idiag, ctx->sp_y));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
 PetscErrorCode MCSORDestroy(MCSOR *mc)
 {
   PetscFunctionBeginUser;
@@ -68,18 +193,38 @@ PetscErrorCode MCSORDestroy(MCSOR *mc)
       for (PetscInt i = 0; i < ctx->ncolors; ++i) {
         PetscCall(VecScatterDestroy(&ctx->scatters[i]));
         PetscCall(VecDestroy(&ctx->ghostvecs[i]));
+        if (ctx->plans) PetscCall(NodeHaloPlanDestroy(&ctx->plans[i]));
       }
       PetscCall(PetscFree(ctx->ghostvecs));
       PetscCall(PetscFree(ctx->scatters));
+      PetscCall(PetscFree(ctx->plans));
     }
+    PetscCall(NodeHaloDestroy(&ctx->nh));
+
+    if (ctx->ca_subs) PetscCall(MatDestroySubMatrices(1, &ctx->ca_subs));
+    PetscCall(ISDestroy(&ctx->ca_isrow));
+    PetscCall(ISDestroy(&ctx->ca_iscol));
+    PetscCall(PetscFree4(ctx->ca_pos, ctx->ca_diag, ctx->ca_rows, ctx->ca_idiag));
+    PetscCall(PetscFree(ctx->ca_ptr));
+    PetscCall(VecDestroy(&ctx->ca_y));
+    PetscCall(VecDestroy(&ctx->ca_b));
+    PetscCall(VecScatterDestroy(&ctx->ca_ysct));
+    PetscCall(VecScatterDestroy(&ctx->ca_bsct));
     PetscCall(VecDestroy(&ctx->idiag));
 
-    PetscCall(VecDestroy(&ctx->z));
-    PetscCall(VecDestroy(&ctx->w));
     PetscCall(VecDestroy(&ctx->u));
+    PetscCall(LRCCorrectionDestroy(&ctx->lrc));
+
+    PetscCall(PetscFree(ctx->res_color));
+    PetscCall(VecDestroy(&ctx->res_ghost));
+    PetscCall(VecScatterDestroy(&ctx->res_sct));
+    for (PetscInt dir = 0; dir < 2; ++dir) PetscCall(PetscFree2(ctx->res_ABb[dir], ctx->res_BtBb[dir]));
+    PetscCall(PetscFree(ctx->res_S));
 
     PetscCall(MatDestroy(&ctx->Bb));
     PetscCall(MatDestroy(&ctx->Bb_bk));
+    PetscCall(MCSORDestroy(&ctx->det));
+    PetscCall(MCSORFreeSingle(ctx));
 
     PetscCall(ISColoringDestroy(&ctx->isc));
     PetscCall(PetscFree(ctx));
@@ -98,16 +243,146 @@ PetscErrorCode MCSORGetISColoring(MCSOR mc, ISColoring *isc)
   PetscFunctionReturn(PETSC_SUCCESS);
 }
 
-static PetscErrorCode MCSORPostSOR_LRC(MCSOR mc, Vec y)
+/*  Low-rank correction y -= Bb (B^T y) for samplers on `MATLRC` operators.
+
+    B^T y is a global reduction of k values. Instead of a blocking
+    MatMultTranspose, LRCCorrectionBegin computes the local part (or uses the
+    one accumulated by the MCSOR sweep kernels) and starts an MPI_Iallreduce,
+    LRCCorrectionEnd waits for it and applies y -= Bb w locally (all k values
+    of w are known on every rank after the reduction, so no further
+    communication is needed). In between, the caller can draw the noise for
+    the next sweep.
+
+    The low-rank noise B eta of the next sweep (eta is a k-vector with the
+    column layout of B) can be sent along in the same reduction, in which case
+    LRCCorrectionEnd adds it to the next right hand side. */
+PetscErrorCode LRCCorrectionCreate(Mat B, LRCCorrection *lrc)
+{
+  LRCCorrection lc;
+  Mat           Bl;
+
+  PetscFunctionBeginUser;
+  PetscCall(PetscNew(&lc));
+  lc->comm = PetscObjectComm((PetscObject)B);
+  lc->B    = B;
+  PetscCall(MatGetLocalSize(B, &lc->n, NULL));
+  PetscCall(MatGetSize(B, NULL, &lc->k));
+  PetscCall(MatDenseGetLocalMatrix(B, &Bl));
+  PetscCall(MatDenseGetLDA(Bl, &lc->lda));
+  PetscCall(MatDenseGetArrayRead(Bl, &lc->barr));
+  PetscCall(PetscCalloc2(2 * lc->k, &lc->loc, 2 * lc->k, &lc->red));
+  *lrc = lc;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+PetscErrorCode LRCCorrectionDestroy(LRCCorrection *lrc)
 {
-  MCSOR_Ctx ctx = mc->ctx;
+  Mat Bl;
 
   PetscFunctionBeginUser;
-  PetscCall(MatMultTranspose(ctx->B, y, ctx->w));
-  PetscAssert(ctx->type == SOR_FORWARD_SWEEP || ctx->type == SOR_BACKWARD_SWEEP, MPI_COMM_WORLD, PETSC_ERR_PLIB, "Symmetric sweep type should be handled outside this function");
-  if (ctx->type == SOR_FORWARD_SWEEP) PetscCall(MatMult(ctx->Bb, ctx->w, ctx->z));
-  else PetscCall(MatMult(ctx->Bb_bk, ctx->w, ctx->z));
-  PetscCall(VecAXPY(y, -1, ctx->z));
+  if (!*lrc) PetscFunctionReturn(PETSC_SUCCESS);
+  if ((*lrc)->pending) PetscCallMPI(MPI_Wait(&(*lrc)->req, MPI_STATUS_IGNORE));
+  PetscCall(MatDenseGetLocalMatrix((*lrc)->B, &Bl));
+  PetscCall(MatDenseRestoreArrayRead(Bl, &(*lrc)->barr));
+  PetscCall(PetscFree2((*lrc)->loc, (*lrc)->red));
+  PetscCall(PetscFree(*lrc));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Start the reduction of B^T y (if `y` is not NULL) and of the
+    low-rank noise `eta` (if not NULL).
+ */
+PetscErrorCode LRCCorrectionBegin(LRCCorrection lc, Vec y, Vec eta)
+{
+  PetscInt off, cnt;
+
+  PetscFunctionBeginUser;
+  PetscCheck(!lc->pending, PETSC_COMM_SELF, PETSC_ERR_ORDER, "LRCCorrectionEnd must be called before the next LRCCorrectionBegin");
+  if (y && !lc->fused) {
+    const PetscScalar *yarr;
+
+    PetscCall(VecGetArrayRead(y, &yarr));
+    for (PetscInt j = 0; j < lc->k; ++j) {
+      PetscScalar sum = 0;
+
+      for (PetscInt i = 0; i < lc->n; ++i) sum += lc->barr[i + j * lc->lda] * yarr[i];
+      lc->loc[j] = sum;
+    }
+    PetscCall(VecRestoreArrayRead(y, &yarr));
+  }
+  if (eta) {
+    const PetscScalar *earr;
+    PetscInt           rstart, rend;
+
+    PetscCall(VecGetOwnershipRange(eta, &rstart, &rend));
+    PetscCall(PetscArrayzero(lc->loc + lc->k, lc->k));
+    PetscCall(VecGetArrayRead(eta, &earr));
+    for (PetscInt i = rstart; i < rend; ++i) lc->loc[lc->k + i] = earr[i - rstart];
+    PetscCall(VecRestoreArrayRead(eta, &earr));
+  }
+  lc->fused  = PETSC_FALSE;
+  lc->hasy   = y ? PETSC_TRUE : PETSC_FALSE;
+  lc->haseta = eta ? PETSC_TRUE : PETSC_FALSE;
+
+  off = lc->hasy ? 0 : lc->k;
+  cnt = (lc->hasy ? lc->k : 0) + (lc->haseta ? lc->k : 0);
+  if (cnt == 0) PetscFunctionReturn(PETSC_SUCCESS);
+  PetscCallMPI(MPI_Iallreduce(lc->loc + off, lc->red + off, (PetscMPIInt)cnt, MPIU_SCALAR, MPIU_SUM, lc->comm, &lc->req));
+  lc->pending = PETSC_TRUE;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Finish the reduction started with LRCCorrectionBegin, apply
+    y -= Bb (B^T y) and, if `eta` was passed to LRCCorrectionBegin and `rhs`
+    is not NULL, rhs += B eta.
+ */
+PetscErrorCode LRCCorrectionEnd(LRCCorrection lc, Mat Bb, Vec y, Vec rhs)
+{
+  PetscScalar *arr;
+
+  PetscFunctionBeginUser;
+  if (!lc->pending) PetscFunctionReturn(PETSC_SUCCESS);
+  PetscCallMPI(MPI_Wait(&lc->req, MPI_STATUS_IGNORE));
+  lc->pending = PETSC_FALSE;
+
+  if (lc->hasy && y) {
+    Mat                Bbl;
+    const PetscScalar *bbarr;
+    PetscInt           lda;
+
+    PetscCall(MatDenseGetLocalMatrix(Bb, &Bbl));
+    PetscCall(MatDenseGetLDA(Bbl, &lda));
+    PetscCall(MatDenseGetArrayRead(Bbl, &bbarr));
+    PetscCall(VecGetArray(y, &arr));
+    for (PetscInt j = 0; j < lc->k; ++j)
+      for (PetscInt i = 0; i < lc->n; ++i) arr[i] -= bbarr[i + j * lda] * lc->red[j];
+    PetscCall(VecRestoreArray(y, &arr));
+    PetscCall(MatDenseRestoreArrayRead(Bbl, &bbarr));
+  }
+  if (lc->haseta && rhs) {
+    PetscCall(VecGetArray(rhs, &arr));
+    for (PetscInt j = 0; j < lc->k; ++j)
+      for (PetscInt i = 0; i < lc->n; ++i) arr[i] += lc->barr[i + j * lc->lda] * lc->red[lc->k + j];
+    PetscCall(VecRestoreArray(rhs, &arr));
+  }
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* If the operator is a MATLRC, returns the buffer into which the sweep
+   kernels accumulate the local part of B^T y as the rows are updated (NULL
+   otherwise). */
+static PetscErrorCode MCSORGetFusedLRC(MCSOR_Ctx ctx, PetscScalar **wl, const PetscScalar **barr, PetscInt *lda, PetscInt *k)
+{
+  PetscFunctionBeginUser;
+  *wl = NULL;
+  if (ctx->lrc) {
+    PetscCall(PetscArrayzero(ctx->lrc->loc, ctx->lrc->k));
+    ctx->lrc->fused = PETSC_TRUE;
+    *wl             = ctx->lrc->loc;
+    *barr           = ctx->lrc->barr;
+    *lda            = ctx->lrc->lda;
+    *k              = ctx->lrc->k;
+  }
   PetscFunctionReturn(PETSC_SUCCESS);
 }
 
@@ -119,6 +394,22 @@ static PetscErrorCode MCSORUpdateIDiag(MCSOR mc)
   PetscCall(MatGetDiagonal(ctx->Asor, ctx->idiag));
   PetscCall(VecReciprocal(ctx->idiag));
   PetscCall(VecScale(ctx->idiag, ctx->omega));
+  if (ctx->ca_subs) {
+    const PetscScalar *vals;
+
+    PetscCall(MatSeqAIJGetArrayRead(ctx->ca_subs[0], &vals));
+    for (PetscInt i = 0; i < ctx->ca_nrows; ++i) ctx->ca_idiag[i] = ctx->omega / vals[ctx->ca_diag[i]];
+    PetscCall(MatSeqAIJRestoreArrayRead(ctx->ca_subs[0], &vals));
+  }
+  if (ctx->sp_idiag) {
+    const PetscScalar *idiagarr;
+    PetscInt           n;
+
+    PetscCall(VecGetLocalSize(ctx->idiag, &n));
+    PetscCall(VecGetArrayRead(ctx->idiag, &idiagarr));
+    for (PetscInt i = 0; i < n; ++i) ctx->sp_idiag[i] = (float)PetscRealPart(idiagarr[i]);
+    PetscCall(VecRestoreArrayRead(ctx->idiag, &idiagarr));
+  }
   ctx->omega_changed = PETSC_FALSE;
   PetscFunctionReturn(PETSC_SUCCESS);
 }
@@ -149,7 +440,10 @@ static PetscErrorCode MatGetDiagonalPointers(Mat A, PetscInt **diagptrs)
   PetscFunctionReturn(PETSC_SUCCESS);
 }
 
-static PetscErrorCode MatCreateScatters(Mat mat, ISColoring isc, VecScatter **scatters, Vec **ghostvecs)
+/* Creates, for each colour, the sequential vector holding the ghost values
+   needed to update the rows of that colour and either a VecScatter or (if
+   `nh` is not NULL) a node-aware halo plan that fills it. */
+static PetscErrorCode MatCreateScatters(Mat mat, ISColoring isc, NodeHalo nh, VecScatter **scatters, NodeHaloPlan **plans, Vec **ghostvecs)
 {
   PetscInt        ncolors, localRows, globalRows, *nTotalOffProc;
   IS             *iss, is;
@@ -159,8 +453,9 @@ static PetscErrorCode MatCreateScatters(Mat mat, ISColoring isc, VecScatter **sc
 
   PetscFunctionBeginUser;
   PetscCall(ISColoringGetIS(isc, PETSC_USE_POINTER, &ncolors, &iss));
-  PetscCall(PetscMalloc1(ncolors, scatters));
+  PetscCall(PetscCalloc1(ncolors, scatters));
   PetscCall(PetscMalloc1(ncolors, ghostvecs));
+  if (nh) PetscCall(PetscCalloc1(ncolors, plans));
   PetscCall(MatMPIAIJGetSeqAIJ(mat, NULL, &ao, &colmap));
   PetscCall(MatSeqAIJGetCSRAndMemType(ao, &rowptr, &colptr, NULL, NULL));
 
@@ -200,7 +495,8 @@ static PetscErrorCode MatCreateScatters(Mat mat, ISColoring isc, VecScatter **sc
 
     PetscCall(ISCreateGeneral(PETSC_COMM_SELF, nTotalOffProc[color], offProcIdx, PETSC_COPY_VALUES, &is));
     PetscCall(VecCreateSeq(MPI_COMM_SELF, nTotalOffProc[color], &(*ghostvecs)[color]));
-    PetscCall(VecScatterCreate(gvec, is, (*ghostvecs)[color], NULL, &((*scatters)[color])));
+    if (nh) PetscCall(NodeHaloPlanCreate(nh, 0, gvec, is, (*ghostvecs)[color], NULL, &((*plans)[color])));
+    else PetscCall(VecScatterCreate(gvec, is, (*ghostvecs)[color], NULL, &((*scatters)[color])));
     PetscCall(ISDestroy(&is));
   }
 
@@ -213,28 +509,385 @@ static PetscErrorCode MatCreateScatters(Mat mat, ISColoring isc, VecScatter **sc
   PetscFunctionReturn(PETSC_SUCCESS);
 }
 
-PetscErrorCode MCSORApply(MCSOR mc, Vec b, Vec y)
+/* Called by the sweep kernels after row r (of colour `color`) has been
+   updated from yold to yarr[r]. `offsum` is the sum of a_rj y_j over the
+   local off-diagonal entries of the row at the time of the update.
+
+   The residual of row r is final once all its neighbours have been updated.
+   Neighbours of colours that come later in the sweep are still at their old
+   values, they fix up the residual of row r when they are updated (A is
+   symmetric, so row r contains a_jr = a_rj for all its neighbours j). */
+static inline void MCSORFusedResidualRow(MCSOR_Ctx ctx, const PetscInt *rowptr, const PetscInt *colptr, const PetscReal *matvals, PetscInt r, PetscInt color, PetscReal offsum, PetscReal yold, const PetscReal *yarr)
 {
-  MCSOR_Ctx ctx = mc->ctx;
+  const PetscReal dy = yarr[r] - yold;
+
+  ctx->res_arr[r] = ctx->res_barr[r] - offsum - matvals[ctx->diagptrs[r]] * yarr[r];
+  if (ctx->type == SOR_FORWARD_SWEEP) {
+    for (PetscInt k = rowptr[r]; k < rowptr[r + 1]; ++k)
+      if (ctx->res_color[colptr[k]] < color) ctx->res_arr[colptr[k]] -= matvals[k] * dy;
+  } else {
+    for (PetscInt k = rowptr[r]; k < rowptr[r + 1]; ++k)
+      if (ctx->res_color[colptr[k]] > color) ctx->res_arr[colptr[k]] -= matvals[k] * dy;
+  }
+}
+
+/* Sets up the fused residual: the colour of each row and the ghost scatter
+   (structural, only once) and, for MATLRC, the products with the low-rank
+   correction of the current sweep direction (numeric, again after
+   MCSORUpdateValues). */
+static PetscErrorCode MCSORSetUpResidual(MCSOR_Ctx ctx)
+{
+  PetscInt  n, ncolors, nind;
+  IS       *iss;
+  PetscBool is_mpiaij;
+  Mat       ad;
 
   PetscFunctionBeginUser;
-  PetscCall(PetscLogEventBegin(MULTICOL_SOR, ctx->A, b, y, NULL));
-  if (ctx->omega_changed) PetscCall(MCSORUpdateIDiag(mc));
-  if (ctx->type == SOR_SYMMETRIC_SWEEP) {
-    ctx->type = SOR_FORWARD_SWEEP;
-    PetscCall(ctx->sor(ctx, b, y));
-    if (ctx->postsor) PetscCall(ctx->postsor(mc, y));
+  PetscCall(MatGetLocalSize(ctx->Asor, &n, NULL));
+  PetscCall(PetscObjectTypeCompare((PetscObject)ctx->Asor, MATMPIAIJ, &is_mpiaij));
+  if (is_mpiaij) PetscCall(MatMPIAIJGetSeqAIJ(ctx->Asor, &ad, NULL, NULL));
+  else ad = ctx->Asor;
+
+  if (!ctx->res_color) {
+    PetscCall(PetscMalloc1(n, &ctx->res_color));
+    PetscCall(ISColoringGetIS(ctx->isc, PETSC_USE_POINTER, &ncolors, &iss));
+    for (PetscInt color = 0; color < ncolors; ++color) {
+      const PetscInt *rowind;
 
-    ctx->type = SOR_BACKWARD_SWEEP;
-    PetscCall(ctx->sor(ctx, b, y));
-    if (ctx->postsor) PetscCall(ctx->postsor(mc, y));
+      PetscCall(ISGetLocalSize(iss[color], &nind));
+      PetscCall(ISGetIndices(iss[color], &rowind));
+      for (PetscInt i = 0; i < nind; ++i) ctx->res_color[rowind[i]] = color;
+      PetscCall(ISRestoreIndices(iss[color], &rowind));
+    }
+    PetscCall(ISColoringRestoreIS(ctx->isc, PETSC_USE_POINTER, &iss));
+
+    if (is_mpiaij) {
+      Mat             ao;
+      const PetscInt *colmap;
+      PetscInt        nghost;
+      IS              is;
+      Vec             x;
+
+      PetscCall(MatMPIAIJGetSeqAIJ(ctx->Asor, NULL, &ao, &colmap));
+      PetscCall(MatGetSize(ao, NULL, &nghost));
+      PetscCall(ISCreateGeneral(PETSC_COMM_SELF, nghost, colmap, PETSC_USE_POINTER, &is));
+      PetscCall(VecCreateSeq(PETSC_COMM_SELF, nghost, &ctx->res_ghost));
+      PetscCall(MatCreateVecs(ctx->Asor, &x, NULL));
+      PetscCall(VecScatterCreate(x, is, ctx->res_ghost, NULL, &ctx->res_sct));
+      PetscCall(VecDestroy(&x));
+      PetscCall(ISDestroy(&is));
+    }
+  }
 
-    ctx->type = SOR_SYMMETRIC_SWEEP;
-  } else {
-    PetscCall(ctx->sor(ctx, b, y));
-    if (ctx->postsor) PetscCall(ctx->postsor(mc, y));
+  if (ctx->lrc && !ctx->res_ABb[ctx->type == SOR_FORWARD_SWEEP ? 0 : 1]) {
+    const PetscInt    *rowptr, *colptr;
+    PetscScalar       *matvals;
+    const PetscScalar *Sarr;
+    Vec                S, Sall;
+    VecScatter         sct;
+    PetscInt           k   = ctx->lrc->k;
+    const PetscInt     dir = ctx->type == SOR_FORWARD_SWEEP ? 0 : 1;
+
+    /* After the sweep, y is corrected as y - Bb c with c = B^T y. The kernels
+       compute the residual before the correction, so A_d Bb c has to be
+       added and B^T y = c - B^T Bb c is needed for the low-rank term. */
+    PetscCall(PetscMalloc2(n * k, &ctx->res_ABb[dir], k * k, &ctx->res_BtBb[dir]));
+    PetscCall(MatSeqAIJGetCSRAndMemType(ad, &rowptr, &colptr, &matvals, NULL));
+    {
+      Mat                Bbl;
+      const PetscScalar *bbarr;
+      PetscInt           lda;
+
+      PetscCall(MatDenseGetLocalMatrix(dir == 0 ? ctx->Bb : ctx->Bb_bk, &Bbl));
+      PetscCall(MatDenseGetLDA(Bbl, &lda));
+      PetscCall(MatDenseGetArrayRead(Bbl, &bbarr));
+      for (PetscInt j = 0; j < k; ++j) {
+        for (PetscInt i = 0; i < n; ++i) {
+          PetscScalar sum = 0;
+
+          for (PetscInt l = rowptr[i]; l < rowptr[i + 1]; ++l) sum += matvals[l] * bbarr[colptr[l] + j * lda];
+          ctx->res_ABb[dir][i + j * n] = sum;
+        }
+        for (PetscInt p = 0; p < k; ++p) {
+          PetscScalar sum = 0;
+
+          for (PetscInt i = 0; i < n; ++i) sum += ctx->lrc->barr[i + p * ctx->lrc->lda] * bbarr[i + j * lda];
+          ctx->res_BtBb[dir][p + j * k] = sum;
+        }
+      }
+      PetscCall(MatDenseRestoreArrayRead(Bbl, &bbarr));
+      PetscCallMPI(MPI_Allreduce(MPI_IN_PLACE, ctx->res_BtBb[dir], (PetscMPIInt)(k * k), MPIU_SCALAR, MPIU_SUM, ctx->lrc->comm));
+    }
+
+    if (!ctx->res_S) {
+      // S is distributed, every rank needs all k entries
+      PetscCall(PetscMalloc1(k, &ctx->res_S));
+      PetscCall(MatLRCGetMats(ctx->A, NULL, NULL, &S, NULL));
+      PetscCall(VecScatterCreateToAll(S, &sct, &Sall));
+      PetscCall(VecScatterBegin(sct, S, Sall, INSERT_VALUES, SCATTER_FORWARD));
+      PetscCall(VecScatterEnd(sct, S, Sall, INSERT_VALUES, SCATTER_FORWARD));
+      PetscCall(VecGetArrayRead(Sall, &Sarr));
+      PetscCall(PetscArraycpy(ctx->res_S, Sarr, k));
+      PetscCall(VecRestoreArrayRead(Sall, &Sarr));
+      PetscCall(VecScatterDestroy(&sct));
+      PetscCall(VecDestroy(&Sall));
+    }
   }
-  PetscCall(PetscLogEventEnd(MULTICOL_SOR, ctx->A, b, y, NULL));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* Adds the contributions to the residual that the sweep kernels cannot
+   compute: the off-process columns (which need the final ghost values) and,
+   for MATLRC, the low-rank correction and the low-rank part of A. */
+static PetscErrorCode MCSORFinishResidual(MCSOR_Ctx ctx, Vec y)
+{
+  PetscScalar *rarr;
+  PetscInt     n;
+
+  PetscFunctionBeginUser;
+  PetscCall(VecGetLocalSize(y, &n));
+  PetscCall(VecGetArray(ctx->res_r, &rarr));
+  if (ctx->res_sct) {
+    Mat                ao;
+    const PetscInt    *bRowptr, *bColptr;
+    PetscScalar       *bMatvals;
+    const PetscScalar *ghostarr;
+
+    PetscCall(VecScatterBegin(ctx->res_sct, y, ctx->res_ghost, INSERT_VALUES, SCATTER_FORWARD));
+    PetscCall(VecScatterEnd(ctx->res_sct, y, ctx->res_ghost, INSERT_VALUES, SCATTER_FORWARD));
+    PetscCall(MatMPIAIJGetSeqAIJ(ctx->Asor, NULL, &ao, NULL));
+    PetscCall(MatSeqAIJGetCSRAndMemType(ao, &bRowptr, &bColptr, &bMatvals, NULL));
+    PetscCall(VecGetArrayRead(ctx->res_ghost, &ghostarr));
+    for (PetscInt i = 0; i < n; ++i)
+      for (PetscInt k = bRowptr[i]; k < bRowptr[i + 1]; ++k) rarr[i] -= bMatvals[k] * ghostarr[bColptr[k]];
+    PetscCall(VecRestoreArrayRead(ctx->res_ghost, &ghostarr));
+  }
+  if (ctx->lrc) {
+    const PetscInt     k   = ctx->lrc->k;
+    const PetscInt     dir = ctx->lrc_Bb == ctx->Bb ? 0 : 1;
+    const PetscScalar *c   = ctx->lrc->red;
+    PetscScalar       *t;
+
+    PetscCall(PetscMalloc1(k, &t));
+    for (PetscInt p = 0; p < k; ++p) {
+      t[p] = c[p];
+      for (PetscInt j = 0; j < k; ++j) t[p] -= ctx->res_BtBb[dir][p + j * k] * c[j];
+      t[p] *= ctx->res_S[p];
+    }
+    for (PetscInt j = 0; j < k; ++j)
+      for (PetscInt i = 0; i < n; ++i) rarr[i] += ctx->res_ABb[dir][i + j * n] * c[j] - ctx->lrc->barr[i + j * ctx->lrc->lda] * t[j];
+    PetscCall(PetscFree(t));
+  }
+  PetscCall(VecRestoreArray(ctx->res_r, &rarr));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* Creates the single precision copies of the matrix values and the inverse
+   diagonal and the buffers for the single precision ghost exchange. */
+static PetscErrorCode MCSORSetUpSingle(MCSOR_Ctx ctx)
+{
+  Mat                ad, ao = NULL;
+  const PetscInt    *rowptr;
+  const PetscScalar *vals, *idiagarr;
+  PetscInt           n, nnz, bnnz = 0;
+  PetscBool          ismpi;
+
+  PetscFunctionBeginUser;
+  PetscCheck(!ctx->nh && !ctx->ca_subs, PetscObjectComm((PetscObject)ctx->A), PETSC_ERR_SUP, "Single precision sweeps are not supported in node-aware or communication-avoiding mode");
+  PetscCall(PetscObjectTypeCompare((PetscObject)ctx->Asor, MATMPIAIJ, &ismpi));
+  if (ismpi) PetscCall(MatMPIAIJGetSeqAIJ(ctx->Asor, &ad, &ao, NULL));
+  else ad = ctx->Asor;
+  PetscCall(MatGetLocalSize(ad, &n, NULL));
+  PetscCall(MatSeqAIJGetCSRAndMemType(ad, &rowptr, NULL, NULL, NULL));
+  nnz = rowptr[n];
+  if (ao) {
+    PetscCall(MatSeqAIJGetCSRAndMemType(ao, &rowptr, NULL, NULL, NULL));
+    bnnz = rowptr[n];
+  }
+  PetscCall(PetscMalloc4(nnz, &ctx->sp_vals, bnnz, &ctx->sp_bvals, n, &ctx->sp_idiag, ao ? n : 0, &ctx->sp_y));
+
+  PetscCall(MatSeqAIJGetArrayRead(ad, &vals));
+  for (PetscInt k = 0; k < nnz; ++k) ctx->sp_vals[k] = (float)PetscRealPart(vals[k]);
+  PetscCall(MatSeqAIJRestoreArrayRead(ad, &vals));
+  if (ao) {
+    PetscCall(MatSeqAIJGetArrayRead(ao, &vals));
+    for (PetscInt k = 0; k < bnnz; ++k) ctx->sp_bvals[k] = (float)PetscRealPart(vals[k]);
+    PetscCall(MatSeqAIJRestoreArrayRead(ao, &vals));
+
+    PetscCall(PetscMalloc2(ctx->ncolors, &ctx->sp_ghost, ctx->ncolors, &ctx->sp_nghost));
+    for (PetscInt i = 0; i < ctx->ncolors; ++i) {
+      PetscCall(VecGetLocalSize(ctx->ghostvecs[i], &ctx->sp_nghost[i]));
+      PetscCall(PetscMalloc1(ctx->sp_nghost[i], &ctx->sp_ghost[i]));
+    }
+  }
+
+  PetscCall(VecGetArrayRead(ctx->idiag, &idiagarr));
+  for (PetscInt i = 0; i < n; ++i) ctx->sp_idiag[i] = (float)PetscRealPart(idiagarr[i]);
+  PetscCall(VecRestoreArrayRead(ctx->idiag, &idiagarr));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* Sweep with the single precision matrix values (sequential and parallel).
+   The ghost values of each colour are sent as floats: the colour scatters
+   are star forests whose roots are the owned entries, so they are applied
+   to a single precision copy of the owned part of y that is kept up to date
+   while the rows are updated. */
+static PetscErrorCode MCSORApply_Single(MCSOR_Ctx ctx, Vec b, Vec y)
+{
+  Mat              ad, ao = NULL;
+  PetscInt         n, nind, ncolors;
+  const PetscInt  *rowptr, *colptr, *bRowptr = NULL, *rowind;
+  const PetscReal *barr;
+  PetscReal       *yarr;
+  IS              *iss;
+  PetscScalar     *wl;
+  const PetscReal *lrcarr = NULL;
+  PetscInt         lda = 0, nlr = 0;
+  const PetscBool  fwd = ctx->type == SOR_FORWARD_SWEEP ? PETSC_TRUE : PETSC_FALSE;
+  PetscBool        ismpi;
+
+  PetscFunctionBeginUser;
+  PetscCall(PetscObjectTypeCompare((PetscObject)ctx->Asor, MATMPIAIJ, &ismpi));
+  if (ismpi) PetscCall(MatMPIAIJGetSeqAIJ(ctx->Asor, &ad, &ao, NULL));
+  else ad = ctx->Asor;
+  PetscCall(MatGetLocalSize(ad, &n, NULL));
+  PetscCall(MatSeqAIJGetCSRAndMemType(ad, &rowptr, &colptr, NULL, NULL));
+  if (ao) PetscCall(MatSeqAIJGetCSRAndMemType(ao, &bRowptr, NULL, NULL, NULL));
+  PetscCall(MCSORGetFusedLRC(ctx, &wl, &lrcarr, &lda, &nlr));
+  PetscCall(ISColoringGetIS(ctx->isc, PETSC_USE_POINTER, &ncolors, &iss));
+  PetscCall(VecGetArrayRead(b, &barr));
+  PetscCall(VecGetArray(y, &yarr));
+  if (ao)
+    for (PetscInt i = 0; i < n; ++i) ctx->sp_y[i] = (float)yarr[i];
+
+  for (PetscInt c = 0; c < ncolors; ++c) {
+    const PetscInt color = fwd ? c : ncolors - 1 - c;
+    const float   *ghost = NULL;
+    PetscInt       gcnt  = 0;
+
+    if (ao) {
+      PetscCall(PetscSFBcastBegin(ctx->scatters[color], MPI_FLOAT, ctx->sp_y, ctx->sp_ghost[color], MPI_REPLACE));
+      PetscCall(PetscSFBcastEnd(ctx->scatters[color], MPI_FLOAT, ctx->sp_y, ctx->sp_ghost[color], MPI_REPLACE));
+      ghost = ctx->sp_ghost[color];
+      // The ghost values are laid out in forward row order
+      if (!fwd) gcnt = ctx->sp_nghost[color];
+    }
+
+    PetscCall(ISGetLocalSize(iss[color], &nind));
+    PetscCall(ISGetIndices(iss[color], &rowind));
+    for (PetscInt i = 0; i < nind; ++i) {
+      const PetscInt r   = rowind[fwd ? i : nind - 1 - i];
+      PetscReal      sum = barr[r];
+
+      for (PetscInt k = rowptr[r]; k < ctx->diagptrs[r]; ++k) sum -= ctx->sp_vals[k] * yarr[colptr[k]];
+      for (PetscInt k = ctx->diagptrs[r] + 1; k < rowptr[r + 1]; ++k) sum -= ctx->sp_vals[k] * yarr[colptr[k]];
+      if (ao) {
+        PetscInt go;
+
+        if (!fwd) gcnt -= bRowptr[r + 1] - bRowptr[r];
+        go = gcnt;
+        for (PetscInt k = bRowptr[r]; k < bRowptr[r + 1]; ++k) sum -= ctx->sp_bvals[k] * ghost[go++];
+        if (fwd) gcnt = go;
+      }
+
+      yarr[r] = (1 - ctx->omega) * yarr[r] + ctx->sp_idiag[r] * sum;
+      if (ao) ctx->sp_y[r] = (float)yarr[r];
+      if (wl)
+        for (PetscInt j = 0; j < nlr; ++j) wl[j] += lrcarr[r + j * lda] * yarr[r];
+    }
+    PetscCall(ISRestoreIndices(iss[color], &rowind));
+  }
+
+  PetscCall(VecRestoreArray(y, &yarr));
+  PetscCall(VecRestoreArrayRead(b, &barr));
+  PetscCall(ISColoringRestoreIS(ctx->isc, PETSC_USE_POINTER, &iss));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* One sweep in the direction ctx->type, starting the low-rank correction.
+   If `withres` is true and a residual was requested, the sweep kernels also
+   compute it. */
+static PetscErrorCode MCSORSweep(MCSOR_Ctx ctx, Vec b, Vec y, Vec eta, PetscBool withres)
+{
+  PetscFunctionBeginUser;
+  if (ctx->sp && !ctx->sp_vals) {
+    PetscLogDouble t0, t1;
+
+    PetscCall(PetscTime(&t0));
+    PetscCall(MCSORSetUpSingle(ctx));
+    PetscCall(PetscTime(&t1));
+    ctx->setup_time[MCSOR_SETUP_SINGLE] += t1 - t0;
+  }
+  withres = withres && ctx->res_r && !ctx->ca_subs && !ctx->sp ? PETSC_TRUE : PETSC_FALSE;
+  if (withres) {
+    if (!ctx->res_color || (ctx->lrc && !ctx->res_ABb[ctx->type == SOR_FORWARD_SWEEP ? 0 : 1])) {
+      PetscLogDouble t0, t1;
+
+      PetscCall(PetscTime(&t0));
+      PetscCall(MCSORSetUpResidual(ctx));
+      PetscCall(PetscTime(&t1));
+      ctx->setup_time[MCSOR_SETUP_RESIDUAL] += t1 - t0;
+    }
+    PetscCall(VecGetArrayRead(ctx->res_b, &ctx->res_barr));
+    PetscCall(VecGetArray(ctx->res_r, &ctx->res_arr));
+  }
+  if (ctx->sp) PetscCall(MCSORApply_Single(ctx, b, y));
+  else PetscCall(ctx->sor(ctx, b, y));
+  PetscCall(PetscLogFlops(ctx->flops));
+  if (withres) {
+    PetscCall(VecRestoreArray(ctx->res_r, &ctx->res_arr));
+    PetscCall(VecRestoreArrayRead(ctx->res_b, &ctx->res_barr));
+    ctx->res_arr   = NULL;
+    ctx->res_fused = PETSC_TRUE;
+  }
+  if (ctx->lrc) {
+    PetscCall(LRCCorrectionBegin(ctx->lrc, y, eta));
+    ctx->lrc_Bb = ctx->type == SOR_FORWARD_SWEEP ? ctx->Bb : ctx->Bb_bk;
+  }
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Complete the sweep started with MCSORApplyBegin. If `eta` was
+    passed there, B eta is added to `rhs`.
+ */
+PetscErrorCode MCSORApplyEnd(MCSOR mc, Vec y, Vec rhs)
+{
+  MCSOR_Ctx ctx = mc->ctx;
+
+  PetscFunctionBeginUser;
+  if (ctx->lrc) PetscCall(LRCCorrectionEnd(ctx->lrc, ctx->lrc_Bb, y, rhs));
+  if (ctx->res_r) {
+    if (ctx->res_fused) PetscCall(MCSORFinishResidual(ctx, y));
+    else PetscCall(MatResidual(ctx->A, ctx->res_b, y, ctx->res_r));
+    ctx->res_b     = NULL;
+    ctx->res_r     = NULL;
+    ctx->res_fused = PETSC_FALSE;
+  }
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Request that the next sweep (the last sweep if the sweep type is
+    symmetric) also computes the residual r = b - A y of the final y. The
+    residual is computed in the same pass over the matrix as the sweep and
+    is available after MCSORApplyEnd (or MCSORApply). Requires a symmetric
+    matrix. The request is cleared after the sweep.
+ */
+PetscErrorCode MCSORSetResidual(MCSOR mc, Vec b, Vec r)
+{
+  MCSOR_Ctx ctx = mc->ctx;
+
+  PetscFunctionBeginUser;
+  ctx->res_b     = b;
+  ctx->res_r     = r;
+  ctx->res_fused = PETSC_FALSE;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+PetscErrorCode MCSORApply(MCSOR mc, Vec b, Vec y)
+{
+  PetscFunctionBeginUser;
+  PetscCall(MCSORApplyBegin(mc, b, y, NULL));
+  PetscCall(MCSORApplyEnd(mc, y, NULL));
   PetscFunctionReturn(PETSC_SUCCESS);
 }
 
@@ -245,9 +898,13 @@ static PetscErrorCode MCSORApply_SEQAIJ(MCSOR_Ctx ctx, Vec b, Vec y)
   const PetscReal *idiagarr, *barr;
   PetscReal       *matvals, *yarr;
   IS              *iss;
+  PetscScalar     *wl;
+  const PetscReal *lrcarr = NULL;
+  PetscInt         lda = 0, nlr = 0;
 
   PetscFunctionBeginUser;
   PetscCall(MatSeqAIJGetCSRAndMemType(ctx->Asor, &rowptr, &colptr, &matvals, NULL));
+  PetscCall(MCSORGetFusedLRC(ctx, &wl, &lrcarr, &lda, &nlr));
   PetscCall(ISColoringGetIS(ctx->isc, PETSC_USE_POINTER, &ncolors, &iss));
   PetscCall(VecGetArrayRead(ctx->idiag, &idiagarr));
   PetscCall(VecGetArrayRead(b, &barr));
@@ -258,13 +915,17 @@ static PetscErrorCode MCSORApply_SEQAIJ(MCSOR_Ctx ctx, Vec b, Vec y)
       PetscCall(ISGetLocalSize(iss[color], &nind));
       PetscCall(ISGetIndices(iss[color], &rowind));
       for (PetscInt i = 0; i < nind; ++i) {
-        const PetscInt r   = rowind[i];
-        PetscReal      sum = barr[r];
+        const PetscInt  r    = rowind[i];
+        const PetscReal yold = yarr[r];
+        PetscReal       sum  = barr[r];
 
         for (PetscInt k = rowptr[r]; k < ctx->diagptrs[r]; ++k) sum -= matvals[k] * yarr[colptr[k]];
         for (PetscInt k = ctx->diagptrs[r] + 1; k < rowptr[r + 1]; ++k) sum -= matvals[k] * yarr[colptr[k]];
 
         yarr[r] = (1. - ctx->omega) * yarr[r] + idiagarr[r] * sum;
+        if (ctx->res_arr) MCSORFusedResidualRow(ctx, rowptr, colptr, matvals, r, color, barr[r] - sum, yold, yarr);
+        if (wl)
+          for (PetscInt j = 0; j < nlr; ++j) wl[j] += lrcarr[r + j * lda] * yarr[r];
       }
 
       PetscCall(ISRestoreIndices(iss[color], &rowind));
@@ -275,13 +936,17 @@ static PetscErrorCode MCSORApply_SEQAIJ(MCSOR_Ctx ctx, Vec b, Vec y)
       PetscCall(ISGetLocalSize(iss[color], &nind));
       PetscCall(ISGetIndices(iss[color], &rowind));
       for (PetscInt i = nind - 1; i >= 0; --i) {
-        const PetscInt r   = rowind[i];
-        PetscReal      sum = barr[r];
+        const PetscInt  r    = rowind[i];
+        const PetscReal yold = yarr[r];
+        PetscReal       sum  = barr[r];
 
         for (PetscInt k = rowptr[r]; k < ctx->diagptrs[r]; ++k) sum -= matvals[k] * yarr[colptr[k]];
         for (PetscInt k = ctx->diagptrs[r] + 1; k < rowptr[r + 1]; ++k) sum -= matvals[k] * yarr[colptr[k]];
 
         yarr[r] = (1. - ctx->omega) * yarr[r] + idiagarr[r] * sum;
+        if (ctx->res_arr) MCSORFusedResidualRow(ctx, rowptr, colptr, matvals, r, color, barr[r] - sum, yold, yarr);
+        if (wl)
+          for (PetscInt j = 0; j < nlr; ++j) wl[j] += lrcarr[r + j * lda] * yarr[r];
       }
 
       PetscCall(ISRestoreIndices(iss[color], &rowind));
@@ -295,6 +960,20 @@ static PetscErrorCode MCSORApply_SEQAIJ(MCSOR_Ctx ctx, Vec b, Vec y)
   PetscFunctionReturn(PETSC_SUCCESS);
 }
 
+static PetscErrorCode MCSORGhostExchange(MCSOR_Ctx ctx, PetscInt color, Vec y)
+{
+  PetscFunctionBeginUser;
+  if (ctx->nh) {
+    PetscCall(NodeHaloPlanBegin(ctx->plans[color], y, ctx->ghostvecs[color]));
+    PetscCall(NodeHaloWait(ctx->nh));
+    PetscCall(NodeHaloPlanEnd(ctx->plans[color], y, ctx->ghostvecs[color]));
+  } else {
+    PetscCall(VecScatterBegin(ctx->scatters[color], y, ctx->ghostvecs[color], INSERT_VALUES, SCATTER_FORWARD));
+    PetscCall(VecScatterEnd(ctx->scatters[color], y, ctx->ghostvecs[color], INSERT_VALUES, SCATTER_FORWARD));
+  }
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
 static PetscErrorCode MCSORApply_MPIAIJ(MCSOR_Ctx ctx, Vec b, Vec y)
 {
   Mat              ad, ao; // Local and off-processor parts of mat
@@ -303,8 +982,12 @@ static PetscErrorCode MCSORApply_MPIAIJ(MCSOR_Ctx ctx, Vec b, Vec y)
   const PetscReal *idiagarr, *barr, *ghostarr;
   PetscReal       *matvals, *bMatvals, *yarr;
   IS              *iss;
+  PetscScalar     *wl;
+  const PetscReal *lrcarr = NULL;
+  PetscInt         lda = 0, nlr = 0;
 
   PetscFunctionBeginUser;
+  PetscCall(MCSORGetFusedLRC(ctx, &wl, &lrcarr, &lda, &nlr));
   PetscCall(MatMPIAIJGetSeqAIJ(ctx->Asor, &ad, &ao, NULL));
   PetscCall(MatSeqAIJGetCSRAndMemType(ad, &rowptr, &colptr, &matvals, NULL));
   PetscCall(MatSeqAIJGetCSRAndMemType(ao, &bRowptr, &bColptr, &bMatvals, NULL));
@@ -313,10 +996,14 @@ static PetscErrorCode MCSORApply_MPIAIJ(MCSOR_Ctx ctx, Vec b, Vec y)
   PetscCall(VecGetArrayRead(ctx->idiag, &idiagarr));
   PetscCall(VecGetArrayRead(b, &barr));
 
+  if (ctx->nh) {
+    PetscCall(NodeHaloWait(ctx->nh));
+    PetscCall(NodeHaloPublish(ctx->nh, 0, y, NULL));
+  }
+
   if (ctx->type == SOR_FORWARD_SWEEP) {
     for (PetscInt color = 0; color < ncolors; ++color) {
-      PetscCall(VecScatterBegin(ctx->scatters[color], y, ctx->ghostvecs[color], INSERT_VALUES, SCATTER_FORWARD));
-      PetscCall(VecScatterEnd(ctx->scatters[color], y, ctx->ghostvecs[color], INSERT_VALUES, SCATTER_FORWARD));
+      PetscCall(MCSORGhostExchange(ctx, color, y));
       PetscCall(VecGetArrayRead(ctx->ghostvecs[color], &ghostarr));
 
       PetscCall(ISGetLocalSize(iss[color], &nind));
@@ -325,25 +1012,31 @@ static PetscErrorCode MCSORApply_MPIAIJ(MCSOR_Ctx ctx, Vec b, Vec y)
 
       gcnt = 0;
       for (PetscInt i = 0; i < nind; ++i) {
-        PetscReal sum = 0;
+        const PetscReal yold = yarr[rowind[i]];
+        PetscReal       sum  = 0, dsum;
 
         for (PetscInt k = rowptr[rowind[i]]; k < ctx->diagptrs[rowind[i]]; ++k) sum -= matvals[k] * yarr[colptr[k]];
         for (PetscInt k = ctx->diagptrs[rowind[i]] + 1; k < rowptr[rowind[i] + 1]; ++k) sum -= matvals[k] * yarr[colptr[k]];
+        dsum = sum;
         for (PetscInt k = bRowptr[rowind[i]]; k < bRowptr[rowind[i] + 1]; ++k) sum -= bMatvals[k] * ghostarr[gcnt++];
 
         yarr[rowind[i]] = (1 - ctx->omega) * yarr[rowind[i]] + idiagarr[rowind[i]] * (sum + barr[rowind[i]]);
+        if (ctx->res_arr) MCSORFusedResidualRow(ctx, rowptr, colptr, matvals, rowind[i], color, -dsum, yold, yarr);
+        if (wl)
+          for (PetscInt j = 0; j < nlr; ++j) wl[j] += lrcarr[rowind[i] + j * lda] * yarr[rowind[i]];
       }
 
       PetscCall(VecRestoreArray(y, &yarr));
       PetscCall(VecRestoreArrayRead(ctx->ghostvecs[color], &ghostarr));
       PetscCall(ISRestoreIndices(iss[color], &rowind));
+
+      if (ctx->nh) PetscCall(NodeHaloPublish(ctx->nh, 0, y, iss[color]));
     }
   }
 
   if (ctx->type == SOR_BACKWARD_SWEEP) {
     for (PetscInt color = ncolors - 1; color >= 0; --color) {
-      PetscCall(VecScatterBegin(ctx->scatters[color], y, ctx->ghostvecs[color], INSERT_VALUES, SCATTER_FORWARD));
-      PetscCall(VecScatterEnd(ctx->scatters[color], y, ctx->ghostvecs[color], INSERT_VALUES, SCATTER_FORWARD));
+      PetscCall(MCSORGhostExchange(ctx, color, y));
       PetscCall(VecGetArrayRead(ctx->ghostvecs[color], &ghostarr));
 
       PetscCall(ISGetLocalSize(iss[color], &nind));
@@ -357,20 +1050,28 @@ static PetscErrorCode MCSORApply_MPIAIJ(MCSOR_Ctx ctx, Vec b, Vec y)
       PetscCall(VecGetLocalSize(ctx->ghostvecs[color], &ghostSize));
       gcnt = ghostSize;
       for (PetscInt i = nind - 1; i >= 0; --i) {
-        PetscReal sum = 0;
+        const PetscReal yold = yarr[rowind[i]];
+        PetscReal       sum  = 0, dsum;
         gcnt -= bRowptr[rowind[i] + 1] - bRowptr[rowind[i]];
 
         for (PetscInt k = rowptr[rowind[i]]; k < ctx->diagptrs[rowind[i]]; ++k) sum -= matvals[k] * yarr[colptr[k]];
         for (PetscInt k = ctx->diagptrs[rowind[i]] + 1; k < rowptr[rowind[i] + 1]; ++k) sum -= matvals[k] * yarr[colptr[k]];
+        dsum = sum;
+
         PetscInt go = gcnt;
         for (PetscInt k = bRowptr[rowind[i]]; k < bRowptr[rowind[i] + 1]; ++k) sum -= bMatvals[k] * ghostarr[go++];
 
         yarr[rowind[i]] = (1 - ctx->omega) * yarr[rowind[i]] + idiagarr[rowind[i]] * (sum + barr[rowind[i]]);
+        if (ctx->res_arr) MCSORFusedResidualRow(ctx, rowptr, colptr, matvals, rowind[i], color, -dsum, yold, yarr);
+        if (wl)
+          for (PetscInt j = 0; j < nlr; ++j) wl[j] += lrcarr[rowind[i] + j * lda] * yarr[rowind[i]];
       }
 
       PetscCall(VecRestoreArray(y, &yarr));
       PetscCall(VecRestoreArrayRead(ctx->ghostvecs[color], &ghostarr));
       PetscCall(ISRestoreIndices(iss[color], &rowind));
+
+      if (ctx->nh) PetscCall(NodeHaloPublish(ctx->nh, 0, y, iss[color]));
     }
   }
 
@@ -380,6 +1081,220 @@ static PetscErrorCode MCSORApply_MPIAIJ(MCSOR_Ctx ctx, Vec b, Vec y)
   PetscFunctionReturn(PETSC_SUCCESS);
 }
 
+/* Copies the owned part of the global vector `x` into (or, if `toloc` is
+   false, out of) the overlapped local vector `xloc`. */
+static PetscErrorCode MCSORCACopyOwned(MCSOR_Ctx ctx, Vec x, Vec xloc, PetscBool toloc)
+{
+  const PetscScalar *src;
+  PetscScalar       *dst;
+  PetscInt           n;
+
+  PetscFunctionBeginUser;
+  PetscCall(VecGetLocalSize(x, &n));
+  if (toloc) {
+    PetscCall(VecGetArrayRead(x, &src));
+    PetscCall(VecGetArray(xloc, &dst));
+    PetscCall(PetscArraycpy(dst + ctx->ca_off, src, n));
+    PetscCall(VecRestoreArray(xloc, &dst));
+    PetscCall(VecRestoreArrayRead(x, &src));
+  } else {
+    PetscCall(VecGetArrayRead(xloc, &src));
+    PetscCall(VecGetArray(x, &dst));
+    PetscCall(PetscArraycpy(dst, src + ctx->ca_off, n));
+    PetscCall(VecRestoreArray(x, &dst));
+    PetscCall(VecRestoreArrayRead(xloc, &src));
+  }
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+static PetscErrorCode MCSORApply_MPIAIJ_CA(MCSOR_Ctx ctx, Vec b, Vec y)
+{
+  const PetscInt     s = ctx->ca_depth, ncolors = ctx->ncolors;
+  const PetscInt    *rowptr, *colptr;
+  const PetscScalar *barr;
+  PetscScalar       *matvals, *yarr;
+
+  PetscFunctionBeginUser;
+  PetscCall(MatSeqAIJGetCSRAndMemType(ctx->ca_subs[0], &rowptr, &colptr, &matvals, NULL));
+
+  PetscCall(MCSORCACopyOwned(ctx, b, ctx->ca_b, PETSC_TRUE));
+  PetscCall(MCSORCACopyOwned(ctx, y, ctx->ca_y, PETSC_TRUE));
+  PetscCall(VecScatterBegin(ctx->ca_bsct, b, ctx->ca_b, INSERT_VALUES, SCATTER_FORWARD));
+  PetscCall(VecScatterBegin(ctx->ca_ysct, y, ctx->ca_y, INSERT_VALUES, SCATTER_FORWARD));
+  PetscCall(VecScatterEnd(ctx->ca_bsct, b, ctx->ca_b, INSERT_VALUES, SCATTER_FORWARD));
+
+  // Colours are processed in blocks of s; the backward sweep walks the colours in reverse
+  for (PetscInt blk = 0; blk < ncolors; blk += s) {
+    if (blk > 0) PetscCall(VecScatterBegin(ctx->ca_ysct, y, ctx->ca_y, INSERT_VALUES, SCATTER_FORWARD));
+    PetscCall(VecScatterEnd(ctx->ca_ysct, y, ctx->ca_y, INSERT_VALUES, SCATTER_FORWARD));
+
+    PetscCall(VecGetArray(ctx->ca_y, &yarr));
+    PetscCall(VecGetArrayRead(ctx->ca_b, &barr));
+    for (PetscInt k = 0; k < s && blk + k < ncolors; ++k) {
+      const PetscInt color = ctx->type == SOR_FORWARD_SWEEP ? blk + k : ncolors - 1 - blk - k;
+
+      // Rows of this colour at distance <= s - 1 - k from the owned rows
+      for (PetscInt j = ctx->ca_ptr[color * s]; j < ctx->ca_ptr[color * s + s - k]; ++j) {
+        const PetscInt i = ctx->ca_rows[j], r = ctx->ca_pos[i];
+        PetscScalar    sum = barr[r];
+
+        for (PetscInt kk = rowptr[i]; kk < ctx->ca_diag[i]; ++kk) sum -= matvals[kk] * yarr[colptr[kk]];
+        for (PetscInt kk = ctx->ca_diag[i] + 1; kk < rowptr[i + 1]; ++kk) sum -= matvals[kk] * yarr[colptr[kk]];
+
+        yarr[r] = (1 - ctx->omega) * yarr[r] + ctx->ca_idiag[i] * sum;
+      }
+    }
+    PetscCall(VecRestoreArrayRead(ctx->ca_b, &barr));
+    PetscCall(VecRestoreArray(ctx->ca_y, &yarr));
+
+    PetscCall(MCSORCACopyOwned(ctx, y, ctx->ca_y, PETSC_FALSE));
+  }
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* Sets up the communication-avoiding mode: finds the rows within distance
+   ca_depth of the owned rows, extracts the local overlapped matrix and sorts
+   the rows that are updated redundantly by colour and distance. */
+static PetscErrorCode MCSORSetUpCA(MCSOR_Ctx ctx)
+{
+  Mat                A = ctx->Asor;
+  const PetscInt     s = ctx->ca_depth;
+  PetscInt           rstart, rend, m = 0, nprev = 0, *prev = NULL, *depth = NULL, ncolors, *rowidx, *from, *to, nhalo = 0, *cursor;
+  const PetscInt    *idx, *rowptr, *colptr;
+  PetscScalar       *matvals, *carr;
+  const PetscScalar *clocarr;
+  IS                 is, isrow, iscol, isfrom, isto, *iss;
+  Vec                cvec, cloc;
+  VecScatter         sct;
+
+  PetscFunctionBeginUser;
+  PetscCall(MatGetOwnershipRange(A, &rstart, &rend));
+  PetscCall(ISCreateStride(PETSC_COMM_SELF, rend - rstart, rstart, 1, &is));
+
+  // Grow the owned rows one layer at a time to find the distance of each overlap row
+  for (PetscInt t = 0; t <= s; ++t) {
+    PetscInt *cur;
+
+    if (t > 0) PetscCall(MatIncreaseOverlap(A, 1, &is, 1));
+    PetscCall(ISSort(is));
+    PetscCall(ISGetLocalSize(is, &m));
+    PetscCall(ISGetIndices(is, &idx));
+    PetscCall(PetscMalloc1(m, &cur));
+    for (PetscInt i = 0; i < m; ++i) {
+      PetscInt loc;
+
+      PetscCall(PetscFindInt(idx[i], nprev, prev, &loc));
+      cur[i] = loc >= 0 ? depth[loc] : t;
+    }
+    PetscCall(PetscFree(depth));
+    depth = cur;
+    PetscCall(PetscFree(prev));
+    PetscCall(PetscMalloc1(m, &prev));
+    PetscCall(PetscArraycpy(prev, idx, m));
+    nprev = m;
+    PetscCall(ISRestoreIndices(is, &idx));
+  }
+  PetscCall(ISDestroy(&is));
+
+  // prev now holds the (sorted) global indices of all rows at distance <= s
+  ctx->ca_off = 0;
+  for (PetscInt i = 0; i < m; ++i) {
+    if (prev[i] == rstart) ctx->ca_off = i;
+    if (prev[i] < rstart || prev[i] >= rend) nhalo++;
+  }
+
+  ctx->ca_nrows = 0;
+  for (PetscInt i = 0; i < m; ++i)
+    if (depth[i] < s) ctx->ca_nrows++;
+  PetscCall(PetscMalloc4(ctx->ca_nrows, &ctx->ca_pos, ctx->ca_nrows, &ctx->ca_diag, ctx->ca_nrows, &ctx->ca_rows, ctx->ca_nrows, &ctx->ca_idiag));
+  PetscCall(PetscMalloc1(ctx->ca_nrows, &rowidx));
+  for (PetscInt i = 0, j = 0; i < m; ++i) {
+    if (depth[i] < s) {
+      ctx->ca_pos[j] = i;
+      rowidx[j++]    = prev[i];
+    }
+  }
+
+  PetscCall(ISCreateGeneral(PETSC_COMM_SELF, ctx->ca_nrows, rowidx, PETSC_OWN_POINTER, &isrow));
+  PetscCall(ISCreateGeneral(PETSC_COMM_SELF, m, prev, PETSC_COPY_VALUES, &iscol));
+  PetscCall(MatCreateSubMatrices(A, 1, &isrow, &iscol, MAT_INITIAL_MATRIX, &ctx->ca_subs));
+  ctx->ca_isrow = isrow; // Kept to refresh the values, see MCSORUpdateValues
+  ctx->ca_iscol = iscol;
+
+  PetscCall(MatSeqAIJGetCSRAndMemType(ctx->ca_subs[0], &rowptr, &colptr, &matvals, NULL));
+  for (PetscInt i = 0; i < ctx->ca_nrows; ++i) {
+    ctx->ca_diag[i] = -1;
+    for (PetscInt k = rowptr[i]; k < rowptr[i + 1]; ++k)
+      if (colptr[k] == ctx->ca_pos[i]) ctx->ca_diag[i] = k;
+    PetscCheck(ctx->ca_diag[i] >= 0, PETSC_COMM_SELF, PETSC_ERR_ARG_WRONGSTATE, "Missing diagonal entry in row %" PetscInt_FMT, prev[ctx->ca_pos[i]]);
+  }
+
+  // Get the colour of every row at distance <= s
+  PetscCall(ISColoringGetIS(ctx->isc, PETSC_USE_POINTER, &ncolors, &iss));
+  PetscCall(MatCreateVecs(A, &cvec, NULL));
+  PetscCall(VecGetArray(cvec, &carr));
+  for (PetscInt color = 0; color < ncolors; ++color) {
+    PetscInt n;
+
+    PetscCall(ISGetLocalSize(iss[color], &n));
+    PetscCall(ISGetIndices(iss[color], &idx));
+    for (PetscInt i = 0; i < n; ++i) carr[idx[i]] = color;
+    PetscCall(ISRestoreIndices(iss[color], &idx));
+  }
+  PetscCall(VecRestoreArray(cvec, &carr));
+  PetscCall(ISColoringRestoreIS(ctx->isc, PETSC_USE_POINTER, &iss));
+
+  PetscCall(VecCreateSeq(PETSC_COMM_SELF, m, &cloc));
+  PetscCall(VecScatterCreate(cvec, iscol, cloc, NULL, &sct));
+  PetscCall(VecScatterBegin(sct, cvec, cloc, INSERT_VALUES, SCATTER_FORWARD));
+  PetscCall(VecScatterEnd(sct, cvec, cloc, INSERT_VALUES, SCATTER_FORWARD));
+  PetscCall(VecScatterDestroy(&sct));
+
+  // Sort the rows by colour and then by distance
+  PetscCall(PetscCalloc1(ncolors * s + 1, &ctx->ca_ptr));
+  PetscCall(VecGetArrayRead(cloc, &clocarr));
+  for (PetscInt i = 0; i < ctx->ca_nrows; ++i) {
+    const PetscInt r = ctx->ca_pos[i];
+
+    ctx->ca_ptr[(PetscInt)PetscRealPart(clocarr[r]) * s + depth[r] + 1]++;
+  }
+  for (PetscInt i = 0; i < ncolors * s; ++i) ctx->ca_ptr[i + 1] += ctx->ca_ptr[i];
+  PetscCall(PetscMalloc1(ncolors * s, &cursor));
+  PetscCall(PetscArraycpy(cursor, ctx->ca_ptr, ncolors * s));
+  for (PetscInt i = 0; i < ctx->ca_nrows; ++i) {
+    const PetscInt r = ctx->ca_pos[i];
+
+    ctx->ca_rows[cursor[(PetscInt)PetscRealPart(clocarr[r]) * s + depth[r]]++] = i;
+  }
+  PetscCall(VecRestoreArrayRead(cloc, &clocarr));
+  PetscCall(PetscFree(cursor));
+  PetscCall(VecDestroy(&cloc));
+
+  // Scatter that fills the overlap (non-owned) entries of the local vectors
+  PetscCall(PetscMalloc1(nhalo, &from));
+  PetscCall(PetscMalloc1(nhalo, &to));
+  for (PetscInt i = 0, j = 0; i < m; ++i) {
+    if (prev[i] < rstart || prev[i] >= rend) {
+      from[j] = prev[i];
+      to[j++] = i;
+    }
+  }
+  PetscCall(ISCreateGeneral(PETSC_COMM_SELF, nhalo, from, PETSC_OWN_POINTER, &isfrom));
+  PetscCall(ISCreateGeneral(PETSC_COMM_SELF, nhalo, to, PETSC_OWN_POINTER, &isto));
+  PetscCall(VecCreateSeq(PETSC_COMM_SELF, m, &ctx->ca_y));
+  PetscCall(VecDuplicate(ctx->ca_y, &ctx->ca_b));
+  PetscCall(VecScatterCreate(cvec, isfrom, ctx->ca_y, isto, &ctx->ca_ysct));
+  PetscCall(VecScatterCopy(ctx->ca_ysct, &ctx->ca_bsct));
+  PetscCall(ISDestroy(&isfrom));
+  PetscCall(ISDestroy(&isto));
+  PetscCall(VecDestroy(&cvec));
+
+  PetscCall(PetscInfo(NULL, "Communication-avoiding MCSOR with depth %" PetscInt_FMT ": %" PetscInt_FMT " owned rows, %" PetscInt_FMT " redundant rows, %" PetscInt_FMT " overlap values\n", s, rend - rstart, ctx->ca_nrows - (rend - rstart), nhalo));
+  PetscCall(PetscFree(prev));
+  PetscCall(PetscFree(depth));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
 static PetscErrorCode MatCreateISColoring_AIJ(Mat A, ISColoring *isc)
 {
   MatColoring mc;
@@ -409,11 +1324,30 @@ static PetscErrorCode MatCreateISColoring_Seq(Mat A, ISColoring *isc)
   PetscFunctionReturn(PETSC_SUCCESS);
 }
 
+/* Drops the low-rank corrections (MATLRC), they are rebuilt at the next
+   sweep, see MCSORSetUpOnDemand() */
+static PetscErrorCode MCSORClearCorrections(MCSOR_Ctx ctx)
+{
+  PetscFunctionBeginUser;
+  for (PetscInt dir = 0; dir < 2; ++dir) PetscCall(PetscFree2(ctx->res_ABb[dir], ctx->res_BtBb[dir]));
+  PetscCall(PetscFree(ctx->res_S));
+  PetscCall(MatDestroy(&ctx->Bb));
+  PetscCall(MatDestroy(&ctx->Bb_bk));
+  ctx->setup_time[MCSOR_SETUP_FORWARD]  = 0;
+  ctx->setup_time[MCSOR_SETUP_BACKWARD] = 0;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
 PetscErrorCode MCSORSetOmega(MCSOR mc, PetscReal omega)
 {
   MCSOR_Ctx ctx = mc->ctx;
 
   PetscFunctionBeginUser;
+  // The low-rank corrections are built with the deterministic sweep, which uses the same omega
+  if (ctx->det && omega != ctx->omega) {
+    PetscCall(MCSORSetOmega(ctx->det, omega));
+    PetscCall(MCSORClearCorrections(ctx));
+  }
   ctx->omega         = omega;
   ctx->omega_changed = PETSC_TRUE;
   PetscFunctionReturn(PETSC_SUCCESS);
@@ -438,18 +1372,158 @@ PetscErrorCode MCSORGetSweepType(MCSOR mc, MatSORType *type)
   PetscFunctionReturn(PETSC_SUCCESS);
 }
 
+/* Colouring and ghost scatters of a matrix, shared by all MCSORs on it (see
+   ParMGMCMatComposeCache). The scatters are created by the first MCSOR that
+   needs them. */
+typedef struct {
+  ISColoring  isc;
+  PetscInt    ncolors;
+  VecScatter *scatters;
+  Vec        *ghostvecs;
+} *MCSORColoringCache;
+
+static PetscErrorCode MCSORColoringCacheDestroy(void *data)
+{
+  MCSORColoringCache cc = data;
+
+  PetscFunctionBeginUser;
+  if (cc->scatters) {
+    for (PetscInt i = 0; i < cc->ncolors; ++i) {
+      PetscCall(VecScatterDestroy(&cc->scatters[i]));
+      PetscCall(VecDestroy(&cc->ghostvecs[i]));
+    }
+    PetscCall(PetscFree(cc->scatters));
+    PetscCall(PetscFree(cc->ghostvecs));
+  }
+  PetscCall(ISColoringDestroy(&cc->isc));
+  PetscCall(PetscFree(cc));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+static PetscErrorCode MCSORGetColoringCache(Mat A, MCSORColoringCache *cc)
+{
+  PetscObjectState state;
+  PetscMPIInt      size;
+
+  PetscFunctionBeginUser;
+  PetscCall(MatGetNonzeroState(A, &state));
+  PetscCall(ParMGMCMatQueryCache(A, "MCSORColoring", state, (void **)cc));
+  if (*cc) PetscFunctionReturn(PETSC_SUCCESS);
+
+  PetscCall(PetscNew(cc));
+  PetscCallMPI(MPI_Comm_size(PetscObjectComm((PetscObject)A), &size));
+  if (size == 1) PetscCall(MatCreateISColoring_Seq(A, &(*cc)->isc));
+  else PetscCall(MatCreateISColoring_AIJ(A, &(*cc)->isc));
+  PetscCall(ISColoringGetIS((*cc)->isc, PETSC_USE_POINTER, &(*cc)->ncolors, NULL));
+  PetscCall(ParMGMCMatComposeCache(A, "MCSORColoring", state, *cc, MCSORColoringCacheDestroy));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Writes the colour of each row of `A`, as computed for the MCSORs
+    on `A`, to the binary viewer (see ParMGMCMatSaveSetup). If `A` has no
+    colouring yet it is computed.
+ */
+PetscErrorCode MCSORSaveColoring(Mat A, PetscViewer viewer)
+{
+  MCSORColoringCache cc;
+  IS                *iss;
+  Vec                colors;
+  PetscScalar       *carr;
+
+  PetscFunctionBeginUser;
+  PetscCall(MCSORGetColoringCache(A, &cc));
+  PetscCall(MatCreateVecs(A, &colors, NULL));
+  PetscCall(VecGetArrayWrite(colors, &carr));
+  PetscCall(ISColoringGetIS(cc->isc, PETSC_USE_POINTER, NULL, &iss));
+  for (PetscInt c = 0; c < cc->ncolors; ++c) {
+    PetscInt        n;
+    const PetscInt *idx;
+
+    PetscCall(ISGetLocalSize(iss[c], &n));
+    PetscCall(ISGetIndices(iss[c], &idx));
+    for (PetscInt i = 0; i < n; ++i) carr[idx[i]] = c;
+    PetscCall(ISRestoreIndices(iss[c], &idx));
+  }
+  PetscCall(ISColoringRestoreIS(cc->isc, PETSC_USE_POINTER, &iss));
+  PetscCall(VecRestoreArrayWrite(colors, &carr));
+  PetscCall(VecView(colors, viewer));
+  PetscCall(VecDestroy(&colors));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Reads a colouring written by MCSORSaveColoring and stores it on
+    `A`, so that the MCSORs on `A` use it instead of colouring the matrix.
+    The matrix must have the nonzero pattern and the parallel layout of the
+    saved one.
+ */
+PetscErrorCode MCSORLoadColoring(Mat A, PetscViewer viewer)
+{
+  MCSORColoringCache cc;
+  Vec                colors;
+  const PetscScalar *carr;
+  ISColoringValue   *vals;
+  PetscInt           n;
+  PetscReal          max;
+  PetscObjectState   state;
+
+  PetscFunctionBeginUser;
+  PetscCall(MatCreateVecs(A, &colors, NULL));
+  PetscCall(VecLoad(colors, viewer));
+  PetscCall(VecMax(colors, NULL, &max));
+  PetscCall(VecGetLocalSize(colors, &n));
+  PetscCall(PetscMalloc1(n, &vals));
+  PetscCall(VecGetArrayRead(colors, &carr));
+  for (PetscInt i = 0; i < n; ++i) vals[i] = (ISColoringValue)PetscRealPart(carr[i]);
+  PetscCall(VecRestoreArrayRead(colors, &carr));
+  PetscCall(VecDestroy(&colors));
+
+  PetscCall(PetscNew(&cc));
+  cc->ncolors = (PetscInt)max + 1;
+  PetscCall(ISColoringCreate(PetscObjectComm((PetscObject)A), cc->ncolors, n, vals, PETSC_OWN_POINTER, &cc->isc));
+  PetscCall(ISColoringSetType(cc->isc, IS_COLORING_LOCAL));
+  PetscCall(MatGetNonzeroState(A, &state));
+  PetscCall(ParMGMCMatComposeCache(A, "MCSORColoring", state, cc, MCSORColoringCacheDestroy));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
 static PetscErrorCode MCSORSetupSOR(MCSOR mc)
 {
-  MCSOR_Ctx   ctx = mc->ctx;
-  PetscMPIInt size;
+  MCSOR_Ctx          ctx = mc->ctx;
+  MCSORColoringCache cc;
 
   PetscFunctionBeginUser;
   PetscCall(MatGetDiagonalPointers(ctx->Asor, &(ctx->diagptrs)));
   PetscCall(MatCreateVecs(ctx->Asor, &ctx->idiag, NULL));
-  PetscCallMPI(MPI_Comm_size(PetscObjectComm((PetscObject)ctx->Asor), &size));
-  if (size == 1) PetscCall(MatCreateISColoring_Seq(ctx->Asor, &ctx->isc));
-  else PetscCall(MatCreateISColoring_AIJ(ctx->Asor, &ctx->isc));
-  PetscCall(ISColoringGetIS(ctx->isc, PETSC_USE_POINTER, &ctx->ncolors, NULL));
+  // The colouring only depends on the nonzero pattern, it is shared with other MCSORs on Asor
+  PetscCall(MCSORGetColoringCache(ctx->Asor, &cc));
+  PetscCall(ISColoringReference(cc->isc));
+  ctx->isc     = cc->isc;
+  ctx->ncolors = cc->ncolors;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* The per-colour ghost scatters, shared with the other MCSORs on the matrix
+   (the ghost vectors themselves are not, each MCSOR gets its own) */
+static PetscErrorCode MCSORCreateScatters(MCSOR_Ctx ctx)
+{
+  MCSORColoringCache cc;
+
+  PetscFunctionBeginUser;
+  PetscCall(MCSORGetColoringCache(ctx->Asor, &cc));
+  if (cc->isc != ctx->isc) {
+    // The cache was rebuilt after this MCSOR was set up
+    PetscCall(MatCreateScatters(ctx->Asor, ctx->isc, NULL, &ctx->scatters, &ctx->plans, &ctx->ghostvecs));
+    PetscFunctionReturn(PETSC_SUCCESS);
+  }
+  // The ghost vectors of the cache are only used as templates
+  if (!cc->scatters) PetscCall(MatCreateScatters(ctx->Asor, cc->isc, NULL, &cc->scatters, NULL, &cc->ghostvecs));
+  PetscCall(PetscMalloc1(cc->ncolors, &ctx->scatters));
+  PetscCall(PetscMalloc1(cc->ncolors, &ctx->ghostvecs));
+  for (PetscInt i = 0; i < cc->ncolors; ++i) {
+    PetscCall(PetscObjectReference((PetscObject)cc->scatters[i]));
+    ctx->scatters[i] = cc->scatters[i];
+    PetscCall(VecDuplicate(cc->ghostvecs[i], &ctx->ghostvecs[i]));
+  }
   PetscFunctionReturn(PETSC_SUCCESS);
 }
 
@@ -550,11 +1624,95 @@ static PetscErrorCode MCSORApplyAsDetSOR(void *ctx, Vec b, Vec y)
   PetscFunctionReturn(PETSC_SUCCESS);
 }
 
-PetscErrorCode MCSORSetUp(MCSOR mc)
+/* Builds Bb = M_A^-1 B (S^-1 + B^T M_A^-1 B)^-1 for the sweep direction `dir`
+   (0 = forward, 1 = backward), with M_A^-1 supplied by the deterministic
+   MCSOR on the base AIJ. */
+static PetscErrorCode MCSORBuildCorrection(MCSOR_Ctx ctx, PetscInt dir)
+{
+  Vec            S;
+  PetscLogDouble t0, t1;
+
+  PetscFunctionBeginUser;
+  PetscCall(PetscTime(&t0));
+  if (!ctx->det) {
+    // The deterministic MCSOR is kept, so that the corrections can be
+    // rebuilt without a new colouring when the values change
+    PetscCall(MCSORCreate(ctx->Asor, &ctx->det));
+    PetscCall(MCSORSetOmega(ctx->det, ctx->omega));
+    PetscCall(MCSORSetNodeAware(ctx->det, ctx->node_aware));
+    PetscCall(MCSORSetCommunicationAvoidingDepth(ctx->det, ctx->ca_depth));
+    PetscCall(MCSORSetSinglePrecision(ctx->det, ctx->sp));
+    PetscCall(MCSORSetUp(ctx->det));
+  }
+  PetscCall(MatLRCGetMats(ctx->A, NULL, NULL, &S, NULL));
+  PetscCall(MCSORSetSweepType(ctx->det, dir == 0 ? SOR_FORWARD_SWEEP : SOR_BACKWARD_SWEEP));
+  PetscCall(MCSORBuildLRCCorrection(MCSORApplyAsDetSOR, ctx->det, ctx->Asor, ctx->B, S, dir == 0 ? &ctx->Bb : &ctx->Bb_bk));
+  PetscCall(PetscTime(&t1));
+  ctx->setup_time[MCSOR_SETUP_FORWARD + dir] += t1 - t0;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* Sets up what the next sweep needs and has not been built yet: the ghost
+   scatters and the low-rank corrections of the directions that are swept. */
+static PetscErrorCode MCSORSetUpOnDemand(MCSOR_Ctx ctx)
+{
+  PetscFunctionBeginUser;
+  if (ctx->sor == MCSORApply_MPIAIJ && !ctx->scatters) {
+    PetscLogDouble t0, t1;
+
+    PetscCall(PetscTime(&t0));
+    PetscCall(MCSORCreateScatters(ctx));
+    PetscCall(PetscTime(&t1));
+    ctx->setup_time[MCSOR_SETUP_SCATTERS] += t1 - t0;
+  }
+  if (ctx->lrc) {
+    if (ctx->type != SOR_BACKWARD_SWEEP && !ctx->Bb) PetscCall(MCSORBuildCorrection(ctx, 0));
+    if (ctx->type != SOR_FORWARD_SWEEP && !ctx->Bb_bk) PetscCall(MCSORBuildCorrection(ctx, 1));
+  }
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Start a sweep. For `MATLRC` operators the low-rank correction of y
+    is only started, it must be completed with MCSORApplyEnd before y is
+    used. Work that does not depend on y (e.g., drawing the noise of the next
+    sweep) can be done in between.
+
+    `eta` is the low-rank noise of the next sweep (k-vector with the column
+    layout of B) or NULL; it is reduced together with the correction and
+    added (as B eta) to the vector passed to MCSORApplyEnd. Must be NULL for
+    non-`MATLRC` operators.
+ */
+PetscErrorCode MCSORApplyBegin(MCSOR mc, Vec b, Vec y, Vec eta)
 {
   MCSOR_Ctx ctx = mc->ctx;
-  MatType   type;
-  Mat       A = ctx->A;
+
+  PetscFunctionBeginUser;
+  PetscCheck(!eta || ctx->lrc, PetscObjectComm((PetscObject)ctx->A), PETSC_ERR_ARG_WRONG, "Low-rank noise can only be passed for MATLRC operators");
+  PetscCall(MCSORSetUpOnDemand(ctx));
+  PetscCall(PetscLogEventBegin(MULTICOL_SOR, ctx->A, b, y, NULL));
+  if (ctx->omega_changed) PetscCall(MCSORUpdateIDiag(mc));
+  if (ctx->type == SOR_SYMMETRIC_SWEEP) {
+    ctx->type = SOR_FORWARD_SWEEP;
+    PetscCall(MCSORSweep(ctx, b, y, NULL, PETSC_FALSE));
+    if (ctx->lrc) PetscCall(LRCCorrectionEnd(ctx->lrc, ctx->lrc_Bb, y, NULL));
+
+    ctx->type = SOR_BACKWARD_SWEEP;
+    PetscCall(MCSORSweep(ctx, b, y, eta, PETSC_TRUE));
+
+    ctx->type = SOR_SYMMETRIC_SWEEP;
+  } else {
+    PetscCall(MCSORSweep(ctx, b, y, eta, PETSC_TRUE));
+  }
+  PetscCall(PetscLogEventEnd(MULTICOL_SOR, ctx->A, b, y, NULL));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+PetscErrorCode MCSORSetUp(MCSOR mc)
+{
+  MCSOR_Ctx      ctx = mc->ctx;
+  MatType        type;
+  Mat            A = ctx->A;
+  PetscLogDouble t0, t1;
 
   PetscFunctionBeginUser;
   PetscCall(MatGetType(A, &type));
@@ -567,43 +1725,130 @@ PetscErrorCode MCSORSetUp(MCSOR mc)
   } else {
     PetscCheck(false, MPI_COMM_WORLD, PETSC_ERR_SUP, "Matrix type not supported");
   }
+  PetscCall(PetscTime(&t0));
   PetscCall(MCSORSetupSOR(mc));
+  PetscCall(PetscTime(&t1));
+  ctx->setup_time[MCSOR_SETUP_COLORING] += t1 - t0;
 
-  if (strcmp(type, MATLRC) == 0) {
-    Vec   S;
-    MCSOR mca;
-
-    PetscCall(MatLRCGetMats(A, &ctx->Asor, &ctx->B, &S, NULL));
-
-    // For each direction build Bb = M_A^-1 B (S^-1 + B^T M_A^-1 B)^-1, with
-    // M_A^-1 supplied by a temporary deterministic MCSOR on the base AIJ.
-    PetscCall(MCSORCreate(ctx->Asor, &mca));
-    PetscCall(MCSORSetSweepType(mca, SOR_FORWARD_SWEEP));
-    PetscCall(MCSORSetUp(mca));
-    PetscCall(MCSORBuildLRCCorrection(MCSORApplyAsDetSOR, mca, ctx->Asor, ctx->B, S, &ctx->Bb));
-    PetscCall(MCSORDestroy(&mca));
+  PetscCall(MatGetNonzeroState(ctx->Asor, &ctx->nnzstate));
 
-    PetscCall(MCSORCreate(ctx->Asor, &mca));
-    PetscCall(MCSORSetSweepType(mca, SOR_BACKWARD_SWEEP));
-    PetscCall(MCSORSetUp(mca));
-    PetscCall(MCSORBuildLRCCorrection(MCSORApplyAsDetSOR, mca, ctx->Asor, ctx->B, S, &ctx->Bb_bk));
-    PetscCall(MCSORDestroy(&mca));
+  if (strcmp(type, MATLRC) == 0) {
+    // The corrections Bb and Bb_bk are built at the first sweep in their direction
+    PetscCall(MatLRCGetMats(A, &ctx->Asor, &ctx->B, NULL, NULL));
+    PetscCall(LRCCorrectionCreate(ctx->B, &ctx->lrc));
+  }
 
-    PetscCall(MatCreateVecs(ctx->Bb, &ctx->w, &ctx->z));
+  {
+    MatInfo  info;
+    PetscInt n, k = 0;
 
-    ctx->postsor = MCSORPostSOR_LRC;
+    // One multiply-add per nonzero, plus B^T y and the update with B for MATLRC
+    PetscCall(MatGetInfo(ctx->Asor, MAT_LOCAL, &info));
+    PetscCall(MatGetLocalSize(ctx->Asor, &n, NULL));
+    if (ctx->B) PetscCall(MatGetSize(ctx->B, NULL, &k));
+    ctx->flops = 2 * info.nz_used + 4. * n * k;
   }
 
   PetscCall(MatGetType(ctx->Asor, &type));
   if (strcmp(type, MATSEQAIJ) == 0) {
     ctx->sor = MCSORApply_SEQAIJ;
+  } else if (ctx->ca_depth > 1) {
+    PetscCheck(!ctx->node_aware, PetscObjectComm((PetscObject)ctx->A), PETSC_ERR_SUP, "Node-aware and communication-avoiding mode cannot be combined");
+    PetscCheck(!ctx->lrc, PetscObjectComm((PetscObject)ctx->A), PETSC_ERR_SUP, "Communication-avoiding mode is not supported for MATLRC operators");
+    PetscCall(PetscTime(&t0));
+    PetscCall(MCSORSetUpCA(ctx));
+    PetscCall(PetscTime(&t1));
+    ctx->setup_time[MCSOR_SETUP_SCATTERS] += t1 - t0;
+    ctx->sor = MCSORApply_MPIAIJ_CA;
   } else {
-    PetscCall(MatCreateScatters(ctx->Asor, ctx->isc, &ctx->scatters, &ctx->ghostvecs));
+    // Node-aware halo plans are not shared and are created here, the shared
+    // colour scatters are created at the first sweep (MCSORSetUpOnDemand)
+    if (ctx->node_aware) {
+      Vec x;
+
+      PetscCall(PetscTime(&t0));
+      PetscCall(MatCreateVecs(ctx->Asor, &x, NULL));
+      PetscCall(NodeHaloCreate(x, 1, &ctx->nh));
+      PetscCall(VecDestroy(&x));
+      PetscCall(MatCreateScatters(ctx->Asor, ctx->isc, ctx->nh, &ctx->scatters, &ctx->plans, &ctx->ghostvecs));
+      PetscCall(PetscTime(&t1));
+      ctx->setup_time[MCSOR_SETUP_SCATTERS] += t1 - t0;
+    }
     ctx->sor = MCSORApply_MPIAIJ;
   }
   PetscFunctionReturn(PETSC_SUCCESS);
 }
 
+/** @brief Refreshes everything that depends on the values of the matrix
+    after they have changed, reusing the colouring, the ghost scatters and
+    the other structural data of MCSORSetUp. The nonzero pattern of the
+    (base) matrix must not have changed. For `MATLRC` operators the
+    low-rank corrections are rebuilt with the new values of A, B and S at
+    the next sweep (B and S must keep their sizes).
+ */
+PetscErrorCode MCSORUpdateValues(MCSOR mc)
+{
+  MCSOR_Ctx        ctx = mc->ctx;
+  PetscObjectState state;
+
+  PetscFunctionBeginUser;
+  PetscCheck(ctx->isc, PetscObjectComm((PetscObject)ctx->A), PETSC_ERR_ORDER, "MCSORSetUp must be called first");
+  PetscCall(MatGetNonzeroState(ctx->Asor, &state));
+  PetscCheck(state == ctx->nnzstate, PetscObjectComm((PetscObject)ctx->A), PETSC_ERR_ARG_WRONGSTATE, "The nonzero pattern of the matrix has changed, call MCSORSetUp on a new MCSOR");
+  if (ctx->ca_subs) PetscCall(MatCreateSubMatrices(ctx->Asor, 1, &ctx->ca_isrow, &ctx->ca_iscol, MAT_REUSE_MATRIX, &ctx->ca_subs));
+  ctx->omega_changed = PETSC_TRUE; // The inverse diagonal is recomputed before the next sweep
+  if (ctx->sp_vals) PetscCall(MCSORFreeSingle(ctx));
+  if (ctx->det) {
+    PetscCall(MCSORSetOmega(ctx->det, ctx->omega));
+    PetscCall(MCSORUpdateValues(ctx->det));
+  }
+  PetscCall(MCSORClearCorrections(ctx));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Read ghost values owned by ranks on the same node directly from
+    shared memory instead of sending them as MPI messages. Must be called
+    before MCSORSetUp. Default is PETSC_FALSE.
+ */
+PetscErrorCode MCSORSetNodeAware(MCSOR mc, PetscBool flg)
+{
+  MCSOR_Ctx ctx = mc->ctx;
+
+  PetscFunctionBeginUser;
+  ctx->node_aware = flg;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Set the depth s of the communication-avoiding mode: one ghost
+    exchange is performed for every s colours, the values of the overlap rows
+    are computed redundantly. s = 1 (the default) disables the mode. Not
+    supported for `MATLRC` operators. Must be called before MCSORSetUp.
+ */
+PetscErrorCode MCSORSetCommunicationAvoidingDepth(MCSOR mc, PetscInt s)
+{
+  MCSOR_Ctx ctx = mc->ctx;
+
+  PetscFunctionBeginUser;
+  PetscCheck(s >= 1, PetscObjectComm((PetscObject)ctx->A), PETSC_ERR_ARG_OUTOFRANGE, "Depth must be at least 1");
+  ctx->ca_depth = s;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Sweep with single precision matrix values and ghost exchanges
+    (see the notes at the top of this file). Can be changed at any time.
+    Default is PETSC_FALSE.
+ */
+PetscErrorCode MCSORSetSinglePrecision(MCSOR mc, PetscBool flg)
+{
+  MCSOR_Ctx ctx = mc->ctx;
+
+  PetscFunctionBeginUser;
+  PetscCall(MCSORFreeSingle(ctx));
+  ctx->sp = flg;
+  if (ctx->det) PetscCall(MCSORSetSinglePrecision(ctx->det, flg));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
 PetscErrorCode MCSORGetNumColors(MCSOR mc, PetscInt *colors)
 {
   MCSOR_Ctx ctx = mc->ctx;
@@ -615,6 +1860,62 @@ PetscErrorCode MCSORGetNumColors(MCSOR mc, PetscInt *colors)
   PetscFunctionReturn(PETSC_SUCCESS);
 }
 
+/** @brief Prints the time spent on setting up each component of the sampler
+    so far, the maximum over all ranks (collective). Components that are
+    built on first use and have not been needed yet are listed as not built.
+ */
+PetscErrorCode MCSORView(MCSOR mc, PetscViewer viewer)
+{
+  MCSOR_Ctx      ctx = mc->ctx;
+  PetscBool      built[MCSOR_SETUP_NCOMPONENTS], needed[MCSOR_SETUP_NCOMPONENTS];
+  PetscLogDouble tmax[MCSOR_SETUP_NCOMPONENTS];
+
+  PetscFunctionBeginUser;
+  built[MCSOR_SETUP_COLORING]  = ctx->isc ? PETSC_TRUE : PETSC_FALSE;
+  built[MCSOR_SETUP_SCATTERS]  = ctx->scatters || ctx->ca_subs ? PETSC_TRUE : PETSC_FALSE;
+  built[MCSOR_SETUP_FORWARD]   = ctx->Bb ? PETSC_TRUE : PETSC_FALSE;
+  built[MCSOR_SETUP_BACKWARD]  = ctx->Bb_bk ? PETSC_TRUE : PETSC_FALSE;
+  built[MCSOR_SETUP_RESIDUAL]  = ctx->res_color ? PETSC_TRUE : PETSC_FALSE;
+  built[MCSOR_SETUP_SINGLE]    = ctx->sp_vals ? PETSC_TRUE : PETSC_FALSE;
+  needed[MCSOR_SETUP_COLORING] = PETSC_TRUE;
+  needed[MCSOR_SETUP_SCATTERS] = ctx->sor && ctx->sor != MCSORApply_SEQAIJ ? PETSC_TRUE : PETSC_FALSE;
+  needed[MCSOR_SETUP_FORWARD]  = ctx->lrc ? PETSC_TRUE : PETSC_FALSE;
+  needed[MCSOR_SETUP_BACKWARD] = ctx->lrc ? PETSC_TRUE : PETSC_FALSE;
+  needed[MCSOR_SETUP_RESIDUAL] = built[MCSOR_SETUP_RESIDUAL];
+  needed[MCSOR_SETUP_SINGLE]   = ctx->sp;
+
+  PetscCall(PetscArraycpy(tmax, ctx->setup_time, MCSOR_SETUP_NCOMPONENTS));
+  PetscCallMPI(MPI_Allreduce(MPI_IN_PLACE, tmax, MCSOR_SETUP_NCOMPONENTS, MPI_DOUBLE, MPI_MAX, PetscObjectComm((PetscObject)ctx->A)));
+  PetscCall(PetscViewerASCIIPrintf(viewer, "Setup time (max. over ranks):\n"));
+  PetscCall(PetscViewerASCIIPushTab(viewer));
+  for (PetscInt c = 0; c < MCSOR_SETUP_NCOMPONENTS; ++c) {
+    if (!needed[c]) continue;
+    if (built[c]) PetscCall(PetscViewerASCIIPrintf(viewer, "%s: %g s\n", MCSORSetupComponentNames[c], (double)tmax[c]));
+    else PetscCall(PetscViewerASCIIPrintf(viewer, "%s: not built\n", MCSORSetupComponentNames[c]));
+  }
+  PetscCall(PetscViewerASCIIPopTab(viewer));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Reads the options -mc_sor_omega, -mc_sor_node_aware,
+    -mc_sor_ca_depth and -mc_sor_single_precision. Must be called before
+    MCSORSetUp.
+ */
+PetscErrorCode MCSORSetFromOptions(MCSOR mc)
+{
+  MCSOR_Ctx ctx = mc->ctx;
+
+  PetscFunctionBeginUser;
+  PetscOptionsBegin(PetscObjectComm((PetscObject)ctx->A), NULL, "Options for the multicolour SOR", NULL);
+  PetscCall(PetscOptionsReal("-mc_sor_omega", "SOR relaxation parameter", "MCSORSetOmega", ctx->omega, &ctx->omega, NULL));
+  PetscCall(PetscOptionsBool("-mc_sor_node_aware", "Read ghost values of ranks on the same node from shared memory", "MCSORSetNodeAware", ctx->node_aware, &ctx->node_aware, NULL));
+  PetscCall(PetscOptionsInt("-mc_sor_ca_depth", "Number of colours per ghost exchange (communication-avoiding mode)", "MCSORSetCommunicationAvoidingDepth", ctx->ca_depth, &ctx->ca_depth, NULL));
+  PetscCall(PetscOptionsBool("-mc_sor_single_precision", "Sweep with single precision matrix values and ghost exchanges", "MCSORSetSinglePrecision", ctx->sp, &ctx->sp, NULL));
+  PetscOptionsEnd();
+  PetscCheck(ctx->ca_depth >= 1, PetscObjectComm((PetscObject)ctx->A), PETSC_ERR_ARG_OUTOFRANGE, "Depth must be at least 1");
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
 PetscErrorCode MCSORCreate(Mat A, MCSOR *m)
 {
   MCSOR     mc;
@@ -626,16 +1927,22 @@ PetscErrorCode MCSORCreate(Mat A, MCSOR *m)
 
   ctx->scatters      = NULL;
   ctx->ghostvecs     = NULL;
+  ctx->plans         = NULL;
+  ctx->nh            = NULL;
+  ctx->node_aware    = PETSC_FALSE;
+  ctx->ca_depth      = 1;
+  ctx->ca_subs       = NULL;
   ctx->omega_changed = PETSC_TRUE;
   ctx->A             = A;
   mc->ctx            = ctx;
   ctx->B             = NULL;
-  ctx->z             = NULL;
-  ctx->w             = NULL;
-  ctx->postsor       = NULL;
+  ctx->lrc           = NULL;
+  ctx->res_b         = NULL;
+  ctx->res_r         = NULL;
+  ctx->res_color     = NULL;
   ctx->type          = SOR_FORWARD_SWEEP;
   ctx->omega         = 1;
-  PetscCall(PetscOptionsGetReal(NULL, NULL, "-mc_sor_omega", &ctx->omega, NULL)); // TODO: Put this in a seperate MCSORSetFromOptions
+  ctx->sp            = PETSC_FALSE;
 
   *m = mc;
   PetscFunctionReturn(PETSC_SUCCESS);
@@ -0,0 +1,667 @@
+/*  ParMGMC - Implementation of the Multigrid Monte Carlo method in PETSc.
+    Copyright (C) 2024  Nils Friess
+
+    This file is part of ParMGMC which is released under the GNU LESSER GENERAL
+    PUBLIC LICENSE (LGPL). See file LICENSE in the project root folder for full
+    license details.
+*/
+
+#include "parmgmc/mlmc.h"
+#include "parmgmc/iact.h"
+#include "parmgmc/parmgmc.h"
+#include "parmgmc/pc/pc_gamgmc.h"
+
+#include <petscerror.h>
+#include <petscksp.h>
+#include <petscmat.h>
+#include <petscoptions.h>
+#include <petscpc.h>
+#include <petscsys.h>
+#include <petscsystypes.h>
+#include <petsctime.h>
+#include <petscvec.h>
+#include <petscviewer.h>
+#include <mpi.h>
+
+/** @file mlmc.c
+    @brief Multilevel Monte Carlo estimator for expectations of quantities of
+    interest of Gaussian random fields.
+
+    # Notes
+    Given a hierarchy of precision matrices \f$A_0, \dots, A_{L-1}\f$ (level 0
+    is the coarsest) with interpolations \f$P_l\f$ from level l-1 to level l
+    such that \f$A_{l-1} = P_l^T A_l P_l\f$ (i.e., the hierarchy a Galerkin
+    multigrid method builds), the estimator computes
+
+        E[Q_{L-1}] = E[Q_0] + sum_{l=1}^{L-1} E[Q_l - Q_{l-1}]
+
+    where each term is estimated from its own samples. On level l a Markov
+    chain (by default PCGAMGMC, options prefix `mlmc_sampler_`) generates
+    samples \f$x_l \sim N(A_l^{-1} b_l, A_l^{-1})\f$. The coarse partner of
+    each sample is obtained by sharing the noise through the interpolation:
+
+        x_{l-1} = A_{l-1}^{-1} P_l^T A_l x_l.
+
+    Since \f$A_l x_l \sim N(b_l, A_l)\f$, this gives exactly
+    \f$x_{l-1} \sim N(A_{l-1}^{-1} b_{l-1}, A_{l-1}^{-1})\f$ with
+    \f$b_{l-1} = P_l^T b_l\f$, so the telescoping sum is unbiased, and
+    \f$x_{l-1}\f$ is the energy projection of \f$x_l\f$ onto the coarse space,
+    so the variance of the differences decays with the mesh size. The coarse
+    solves use the KSP with options prefix `mlmc_solver_` (CG by default).
+
+    The variance of each level is estimated online and multiplied with the
+    integrated autocorrelation time of the level's chain. The number of
+    samples per level is then chosen to minimise the cost for a given root
+    mean squared error eps:
+
+        N_l = 2 / eps^2 sqrt(V_l / C_l) sum_k sqrt(V_k C_k),
+
+    where C_l is the measured cost per sample. Samples are added until the
+    estimated N_l are reached on all levels. The bias of the finest level is
+    not controlled; MLMCView() reports |E[Q_{L-1} - Q_{L-2}]| as an
+    indicator.
+
+    The bias is estimated by |E[Q_{L-1} - Q_{L-2}]|, which bounds the bias
+    of the finest level if the error decays at least linearly with the mesh
+    size, and compared with eps / sqrt(2) (the variance is reduced to
+    eps^2 / 2). The number of levels is given by the hierarchy and is not
+    changed; if the bias is too large, this is reported (with -info and in
+    MLMCView()) and a finer hierarchy is needed.
+
+    The quantity of interest is either the dot product with a measurement
+    vector given on the finest level (MLMCSetMeasurementVec(), it is
+    restricted to the coarser levels with the transposed interpolations), or
+    a user callback (MLMCSetQOI()) that receives the level index as its first
+    argument. The callback is called on the communicator of the sample (see
+    below) and must return the same value on all of its ranks.
+
+    The level pairs are independent of each other and run concurrently: the
+    ranks are split into `-mlmc_groups` groups of consecutive ranks (default:
+    one group per level, or one group per rank if there are fewer ranks than
+    levels) with `MPI_Comm_split`, and level pair l runs on group l mod
+    (number of groups). The operators, interpolations and vectors of a level
+    pair are redistributed onto its group with ParMGMCMatRedistribute(),
+    which handles `MATLRC` operators, and its chain and coupling solver are
+    created on the group's communicator. Only the level statistics are
+    exchanged between the groups, after each round of added samples.
+
+    # Options
+    - `-mlmc_rmse` - Target root mean squared error (default 1e-2)
+    - `-mlmc_initial_samples` - Number of samples per level used to get the
+      first variance estimates (default 50)
+    - `-mlmc_burnin` - Number of samples discarded at the start of each
+      level's chain (default 100)
+    - `-mlmc_max_samples` - Upper limit for the number of samples per level
+      (default 100000)
+    - `-mlmc_groups` - Number of groups of ranks the level pairs are
+      distributed over (default min(number of ranks, number of levels))
+    - `-mlmc_view` - Print the level statistics after MLMCEstimate()
+ */
+
+typedef struct _MLMCLevel {
+  struct _MLMCCtx *mlmc;
+  PetscInt         idx;
+  PetscMPIInt      group;        // Group of ranks that runs this level pair
+  Mat              A, P;         // Level operator and interpolation from level idx - 1
+  Mat              Af, Ac, Pf;   // The same (and A_{idx-1}) on the group's communicator
+  KSP              sampler;      // Markov chain on this level
+  KSP              solver;       // Coupling solve on level idx - 1
+  Vec              x, b, m, mc, r, rc, xc;
+  PetscScalar     *Y; // Samples of Q_l - Q_{l-1}, only stored on the group's ranks
+  PetscInt         n, cap;
+  PetscBool        burnt_in, recording;
+  PetscScalar      mean;
+  PetscReal        var, tau, cost;
+} *MLMCLevel;
+
+typedef struct _MLMCCtx {
+  MPI_Comm           comm, subcomm;
+  PetscMPIInt        groups;         // Number of groups requested, 0 for the default
+  PetscMPIInt        ngroups, group; // Number of groups, group of this rank
+  PetscInt           nlevels;
+  struct _MLMCLevel *levels;
+  Vec                b, m;
+  PetscReal          rmse, bias;
+  PetscInt           nstart, nburnin, maxsamples;
+  PetscBool          setup_called, view, bias_converged;
+  PetscErrorCode (*qoi)(PetscInt, Vec, PetscScalar *, void *);
+  void *qoictx;
+} *MLMCCtx;
+
+/* Destroys everything MLMCSetUp creates */
+static PetscErrorCode MLMC_ResetLevels(MLMCCtx ctx)
+{
+  PetscFunctionBeginUser;
+  for (PetscInt l = 0; l < ctx->nlevels; ++l) {
+    MLMCLevel lvl = &ctx->levels[l];
+
+    PetscCall(MatDestroy(&lvl->Af));
+    PetscCall(MatDestroy(&lvl->Ac));
+    PetscCall(MatDestroy(&lvl->Pf));
+    PetscCall(KSPDestroy(&lvl->sampler));
+    PetscCall(KSPDestroy(&lvl->solver));
+    PetscCall(VecDestroy(&lvl->x));
+    PetscCall(VecDestroy(&lvl->b));
+    PetscCall(VecDestroy(&lvl->m));
+    PetscCall(VecDestroy(&lvl->mc));
+    PetscCall(VecDestroy(&lvl->r));
+    PetscCall(VecDestroy(&lvl->rc));
+    PetscCall(VecDestroy(&lvl->xc));
+    PetscCall(PetscFree(lvl->Y));
+  }
+  if (ctx->subcomm != MPI_COMM_NULL) PetscCallMPI(MPI_Comm_free(&ctx->subcomm));
+  ctx->setup_called = PETSC_FALSE;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+static PetscErrorCode MLMC_FreeLevels(MLMCCtx ctx)
+{
+  PetscFunctionBeginUser;
+  PetscCall(MLMC_ResetLevels(ctx));
+  for (PetscInt l = 0; l < ctx->nlevels; ++l) {
+    PetscCall(MatDestroy(&ctx->levels[l].A));
+    PetscCall(MatDestroy(&ctx->levels[l].P));
+  }
+  PetscCall(PetscFree(ctx->levels));
+  ctx->nlevels      = 0;
+  ctx->setup_called = PETSC_FALSE;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+PetscErrorCode MLMCDestroy(MLMC *mlmc)
+{
+  MLMCCtx ctx = (*mlmc)->ctx;
+
+  PetscFunctionBeginUser;
+  PetscCall(MLMC_FreeLevels(ctx));
+  PetscCall(VecDestroy(&ctx->b));
+  PetscCall(VecDestroy(&ctx->m));
+  PetscCall(PetscFree(ctx));
+  PetscCall(PetscFree(*mlmc));
+  *mlmc = NULL;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Sets the level operators `A[0], ..., A[nlevels - 1]` (level 0 is the
+    coarsest) and the interpolations `P[l]` from level l-1 to level l (as in
+    PCMGSetInterpolation(), `P[0]` is ignored). The coarse operators must be
+    the Galerkin products of the finer ones.
+ */
+PetscErrorCode MLMCSetHierarchy(MLMC mlmc, PetscInt nlevels, const Mat A[], const Mat P[])
+{
+  MLMCCtx ctx = mlmc->ctx;
+
+  PetscFunctionBeginUser;
+  PetscCheck(nlevels > 0, ctx->comm, PETSC_ERR_ARG_OUTOFRANGE, "Need at least one level");
+  PetscCall(MLMC_FreeLevels(ctx));
+  PetscCall(PetscCalloc1(nlevels, &ctx->levels));
+  ctx->nlevels = nlevels;
+  for (PetscInt l = 0; l < nlevels; ++l) {
+    MLMCLevel lvl = &ctx->levels[l];
+
+    lvl->mlmc = ctx;
+    lvl->idx  = l;
+    lvl->A    = A[l];
+    PetscCall(PetscObjectReference((PetscObject)A[l]));
+    if (l > 0) {
+      lvl->P = P[l];
+      PetscCall(PetscObjectReference((PetscObject)P[l]));
+    }
+  }
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Takes the hierarchy from a PCGAMGMC (or PCMG) that has already been
+    set up.
+ */
+PetscErrorCode MLMCSetHierarchyFromPC(MLMC mlmc, PC pc)
+{
+  MLMCCtx   ctx = mlmc->ctx;
+  PC        mg  = pc;
+  PetscBool isgamgmc, ismg;
+  PetscInt  nlevels;
+  Mat      *A, *P;
+
+  PetscFunctionBeginUser;
+  PetscCall(PetscObjectTypeCompare((PetscObject)pc, PCGAMGMC, &isgamgmc));
+  if (isgamgmc) PetscCall(PCGAMGMCGetInternalPC(pc, &mg));
+  PetscCall(PetscObjectTypeCompareAny((PetscObject)mg, &ismg, PCMG, PCGAMG, ""));
+  PetscCheck(ismg, ctx->comm, PETSC_ERR_SUP, "Hierarchy can only be obtained from PCGAMGMC or PCMG");
+  PetscCall(PCMGGetLevels(mg, &nlevels));
+  PetscCheck(nlevels > 0, ctx->comm, PETSC_ERR_ORDER, "PC must be set up before the hierarchy can be extracted");
+  PetscCall(PetscCalloc2(nlevels, &A, nlevels, &P));
+  for (PetscInt l = 0; l < nlevels; ++l) {
+    KSP ksp;
+
+    PetscCall(PCMGGetSmoother(mg, l, &ksp));
+    PetscCall(KSPGetOperators(ksp, &A[l], NULL));
+    if (l > 0) PetscCall(PCMGGetInterpolation(mg, l, &P[l]));
+  }
+  PetscCall(MLMCSetHierarchy(mlmc, nlevels, A, P));
+  PetscCall(PetscFree2(A, P));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Sets the right hand side on the finest level, i.e., the samples on
+    that level have mean \f$A_{L-1}^{-1} b\f$. Default is zero.
+ */
+PetscErrorCode MLMCSetRHS(MLMC mlmc, Vec b)
+{
+  MLMCCtx ctx = mlmc->ctx;
+
+  PetscFunctionBeginUser;
+  PetscCall(PetscObjectReference((PetscObject)b));
+  PetscCall(VecDestroy(&ctx->b));
+  ctx->b            = b;
+  ctx->setup_called = PETSC_FALSE;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Uses the dot product with `m` (a vector on the finest level) as the
+    quantity of interest.
+ */
+PetscErrorCode MLMCSetMeasurementVec(MLMC mlmc, Vec m)
+{
+  MLMCCtx ctx = mlmc->ctx;
+
+  PetscFunctionBeginUser;
+  PetscCall(PetscObjectReference((PetscObject)m));
+  PetscCall(VecDestroy(&ctx->m));
+  ctx->m            = m;
+  ctx->setup_called = PETSC_FALSE;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Sets a quantity of interest that is used instead of the
+    measurement vector. The first argument passed to `qoi` is the level. The
+    sample lives on the communicator of the group of ranks that runs the
+    level pair (PetscObjectComm((PetscObject)x)), the callback is collective
+    on it and must return the same value on all of its ranks.
+ */
+PetscErrorCode MLMCSetQOI(MLMC mlmc, PetscErrorCode (*qoi)(PetscInt, Vec, PetscScalar *, void *), void *qoictx)
+{
+  MLMCCtx ctx = mlmc->ctx;
+
+  PetscFunctionBeginUser;
+  ctx->qoi    = qoi;
+  ctx->qoictx = qoictx;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+PetscErrorCode MLMCSetRMSE(MLMC mlmc, PetscReal rmse)
+{
+  MLMCCtx ctx = mlmc->ctx;
+
+  PetscFunctionBeginUser;
+  PetscCheck(rmse > 0, ctx->comm, PETSC_ERR_ARG_OUTOFRANGE, "Target error must be positive");
+  ctx->rmse = rmse;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* Q_l(x); m is the measurement vector of level l on the communicator of x */
+static PetscErrorCode MLMC_EvaluateQOI(MLMCCtx ctx, PetscInt l, Vec m, Vec x, PetscScalar *q)
+{
+  PetscFunctionBeginUser;
+  if (ctx->qoi) PetscCall(ctx->qoi(l, x, q, ctx->qoictx));
+  else PetscCall(VecDot(x, m, q));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+static PetscErrorCode MLMC_SampleCallback(PetscInt it, Vec x, void *lctx)
+{
+  MLMCLevel   lvl = lctx;
+  MLMCCtx     ctx = lvl->mlmc;
+  PetscScalar qf, qc = 0;
+
+  PetscFunctionBeginUser;
+  (void)it;
+  if (!lvl->recording) PetscFunctionReturn(PETSC_SUCCESS);
+  PetscCall(MLMC_EvaluateQOI(ctx, lvl->idx, lvl->m, x, &qf));
+  if (lvl->idx > 0) {
+    // Coarse partner x_{l-1} = A_{l-1}^{-1} P^T A_l x_l
+    PetscCall(MatMult(lvl->Af, x, lvl->r));
+    PetscCall(MatRestrict(lvl->Pf, lvl->r, lvl->rc));
+    PetscCall(KSPSolve(lvl->solver, lvl->rc, lvl->xc));
+    PetscCall(MLMC_EvaluateQOI(ctx, lvl->idx - 1, lvl->mc, lvl->xc, &qc));
+  }
+  lvl->Y[lvl->n++] = qf - qc;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* Number of rows of a matrix with N rows that rank `rank` of a group of
+   `size` ranks owns */
+static PetscInt MLMC_LocalSize(PetscInt N, PetscMPIInt rank, PetscMPIInt size)
+{
+  return N / size + (rank < N % size);
+}
+
+PetscErrorCode MLMCSetUp(MLMC mlmc)
+{
+  MLMCCtx     ctx = mlmc->ctx;
+  PetscMPIInt rank, size, subrank, subsize;
+  Vec        *bs, *ms;
+
+  PetscFunctionBeginUser;
+  PetscCheck(ctx->nlevels > 0, ctx->comm, PETSC_ERR_ORDER, "Call MLMCSetHierarchy() first");
+  PetscCheck(ctx->qoi || ctx->m, ctx->comm, PETSC_ERR_ORDER, "Set a measurement vector or a quantity of interest first");
+  PetscCall(MLMC_ResetLevels(ctx));
+
+  /* Groups of consecutive ranks, level pair l runs on group l % ngroups */
+  PetscCallMPI(MPI_Comm_rank(ctx->comm, &rank));
+  PetscCallMPI(MPI_Comm_size(ctx->comm, &size));
+  ctx->ngroups = ctx->groups > 0 ? ctx->groups : (PetscMPIInt)PetscMin(size, ctx->nlevels);
+  PetscCheck(ctx->ngroups <= size, ctx->comm, PETSC_ERR_ARG_OUTOFRANGE, "Cannot split %d ranks into %d groups", size, ctx->ngroups);
+  ctx->group = (PetscMPIInt)(((PetscInt64)rank * ctx->ngroups) / size);
+  PetscCallMPI(MPI_Comm_split(ctx->comm, ctx->group, rank, &ctx->subcomm));
+  PetscCallMPI(MPI_Comm_rank(ctx->subcomm, &subrank));
+  PetscCallMPI(MPI_Comm_size(ctx->subcomm, &subsize));
+  for (PetscInt l = 0; l < ctx->nlevels; ++l) ctx->levels[l].group = (PetscMPIInt)(l % ctx->ngroups);
+
+  /* Right hand sides and measurement vectors on all levels, from fine to coarse */
+  PetscCall(PetscCalloc2(ctx->nlevels, &bs, ctx->nlevels, &ms));
+  for (PetscInt l = ctx->nlevels - 1; l >= 0; --l) {
+    PetscCall(MatCreateVecs(ctx->levels[l].A, NULL, &bs[l]));
+    if (l == ctx->nlevels - 1) {
+      if (ctx->b) PetscCall(VecCopy(ctx->b, bs[l]));
+      else PetscCall(VecZeroEntries(bs[l]));
+    } else PetscCall(MatRestrict(ctx->levels[l + 1].P, bs[l + 1], bs[l]));
+
+    if (ctx->m) {
+      PetscCall(VecDuplicate(bs[l], &ms[l]));
+      if (l == ctx->nlevels - 1) PetscCall(VecCopy(ctx->m, ms[l]));
+      else PetscCall(MatRestrict(ctx->levels[l + 1].P, ms[l + 1], ms[l]));
+    }
+  }
+
+  /* Move each level pair onto its group. This is collective on the whole
+     communicator, ranks outside the group take part with empty blocks. */
+  for (PetscInt l = 0; l < ctx->nlevels; ++l) {
+    MLMCLevel lvl  = &ctx->levels[l];
+    PetscBool mine = lvl->group == ctx->group ? PETSC_TRUE : PETSC_FALSE;
+    MPI_Comm  sub  = mine ? ctx->subcomm : MPI_COMM_NULL;
+    PetscInt  N, nf, nc = 0;
+
+    PetscCall(MatGetSize(lvl->A, &N, NULL));
+    nf = mine ? MLMC_LocalSize(N, subrank, subsize) : 0;
+    PetscCall(ParMGMCMatRedistribute(lvl->A, sub, nf, nf, &lvl->Af));
+    PetscCall(ParMGMCVecRedistribute(bs[l], sub, nf, &lvl->b));
+    if (ctx->m) PetscCall(ParMGMCVecRedistribute(ms[l], sub, nf, &lvl->m));
+    if (l > 0) {
+      PetscCall(MatGetSize(ctx->levels[l - 1].A, &N, NULL));
+      nc = mine ? MLMC_LocalSize(N, subrank, subsize) : 0;
+      PetscCall(ParMGMCMatRedistribute(ctx->levels[l - 1].A, sub, nc, nc, &lvl->Ac));
+      PetscCall(ParMGMCMatRedistribute(lvl->P, sub, nf, nc, &lvl->Pf));
+      if (ctx->m) PetscCall(ParMGMCVecRedistribute(ms[l - 1], sub, nc, &lvl->mc));
+    }
+  }
+  for (PetscInt l = 0; l < ctx->nlevels; ++l) {
+    PetscCall(VecDestroy(&bs[l]));
+    PetscCall(VecDestroy(&ms[l]));
+  }
+  PetscCall(PetscFree2(bs, ms));
+
+  for (PetscInt l = 0; l < ctx->nlevels; ++l) {
+    MLMCLevel lvl = &ctx->levels[l];
+    PC        pc;
+
+    lvl->n        = 0;
+    lvl->cap      = 0;
+    lvl->burnt_in = PETSC_FALSE;
+    if (lvl->group != ctx->group) continue;
+
+    PetscCall(VecDuplicate(lvl->b, &lvl->x));
+    PetscCall(VecZeroEntries(lvl->x));
+    PetscCall(KSPCreate(ctx->subcomm, &lvl->sampler));
+    PetscCall(KSPSetOperators(lvl->sampler, lvl->Af, lvl->Af));
+    PetscCall(KSPSetType(lvl->sampler, KSPRICHARDSON));
+    PetscCall(KSPGetPC(lvl->sampler, &pc));
+    PetscCall(PCSetType(pc, PCGAMGMC));
+    PetscCall(KSPSetOptionsPrefix(lvl->sampler, "mlmc_sampler_"));
+    PetscCall(KSPSetFromOptions(lvl->sampler));
+    PetscCall(KSPSetUp(lvl->sampler));
+    PetscCall(KSPSetNormType(lvl->sampler, KSP_NORM_NONE));
+    PetscCall(KSPSetConvergenceTest(lvl->sampler, KSPConvergedSkip, NULL, NULL));
+    PetscCall(KSPSetInitialGuessNonzero(lvl->sampler, PETSC_TRUE));
+    PetscCall(PCSetSampleCallback(pc, MLMC_SampleCallback, lvl, NULL));
+
+    if (l > 0) {
+      PetscBool islrc;
+
+      PetscCall(KSPCreate(ctx->subcomm, &lvl->solver));
+      PetscCall(KSPSetOperators(lvl->solver, lvl->Ac, lvl->Ac));
+      PetscCall(KSPSetType(lvl->solver, KSPCG));
+      PetscCall(KSPSetTolerances(lvl->solver, 1e-10, 1e-12, PETSC_DEFAULT, PETSC_DEFAULT));
+      PetscCall(KSPGetPC(lvl->solver, &pc));
+      PetscCall(PetscObjectTypeCompare((PetscObject)lvl->Ac, MATLRC, &islrc));
+      PetscCall(PCSetType(pc, islrc ? PCNONE : PCGAMG));
+      PetscCall(KSPSetOptionsPrefix(lvl->solver, "mlmc_solver_"));
+      PetscCall(KSPSetFromOptions(lvl->solver));
+      PetscCall(KSPSetUp(lvl->solver));
+
+      PetscCall(VecDuplicate(lvl->x, &lvl->r));
+      PetscCall(MatCreateVecs(lvl->Ac, &lvl->xc, &lvl->rc));
+    }
+  }
+  PetscCall(PetscInfo(NULL, "MLMC: %" PetscInt_FMT " level pairs on %d group(s) of ranks\n", ctx->nlevels, ctx->ngroups));
+  ctx->setup_called = PETSC_TRUE;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* Adds n samples of Q_l - Q_{l-1} and measures the cost per sample */
+static PetscErrorCode MLMC_RunLevel(MLMCCtx ctx, MLMCLevel lvl, PetscInt n)
+{
+  PetscLogDouble t0, t1, t;
+
+  PetscFunctionBeginUser;
+  if (n <= 0) PetscFunctionReturn(PETSC_SUCCESS);
+  if (!lvl->burnt_in && ctx->nburnin > 0) {
+    PetscCall(KSPSetTolerances(lvl->sampler, PETSC_DEFAULT, PETSC_DEFAULT, PETSC_DEFAULT, ctx->nburnin));
+    PetscCall(KSPSolve(lvl->sampler, lvl->b, lvl->x));
+  }
+  lvl->burnt_in = PETSC_TRUE;
+
+  if (lvl->n + n > lvl->cap) {
+    lvl->cap = PetscMax(lvl->n + n, 2 * lvl->cap);
+    PetscCall(PetscRealloc(sizeof(PetscScalar) * lvl->cap, &lvl->Y));
+  }
+
+  lvl->recording = PETSC_TRUE;
+  PetscCall(KSPSetTolerances(lvl->sampler, PETSC_DEFAULT, PETSC_DEFAULT, PETSC_DEFAULT, n));
+  PetscCall(PetscTime(&t0));
+  PetscCall(KSPSolve(lvl->sampler, lvl->b, lvl->x));
+  PetscCall(PetscTime(&t1));
+  lvl->recording = PETSC_FALSE;
+
+  t = (t1 - t0) / n;
+  PetscCallMPI(MPI_Allreduce(MPI_IN_PLACE, &t, 1, MPI_DOUBLE, MPI_MAX, ctx->subcomm));
+  lvl->cost = PetscMax((PetscReal)t, PETSC_SMALL);
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+static PetscErrorCode MLMC_UpdateStatistics(MLMCLevel lvl)
+{
+  PetscScalar tau = 1;
+
+  PetscFunctionBeginUser;
+  lvl->mean = 0;
+  for (PetscInt i = 0; i < lvl->n; ++i) lvl->mean += lvl->Y[i];
+  lvl->mean /= lvl->n;
+
+  lvl->var = 0;
+  for (PetscInt i = 0; i < lvl->n; ++i) lvl->var += PetscRealPart(PetscConj(lvl->Y[i] - lvl->mean) * (lvl->Y[i] - lvl->mean));
+  if (lvl->n > 1) {
+    lvl->var /= lvl->n - 1;
+    if (lvl->var > 0) PetscCall(IACT(lvl->n, lvl->Y, &tau, NULL, NULL));
+  }
+  lvl->tau = PetscMax(1., PetscRealPart(tau));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* Makes the statistics of all levels known on all ranks. They are computed
+   by the group that runs the level pair, its first rank contributes them. */
+static PetscErrorCode MLMC_ShareStatistics(MLMCCtx ctx)
+{
+  PetscReal   *st;
+  PetscScalar *mean;
+  PetscMPIInt  subrank;
+
+  PetscFunctionBeginUser;
+  PetscCallMPI(MPI_Comm_rank(ctx->subcomm, &subrank));
+  PetscCall(PetscCalloc2(4 * ctx->nlevels, &st, ctx->nlevels, &mean));
+  for (PetscInt l = 0; l < ctx->nlevels; ++l) {
+    MLMCLevel lvl = &ctx->levels[l];
+
+    if (lvl->group != ctx->group || subrank != 0) continue;
+    st[4 * l]     = (PetscReal)lvl->n;
+    st[4 * l + 1] = lvl->var;
+    st[4 * l + 2] = lvl->tau;
+    st[4 * l + 3] = lvl->cost;
+    mean[l]       = lvl->mean;
+  }
+  PetscCallMPI(MPI_Allreduce(MPI_IN_PLACE, st, (PetscMPIInt)(4 * ctx->nlevels), MPIU_REAL, MPIU_SUM, ctx->comm));
+  PetscCallMPI(MPI_Allreduce(MPI_IN_PLACE, mean, (PetscMPIInt)ctx->nlevels, MPIU_SCALAR, MPIU_SUM, ctx->comm));
+  for (PetscInt l = 0; l < ctx->nlevels; ++l) {
+    MLMCLevel lvl = &ctx->levels[l];
+
+    lvl->n    = (PetscInt)st[4 * l];
+    lvl->var  = st[4 * l + 1];
+    lvl->tau  = st[4 * l + 2];
+    lvl->cost = st[4 * l + 3];
+    lvl->mean = mean[l];
+  }
+  PetscCall(PetscFree2(st, mean));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Estimates the expectation of the quantity of interest on the finest
+    level up to the root mean squared error set with MLMCSetRMSE(). The
+    samples are added to all level pairs concurrently, each on its group of
+    ranks.
+ */
+PetscErrorCode MLMCEstimate(MLMC mlmc, PetscScalar *est)
+{
+  MLMCCtx ctx = mlmc->ctx;
+
+  PetscFunctionBeginUser;
+  if (!ctx->setup_called) PetscCall(MLMCSetUp(mlmc));
+
+  for (PetscInt l = 0; l < ctx->nlevels; ++l) {
+    MLMCLevel lvl = &ctx->levels[l];
+
+    if (lvl->group != ctx->group) continue;
+    PetscCall(MLMC_RunLevel(ctx, lvl, PetscMax(ctx->nstart - lvl->n, 0)));
+    PetscCall(MLMC_UpdateStatistics(lvl));
+  }
+  PetscCall(MLMC_ShareStatistics(ctx));
+
+  while (PETSC_TRUE) {
+    PetscReal sum  = 0;
+    PetscBool done = PETSC_TRUE;
+
+    for (PetscInt l = 0; l < ctx->nlevels; ++l) sum += PetscSqrtReal(ctx->levels[l].var * ctx->levels[l].tau * ctx->levels[l].cost);
+    for (PetscInt l = 0; l < ctx->nlevels; ++l) {
+      MLMCLevel lvl = &ctx->levels[l];
+      PetscReal nopt;
+
+      nopt = PetscCeilReal(2 / (ctx->rmse * ctx->rmse) * PetscSqrtReal(lvl->var * lvl->tau / lvl->cost) * sum);
+      nopt = PetscMin(nopt, (PetscReal)ctx->maxsamples);
+      if (nopt > lvl->n) {
+        done = PETSC_FALSE;
+        if (lvl->group != ctx->group) continue;
+        PetscCall(PetscInfo(NULL, "MLMC level %" PetscInt_FMT ": adding %" PetscInt_FMT " samples\n", l, (PetscInt)nopt - lvl->n));
+        PetscCall(MLMC_RunLevel(ctx, lvl, (PetscInt)nopt - lvl->n));
+        PetscCall(MLMC_UpdateStatistics(lvl));
+      }
+    }
+    if (done) break;
+    PetscCall(MLMC_ShareStatistics(ctx));
+  }
+
+  *est = 0;
+  for (PetscInt l = 0; l < ctx->nlevels; ++l) *est += ctx->levels[l].mean;
+
+  /* Bias check, the statistical error is at most rmse / sqrt(2) */
+  if (ctx->nlevels > 1) {
+    ctx->bias           = PetscAbsScalar(ctx->levels[ctx->nlevels - 1].mean);
+    ctx->bias_converged = ctx->bias <= ctx->rmse / PetscSqrtReal(2.) ? PETSC_TRUE : PETSC_FALSE;
+  } else PetscCall(PetscInfo(NULL, "MLMC: the bias cannot be estimated with a single level\n"));
+  if (ctx->nlevels > 1 && !ctx->bias_converged) PetscCall(PetscInfo(NULL, "MLMC: estimated bias %g exceeds rmse / sqrt(2) = %g, the hierarchy needs more levels\n", (double)ctx->bias, (double)(ctx->rmse / PetscSqrtReal(2.))));
+  if (ctx->view) PetscCall(MLMCView(mlmc, PETSC_VIEWER_STDOUT_(ctx->comm)));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Returns the number of samples, the mean and variance of
+    \f$Q_l - Q_{l-1}\f$ (just \f$Q_0\f$ on level 0) and the cost per sample
+    in seconds on level `l`. Each output argument can be NULL.
+ */
+PetscErrorCode MLMCGetLevelStatistics(MLMC mlmc, PetscInt l, PetscInt *n, PetscScalar *mean, PetscReal *var, PetscReal *cost)
+{
+  MLMCCtx ctx = mlmc->ctx;
+
+  PetscFunctionBeginUser;
+  PetscCheck(l >= 0 && l < ctx->nlevels, ctx->comm, PETSC_ERR_ARG_OUTOFRANGE, "Level %" PetscInt_FMT " does not exist", l);
+  if (n) *n = ctx->levels[l].n;
+  if (mean) *mean = ctx->levels[l].mean;
+  if (var) *var = ctx->levels[l].var;
+  if (cost) *cost = ctx->levels[l].cost;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+PetscErrorCode MLMCView(MLMC mlmc, PetscViewer v)
+{
+  MLMCCtx     ctx = mlmc->ctx;
+  PetscScalar est = 0;
+  PetscBool   isascii;
+
+  PetscFunctionBeginUser;
+  PetscCall(PetscObjectTypeCompare((PetscObject)v, PETSCVIEWERASCII, &isascii));
+  if (!isascii) PetscFunctionReturn(PETSC_SUCCESS);
+  PetscCall(PetscViewerASCIIPrintf(v, "MLMC estimator with %" PetscInt_FMT " levels, target RMSE %g\n", ctx->nlevels, (double)ctx->rmse));
+  PetscCall(PetscViewerASCIIPushTab(v));
+  for (PetscInt l = 0; l < ctx->nlevels; ++l) {
+    MLMCLevel lvl = &ctx->levels[l];
+
+    est += lvl->mean;
+    PetscCall(PetscViewerASCIIPrintf(v, "Level %" PetscInt_FMT ": %" PetscInt_FMT " samples, mean %g, variance %g, IACT %.2f, cost/sample %g s\n", l, lvl->n, (double)PetscRealPart(lvl->mean), (double)lvl->var, (double)lvl->tau, (double)lvl->cost));
+  }
+  PetscCall(PetscViewerASCIIPrintf(v, "Estimate: %g\n", (double)PetscRealPart(est)));
+  PetscCall(PetscViewerASCIIPrintf(v, "Level pairs distributed over %d group(s) of ranks\n", ctx->ngroups));
+  if (ctx->nlevels > 1) PetscCall(PetscViewerASCIIPrintf(v, "Bias indicator |E[Q_L - Q_{L-1}]|: %g (target %g, %s)\n", (double)ctx->bias, (double)(ctx->rmse / PetscSqrtReal(2.)), ctx->bias_converged ? "converged" : "not converged, more levels needed"));
+  PetscCall(PetscViewerASCIIPopTab(v));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+PetscErrorCode MLMCSetFromOptions(MLMC mlmc)
+{
+  MLMCCtx ctx = mlmc->ctx;
+
+  PetscFunctionBeginUser;
+  PetscOptionsBegin(ctx->comm, NULL, "Options for the MLMC estimator", NULL);
+  PetscCall(PetscOptionsReal("-mlmc_rmse", "Target root mean squared error", "MLMCSetRMSE", ctx->rmse, &ctx->rmse, NULL));
+  PetscCall(PetscOptionsInt("-mlmc_initial_samples", "Number of samples per level for the initial variance estimates", NULL, ctx->nstart, &ctx->nstart, NULL));
+  PetscCall(PetscOptionsInt("-mlmc_burnin", "Number of samples discarded at the start of each chain", NULL, ctx->nburnin, &ctx->nburnin, NULL));
+  PetscCall(PetscOptionsInt("-mlmc_max_samples", "Maximum number of samples per level", NULL, ctx->maxsamples, &ctx->maxsamples, NULL));
+  PetscCall(PetscOptionsBool("-mlmc_view", "Print level statistics after the estimation", "MLMCView", ctx->view, &ctx->view, NULL));
+  PetscCall(PetscOptionsMPIInt("-mlmc_groups", "Number of groups of ranks the level pairs are distributed over (0: one per level)", NULL, ctx->groups, &ctx->groups, NULL));
+  PetscOptionsEnd();
+  PetscCheck(ctx->nstart > 1, ctx->comm, PETSC_ERR_ARG_OUTOFRANGE, "Need at least 2 initial samples per level");
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+PetscErrorCode MLMCCreate(MPI_Comm comm, MLMC *mlmc)
+{
+  MLMCCtx ctx;
+
+  PetscFunctionBeginUser;
+  PetscCall(PetscNew(mlmc));
+  PetscCall(PetscNew(&ctx));
+  (*mlmc)->ctx = ctx;
+
+  ctx->comm       = comm;
+  ctx->subcomm    = MPI_COMM_NULL;
+  ctx->rmse       = 1e-2;
+  ctx->nstart     = 50;
+  ctx->nburnin    = 100;
+  ctx->maxsamples = 100000;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
@@ -163,6 +163,26 @@ static PetscErrorCode MS_AssembleMat(MS ms)
   PetscFunctionReturn(PETSC_SUCCESS);
 }
 
+/* Recomputes the values of the precision matrix in place, e.g. after kappa
+   has changed. The nonzero pattern stays the same, so the sampler only redoes
+   its numeric setup at the next sample. */
+static PetscErrorCode MS_ReassembleMat(MS ms)
+{
+  MSCtx   ctx = ms->ctx;
+  PetscDS ds;
+  Vec     u;
+
+  PetscFunctionBeginUser;
+  PetscCall(DMGetDS(ctx->dm, &ds));
+  PetscCall(PetscDSSetConstants(ds, 1, &ctx->kappa));
+  PetscCall(DMGetLocalVector(ctx->dm, &u));
+  PetscCall(VecZeroEntries(u));
+  PetscCall(MatZeroEntries(ctx->A));
+  PetscCall(DMPlexSNESComputeJacobianFEM(ctx->dm, u, ctx->A, ctx->A, NULL));
+  PetscCall(DMRestoreLocalVector(ctx->dm, &u));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
 static PetscErrorCode MS_SampleCallback(PetscInt it, Vec y, void *msctx)
 {
   MSCtx ctx = msctx;
@@ -281,6 +301,8 @@ PetscErrorCode MSSetKappa(MS ms, PetscScalar kappa)
   PetscFunctionBeginUser;
   PetscCheck(kappa >= 0, ctx->comm, PETSC_ERR_SUP, "Range parameter kappa must be nonnegative");
   ctx->kappa = kappa;
+  // After MSSetUp the matrix is updated in place, the sampler is kept
+  if (ctx->A) PetscCall(MS_ReassembleMat(ms));
   PetscFunctionReturn(PETSC_SUCCESS);
 }
 
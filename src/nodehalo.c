@@ -0,0 +1,339 @@
+/*  ParMGMC - Implementation of the Multigrid Monte Carlo method in PETSc.
+    Copyright (C) 2024  Nils Friess
+
+    This file is part of ParMGMC which is released under the GNU LESSER GENERAL
+    PUBLIC LICENSE (LGPL). See file LICENSE in the project root folder for full
+    license details.
+*/
+
+#include "parmgmc/nodehalo.h"
+
+#include <petscerror.h>
+#include <petscis.h>
+#include <petsclog.h>
+#include <petscsys.h>
+#include <petscsystypes.h>
+#include <petscvec.h>
+#include <mpi.h>
+
+/** @file nodehalo.c
+    @brief Node-aware ghost exchange through MPI shared memory
+
+    # Notes
+    Every rank copies (publishes) its owned vector entries into a segment of
+    an `MPI_Win_allocate_shared` window that is shared by all ranks on the
+    same node. Ghost values owned by a rank on the same node are then read
+    directly from that rank's segment, only ghost values owned by ranks on
+    other nodes are communicated with a (smaller) VecScatter.
+
+    The window is split into `nbuf` buffers, each holding a full copy of the
+    owned entries. A typical exchange looks like
+
+        NodeHaloPublish(nh, buf, x, NULL);
+        NodeHaloPlanBegin(plan, x, ghost);   // off-node part
+        NodeHaloFence(nh);                   // all ranks on node published
+        NodeHaloPlanEnd(plan, x, ghost);     // off-node part + on-node reads
+
+    `NodeHaloFence` is a barrier on the node communicator, so all ranks on a
+    node must call it the same number of times. A rank must not publish into
+    a buffer again before all ranks on the node have read from it, i.e.,
+    before the next fence. Callers that publish twice between two reads use
+    two buffers.
+
+    Instead of the fence, callers that alternate between reading and
+    publishing into a single buffer can use NodeHaloWait(). Every rank counts
+    its publishes in a flag in shared memory, and NodeHaloWait() only waits
+    until the on-node neighbours (the ranks that the plans read from) have
+    published as often as the calling rank:
+
+        NodeHaloPlanBegin(plan, x, ghost);
+        NodeHaloWait(nh);                    // neighbours have caught up
+        NodeHaloPlanEnd(plan, x, ghost);
+        ...                                  // update some entries of x
+        NodeHaloWait(nh);                    // only needed if there was no read
+        NodeHaloPublish(nh, 0, x, rows);
+
+    A neighbour can then be at most one publish ahead, so a read sees the
+    neighbour's values after its previous publish and, for all entries that
+    are not part of the neighbour's next publish, no newer ones. This assumes
+    that the neighbour relation is symmetric (i.e., the plans are built from
+    a matrix with a symmetric nonzero pattern): a rank must wait for every
+    rank that reads from it.
+*/
+
+struct _NodeHalo {
+  MPI_Comm        comm, nodecomm;
+  MPI_Win         win, flagwin;
+  PetscInt        nbuf, n;
+  PetscInt        npub;   // number of publishes of this rank
+  PetscInt      **flags;  // publish counter of each node rank (in flagwin)
+  PetscBool      *nbr;    // node ranks that a plan reads from
+  PetscScalar    *seg;
+  PetscMPIInt     rank, nodesize;
+  PetscMPIInt    *nodeof; // node rank of each rank in comm (or MPI_UNDEFINED)
+  PetscScalar   **base;   // start of each node rank's segment
+  PetscLayout     map;
+  const PetscInt *ranges;
+};
+
+struct _NodeHaloPlan {
+  NodeHalo            nh;
+  VecScatter          sct; // off-node part
+  PetscInt            non, noff;
+  PetscInt           *dst;
+  const PetscScalar **src;
+};
+
+/** @brief Create the shared memory segments for vectors with the layout of `x`.
+
+    @param x    template vector (only the layout and communicator are used)
+    @param nbuf number of independent buffers to allocate
+    @param nh   the new NodeHalo
+*/
+PetscErrorCode NodeHaloCreate(Vec x, PetscInt nbuf, NodeHalo *nh)
+{
+  NodeHalo    h;
+  PetscLayout map;
+  PetscMPIInt size, *all, *node;
+  MPI_Group   grp, nodegrp;
+  PetscInt   *flag;
+
+  PetscFunctionBeginUser;
+  PetscCheck(nbuf > 0, PetscObjectComm((PetscObject)x), PETSC_ERR_ARG_OUTOFRANGE, "Number of buffers must be positive");
+  PetscCall(PetscNew(&h));
+  h->comm = PetscObjectComm((PetscObject)x);
+  h->nbuf = nbuf;
+  PetscCall(VecGetLocalSize(x, &h->n));
+  PetscCall(VecGetLayout(x, &map));
+  PetscCall(PetscLayoutReference(map, &h->map));
+  PetscCall(PetscLayoutGetRanges(h->map, &h->ranges));
+
+  PetscCallMPI(MPI_Comm_rank(h->comm, &h->rank));
+  PetscCallMPI(MPI_Comm_size(h->comm, &size));
+  PetscCallMPI(MPI_Comm_split_type(h->comm, MPI_COMM_TYPE_SHARED, h->rank, MPI_INFO_NULL, &h->nodecomm));
+  PetscCallMPI(MPI_Comm_size(h->nodecomm, &h->nodesize));
+
+  PetscCallMPI(MPI_Win_allocate_shared((MPI_Aint)(nbuf * h->n * sizeof(PetscScalar)), sizeof(PetscScalar), MPI_INFO_NULL, h->nodecomm, &h->seg, &h->win));
+  PetscCallMPI(MPI_Win_lock_all(MPI_MODE_NOCHECK, h->win));
+
+  PetscCallMPI(MPI_Win_allocate_shared((MPI_Aint)sizeof(PetscInt), sizeof(PetscInt), MPI_INFO_NULL, h->nodecomm, &flag, &h->flagwin));
+  PetscCallMPI(MPI_Win_lock_all(MPI_MODE_NOCHECK, h->flagwin));
+
+  PetscCall(PetscMalloc3(h->nodesize, &h->base, h->nodesize, &h->flags, h->nodesize, &h->nbr));
+  for (PetscMPIInt q = 0; q < h->nodesize; ++q) {
+    MPI_Aint sz;
+    int      du;
+
+    PetscCallMPI(MPI_Win_shared_query(h->win, q, &sz, &du, &h->base[q]));
+    PetscCallMPI(MPI_Win_shared_query(h->flagwin, q, &sz, &du, &h->flags[q]));
+    h->nbr[q] = PETSC_FALSE;
+  }
+  // Nobody reads the flags before the barrier in NodeHaloFence
+  *flag = 0;
+  PetscCall(NodeHaloFence(h));
+
+  // Map each rank of the original communicator to its rank on this node
+  PetscCall(PetscMalloc2(size, &all, size, &node));
+  for (PetscMPIInt r = 0; r < size; ++r) all[r] = r;
+  PetscCallMPI(MPI_Comm_group(h->comm, &grp));
+  PetscCallMPI(MPI_Comm_group(h->nodecomm, &nodegrp));
+  PetscCallMPI(MPI_Group_translate_ranks(grp, size, all, nodegrp, node));
+  PetscCallMPI(MPI_Group_free(&grp));
+  PetscCallMPI(MPI_Group_free(&nodegrp));
+  PetscCall(PetscMalloc1(size, &h->nodeof));
+  for (PetscMPIInt r = 0; r < size; ++r) h->nodeof[r] = node[r];
+  PetscCall(PetscFree2(all, node));
+
+  PetscCall(PetscInfo(NULL, "Node-aware halo: %d of %d ranks share this node\n", h->nodesize, size));
+  *nh = h;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+PetscErrorCode NodeHaloDestroy(NodeHalo *nh)
+{
+  PetscFunctionBeginUser;
+  if (!*nh) PetscFunctionReturn(PETSC_SUCCESS);
+  PetscCallMPI(MPI_Win_unlock_all((*nh)->win));
+  PetscCallMPI(MPI_Win_free(&(*nh)->win));
+  PetscCallMPI(MPI_Win_unlock_all((*nh)->flagwin));
+  PetscCallMPI(MPI_Win_free(&(*nh)->flagwin));
+  PetscCallMPI(MPI_Comm_free(&(*nh)->nodecomm));
+  PetscCall(PetscLayoutDestroy(&(*nh)->map));
+  PetscCall(PetscFree3((*nh)->base, (*nh)->flags, (*nh)->nbr));
+  PetscCall(PetscFree((*nh)->nodeof));
+  PetscCall(PetscFree(*nh));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+PetscErrorCode NodeHaloGetNodeSize(NodeHalo nh, PetscMPIInt *nodesize)
+{
+  PetscFunctionBeginUser;
+  *nodesize = nh->nodesize;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Copy the owned entries of `x` into buffer `buf` of this rank's segment.
+
+    If `rows` is not NULL, only the (local) indices in `rows` are copied.
+*/
+PetscErrorCode NodeHaloPublish(NodeHalo nh, PetscInt buf, Vec x, IS rows)
+{
+  const PetscScalar *xarr;
+  PetscScalar       *seg = nh->seg + buf * nh->n;
+
+  PetscFunctionBeginUser;
+  PetscAssert(buf >= 0 && buf < nh->nbuf, PETSC_COMM_SELF, PETSC_ERR_ARG_OUTOFRANGE, "Invalid buffer %" PetscInt_FMT, buf);
+  PetscCall(VecGetArrayRead(x, &xarr));
+  if (rows) {
+    PetscInt        n;
+    const PetscInt *idx;
+
+    PetscCall(ISGetLocalSize(rows, &n));
+    PetscCall(ISGetIndices(rows, &idx));
+    for (PetscInt i = 0; i < n; ++i) seg[idx[i]] = xarr[idx[i]];
+    PetscCall(ISRestoreIndices(rows, &idx));
+  } else {
+    PetscCall(PetscArraycpy(seg, xarr, nh->n));
+  }
+  PetscCall(VecRestoreArrayRead(x, &xarr));
+  // The values must be visible before the counter
+  PetscCallMPI(MPI_Win_sync(nh->win));
+  *nh->flags[nh->nodeof[nh->rank]] = ++nh->npub;
+  PetscCallMPI(MPI_Win_sync(nh->flagwin));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Make all values published so far visible to the other ranks on the node.
+
+    Collective on the node communicator.
+*/
+PetscErrorCode NodeHaloFence(NodeHalo nh)
+{
+  PetscFunctionBeginUser;
+  PetscCallMPI(MPI_Win_sync(nh->win));
+  PetscCallMPI(MPI_Barrier(nh->nodecomm));
+  PetscCallMPI(MPI_Win_sync(nh->win));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Wait until all on-node neighbours have published at least as often
+    as this rank.
+
+    Only waits for the ranks that the plans created so far read from, see the
+    notes at the top of this file.
+*/
+PetscErrorCode NodeHaloWait(NodeHalo nh)
+{
+  PetscFunctionBeginUser;
+  for (PetscMPIInt q = 0; q < nh->nodesize; ++q) {
+    if (!nh->nbr[q]) continue;
+    while (PETSC_TRUE) {
+      PetscCallMPI(MPI_Win_sync(nh->flagwin));
+      if (*(volatile PetscInt *)nh->flags[q] >= nh->npub) break;
+    }
+  }
+  // Do not read the values before the counters
+  PetscCallMPI(MPI_Win_sync(nh->win));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Create a plan that gathers the global indices `from` of a vector with
+    the layout of `x` into the positions `to` of the sequential vector `ghost`.
+
+    This is the equivalent of `VecScatterCreate(x, from, ghost, to, &sct)`. If
+    `to` is NULL, the i-th entry of `from` is stored at position i. Entries
+    owned by ranks on the same node are read from buffer `buf`.
+*/
+PetscErrorCode NodeHaloPlanCreate(NodeHalo nh, PetscInt buf, Vec x, IS from, Vec ghost, IS to, NodeHaloPlan *plan)
+{
+  NodeHaloPlan    p;
+  PetscInt        n, cnt = 0, *offfrom, *offto;
+  const PetscInt *fidx, *tidx = NULL;
+  IS              offfromis, offtois;
+
+  PetscFunctionBeginUser;
+  PetscCall(PetscNew(&p));
+  p->nh = nh;
+
+  PetscCall(ISGetLocalSize(from, &n));
+  PetscCall(ISGetIndices(from, &fidx));
+  if (to) PetscCall(ISGetIndices(to, &tidx));
+  PetscCall(PetscMalloc2(n, &p->dst, n, &p->src));
+  PetscCall(PetscMalloc1(n, &offfrom));
+  PetscCall(PetscMalloc1(n, &offto));
+  for (PetscInt i = 0; i < n; ++i) {
+    PetscMPIInt owner, q;
+    PetscInt    pos = tidx ? tidx[i] : i;
+
+    PetscCall(PetscLayoutFindOwner(nh->map, fidx[i], &owner));
+    q = nh->nodeof[owner];
+    if (q != MPI_UNDEFINED) {
+      const PetscInt nq = nh->ranges[owner + 1] - nh->ranges[owner];
+
+      if (owner != nh->rank) nh->nbr[q] = PETSC_TRUE;
+      p->src[p->non] = nh->base[q] + buf * nq + (fidx[i] - nh->ranges[owner]);
+      p->dst[p->non] = pos;
+      p->non++;
+    } else {
+      offfrom[cnt] = fidx[i];
+      offto[cnt]   = pos;
+      cnt++;
+    }
+  }
+  if (to) PetscCall(ISRestoreIndices(to, &tidx));
+  PetscCall(ISRestoreIndices(from, &fidx));
+  p->noff = cnt;
+
+  PetscCall(ISCreateGeneral(PETSC_COMM_SELF, cnt, offfrom, PETSC_OWN_POINTER, &offfromis));
+  PetscCall(ISCreateGeneral(PETSC_COMM_SELF, cnt, offto, PETSC_OWN_POINTER, &offtois));
+  PetscCall(VecScatterCreate(x, offfromis, ghost, offtois, &p->sct));
+  PetscCall(ISDestroy(&offfromis));
+  PetscCall(ISDestroy(&offtois));
+
+  PetscCall(PetscInfo(NULL, "Node-aware halo plan: %" PetscInt_FMT " on-node and %" PetscInt_FMT " off-node ghost values\n", p->non, p->noff));
+  *plan = p;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+PetscErrorCode NodeHaloPlanGetSizes(NodeHaloPlan plan, PetscInt *non, PetscInt *noff)
+{
+  PetscFunctionBeginUser;
+  if (non) *non = plan->non;
+  if (noff) *noff = plan->noff;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Start the off-node part of the exchange. */
+PetscErrorCode NodeHaloPlanBegin(NodeHaloPlan plan, Vec x, Vec ghost)
+{
+  PetscFunctionBeginUser;
+  PetscCall(VecScatterBegin(plan->sct, x, ghost, INSERT_VALUES, SCATTER_FORWARD));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Finish the off-node part of the exchange and read the on-node values.
+
+    The on-node values are read from the shared segments as they were at the
+    last NodeHaloFence.
+*/
+PetscErrorCode NodeHaloPlanEnd(NodeHaloPlan plan, Vec x, Vec ghost)
+{
+  PetscScalar *garr;
+
+  PetscFunctionBeginUser;
+  PetscCall(VecScatterEnd(plan->sct, x, ghost, INSERT_VALUES, SCATTER_FORWARD));
+  PetscCall(VecGetArray(ghost, &garr));
+  for (PetscInt i = 0; i < plan->non; ++i) garr[plan->dst[i]] = *plan->src[i];
+  PetscCall(VecRestoreArray(ghost, &garr));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+PetscErrorCode NodeHaloPlanDestroy(NodeHaloPlan *plan)
+{
+  PetscFunctionBeginUser;
+  if (!*plan) PetscFunctionReturn(PETSC_SUCCESS);
+  PetscCall(VecScatterDestroy(&(*plan)->sct));
+  PetscCall(PetscFree2((*plan)->dst, (*plan)->src));
+  PetscCall(PetscFree(*plan));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
@@ -8,6 +8,7 @@
 
 #include "parmgmc/obs.h"
 
+#include <petscblaslapack.h>
 #include <petscdm.h>
 #include <petscerror.h>
 #include <petscmat.h>
@@ -178,3 +179,246 @@ PetscErrorCode MakeObservationMats(DM dm, PetscInt nobs, PetscScalar sigma2, con
   }
   PetscFunctionReturn(PETSC_SUCCESS);
 }
+
+/* Eigendecomposition of the symmetric l x l matrix `a` (column major). The
+   eigenvalues are returned in ascending order in `w`, `a` is overwritten with
+   the eigenvectors. */
+static PetscErrorCode SymmetricEigen(PetscBLASInt l, PetscScalar *a, PetscReal *w)
+{
+  PetscFunctionBeginUser;
+#if defined(PETSC_USE_COMPLEX)
+  SETERRQ(PETSC_COMM_SELF, PETSC_ERR_SUP, "Compression of the observations is only implemented for real scalars");
+#else
+  PetscBLASInt lwork = -1, info;
+  PetscScalar  wkopt, *work;
+
+  PetscCallBLAS("LAPACKsyev", LAPACKsyev_("V", "U", &l, a, &l, w, &wkopt, &lwork, &info));
+  lwork = (PetscBLASInt)wkopt;
+  PetscCall(PetscMalloc1(lwork, &work));
+  PetscCall(PetscFPTrapPush(PETSC_FP_TRAP_OFF));
+  PetscCallBLAS("LAPACKsyev", LAPACKsyev_("V", "U", &l, a, &l, w, work, &lwork, &info));
+  PetscCall(PetscFPTrapPop());
+  PetscCall(PetscFree(work));
+  PetscCheck(info == 0, PETSC_COMM_SELF, PETSC_ERR_LIB, "LAPACK syev failed with error %" PetscBLASInt_FMT, info);
+  PetscFunctionReturn(PETSC_SUCCESS);
+#endif
+}
+
+/* Standard normal number (polar method), `rand` must draw from [-1, 1] */
+static PetscErrorCode RandomStandardNormal(PetscRandom rand, PetscReal *z)
+{
+  PetscReal u, v, s;
+
+  PetscFunctionBeginUser;
+  do {
+    PetscCall(PetscRandomGetValueReal(rand, &u));
+    PetscCall(PetscRandomGetValueReal(rand, &v));
+    s = u * u + v * v;
+  } while (s >= 1 || s == 0);
+  *z = u * PetscSqrtReal(-2 * PetscLogReal(s) / s);
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* A posteriori estimate of ||(I - Q Q^T) B S^{1/2}|| from `ntest` Gaussian
+   probes w: with probability at least 1 - 10^-ntest the norm is at most
+   10 sqrt(2 / pi) max_i ||(I - Q Q^T) B S^{1/2} w_i|| (Halko, Martinsson and
+   Tropp, 2011, Lemma 4.1). Q has q orthonormal columns (n local rows). */
+static PetscErrorCode ProjectionErrorEstimate(MPI_Comm comm, PetscRandom rand, PetscInt ntest, PetscInt n, PetscInt k, PetscInt q, const PetscScalar *barr, PetscBLASInt bldb, const PetscScalar *sqs, const PetscScalar *qb, PetscBLASInt bldq, PetscReal *err)
+{
+  PetscScalar  *w, *yt, *c, one = 1., mone = -1., zero = 0.;
+  PetscReal    *nrm;
+  PetscBLASInt  bn, bk, bq, bt;
+
+  PetscFunctionBeginUser;
+  PetscCall(PetscBLASIntCast(n, &bn));
+  PetscCall(PetscBLASIntCast(k, &bk));
+  PetscCall(PetscBLASIntCast(q, &bq));
+  PetscCall(PetscBLASIntCast(ntest, &bt));
+  PetscCall(PetscMalloc4(k * ntest, &w, PetscMax(n, 1) * ntest, &yt, PetscMax(q, 1) * ntest, &c, ntest, &nrm));
+  for (PetscInt j = 0; j < ntest; ++j)
+    for (PetscInt i = 0; i < k; ++i) {
+      PetscReal z;
+
+      PetscCall(RandomStandardNormal(rand, &z));
+      w[i + j * k] = sqs[i] * z;
+    }
+  PetscCall(PetscArrayzero(c, PetscMax(q, 1) * ntest));
+  if (n > 0) {
+    PetscCallBLAS("BLASgemm", BLASgemm_("N", "N", &bn, &bt, &bk, &one, barr, &bldb, w, &bk, &zero, yt, &bldq));
+    if (q > 0) PetscCallBLAS("BLASgemm", BLASgemm_("T", "N", &bq, &bt, &bn, &one, qb, &bldq, yt, &bldq, &zero, c, &bq));
+  }
+  PetscCallMPI(MPI_Allreduce(MPI_IN_PLACE, c, (PetscMPIInt)(q * ntest), MPIU_SCALAR, MPIU_SUM, comm));
+  if (n > 0 && q > 0) PetscCallBLAS("BLASgemm", BLASgemm_("N", "N", &bn, &bt, &bq, &mone, qb, &bldq, c, &bq, &one, yt, &bldq));
+  for (PetscInt j = 0; j < ntest; ++j) {
+    nrm[j] = 0;
+    for (PetscInt i = 0; i < n; ++i) nrm[j] += PetscRealPart(PetscConj(yt[i + j * bldq]) * yt[i + j * bldq]);
+  }
+  PetscCallMPI(MPI_Allreduce(MPI_IN_PLACE, nrm, (PetscMPIInt)ntest, MPIU_REAL, MPIU_SUM, comm));
+  *err = 0;
+  for (PetscInt j = 0; j < ntest; ++j) *err = PetscMax(*err, PetscSqrtReal(nrm[j]));
+  *err *= 10 * PetscSqrtReal(2 / PETSC_PI);
+  PetscCall(PetscLogFlops(2. * n * k * ntest + 4. * n * q * ntest));
+  PetscCall(PetscFree4(w, yt, c, nrm));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/**
+   @brief Compress the low-rank update B S B^T (e.g., constructed with
+   MakeObservationMats()) to U D U^T, where U has orthonormal columns and r
+   <= k columns, such that ||B S B^T - U D U^T|| <= rtol ||B S B^T|| in the
+   spectral norm (with probability at least 1 - 10^-10). The samplers on the
+   operator `MatCreateLRC(A, U, D, U)` then work with r instead of k columns
+   in every sweep.
+
+   The range of B S^{1/2} is found with a randomized range finder. The
+   sketch size l is doubled until (a) it exceeds the number r of directions
+   kept by at least 10 (oversampling) and (b) an a posteriori estimate with
+   10 Gaussian probes shows that the projection error
+   e = ||(I - Q Q^T) B S^{1/2}|| of the sketch basis Q is small enough. Half
+   of the tolerance is used for the projection, which changes the update by
+   at most 2 e ||B S^{1/2}||, and half for the truncation: the eigenvalues of
+   the projected update that are larger than rtol / 2 times the largest one
+   are kept. With many observations whose influence overlaps (e.g.,
+   thousands of sensors on a coarse field), r is usually much smaller than
+   k. The entries of S must be non-negative and `rtol` should not be smaller
+   than the square root of the machine precision.
+
+   # Input Parameters
+   - `B` - The observation matrix of size `# grid points` x `k` (MATDENSE)
+   - `S` - The inverse diagonal noise matrix, represented as a vector of length `k`
+   - `rtol` - The relative tolerance for the eigenvalues that are kept
+
+   # Output parameters
+   - `U` - The dense matrix of size `# grid points` x `r` with orthonormal columns
+   - `D` - The eigenvalues of the compressed update, a vector of length `r`
+ */
+PetscErrorCode CompressObservationMats(Mat B, Vec S, PetscReal rtol, Mat *U, Vec *D)
+{
+  MPI_Comm           comm;
+  Mat                Bl, Ul;
+  Vec                Sall;
+  VecScatter         sct;
+  PetscRandom        rand;
+  const PetscScalar *sarr, *barr;
+  PetscScalar       *sqs, *om = NULL, *y = NULL, *qb = NULL, *g = NULL, *z = NULL, *m = NULL, *uarr, *darr, one = 1., zero = 0.;
+  PetscReal         *gw = NULL, *mw = NULL;
+  PetscReal          err = 0;
+  PetscInt           n, N, k, l, q = 0, r = 0, ldb, ldu, rstart, rend;
+  const PetscInt     p = 10, ntest = 10; // Oversampling and number of probes of the error estimate
+  PetscBLASInt       bn, bk, bl, bq, br, bldb, bldy, bldu;
+  PetscBool          done = PETSC_FALSE;
+
+  PetscFunctionBeginUser;
+  PetscCall(PetscObjectGetComm((PetscObject)B, &comm));
+  PetscCall(MatGetSize(B, &N, &k));
+  PetscCall(MatGetLocalSize(B, &n, NULL));
+  PetscCall(PetscBLASIntCast(n, &bn));
+  PetscCall(PetscBLASIntCast(k, &bk));
+  PetscCall(PetscBLASIntCast(PetscMax(n, 1), &bldy));
+
+  /* Every rank needs all of S^{1/2} */
+  PetscCall(VecScatterCreateToAll(S, &sct, &Sall));
+  PetscCall(VecScatterBegin(sct, S, Sall, INSERT_VALUES, SCATTER_FORWARD));
+  PetscCall(VecScatterEnd(sct, S, Sall, INSERT_VALUES, SCATTER_FORWARD));
+  PetscCall(PetscMalloc1(k, &sqs));
+  PetscCall(VecGetArrayRead(Sall, &sarr));
+  for (PetscInt i = 0; i < k; ++i) {
+    PetscCheck(PetscRealPart(sarr[i]) >= 0, comm, PETSC_ERR_ARG_OUTOFRANGE, "The entries of S must be non-negative");
+    sqs[i] = PetscSqrtScalar(sarr[i]);
+  }
+  PetscCall(VecRestoreArrayRead(Sall, &sarr));
+  PetscCall(VecScatterDestroy(&sct));
+  PetscCall(VecDestroy(&Sall));
+
+  PetscCall(MatDenseGetLocalMatrix(B, &Bl));
+  PetscCall(MatDenseGetLDA(Bl, &ldb));
+  PetscCall(PetscBLASIntCast(PetscMax(ldb, 1), &bldb));
+  PetscCall(MatDenseGetArrayRead(Bl, &barr));
+
+  /* The test matrix is the same on all ranks (same seed), so each rank can
+     compute its rows of the sketch without communication */
+  PetscCall(PetscRandomCreate(PETSC_COMM_SELF, &rand));
+  PetscCall(PetscRandomSetInterval(rand, -1, 1));
+  PetscCall(PetscRandomSetSeed(rand, 0x5eed));
+  PetscCall(PetscRandomSeed(rand));
+
+  l = PetscMin(k, 16 + p);
+  while (!done) {
+    PetscCall(PetscBLASIntCast(l, &bl));
+    PetscCall(PetscFree6(om, y, qb, g, gw, mw));
+    PetscCall(PetscFree2(z, m));
+    PetscCall(PetscMalloc6(k * l, &om, PetscMax(n, 1) * l, &y, PetscMax(n, 1) * l, &qb, l * l, &g, l, &gw, l, &mw));
+
+    /* Y = B S^{1/2} Omega and its orthonormal basis Q = Y W L^{-1/2} from the
+       eigendecomposition Y^T Y = W L W^T */
+    for (PetscInt j = 0; j < l; ++j)
+      for (PetscInt i = 0; i < k; ++i) {
+        PetscScalar v;
+
+        PetscCall(PetscRandomGetValue(rand, &v));
+        om[i + j * k] = sqs[i] * v;
+      }
+    PetscCall(PetscArrayzero(g, l * l));
+    if (n > 0) {
+      PetscCallBLAS("BLASgemm", BLASgemm_("N", "N", &bn, &bl, &bk, &one, barr, &bldb, om, &bk, &zero, y, &bldy));
+      PetscCallBLAS("BLASgemm", BLASgemm_("T", "N", &bl, &bl, &bn, &one, y, &bldy, y, &bldy, &zero, g, &bl));
+    }
+    PetscCallMPI(MPI_Allreduce(MPI_IN_PLACE, g, (PetscMPIInt)(l * l), MPIU_SCALAR, MPIU_SUM, comm));
+    PetscCall(SymmetricEigen(bl, g, gw));
+    if (gw[l - 1] <= 0) break;
+    for (q = 0; q < l && gw[l - 1 - q] > PETSC_SQRT_MACHINE_EPSILON * gw[l - 1]; ++q) {
+      for (PetscInt i = 0; i < l; ++i) g[i + (l - 1 - q) * l] /= PetscSqrtReal(gw[l - 1 - q]);
+    }
+    PetscCall(PetscBLASIntCast(q, &bq));
+    if (n > 0) PetscCallBLAS("BLASgemm", BLASgemm_("N", "N", &bn, &bq, &bl, &one, y, &bldy, g + (l - q) * l, &bl, &zero, qb, &bldy));
+
+    /* The projected update Q^T B S B^T Q = Z Z^T with Z = Q^T B S^{1/2} */
+    PetscCall(PetscMalloc2(q * k, &z, q * q, &m));
+    PetscCall(PetscArrayzero(z, q * k));
+    if (n > 0) PetscCallBLAS("BLASgemm", BLASgemm_("T", "N", &bq, &bk, &bn, &one, qb, &bldy, barr, &bldb, &zero, z, &bq));
+    PetscCallMPI(MPI_Allreduce(MPI_IN_PLACE, z, (PetscMPIInt)(q * k), MPIU_SCALAR, MPIU_SUM, comm));
+    for (PetscInt j = 0; j < k; ++j)
+      for (PetscInt i = 0; i < q; ++i) z[i + j * q] *= sqs[j];
+    PetscCallBLAS("BLASgemm", BLASgemm_("N", "T", &bq, &bq, &bk, &one, z, &bq, z, &bq, &zero, m, &bq));
+    PetscCall(SymmetricEigen(bq, m, mw));
+    r = 0;
+    while (r < q && mw[q - 1 - r] > rtol / 2 * mw[q - 1]) ++r;
+
+    /* The sketch is large enough if it is oversampled and the estimated
+       projection error e satisfies 2 e ||B S^{1/2}|| <= rtol / 2 ||B S B^T||.
+       With l = k the sketch spans the range of B S^{1/2}. */
+    if (l == k) done = PETSC_TRUE;
+    else if (r + p <= l) {
+      PetscCall(ProjectionErrorEstimate(comm, rand, ntest, n, k, q, barr, bldb, sqs, qb, bldy, &err));
+      done = 4 * err <= rtol * PetscSqrtReal(mw[q - 1]) ? PETSC_TRUE : PETSC_FALSE;
+    }
+    if (!done) l = PetscMin(2 * l, k);
+  }
+  PetscCall(MatDenseRestoreArrayRead(Bl, &barr));
+  PetscCall(PetscRandomDestroy(&rand));
+  PetscCheck(r > 0, comm, PETSC_ERR_ARG_WRONG, "The low-rank update is zero");
+
+  /* U = Q V_r, D = diag of the r largest eigenvalues */
+  PetscCall(PetscBLASIntCast(r, &br));
+  PetscCall(MatCreateDense(comm, n, PETSC_DECIDE, N, r, NULL, U));
+  PetscCall(MatDenseGetLocalMatrix(*U, &Ul));
+  PetscCall(MatDenseGetLDA(Ul, &ldu));
+  PetscCall(PetscBLASIntCast(PetscMax(ldu, 1), &bldu));
+  PetscCall(MatDenseGetArrayWrite(Ul, &uarr));
+  if (n > 0) PetscCallBLAS("BLASgemm", BLASgemm_("N", "N", &bn, &br, &bq, &one, qb, &bldy, m + (q - r) * q, &bq, &zero, uarr, &bldu));
+  PetscCall(MatDenseRestoreArrayWrite(Ul, &uarr));
+  PetscCall(MatAssemblyBegin(*U, MAT_FINAL_ASSEMBLY));
+  PetscCall(MatAssemblyEnd(*U, MAT_FINAL_ASSEMBLY));
+
+  PetscCall(MatCreateVecs(*U, D, NULL));
+  PetscCall(VecGetOwnershipRange(*D, &rstart, &rend));
+  PetscCall(VecGetArrayWrite(*D, &darr));
+  for (PetscInt j = rstart; j < rend; ++j) darr[j - rstart] = mw[q - r + j];
+  PetscCall(VecRestoreArrayWrite(*D, &darr));
+  PetscCall(PetscInfo(B, "Compressed the low-rank update from rank %" PetscInt_FMT " to rank %" PetscInt_FMT " (sketch size %" PetscInt_FMT ", estimated projection error %g)\n", k, r, l, (double)err));
+
+  PetscCall(PetscFree6(om, y, qb, g, gw, mw));
+  PetscCall(PetscFree2(z, m));
+  PetscCall(PetscFree(sqs));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
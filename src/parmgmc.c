@@ -7,10 +7,12 @@
  */
 
 #include "parmgmc/parmgmc.h"
+#include "parmgmc/mc_sor.h"
 #include "parmgmc/pc/pc_chols.h"
 #include "parmgmc/pc/pc_gamgmc.h"
 #include "parmgmc/pc/pc_mcgibbs.h"
 #include "parmgmc/pc/pc_parsor.h"
+#include "parmgmc/pc/pc_patchgibbs.h"
 #include "parmgmc/pc/pc_sorgibbs.h"
 #include "parmgmc/pc/woodbury.h"
 
@@ -22,6 +24,8 @@
 #include <petscpc.h>
 #include <petscpctypes.h>
 #include <petscsys.h>
+#include <petscviewer.h>
+#include <stdint.h>
 
 #ifdef PARMGMC_HAVE_MKL
   #include <mkl_vsl.h>
@@ -50,6 +54,7 @@ static PetscErrorCode ParMGMCRegisterPCAll(void)
   PetscCall(PCRegister(PCCHOLSAMPLER, PCCreate_CholSampler));
   PetscCall(PCRegister(PCPARSOR, PCCreate_PARSOR));
   PetscCall(PCRegister(PCWOODBURY, PCCreate_Woodbury));
+  PetscCall(PCRegister(PCPATCHGIBBS, PCCreate_PatchGibbs));
   PetscFunctionReturn(PETSC_SUCCESS);
 }
 
@@ -115,6 +120,54 @@ PetscErrorCode VecSetRandomStandardNormal(Vec v, PetscRandom r)
   PetscFunctionReturn(PETSC_SUCCESS);
 }
 
+/* SplitMix64 finalizer, a bijective mixing function on 64 bit integers */
+static inline uint64_t ParMGMCMix64(uint64_t x)
+{
+  x += 0x9E3779B97F4A7C15ULL;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+  return x ^ (x >> 31);
+}
+
+/* Uniform number in (0, 1) determined by (key, counter, index) */
+static inline PetscReal ParMGMCCounterUniform(uint64_t key, uint64_t counter, uint64_t index)
+{
+  uint64_t h = ParMGMCMix64(key ^ ParMGMCMix64(counter ^ ParMGMCMix64(index)));
+
+  return (PetscReal)(((double)(h >> 11) + 0.5) / 9007199254740992.0); // 2^53
+}
+
+/** @brief Fill v with standard normal numbers that only depend on `key`,
+    `counter` and the global index of each entry.
+
+    Unlike VecSetRandomStandardNormal() this does not advance any random
+    stream, so ranks that hold copies of the same vector (or different
+    distributions of it) obtain identical values without communication as
+    long as they use the same key and counter. Use a new counter for every
+    draw.
+*/
+PetscErrorCode VecSetRandomStandardNormalCounter(Vec v, PetscInt64 key, PetscInt64 counter)
+{
+  PetscInt     n, rstart;
+  PetscScalar *array;
+
+  PetscFunctionBegin;
+  PetscCall(PetscLogEventBegin(VEC_SET_RANDOM_NORMAL, v, 0, 0, 0));
+  PetscCall(VecGetLocalSize(v, &n));
+  PetscCall(VecGetOwnershipRange(v, &rstart, NULL));
+  PetscCall(VecGetArray(v, &array));
+  for (PetscInt i = 0; i < n; ++i) {
+    uint64_t  g  = 2 * (uint64_t)(rstart + i);
+    PetscReal u1 = ParMGMCCounterUniform((uint64_t)key, (uint64_t)counter, g);
+    PetscReal u2 = ParMGMCCounterUniform((uint64_t)key, (uint64_t)counter, g + 1);
+
+    array[i] = PetscSqrtReal(-2.0 * PetscLogReal(u1)) * PetscCosReal(2.0 * PETSC_PI * u2);
+  }
+  PetscCall(VecRestoreArray(v, &array));
+  PetscCall(PetscLogEventEnd(VEC_SET_RANDOM_NORMAL, v, 0, 0, 0));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
 PetscErrorCode ParMGMCInitialize(void)
 {
   PetscFunctionBeginUser;
@@ -149,3 +202,442 @@ PetscErrorCode PCSetSampleCallback(PC pc, PetscErrorCode (*cb)(PetscInt, Vec, vo
   PetscUseMethod((PetscObject)pc, "PCSetSampleCallback_C", (PC, PetscErrorCode(*)(PetscInt, Vec, void *), void *, PetscErrorCode (*)(void *)), (pc, cb, ctx, deleter));
   PetscFunctionReturn(PETSC_SUCCESS);
 }
+
+/** @brief Ask a sampler to compute the residual b - A y of its final sweep
+    in the same pass over the matrix as the sweep. Does nothing for samplers
+    that do not support this.
+ */
+PetscErrorCode PCSetFusedResidual(PC pc, PetscBool flg)
+{
+  PetscFunctionBeginUser;
+  PetscTryMethod((PetscObject)pc, "PCSetFusedResidual_C", (PC, PetscBool), (pc, flg));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief If the last PCApplyRichardson call of `pc` was made with right hand
+    side `b` and ended with sample `x` (and neither was modified since), copies
+    the residual computed during that call to `r` and sets `valid` to
+    PETSC_TRUE. Otherwise `valid` is set to PETSC_FALSE and `r` is unchanged.
+ */
+PetscErrorCode PCGetFusedResidual(PC pc, Vec b, Vec x, Vec r, PetscBool *valid)
+{
+  PetscFunctionBeginUser;
+  *valid = PETSC_FALSE;
+  PetscTryMethod((PetscObject)pc, "PCGetFusedResidual_C", (PC, Vec, Vec, Vec, PetscBool *), (pc, b, x, r, valid));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/*  Setup data shared between all objects working on the same matrix.
+
+    Colourings, halo scatters, parallel SOR partitions and multigrid
+    interpolations only depend on the matrix (or even only on its nonzero
+    pattern), so they are composed with the matrix and reused by every
+    sampler (or solver) that is set up on it. Each entry stores the state of
+    the matrix it was computed for; an entry for another state is discarded
+    when it is queried. The cached data must not reference the matrix itself
+    (that would be a reference cycle), consumers that keep parts of it take
+    their own references. */
+typedef struct {
+  PetscObjectState state;
+  void            *data;
+  PetscErrorCode (*destroy)(void *);
+} *ParMGMCMatCache;
+
+#if PETSC_VERSION_LT(3, 23, 0)
+static PetscErrorCode ParMGMCMatCacheDestroy(void *ctx)
+{
+  ParMGMCMatCache cache = ctx;
+#else
+static PetscErrorCode ParMGMCMatCacheDestroy(void **ctx)
+{
+  ParMGMCMatCache cache = *ctx;
+#endif
+
+  PetscFunctionBeginUser;
+  if (cache->destroy) PetscCall(cache->destroy(cache->data));
+  PetscCall(PetscFree(cache));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Returns the data stored under `name` with ParMGMCMatComposeCache,
+    or NULL if there is none or if it was computed for a different `state`
+    of the matrix (usually the result of MatGetNonzeroState or
+    PetscObjectStateGet). The data is owned by the matrix.
+ */
+PetscErrorCode ParMGMCMatQueryCache(Mat A, const char name[], PetscObjectState state, void **data)
+{
+  PetscContainer  container;
+  ParMGMCMatCache cache;
+
+  PetscFunctionBeginUser;
+  *data = NULL;
+  PetscCall(PetscObjectQuery((PetscObject)A, name, (PetscObject *)&container));
+  if (!container) PetscFunctionReturn(PETSC_SUCCESS);
+  PetscCall(PetscContainerGetPointer(container, (void **)&cache));
+  if (cache->state == state) *data = cache->data;
+  else PetscCall(PetscObjectCompose((PetscObject)A, name, NULL));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Stores `data`, computed for the given `state` of the matrix, under
+    `name` on the matrix, replacing a previous entry. The matrix takes
+    ownership, `destroy` is called when the entry is replaced or the matrix
+    is destroyed.
+ */
+PetscErrorCode ParMGMCMatComposeCache(Mat A, const char name[], PetscObjectState state, void *data, PetscErrorCode (*destroy)(void *))
+{
+  PetscContainer  container;
+  ParMGMCMatCache cache;
+
+  PetscFunctionBeginUser;
+  PetscCall(PetscNew(&cache));
+  cache->state   = state;
+  cache->data    = data;
+  cache->destroy = destroy;
+  PetscCall(PetscContainerCreate(PetscObjectComm((PetscObject)A), &container));
+  PetscCall(PetscContainerSetPointer(container, cache));
+#if PETSC_VERSION_LT(3, 23, 0)
+  PetscCall(PetscContainerSetUserDestroy(container, ParMGMCMatCacheDestroy));
+#else
+  PetscCall(PetscContainerSetCtxDestroy(container, ParMGMCMatCacheDestroy));
+#endif
+  PetscCall(PetscObjectCompose((PetscObject)A, name, (PetscObject)container));
+  PetscCall(PetscContainerDestroy(&container));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+typedef struct {
+  PetscInt levels;
+  Mat     *interps;
+} *ParMGMCInterpolations;
+
+static PetscErrorCode ParMGMCInterpolationsDestroy(void *data)
+{
+  ParMGMCInterpolations ip = data;
+
+  PetscFunctionBeginUser;
+  for (PetscInt l = 1; l < ip->levels; ++l) PetscCall(MatDestroy(&ip->interps[l]));
+  PetscCall(PetscFree(ip->interps));
+  PetscCall(PetscFree(ip));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Stores the interpolations of the multigrid PC `mg` (PCMG or PCGAMG,
+    already set up) on its operator, so that a PCGAMGMC on the same matrix
+    uses them instead of coarsening again.
+ */
+PetscErrorCode ParMGMCMatComposeInterpolations(PC mg)
+{
+  ParMGMCInterpolations ip;
+  Mat                   P;
+  PetscObjectState      state;
+
+  PetscFunctionBeginUser;
+  PetscCall(PCGetOperators(mg, NULL, &P));
+  PetscCall(PetscNew(&ip));
+  PetscCall(PCMGGetLevels(mg, &ip->levels));
+  PetscCall(PetscCalloc1(ip->levels, &ip->interps));
+  for (PetscInt l = 1; l < ip->levels; ++l) {
+    PetscCall(PCMGGetInterpolation(mg, l, &ip->interps[l]));
+    PetscCall(PetscObjectReference((PetscObject)ip->interps[l]));
+  }
+  PetscCall(PetscObjectStateGet((PetscObject)P, &state));
+  PetscCall(ParMGMCMatComposeCache(P, "ParMGMCInterpolations", state, ip, ParMGMCInterpolationsDestroy));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Returns the interpolations stored on `A` with
+    ParMGMCMatComposeInterpolations for its current state, `interps[l]`
+    interpolates from level l - 1 to level l. Sets `interps` to NULL if there
+    are none. The matrices are owned by `A`.
+ */
+PetscErrorCode ParMGMCMatQueryInterpolations(Mat A, PetscInt *levels, Mat **interps)
+{
+  ParMGMCInterpolations ip;
+  PetscObjectState      state;
+
+  PetscFunctionBeginUser;
+  PetscCall(PetscObjectStateGet((PetscObject)A, &state));
+  PetscCall(ParMGMCMatQueryCache(A, "ParMGMCInterpolations", state, (void **)&ip));
+  *levels  = ip ? ip->levels : 0;
+  *interps = ip ? ip->interps : NULL;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+#define PARMGMC_SETUP_FILE_MAGIC 0x504d4753
+
+/* Hash of the nonzero pattern of A in global numbering, independent of the
+   parallel layout (the per-row hashes are combined with XOR). */
+static PetscErrorCode ParMGMCMatPatternHash(Mat A, PetscInt64 *hash)
+{
+  PetscInt rstart, rend;
+  uint64_t h = 0, gh;
+
+  PetscFunctionBeginUser;
+  PetscCall(MatGetOwnershipRange(A, &rstart, &rend));
+  for (PetscInt i = rstart; i < rend; ++i) {
+    PetscInt        ncols;
+    const PetscInt *cols;
+    uint64_t        rh = 14695981039346656037ULL;
+
+    PetscCall(MatGetRow(A, i, &ncols, &cols, NULL));
+    rh = (rh ^ (uint64_t)i) * 1099511628211ULL;
+    for (PetscInt j = 0; j < ncols; ++j) rh = (rh ^ (uint64_t)cols[j]) * 1099511628211ULL;
+    PetscCall(MatRestoreRow(A, i, &ncols, &cols, NULL));
+    h ^= ParMGMCMix64(rh);
+  }
+  PetscCallMPI(MPI_Allreduce(&h, &gh, 1, MPI_UINT64_T, MPI_BXOR, PetscObjectComm((PetscObject)A)));
+  *hash = (PetscInt64)gh;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* Header identifying the matrix the setup data was computed for: the global
+   sizes, the number of ranks, each rank's number of rows and the pattern hash. */
+static PetscErrorCode ParMGMCMatSetupKey(Mat A, PetscInt key[4], PetscInt **lrows, PetscInt64 *hash)
+{
+  PetscMPIInt size;
+  PetscInt    m;
+
+  PetscFunctionBeginUser;
+  PetscCallMPI(MPI_Comm_size(PetscObjectComm((PetscObject)A), &size));
+  key[0] = PARMGMC_SETUP_FILE_MAGIC;
+  PetscCall(MatGetSize(A, &key[1], &key[2]));
+  key[3] = size;
+  PetscCall(MatGetLocalSize(A, &m, NULL));
+  PetscCall(PetscMalloc1(size, lrows));
+  PetscCallMPI(MPI_Allgather(&m, 1, MPIU_INT, *lrows, 1, MPIU_INT, PetscObjectComm((PetscObject)A)));
+  PetscCall(ParMGMCMatPatternHash(A, hash));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Writes the setup data that ParMGMC has stored on `A` and that only
+    depends on the nonzero pattern of `A` to a binary viewer: the colouring
+    used by the multicolour Gibbs samplers and the multigrid interpolations
+    (see ParMGMCMatComposeInterpolations). The data can be read back with
+    ParMGMCMatLoadSetup to skip the colouring and the coarsening in a later
+    run on the same matrix.
+ */
+PetscErrorCode ParMGMCMatSaveSetup(Mat A, PetscViewer viewer)
+{
+  PetscInt    key[4], *lrows, levels;
+  PetscInt64  hash;
+  Mat        *interps;
+  MPI_Comm    comm;
+  PetscMPIInt size;
+
+  PetscFunctionBeginUser;
+  PetscCall(PetscObjectGetComm((PetscObject)A, &comm));
+  PetscCallMPI(MPI_Comm_size(comm, &size));
+  PetscCall(ParMGMCMatSetupKey(A, key, &lrows, &hash));
+  PetscCall(PetscViewerBinaryWrite(viewer, key, 4, PETSC_INT));
+  PetscCall(PetscViewerBinaryWrite(viewer, lrows, size, PETSC_INT));
+  PetscCall(PetscViewerBinaryWrite(viewer, &hash, 1, PETSC_INT64));
+  PetscCall(PetscFree(lrows));
+
+  PetscCall(MCSORSaveColoring(A, viewer));
+
+  PetscCall(ParMGMCMatQueryInterpolations(A, &levels, &interps));
+  PetscCall(PetscViewerBinaryWrite(viewer, &levels, 1, PETSC_INT));
+  for (PetscInt l = 1; l < levels; ++l) {
+    PetscInt    lsizes[2], *sizes;
+    PetscMPIInt rank;
+
+    PetscCallMPI(MPI_Comm_rank(comm, &rank));
+    PetscCall(MatGetLocalSize(interps[l], &lsizes[0], &lsizes[1]));
+    PetscCall(PetscMalloc1(2 * size, &sizes));
+    PetscCallMPI(MPI_Gather(lsizes, 2, MPIU_INT, sizes, 2, MPIU_INT, 0, comm));
+    PetscCall(PetscViewerBinaryWrite(viewer, sizes, 2 * size, PETSC_INT));
+    PetscCall(PetscFree(sizes));
+    PetscCall(MatView(interps[l], viewer));
+  }
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Reads setup data written by ParMGMCMatSaveSetup and stores it on
+    `A`. If the data was written for a matrix with a different size, nonzero
+    pattern or parallel layout nothing is loaded and `loaded` (optional) is
+    set to PETSC_FALSE.
+ */
+PetscErrorCode ParMGMCMatLoadSetup(Mat A, PetscViewer viewer, PetscBool *loaded)
+{
+  PetscInt    key[4], fkey[4], *lrows, *flrows, levels;
+  PetscInt64  hash, fhash;
+  PetscBool   match;
+  MPI_Comm    comm;
+  PetscMPIInt size, rank;
+
+  PetscFunctionBeginUser;
+  if (loaded) *loaded = PETSC_FALSE;
+  PetscCall(PetscObjectGetComm((PetscObject)A, &comm));
+  PetscCallMPI(MPI_Comm_size(comm, &size));
+  PetscCallMPI(MPI_Comm_rank(comm, &rank));
+  PetscCall(ParMGMCMatSetupKey(A, key, &lrows, &hash));
+  PetscCall(PetscViewerBinaryRead(viewer, fkey, 4, NULL, PETSC_INT));
+  match = (PetscBool)(fkey[0] == key[0] && fkey[1] == key[1] && fkey[2] == key[2] && fkey[3] == key[3]);
+  if (match) {
+    PetscCall(PetscMalloc1(size, &flrows));
+    PetscCall(PetscViewerBinaryRead(viewer, flrows, size, NULL, PETSC_INT));
+    PetscCall(PetscViewerBinaryRead(viewer, &fhash, 1, NULL, PETSC_INT64));
+    PetscCall(PetscArraycmp(lrows, flrows, size, &match));
+    match = (PetscBool)(match && fhash == hash);
+    PetscCall(PetscFree(flrows));
+  }
+  PetscCall(PetscFree(lrows));
+  if (!match) {
+    PetscCall(PetscInfo(A, "Setup data was written for a different matrix or parallel layout, ignoring it\n"));
+    PetscFunctionReturn(PETSC_SUCCESS);
+  }
+
+  PetscCall(MCSORLoadColoring(A, viewer));
+
+  PetscCall(PetscViewerBinaryRead(viewer, &levels, 1, NULL, PETSC_INT));
+  if (levels > 0) {
+    ParMGMCInterpolations ip;
+    PetscObjectState      state;
+
+    PetscCall(PetscNew(&ip));
+    ip->levels = levels;
+    PetscCall(PetscCalloc1(levels, &ip->interps));
+    for (PetscInt l = 1; l < levels; ++l) {
+      PetscInt *sizes;
+
+      PetscCall(PetscMalloc1(2 * size, &sizes));
+      PetscCall(PetscViewerBinaryRead(viewer, sizes, 2 * size, NULL, PETSC_INT));
+      PetscCall(MatCreate(comm, &ip->interps[l]));
+      PetscCall(MatSetSizes(ip->interps[l], sizes[2 * rank], sizes[2 * rank + 1], PETSC_DETERMINE, PETSC_DETERMINE));
+      PetscCall(MatSetType(ip->interps[l], MATAIJ));
+      PetscCall(MatLoad(ip->interps[l], viewer));
+      PetscCall(PetscFree(sizes));
+    }
+    PetscCall(PetscObjectStateGet((PetscObject)A, &state));
+    PetscCall(ParMGMCMatComposeCache(A, "ParMGMCInterpolations", state, ip, ParMGMCInterpolationsDestroy));
+  }
+  PetscCall(PetscInfo(A, "Loaded setup data (colouring and %" PetscInt_FMT " multigrid levels)\n", levels));
+  if (loaded) *loaded = PETSC_TRUE;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Redistributes the vector `x` onto `subcomm`, a sub-communicator of
+    the communicator of `x` (with the ranks in the same order). Each rank
+    receives the next `m` entries in the global ordering. Ranks that are not
+    part of `subcomm` pass `MPI_COMM_NULL` and m = 0 and get NULL. Collective
+    on the communicator of `x`.
+ */
+PetscErrorCode ParMGMCVecRedistribute(Vec x, MPI_Comm subcomm, PetscInt m, Vec *xsub)
+{
+  Vec        xred;
+  VecScatter sct;
+  PetscInt   M;
+
+  PetscFunctionBeginUser;
+  PetscCall(VecGetSize(x, &M));
+  PetscCall(VecCreateMPI(PetscObjectComm((PetscObject)x), m, M, &xred));
+  PetscCall(VecScatterCreate(x, NULL, xred, NULL, &sct));
+  PetscCall(VecScatterBegin(sct, x, xred, INSERT_VALUES, SCATTER_FORWARD));
+  PetscCall(VecScatterEnd(sct, x, xred, INSERT_VALUES, SCATTER_FORWARD));
+  *xsub = NULL;
+  if (subcomm != MPI_COMM_NULL) {
+    const PetscScalar *src;
+    PetscScalar       *dst;
+
+    PetscCall(VecCreateMPI(subcomm, m, M, xsub));
+    PetscCall(VecGetArrayRead(xred, &src));
+    PetscCall(VecGetArrayWrite(*xsub, &dst));
+    PetscCall(PetscArraycpy(dst, src, m));
+    PetscCall(VecRestoreArrayWrite(*xsub, &dst));
+    PetscCall(VecRestoreArrayRead(xred, &src));
+  }
+  PetscCall(VecScatterDestroy(&sct));
+  PetscCall(VecDestroy(&xred));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Redistributes the matrix `A` (`MATAIJ` or `MATLRC` with an `MATAIJ`
+    base matrix) onto `subcomm`, a sub-communicator of the communicator of
+    `A` (with the ranks in the same order). Each rank receives the next `m`
+    rows in the global ordering, `n` is the local number of columns of the
+    new matrix (as in MatCreateMPIMatConcatenateSeqMat()). For `MATLRC`
+    matrices the rows of the low-rank factor are redistributed in the same
+    way. Ranks that are not part of `subcomm` pass `MPI_COMM_NULL` and
+    m = n = 0 and get NULL. Collective on the communicator of `A`.
+ */
+PetscErrorCode ParMGMCMatRedistribute(Mat A, MPI_Comm subcomm, PetscInt m, PetscInt n, Mat *Asub)
+{
+  MPI_Comm    comm = PetscObjectComm((PetscObject)A);
+  PetscMPIInt rank;
+  Mat         Ab = A, B = NULL, *seqs;
+  Vec         S  = NULL;
+  IS          isrow, iscol;
+  PetscInt    M, N, rstart = 0;
+  PetscBool   islrc;
+
+  PetscFunctionBeginUser;
+  PetscCallMPI(MPI_Comm_rank(comm, &rank));
+  PetscCall(PetscObjectTypeCompare((PetscObject)A, MATLRC, &islrc));
+  if (islrc) PetscCall(MatLRCGetMats(A, &Ab, &B, &S, NULL));
+
+  // Contiguous blocks of rows, so the global ordering is kept
+  PetscCall(MatGetSize(Ab, &M, &N));
+  PetscCallMPI(MPI_Exscan(&m, &rstart, 1, MPIU_INT, MPI_SUM, comm));
+  if (rank == 0) rstart = 0;
+  PetscCall(ISCreateStride(PETSC_COMM_SELF, m, rstart, 1, &isrow));
+  PetscCall(ISCreateStride(PETSC_COMM_SELF, N, 0, 1, &iscol));
+  PetscCall(MatCreateSubMatrices(Ab, 1, &isrow, &iscol, MAT_INITIAL_MATRIX, &seqs));
+  *Asub = NULL;
+  if (subcomm != MPI_COMM_NULL) PetscCall(MatCreateMPIMatConcatenateSeqMat(subcomm, seqs[0], n, MAT_INITIAL_MATRIX, Asub));
+  PetscCall(MatDestroySubMatrices(1, &seqs));
+  PetscCall(ISDestroy(&iscol));
+  PetscCall(ISDestroy(&isrow));
+
+  if (islrc) {
+    Mat          Bsub = NULL;
+    Vec          Sall;
+    VecScatter   sct;
+    PetscScalar *barr = NULL;
+    PetscInt     k, lda = 0;
+
+    // The columns of the low-rank factor are redistributed like vectors
+    PetscCall(MatGetSize(B, NULL, &k));
+    if (subcomm != MPI_COMM_NULL) {
+      PetscCall(MatCreateDense(subcomm, m, PETSC_DECIDE, M, k, NULL, &Bsub));
+      PetscCall(MatDenseGetLDA(Bsub, &lda));
+      PetscCall(MatDenseGetArrayWrite(Bsub, &barr));
+    }
+    for (PetscInt j = 0; j < k; ++j) {
+      Vec bj, bjsub;
+
+      PetscCall(MatDenseGetColumnVecRead(B, j, &bj));
+      PetscCall(ParMGMCVecRedistribute(bj, subcomm, m, &bjsub));
+      PetscCall(MatDenseRestoreColumnVecRead(B, j, &bj));
+      if (bjsub) {
+        const PetscScalar *xarr;
+
+        PetscCall(VecGetArrayRead(bjsub, &xarr));
+        PetscCall(PetscArraycpy(barr + j * lda, xarr, m));
+        PetscCall(VecRestoreArrayRead(bjsub, &xarr));
+        PetscCall(VecDestroy(&bjsub));
+      }
+    }
+
+    // S may be distributed, every rank of the new matrix gets a full copy
+    PetscCall(VecScatterCreateToAll(S, &sct, &Sall));
+    PetscCall(VecScatterBegin(sct, S, Sall, INSERT_VALUES, SCATTER_FORWARD));
+    PetscCall(VecScatterEnd(sct, S, Sall, INSERT_VALUES, SCATTER_FORWARD));
+    if (Bsub) {
+      Vec Ssub;
+      Mat Alrc;
+
+      PetscCall(MatDenseRestoreArrayWrite(Bsub, &barr));
+      PetscCall(VecDuplicate(Sall, &Ssub));
+      PetscCall(VecCopy(Sall, Ssub));
+      PetscCall(MatCreateLRC(*Asub, Bsub, Ssub, NULL, &Alrc));
+      PetscCall(VecDestroy(&Ssub));
+      PetscCall(MatDestroy(&Bsub));
+      PetscCall(MatDestroy(Asub));
+      *Asub = Alrc;
+    }
+    PetscCall(VecScatterDestroy(&sct));
+    PetscCall(VecDestroy(&Sall));
+  }
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
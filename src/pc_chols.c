@@ -13,6 +13,9 @@
 #include <petscvec.h>
 #include <petscviewer.h>
 #include <mpi.h>
+#if defined(PARMGMC_HAVE_OPENMP)
+  #include <omp.h>
+#endif
 
 #if defined(PETSC_HAVE_MKL_PARDISO)
   #define PARMGMC_DEFAULT_SEQ_CHOLESKY MATSOLVERMKL_PARDISO
@@ -26,6 +29,369 @@
   #define PARMGMC_DEFAULT_PAR_CHOLESKY MATSOLVERPETSC
 #endif
 
+/* Sequential sparse Cholesky factor P A P^T = L L^T for the level-scheduled
+   triangular solves (see PCCholSamplerSetLevelScheduling()). L is stored
+   twice, by columns with the diagonal first (for the backward solve) and by
+   rows with the diagonal last (for the forward solve). The columns are
+   grouped into levels of the elimination tree: a column's level is one more
+   than the highest level of its children, so all columns of one level can
+   be processed concurrently. */
+typedef struct _CholLS {
+  PetscInt     n;
+  PetscInt    *perm; // Row i of P A P^T is row perm[i] of A
+  PetscInt    *Lp, *Li, *Rp, *Rj;
+  PetscScalar *Lx, *Rx;
+  PetscInt     nlevels;
+  PetscInt    *lvlptr, *lvl; // Columns of level l are lvl[lvlptr[l]], ..., lvl[lvlptr[l + 1] - 1]
+  PetscScalar *work;
+} *CholLS;
+
+static PetscErrorCode CholLSDestroy(CholLS *ls)
+{
+  PetscFunctionBeginUser;
+  if (!*ls) PetscFunctionReturn(PETSC_SUCCESS);
+  PetscCall(PetscFree((*ls)->perm));
+  PetscCall(PetscFree4((*ls)->Lp, (*ls)->Li, (*ls)->Rp, (*ls)->Rj));
+  PetscCall(PetscFree2((*ls)->Lx, (*ls)->Rx));
+  PetscCall(PetscFree3((*ls)->lvlptr, (*ls)->lvl, (*ls)->work));
+  PetscCall(PetscFree(*ls));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* Nonzero pattern of row k of L: the nodes on the paths from the nonzeros of
+   row k of the upper triangle of C = P A P^T up to k in the elimination tree.
+   Returned in s[top], ..., s[n - 1] in topological order, mark[] is stamped
+   with k. */
+static PetscInt CholLSReach(PetscInt k, const PetscInt *ia, const PetscInt *ja, const PetscInt *perm, const PetscInt *pinv, const PetscInt *parent, PetscInt *s, PetscInt *mark, PetscInt n)
+{
+  PetscInt top = n;
+
+  mark[k] = k;
+  for (PetscInt p = ia[perm[k]]; p < ia[perm[k] + 1]; ++p) {
+    PetscInt i = pinv[ja[p]], len = 0;
+
+    if (i > k) continue;
+    for (; mark[i] != k; i = parent[i]) {
+      s[len++] = i;
+      mark[i]  = k;
+    }
+    while (len > 0) s[--top] = s[--len];
+  }
+  return top;
+}
+
+/* Numeric factorization, row k of L in step k. Expects c[i] = Lp[i], x = 0
+   and mark = -1; fills Li and Lx column by column in the order of the rows. */
+static PetscErrorCode CholLSFactorNumeric(CholLS ls, const PetscInt *ia, const PetscInt *ja, const PetscScalar *aa, const PetscInt *pinv, const PetscInt *parent, PetscInt *s, PetscInt *mark, PetscInt *c, PetscScalar *x)
+{
+  const PetscInt n = ls->n;
+
+  PetscFunctionBeginUser;
+  for (PetscInt k = 0; k < n; ++k) {
+    PetscInt    top = CholLSReach(k, ia, ja, ls->perm, pinv, parent, s, mark, n);
+    PetscScalar d;
+
+    for (PetscInt p = ia[ls->perm[k]]; p < ia[ls->perm[k] + 1]; ++p) {
+      PetscInt i = pinv[ja[p]];
+
+      if (i <= k) x[i] += aa[p];
+    }
+    d    = x[k];
+    x[k] = 0;
+    for (; top < n; ++top) {
+      PetscInt    i   = s[top], q;
+      PetscScalar lki = x[i] / ls->Lx[ls->Lp[i]];
+
+      x[i] = 0;
+      for (q = ls->Lp[i] + 1; q < c[i]; ++q) x[ls->Li[q]] -= ls->Lx[q] * lki;
+      d -= lki * lki;
+      q         = c[i]++;
+      ls->Li[q] = k;
+      ls->Lx[q] = lki;
+    }
+    PetscCheck(PetscRealPart(d) > 0, PETSC_COMM_SELF, PETSC_ERR_MAT_CH_ZRPVT, "Matrix is not positive definite (pivot %" PetscInt_FMT ")", k);
+    ls->Li[c[k]] = k;
+    ls->Lx[c[k]] = PetscSqrtScalar(d);
+    c[k]++;
+  }
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* Up-looking sparse Cholesky factorization of the SeqAIJ matrix A in the
+   ordering perm */
+static PetscErrorCode CholLSCreate(Mat A, IS rowperm, CholLS *ls_out)
+{
+  CholLS             ls;
+  PetscInt           n, *pinv, *parent, *anc, *cnt, *s, *mark, *c, *level, nnz;
+  const PetscInt    *ia, *ja, *rp;
+  const PetscScalar *aa;
+  PetscScalar       *x;
+  PetscBool          done;
+
+  PetscFunctionBeginUser;
+  PetscCall(PetscNew(&ls));
+  PetscCall(MatGetRowIJ(A, 0, PETSC_FALSE, PETSC_FALSE, &n, &ia, &ja, &done));
+  PetscCheck(done, PETSC_COMM_SELF, PETSC_ERR_SUP, "Cannot get the rows of the matrix");
+  PetscCall(MatSeqAIJGetArrayRead(A, &aa));
+  ls->n = n;
+  PetscCall(PetscMalloc1(n, &ls->perm));
+  PetscCall(ISGetIndices(rowperm, &rp));
+  PetscCall(PetscArraycpy(ls->perm, rp, n));
+  PetscCall(ISRestoreIndices(rowperm, &rp));
+  PetscCall(PetscMalloc7(n, &pinv, n, &parent, n, &anc, n + 1, &cnt, n, &s, n, &mark, n, &level));
+  PetscCall(PetscMalloc2(n, &c, n, &x));
+  for (PetscInt i = 0; i < n; ++i) pinv[ls->perm[i]] = i;
+
+  // Elimination tree (with path compression through anc)
+  for (PetscInt k = 0; k < n; ++k) {
+    parent[k] = -1;
+    anc[k]    = -1;
+    for (PetscInt p = ia[ls->perm[k]]; p < ia[ls->perm[k] + 1]; ++p) {
+      PetscInt i = pinv[ja[p]], inext;
+
+      for (; i != -1 && i < k; i = inext) {
+        inext  = anc[i];
+        anc[i] = k;
+        if (inext == -1) parent[i] = k;
+      }
+    }
+  }
+
+  // Column counts
+  for (PetscInt i = 0; i < n; ++i) {
+    cnt[i]  = 1;
+    mark[i] = -1;
+  }
+  for (PetscInt k = 0; k < n; ++k) {
+    PetscInt top = CholLSReach(k, ia, ja, ls->perm, pinv, parent, s, mark, n);
+
+    for (; top < n; ++top) cnt[s[top]]++;
+  }
+  nnz = 0;
+  for (PetscInt i = 0; i < n; ++i) nnz += cnt[i];
+  PetscCall(PetscMalloc4(n + 1, &ls->Lp, nnz, &ls->Li, n + 1, &ls->Rp, nnz, &ls->Rj));
+  PetscCall(PetscMalloc2(nnz, &ls->Lx, nnz, &ls->Rx));
+  ls->Lp[0] = 0;
+  for (PetscInt i = 0; i < n; ++i) {
+    ls->Lp[i + 1] = ls->Lp[i] + cnt[i];
+    c[i]          = ls->Lp[i];
+    x[i]          = 0;
+    mark[i]       = -1;
+  }
+
+  PetscCall(CholLSFactorNumeric(ls, ia, ja, aa, pinv, parent, s, mark, c, x));
+  PetscCall(MatSeqAIJRestoreArrayRead(A, &aa));
+  PetscCall(MatRestoreRowIJ(A, 0, PETSC_FALSE, PETSC_FALSE, &n, &ia, &ja, &done));
+
+  // Rows of L; visiting the columns in order puts the diagonal last
+  PetscCall(PetscArrayzero(cnt, n + 1));
+  for (PetscInt p = 0; p < nnz; ++p) cnt[ls->Li[p] + 1]++;
+  ls->Rp[0] = 0;
+  for (PetscInt i = 0; i < n; ++i) {
+    ls->Rp[i + 1] = ls->Rp[i] + cnt[i + 1];
+    c[i]          = ls->Rp[i];
+  }
+  for (PetscInt j = 0; j < n; ++j) {
+    for (PetscInt p = ls->Lp[j]; p < ls->Lp[j + 1]; ++p) {
+      PetscInt q = c[ls->Li[p]]++;
+
+      ls->Rj[q] = j;
+      ls->Rx[q] = ls->Lx[p];
+    }
+  }
+
+  // Levels of the elimination tree (children have smaller indices than their parents)
+  ls->nlevels = 0;
+  for (PetscInt j = 0; j < n; ++j) level[j] = 0;
+  for (PetscInt j = 0; j < n; ++j) {
+    if (parent[j] != -1) level[parent[j]] = PetscMax(level[parent[j]], level[j] + 1);
+    ls->nlevels = PetscMax(ls->nlevels, level[j] + 1);
+  }
+  PetscCall(PetscCalloc3(ls->nlevels + 1, &ls->lvlptr, n, &ls->lvl, n, &ls->work));
+  for (PetscInt j = 0; j < n; ++j) ls->lvlptr[level[j] + 1]++;
+  for (PetscInt l = 0; l < ls->nlevels; ++l) ls->lvlptr[l + 1] += ls->lvlptr[l];
+  for (PetscInt l = 0; l < ls->nlevels; ++l) c[l] = ls->lvlptr[l];
+  for (PetscInt j = 0; j < n; ++j) ls->lvl[c[level[j]]++] = j;
+
+  PetscCall(PetscFree7(pinv, parent, anc, cnt, s, mark, level));
+  PetscCall(PetscFree2(c, x));
+  *ls_out = ls;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* Numeric refactorization with the new values of A, which must have the
+   nonzero pattern of the matrix passed to CholLSCreate. The elimination
+   tree is read off L (the parent of a column is its first off-diagonal
+   row), the pattern, the ordering and the levels are reused. */
+static PetscErrorCode CholLSRefactor(Mat A, CholLS ls)
+{
+  const PetscInt     n = ls->n;
+  PetscInt          *pinv, *parent, *s, *mark, *c, m;
+  const PetscInt    *ia, *ja;
+  const PetscScalar *aa;
+  PetscScalar       *x;
+  PetscBool          done;
+
+  PetscFunctionBeginUser;
+  PetscCall(MatGetRowIJ(A, 0, PETSC_FALSE, PETSC_FALSE, &m, &ia, &ja, &done));
+  PetscCheck(done && m == n, PETSC_COMM_SELF, PETSC_ERR_ARG_SIZ, "Matrix does not match the factor");
+  PetscCall(MatSeqAIJGetArrayRead(A, &aa));
+  PetscCall(PetscMalloc5(n, &pinv, n, &parent, n, &s, n, &mark, n, &c));
+  PetscCall(PetscMalloc1(n, &x));
+  for (PetscInt i = 0; i < n; ++i) {
+    pinv[ls->perm[i]] = i;
+    parent[i]         = ls->Lp[i + 1] - ls->Lp[i] > 1 ? ls->Li[ls->Lp[i] + 1] : -1;
+    c[i]              = ls->Lp[i];
+    x[i]              = 0;
+    mark[i]           = -1;
+  }
+  PetscCall(CholLSFactorNumeric(ls, ia, ja, aa, pinv, parent, s, mark, c, x));
+  PetscCall(MatSeqAIJRestoreArrayRead(A, &aa));
+  PetscCall(MatRestoreRowIJ(A, 0, PETSC_FALSE, PETSC_FALSE, &m, &ia, &ja, &done));
+
+  for (PetscInt i = 0; i < n; ++i) c[i] = ls->Rp[i];
+  for (PetscInt j = 0; j < n; ++j)
+    for (PetscInt p = ls->Lp[j]; p < ls->Lp[j + 1]; ++p) ls->Rx[c[ls->Li[p]]++] = ls->Lx[p];
+  PetscCall(PetscFree5(pinv, parent, s, mark, c));
+  PetscCall(PetscFree(x));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* out = L^-1 P in */
+static PetscErrorCode CholLSForward(CholLS ls, const PetscScalar *in, PetscScalar *out)
+{
+  const PetscInt n = ls->n;
+
+  PetscFunctionBeginUser;
+#if defined(PARMGMC_HAVE_OPENMP)
+  #pragma omp parallel
+#endif
+  {
+#if defined(PARMGMC_HAVE_OPENMP)
+  #pragma omp for schedule(static)
+#endif
+    for (PetscInt i = 0; i < n; ++i) out[i] = in[ls->perm[i]];
+    for (PetscInt l = 0; l < ls->nlevels; ++l) {
+#if defined(PARMGMC_HAVE_OPENMP)
+  #pragma omp for schedule(static)
+#endif
+      for (PetscInt t = ls->lvlptr[l]; t < ls->lvlptr[l + 1]; ++t) {
+        PetscInt    i   = ls->lvl[t];
+        PetscScalar sum = out[i];
+
+        for (PetscInt p = ls->Rp[i]; p < ls->Rp[i + 1] - 1; ++p) sum -= ls->Rx[p] * out[ls->Rj[p]];
+        out[i] = sum / ls->Rx[ls->Rp[i + 1] - 1];
+      }
+    }
+  }
+  PetscCall(PetscLogFlops(2. * ls->Lp[n]));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* out = P^T L^-T in */
+static PetscErrorCode CholLSBackward(CholLS ls, const PetscScalar *in, PetscScalar *out)
+{
+  const PetscInt n = ls->n;
+  PetscScalar   *w = ls->work;
+
+  PetscFunctionBeginUser;
+#if defined(PARMGMC_HAVE_OPENMP)
+  #pragma omp parallel
+#endif
+  {
+#if defined(PARMGMC_HAVE_OPENMP)
+  #pragma omp for schedule(static)
+#endif
+    for (PetscInt i = 0; i < n; ++i) w[i] = in[i];
+    for (PetscInt l = ls->nlevels - 1; l >= 0; --l) {
+#if defined(PARMGMC_HAVE_OPENMP)
+  #pragma omp for schedule(static)
+#endif
+      for (PetscInt t = ls->lvlptr[l]; t < ls->lvlptr[l + 1]; ++t) {
+        PetscInt    j   = ls->lvl[t];
+        PetscScalar sum = w[j];
+
+        for (PetscInt p = ls->Lp[j] + 1; p < ls->Lp[j + 1]; ++p) sum -= ls->Lx[p] * w[ls->Li[p]];
+        w[j] = sum / ls->Lx[ls->Lp[j]];
+      }
+    }
+#if defined(PARMGMC_HAVE_OPENMP)
+  #pragma omp for schedule(static)
+#endif
+    for (PetscInt i = 0; i < n; ++i) out[ls->perm[i]] = w[i];
+  }
+  PetscCall(PetscLogFlops(2. * ls->Lp[n]));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* X = L^-T X for m right hand sides at once, in the ordering of the factor
+   (no permutation). X is stored by rows, entry i of right hand side r is
+   X[i * m + r], so that every entry of L is read once for all of them. */
+static PetscErrorCode CholLSBackwardBlock(CholLS ls, PetscInt m, PetscScalar *X)
+{
+  PetscFunctionBeginUser;
+#if defined(PARMGMC_HAVE_OPENMP)
+  #pragma omp parallel
+#endif
+  {
+    for (PetscInt l = ls->nlevels - 1; l >= 0; --l) {
+#if defined(PARMGMC_HAVE_OPENMP)
+  #pragma omp for schedule(static)
+#endif
+      for (PetscInt t = ls->lvlptr[l]; t < ls->lvlptr[l + 1]; ++t) {
+        PetscInt     j  = ls->lvl[t];
+        PetscScalar *xj = X + j * m;
+
+        for (PetscInt p = ls->Lp[j] + 1; p < ls->Lp[j + 1]; ++p) {
+          const PetscScalar  a  = ls->Lx[p];
+          const PetscScalar *xi = X + ls->Li[p] * m;
+
+          for (PetscInt r = 0; r < m; ++r) xj[r] -= a * xi[r];
+        }
+        for (PetscInt r = 0; r < m; ++r) xj[r] /= ls->Lx[ls->Lp[j]];
+      }
+    }
+  }
+  PetscCall(PetscLogFlops(2. * ls->Lp[ls->n] * m));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* Selected inversion (Takahashi recursion): the entries of Z = (P A P^T)^-1
+   on the nonzero pattern of L, stored like Lx. Uses Z L = L^-T column by
+   column from the last one; the entries of Z needed for column j all lie in
+   the pattern of L since the pattern of column j is closed under fill. */
+static PetscErrorCode CholLSSelectedInverse(CholLS ls, PetscScalar *Zx)
+{
+  PetscLogDouble flops = 0;
+
+  PetscFunctionBeginUser;
+  for (PetscInt j = ls->n - 1; j >= 0; --j) {
+    const PetscInt    p0 = ls->Lp[j], p1 = ls->Lp[j + 1];
+    const PetscScalar d  = 1. / ls->Lx[p0];
+    PetscScalar       s  = 0;
+
+    for (PetscInt p = p0 + 1; p < p1; ++p) {
+      const PetscInt i   = ls->Li[p];
+      PetscScalar    sum = 0;
+
+      for (PetscInt q = p0 + 1; q < p1; ++q) {
+        const PetscInt k = ls->Li[q], lo = PetscMin(i, k), hi = PetscMax(i, k);
+        PetscInt       loc;
+
+        PetscCall(PetscFindInt(hi, ls->Lp[lo + 1] - ls->Lp[lo], ls->Li + ls->Lp[lo], &loc));
+        PetscCheck(loc >= 0, PETSC_COMM_SELF, PETSC_ERR_PLIB, "Entry (%" PetscInt_FMT ", %" PetscInt_FMT ") is not in the pattern of the factor", hi, lo);
+        sum += Zx[ls->Lp[lo] + loc] * ls->Lx[q];
+      }
+      Zx[p] = -sum * d;
+      s += ls->Lx[p] * Zx[p];
+    }
+    Zx[p0] = d * d - d * s;
+    flops += 2. * (p1 - p0) * (p1 - p0);
+  }
+  PetscCall(PetscLogFlops(flops));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
 typedef struct {
   Vec           r, v, v_cache, xl, yl;
   Mat           F;
@@ -33,8 +399,13 @@ typedef struct {
                                   used for small sequential blocks, e.g. ASM patch smoothers. */
   PetscBLASInt  dense_n;       /* Size of the dense factor; 0 if the dense fast path is not used. */
   PetscInt      dense_threshold; /* Blocks of size <= this are factored and solved densely. */
+  PetscInt      batch;         /* Number of samples that share one triangular solve (dense or level-scheduled factor) */
+  PetscScalar  *blk;           /* Block of batch samples: dense_n x batch (column-major) for the dense
+                                  factor, n x batch by rows for the level-scheduled factor */
   PetscRandom   prand;
   MatSolverType st;
+  PetscBool     level_schedule; /* Factor sequential matrices with CholLS instead of MatGetFactor() */
+  CholLS        ls;
   PetscBool     richardson, is_gamg_coarse; /* is_gamg_coarse should be set if the sampler is used as
                                                coarse grid sampler in GAMGMC. GAMG reduces the number
                                                of MPI ranks that participate on the coarser levels, down
@@ -45,6 +416,21 @@ typedef struct {
 								                               matrix that contains the actual values and use a sequential
 								                               sampler. This involves additional copies but scales much better.
 								     */
+  PetscBool     redundant; /* Every rank holds the full factor and computes the full sample. The noise
+                              is drawn from a counter-based stream with a key that is shared by all
+                              ranks, so all copies of the sample agree without communication. */
+  VecScatter    sct;       /* Gathers the right hand side on every rank (redundant mode) */
+  PetscBool     woodbury;  /* MATLRC: factor only A and correct the samples, see PCCholSamplerSetWoodbury() */
+  Mat           B, W;      /* Low-rank factor and W = A^-1 B (Woodbury mode) */
+  PetscScalar  *wb_C;      /* Cholesky factor of the capacitance matrix S^-1 + B^T A^-1 B (k x k, on every rank) */
+  PetscScalar  *wb_isd;    /* S^-1/2 */
+  PetscScalar  *wb_t;      /* Work k-vector */
+  PetscBLASInt  wb_k;
+  Vec           wb_e;      /* Noise of the low-rank part (sequential, only used on rank 0) */
+  Vec           xall;
+  Mat           Pf, Sf;    /* Matrix whose values are factored and the (sequential) matrix passed to the factorization */
+  PetscObjectState Pf_state; /* Nonzero state of Pf at setup, see CholSamplerRefactor() */
+  PetscInt64    key, counter;
   PetscBool     in_solve;
   PetscInt      sample_index;
   void         *cbctx;
@@ -52,12 +438,22 @@ typedef struct {
   PetscErrorCode (*del_scb)(void *);
 } *PC_CholSampler;
 
-static PetscErrorCode PCCholSamplerNotifySample(PC pc, Vec y)
+/* Everything that depends on the values, rebuilt at the next sample */
+static PetscErrorCode CholSamplerClearWoodburyFactors(PC_CholSampler chol)
 {
-  PC_CholSampler chol = pc->data;
+  PetscFunctionBeginUser;
+  PetscCall(MatDestroy(&chol->W));
+  PetscCall(PetscFree3(chol->wb_C, chol->wb_isd, chol->wb_t));
+  PetscCall(VecDestroy(&chol->wb_e));
+  chol->wb_k = 0;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
 
+static PetscErrorCode CholSamplerClearWoodbury(PC_CholSampler chol)
+{
   PetscFunctionBeginUser;
-  if (chol->scb) PetscCall(chol->scb(chol->sample_index++, y, chol->cbctx));
+  PetscCall(MatDestroy(&chol->B));
+  PetscCall(CholSamplerClearWoodburyFactors(chol));
   PetscFunctionReturn(PETSC_SUCCESS);
 }
 
@@ -69,12 +465,19 @@ static PetscErrorCode PCDestroy_CholSampler(PC pc)
   if (chol->del_scb) PetscCall(chol->del_scb(chol->cbctx));
   PetscCall(PetscRandomDestroy(&chol->prand));
   PetscCall(MatDestroy(&chol->F));
+  PetscCall(CholLSDestroy(&chol->ls));
   PetscCall(PetscFree(chol->dense_L));
+  PetscCall(PetscFree(chol->blk));
   PetscCall(VecDestroy(&chol->r));
   PetscCall(VecDestroy(&chol->v));
   PetscCall(VecDestroy(&chol->v_cache));
   PetscCall(VecDestroy(&chol->xl));
   PetscCall(VecDestroy(&chol->yl));
+  PetscCall(VecDestroy(&chol->xall));
+  PetscCall(VecScatterDestroy(&chol->sct));
+  PetscCall(MatDestroy(&chol->Pf));
+  PetscCall(MatDestroy(&chol->Sf));
+  PetscCall(CholSamplerClearWoodbury(chol));
   PetscCall(PetscFree(chol));
   PetscFunctionReturn(PETSC_SUCCESS);
 }
@@ -86,17 +489,87 @@ static PetscErrorCode PCReset_CholSampler(PC pc)
   PetscFunctionBeginUser;
   PetscCall(PetscRandomDestroy(&chol->prand));
   PetscCall(MatDestroy(&chol->F));
+  PetscCall(CholLSDestroy(&chol->ls));
   PetscCall(PetscFree(chol->dense_L));
+  PetscCall(PetscFree(chol->blk));
   PetscCall(VecDestroy(&chol->r));
   PetscCall(VecDestroy(&chol->v));
   PetscCall(VecDestroy(&chol->v_cache));
   PetscCall(VecDestroy(&chol->xl));
   PetscCall(VecDestroy(&chol->yl));
+  PetscCall(VecDestroy(&chol->xall));
+  PetscCall(VecScatterDestroy(&chol->sct));
+  PetscCall(MatDestroy(&chol->Pf));
+  PetscCall(MatDestroy(&chol->Sf));
+  PetscCall(CholSamplerClearWoodbury(chol));
   chol->dense_n      = 0;
+  chol->counter      = 0;
   chol->sample_index = 0;
   PetscFunctionReturn(PETSC_SUCCESS);
 }
 
+/* Dense Cholesky factor of the sequential matrix S (allocated at the first call) */
+static PetscErrorCode CholSamplerFactorDense(PC_CholSampler chol, Mat S)
+{
+  Mat                D;
+  const PetscScalar *darr;
+  PetscInt           N;
+  PetscBLASInt       n, linfo;
+
+  PetscFunctionBeginUser;
+  PetscCall(MatGetSize(S, &N, NULL));
+  PetscCall(MatConvert(S, MATSEQDENSE, MAT_INITIAL_MATRIX, &D));
+  PetscCall(PetscBLASIntCast(N, &n));
+  if (!chol->dense_L) PetscCall(PetscMalloc1((size_t)N * N, &chol->dense_L));
+  PetscCall(MatDenseGetArrayRead(D, &darr));
+  PetscCall(PetscArraycpy(chol->dense_L, darr, (size_t)N * N));
+  PetscCall(MatDenseRestoreArrayRead(D, &darr));
+  PetscCall(PetscFPTrapPush(PETSC_FP_TRAP_OFF));
+  PetscCallBLAS("LAPACKpotrf", LAPACKpotrf_("L", &n, chol->dense_L, &n, &linfo));
+  PetscCall(PetscFPTrapPop());
+  PetscCheck(linfo == 0, PETSC_COMM_SELF, PETSC_ERR_MAT_CH_ZRPVT, "Dense Cholesky failed: leading minor of order %" PetscBLASInt_FMT " is not positive definite", linfo);
+  chol->dense_n = n;
+  PetscCall(MatDestroy(&D));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* Numeric-only refactorization after the values of the operator have
+   changed but not its nonzero pattern: the sequential copy of the matrix is
+   refreshed in place and the existing symbolic factorization (ordering,
+   elimination tree, pattern of the factor) is reused. */
+static PetscErrorCode CholSamplerRefactor(PC pc)
+{
+  PC_CholSampler chol = pc->data;
+  MPI_Comm       comm = PetscObjectComm((PetscObject)pc);
+  PetscMPIInt    size, rank;
+  MatFactorInfo  info;
+
+  PetscFunctionBeginUser;
+  PetscCallMPI(MPI_Comm_size(comm, &size));
+  PetscCallMPI(MPI_Comm_rank(comm, &rank));
+  if (size != 1 && chol->redundant) {
+    Mat     *seqs = &chol->Sf;
+    IS       all;
+    PetscInt Nall;
+
+    PetscCall(MatGetSize(chol->Pf, &Nall, NULL));
+    PetscCall(ISCreateStride(PETSC_COMM_SELF, Nall, 0, 1, &all));
+    PetscCall(MatCreateSubMatrices(chol->Pf, 1, &all, &all, MAT_REUSE_MATRIX, &seqs));
+    PetscCall(ISDestroy(&all));
+  } else if (size != 1 && !chol->is_gamg_coarse) {
+    PetscCall(MatConvert(chol->Pf, MATSBAIJ, MAT_REUSE_MATRIX, &chol->Sf));
+  } // Otherwise Sf shares the values with Pf
+
+  if (chol->dense_n) PetscCall(CholSamplerFactorDense(chol, chol->Sf));
+  else if (chol->ls) PetscCall(CholLSRefactor(chol->Sf, chol->ls));
+  else if (chol->F && (!chol->is_gamg_coarse || rank == 0)) {
+    PetscCall(MatFactorInfoInitialize(&info));
+    PetscCall(MatCholeskyFactorNumeric(chol->F, chol->Sf, &info));
+  }
+  PetscCall(CholSamplerClearWoodburyFactors(chol));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
 static PetscErrorCode PCSetUp_CholSampler(PC pc)
 {
   PC_CholSampler chol = pc->data;
@@ -113,11 +586,30 @@ static PetscErrorCode PCSetUp_CholSampler(PC pc)
   comm = PetscObjectComm((PetscObject)pc);
   PetscCallMPI(MPI_Comm_rank(comm, &rank));
   PetscCall(MatFactorInfoInitialize(&info));
-  if (!chol->prand) PetscCall(ParMGMCGetPetscRandom(&chol->prand));
-
   PetscCall(MatGetType(pc->pmat, &type));
   PetscCall(PetscStrcmp(type, MATLRC, &flag));
-  if (flag) {
+
+  if (pc->setupcalled && pc->flag == SAME_NONZERO_PATTERN && chol->Pf && (!flag || chol->woodbury)) {
+    PetscObjectState state;
+    Mat              B = NULL;
+
+    P = pc->pmat;
+    if (flag) PetscCall(MatLRCGetMats(pc->pmat, &P, &B, NULL, NULL));
+    PetscCall(MatGetNonzeroState(P, &state));
+    if (P == chol->Pf && B == chol->B && state == chol->Pf_state) {
+      PetscCall(CholSamplerRefactor(pc));
+      PetscFunctionReturn(PETSC_SUCCESS);
+    }
+  }
+  if (pc->setupcalled) PetscCall(PCReset_CholSampler(pc));
+  if (!chol->prand) PetscCall(ParMGMCGetPetscRandom(&chol->prand));
+  PetscCall(CholSamplerClearWoodbury(chol));
+  if (flag && chol->woodbury) {
+    // Only the prior precision is factored, the samples are corrected for the low-rank part
+    PetscCall(MatLRCGetMats(pc->pmat, &P, &chol->B, NULL, NULL));
+    PetscCall(PetscObjectReference((PetscObject)P));
+    PetscCall(PetscObjectReference((PetscObject)chol->B));
+  } else if (flag) {
     Mat A, B, Bs, Bs_S, BSBt;
     Vec D;
 
@@ -159,7 +651,37 @@ static PetscErrorCode PCSetUp_CholSampler(PC pc)
   // Set symmetric flag to allow conversion and help with factorization
   PetscCall(MatSetOption(P, MAT_SYMMETRIC, PETSC_TRUE));
 
-  if (size != 1) {
+  if (size != 1 && chol->redundant) {
+    // Every rank gets a sequential copy of the whole matrix
+    Mat     *seqs;
+    IS       all;
+    Vec      x;
+    PetscInt Nall;
+
+    PetscCall(MatGetSize(P, &Nall, NULL));
+    PetscCall(ISCreateStride(PETSC_COMM_SELF, Nall, 0, 1, &all));
+    PetscCall(MatCreateSubMatrices(P, 1, &all, &all, MAT_INITIAL_MATRIX, &seqs));
+    S = seqs[0];
+    PetscCall(PetscObjectReference((PetscObject)S));
+    PetscCall(MatDestroySubMatrices(1, &seqs));
+    PetscCall(ISDestroy(&all));
+
+    PetscCall(MatCreateVecs(P, &x, NULL));
+    PetscCall(VecScatterCreateToAll(x, &chol->sct, &chol->xall));
+    PetscCall(VecDestroy(&x));
+
+    // Shared key for the noise, different for every sampler
+    if (rank == 0) {
+      unsigned long seed;
+      PetscReal     u;
+
+      PetscCall(PetscRandomGetSeed(chol->prand, &seed));
+      PetscCall(PetscRandomGetValueReal(chol->prand, &u));
+      chol->key = (PetscInt64)seed ^ (PetscInt64)(u * 9007199254740992.0);
+    }
+    PetscCallMPI(MPI_Bcast(&chol->key, 1, MPIU_INT64, 0, comm));
+    chol->counter = 0;
+  } else if (size != 1) {
     if (chol->is_gamg_coarse) PetscCall(MatMPIAIJGetSeqAIJ(P, &S, NULL, NULL));
     else PetscCall(MatConvert(P, MATSBAIJ, MAT_INITIAL_MATRIX, &S));
   } else {
@@ -170,31 +692,29 @@ static PetscErrorCode PCSetUp_CholSampler(PC pc)
   PetscCall(MatCreateVecs(S, &chol->r, &chol->v));
   PetscCall(VecDuplicate(chol->v, &chol->v_cache));
 
-  if (size == 1 && chol->is_gamg_coarse == PETSC_FALSE) PetscCall(MatGetSize(S, &N, NULL));
+  if ((size == 1 || chol->redundant) && chol->is_gamg_coarse == PETSC_FALSE) PetscCall(MatGetSize(S, &N, NULL));
   if (N > 0 && N <= chol->dense_threshold) {
     /* Small sequential block (e.g. an ASM star/patch smoother block): factor and
        solve densely.  These blocks are tiny and structurally near-dense, so a
        LAPACK Cholesky plus BLAS triangular solves avoids the sparse-factor
        indirection and is markedly faster than the sparse path. */
-    Mat                D;
-    const PetscScalar *darr;
-    PetscBLASInt       n, linfo;
-
-    PetscCall(MatConvert(S, MATSEQDENSE, MAT_INITIAL_MATRIX, &D));
-    PetscCall(PetscBLASIntCast(N, &n));
-    PetscCall(PetscMalloc1((size_t)N * N, &chol->dense_L));
-    PetscCall(MatDenseGetArrayRead(D, &darr));
-    PetscCall(PetscArraycpy(chol->dense_L, darr, (size_t)N * N));
-    PetscCall(MatDenseRestoreArrayRead(D, &darr));
-    PetscCall(PetscFPTrapPush(PETSC_FP_TRAP_OFF));
-    PetscCallBLAS("LAPACKpotrf", LAPACKpotrf_("L", &n, chol->dense_L, &n, &linfo));
-    PetscCall(PetscFPTrapPop());
-    PetscCheck(linfo == 0, comm, PETSC_ERR_MAT_CH_ZRPVT, "Dense Cholesky failed: leading minor of order %" PetscBLASInt_FMT " is not positive definite", linfo);
-    chol->dense_n = n;
-    PetscCall(MatDestroy(&D));
+    PetscCall(CholSamplerFactorDense(chol, S));
+  } else if (chol->level_schedule && (size == 1 || chol->is_gamg_coarse || chol->redundant)) {
+    PetscBool isseqaij;
+
+    PetscCall(PetscObjectTypeCompare((PetscObject)S, MATSEQAIJ, &isseqaij));
+    PetscCheck(isseqaij, comm, PETSC_ERR_SUP, "Level-scheduled factorization requires a MATSEQAIJ matrix");
+    PetscCall(MatGetOrdering(S, MATORDERINGMETISND, &rowperm, &colperm));
+    if (!chol->is_gamg_coarse || rank == 0) PetscCall(CholLSCreate(S, rowperm, &chol->ls));
+    if (chol->is_gamg_coarse) {
+      PetscCall(MatCreateVecs(S, &chol->xl, NULL));
+      PetscCall(MatCreateVecs(S, &chol->yl, NULL));
+    }
+    PetscCall(ISDestroy(&rowperm));
+    PetscCall(ISDestroy(&colperm));
   } else {
     PetscCall(MatGetFactor(S, chol->st, MAT_FACTOR_CHOLESKY, &chol->F));
-    if (size == 1 || chol->is_gamg_coarse) PetscCall(MatGetOrdering(S, MATORDERINGMETISND, &rowperm, &colperm));
+    if (size == 1 || chol->is_gamg_coarse || chol->redundant) PetscCall(MatGetOrdering(S, MATORDERINGMETISND, &rowperm, &colperm));
     else PetscCall(MatGetOrdering(S, MATORDERINGEXTERNAL, &rowperm, &colperm));
     if (!chol->is_gamg_coarse || rank == 0) {
       PetscCall(MatCholeskyFactorSymbolic(chol->F, S, rowperm, &info));
@@ -207,8 +727,12 @@ static PetscErrorCode PCSetUp_CholSampler(PC pc)
     PetscCall(ISDestroy(&rowperm));
     PetscCall(ISDestroy(&colperm));
   }
-  if (size != 1 && !chol->is_gamg_coarse) PetscCall(MatDestroy(&S));
-  if (flag) PetscCall(MatDestroy(&P));
+  // Kept for the numeric refactorization, see CholSamplerRefactor()
+  if (size == 1 || chol->is_gamg_coarse) PetscCall(PetscObjectReference((PetscObject)S));
+  chol->Sf = S;
+  if (!flag) PetscCall(PetscObjectReference((PetscObject)P));
+  chol->Pf = P;
+  PetscCall(MatGetNonzeroState(P, &chol->Pf_state));
 
   /* pc->setupcalled         = PETSC_TRUE; */
   /* pc->reusepreconditioner = PETSC_TRUE; */
@@ -231,6 +755,15 @@ static PetscErrorCode CholSamplerForwardSolve(PC_CholSampler chol, Vec in, Vec o
     PetscCallBLAS("BLAStrsv", BLAStrsv_("L", "N", "N", &chol->dense_n, chol->dense_L, &chol->dense_n, outa, &one));
     PetscCall(VecRestoreArray(out, &outa));
     PetscCall(VecRestoreArrayRead(in, &ina));
+  } else if (chol->ls) {
+    const PetscScalar *ina;
+    PetscScalar       *outa;
+
+    PetscCall(VecGetArrayRead(in, &ina));
+    PetscCall(VecGetArrayWrite(out, &outa));
+    PetscCall(CholLSForward(chol->ls, ina, outa));
+    PetscCall(VecRestoreArrayWrite(out, &outa));
+    PetscCall(VecRestoreArrayRead(in, &ina));
   } else {
     PetscCall(MatForwardSolve(chol->F, in, out));
   }
@@ -253,12 +786,219 @@ static PetscErrorCode CholSamplerBackwardSolve(PC_CholSampler chol, Vec in, Vec
     PetscCallBLAS("BLAStrsv", BLAStrsv_("L", "T", "N", &chol->dense_n, chol->dense_L, &chol->dense_n, outa, &one));
     PetscCall(VecRestoreArray(out, &outa));
     PetscCall(VecRestoreArrayRead(in, &ina));
+  } else if (chol->ls) {
+    const PetscScalar *ina;
+    PetscScalar       *outa;
+
+    PetscCall(VecGetArrayRead(in, &ina));
+    PetscCall(VecGetArrayWrite(out, &outa));
+    PetscCall(CholLSBackward(chol->ls, ina, outa));
+    PetscCall(VecRestoreArrayWrite(out, &outa));
+    PetscCall(VecRestoreArrayRead(in, &ina));
   } else {
     PetscCall(MatBackwardSolve(chol->F, in, out));
   }
   PetscFunctionReturn(PETSC_SUCCESS);
 }
 
+/* Copies the locally owned part of the full sample (redundant mode) into y */
+static PetscErrorCode CholSamplerRedundantRestrict(PC_CholSampler chol, Vec y)
+{
+  const PetscScalar *xa;
+  PetscScalar       *ya;
+  PetscInt           rstart, n;
+
+  PetscFunctionBeginUser;
+  PetscCall(VecGetOwnershipRange(y, &rstart, NULL));
+  PetscCall(VecGetLocalSize(y, &n));
+  PetscCall(VecGetArrayRead(chol->xall, &xa));
+  PetscCall(VecGetArrayWrite(y, &ya));
+  PetscCall(PetscArraycpy(ya, xa + rstart, n));
+  PetscCall(VecRestoreArrayWrite(y, &ya));
+  PetscCall(VecRestoreArrayRead(chol->xall, &xa));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* y = A^-1 x with the factor, i.e., the mean of the sampler without noise */
+static PetscErrorCode CholSamplerSolve(PC pc, Vec x, Vec y)
+{
+  PC_CholSampler chol = pc->data;
+  PetscMPIInt    rank;
+
+  PetscFunctionBeginUser;
+  PetscCallMPI(MPI_Comm_rank(PetscObjectComm((PetscObject)pc), &rank));
+  if (chol->is_gamg_coarse) {
+    if (rank == 0) {
+      PetscCall(VecGetLocalVectorRead(x, chol->xl));
+      PetscCall(CholSamplerForwardSolve(chol, chol->xl, chol->v));
+      PetscCall(VecRestoreLocalVectorRead(x, chol->xl));
+      PetscCall(VecGetLocalVector(y, chol->yl));
+      PetscCall(CholSamplerBackwardSolve(chol, chol->v, chol->yl));
+      PetscCall(VecRestoreLocalVector(y, chol->yl));
+    }
+  } else if (chol->sct) {
+    PetscCall(VecScatterBegin(chol->sct, x, chol->xall, INSERT_VALUES, SCATTER_FORWARD));
+    PetscCall(VecScatterEnd(chol->sct, x, chol->xall, INSERT_VALUES, SCATTER_FORWARD));
+    PetscCall(CholSamplerForwardSolve(chol, chol->xall, chol->v));
+    PetscCall(CholSamplerBackwardSolve(chol, chol->v, chol->xall));
+    PetscCall(CholSamplerRedundantRestrict(chol, y));
+  } else {
+    PetscCall(CholSamplerForwardSolve(chol, x, chol->v));
+    PetscCall(CholSamplerBackwardSolve(chol, chol->v, y));
+  }
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* Woodbury mode: computes W = A^-1 B and the Cholesky factor of the
+   capacitance matrix C = S^-1 + B^T W. The k solves are done as one
+   multi-RHS solve where the layout of the factor allows it. */
+static PetscErrorCode CholSamplerSetUpWoodbury(PC pc)
+{
+  PC_CholSampler     chol = pc->data;
+  Mat                Bl, Wl;
+  Vec                S, Sall;
+  VecScatter         sct;
+  const PetscScalar *barr, *wrd, *sarr;
+  PetscScalar       *warr;
+  PetscInt           n, k, ldb, ldw;
+  PetscBLASInt       bn, bk, bldb, bldw, info;
+
+  PetscFunctionBeginUser;
+  PetscCall(MatLRCGetMats(pc->pmat, NULL, NULL, &S, NULL));
+  PetscCall(MatGetLocalSize(chol->B, &n, NULL));
+  PetscCall(MatGetSize(chol->B, NULL, &k));
+  PetscCall(MatDuplicate(chol->B, MAT_DO_NOT_COPY_VALUES, &chol->W));
+  if (chol->dense_n && !chol->sct) {
+    PetscCall(MatCopy(chol->B, chol->W, SAME_NONZERO_PATTERN));
+    PetscCall(PetscBLASIntCast(k, &bk));
+    PetscCall(MatDenseGetLDA(chol->W, &ldw));
+    PetscCall(PetscBLASIntCast(ldw, &bldw));
+    PetscCall(MatDenseGetArray(chol->W, &warr));
+    PetscCallBLAS("LAPACKpotrs", LAPACKpotrs_("L", &chol->dense_n, &bk, chol->dense_L, &chol->dense_n, warr, &bldw, &info));
+    PetscCall(MatDenseRestoreArray(chol->W, &warr));
+    PetscCheck(info == 0, PETSC_COMM_SELF, PETSC_ERR_LIB, "LAPACK potrs failed with error %" PetscBLASInt_FMT, info);
+  } else if (chol->F && !chol->is_gamg_coarse && !chol->sct) {
+    PetscCall(MatMatSolve(chol->F, chol->B, chol->W));
+  } else {
+    for (PetscInt j = 0; j < k; ++j) {
+      Vec bj, wj;
+
+      PetscCall(MatDenseGetColumnVecRead(chol->B, j, &bj));
+      PetscCall(MatDenseGetColumnVecWrite(chol->W, j, &wj));
+      PetscCall(CholSamplerSolve(pc, bj, wj));
+      PetscCall(MatDenseRestoreColumnVecWrite(chol->W, j, &wj));
+      PetscCall(MatDenseRestoreColumnVecRead(chol->B, j, &bj));
+    }
+  }
+
+  PetscCall(PetscBLASIntCast(k, &bk));
+  PetscCall(PetscBLASIntCast(n, &bn));
+  PetscCall(PetscCalloc3((size_t)k * k, &chol->wb_C, k, &chol->wb_isd, k, &chol->wb_t));
+  chol->wb_k = bk;
+  PetscCall(MatDenseGetLocalMatrix(chol->B, &Bl));
+  PetscCall(MatDenseGetLocalMatrix(chol->W, &Wl));
+  PetscCall(MatDenseGetLDA(Bl, &ldb));
+  PetscCall(MatDenseGetLDA(Wl, &ldw));
+  PetscCall(PetscBLASIntCast(ldb, &bldb));
+  PetscCall(PetscBLASIntCast(ldw, &bldw));
+  if (n > 0) {
+    PetscScalar one = 1., zero = 0.;
+
+    PetscCall(MatDenseGetArrayRead(Bl, &barr));
+    PetscCall(MatDenseGetArrayRead(Wl, &wrd));
+    PetscCallBLAS("BLASgemm", BLASgemm_("T", "N", &bk, &bk, &bn, &one, barr, &bldb, wrd, &bldw, &zero, chol->wb_C, &bk));
+    PetscCall(MatDenseRestoreArrayRead(Wl, &wrd));
+    PetscCall(MatDenseRestoreArrayRead(Bl, &barr));
+  }
+  PetscCallMPI(MPI_Allreduce(MPI_IN_PLACE, chol->wb_C, (PetscMPIInt)(k * k), MPIU_SCALAR, MPIU_SUM, PetscObjectComm((PetscObject)pc)));
+  /* S is distributed, every rank needs all of it */
+  PetscCall(VecScatterCreateToAll(S, &sct, &Sall));
+  PetscCall(VecScatterBegin(sct, S, Sall, INSERT_VALUES, SCATTER_FORWARD));
+  PetscCall(VecScatterEnd(sct, S, Sall, INSERT_VALUES, SCATTER_FORWARD));
+  PetscCall(VecGetArrayRead(Sall, &sarr));
+  for (PetscInt i = 0; i < k; ++i) {
+    chol->wb_C[i + i * k] += 1. / sarr[i];
+    chol->wb_isd[i] = 1. / PetscSqrtScalar(sarr[i]);
+  }
+  PetscCall(VecRestoreArrayRead(Sall, &sarr));
+  PetscCall(VecScatterDestroy(&sct));
+  PetscCall(VecDestroy(&Sall));
+  PetscCall(PetscFPTrapPush(PETSC_FP_TRAP_OFF));
+  PetscCallBLAS("LAPACKpotrf", LAPACKpotrf_("L", &bk, chol->wb_C, &bk, &info));
+  PetscCall(PetscFPTrapPop());
+  PetscCheck(info == 0, PetscObjectComm((PetscObject)pc), PETSC_ERR_MAT_CH_ZRPVT, "Capacitance matrix is not positive definite (leading minor %" PetscBLASInt_FMT ")", info);
+  PetscCall(VecCreateSeq(PETSC_COMM_SELF, k, &chol->wb_e));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* Turns a sample y ~ N(A^-1 b, A^-1) into a sample of N((A + B S B^T)^-1 b,
+   (A + B S B^T)^-1) (Matheron's update):
+
+       y <- y - W C^-1 (B^T y + S^-1/2 e),   e ~ N(0, I).
+
+   B^T y and the noise are combined in a single reduction. Without the noise,
+   this turns y = A^-1 b into (A + B S B^T)^-1 b. */
+static PetscErrorCode CholSamplerWoodburyCorrect(PC pc, Vec y, PetscBool noise)
+{
+  PC_CholSampler     chol = pc->data;
+  Mat                Bl, Wl;
+  const PetscScalar *barr, *warr;
+  PetscScalar       *yarr, one = 1., mone = -1., zero = 0.;
+  PetscInt           n, ldb, ldw;
+  PetscBLASInt       bn, bldb, bldw, ione = 1, info;
+  PetscMPIInt        rank;
+
+  PetscFunctionBeginUser;
+  if (!chol->W) PetscCall(CholSamplerSetUpWoodbury(pc));
+  PetscCallMPI(MPI_Comm_rank(PetscObjectComm((PetscObject)pc), &rank));
+  PetscCall(MatDenseGetLocalMatrix(chol->B, &Bl));
+  PetscCall(MatDenseGetLocalMatrix(chol->W, &Wl));
+  PetscCall(MatDenseGetLDA(Bl, &ldb));
+  PetscCall(MatDenseGetLDA(Wl, &ldw));
+  PetscCall(PetscBLASIntCast(ldb, &bldb));
+  PetscCall(PetscBLASIntCast(ldw, &bldw));
+  PetscCall(VecGetLocalSize(y, &n));
+  PetscCall(PetscBLASIntCast(n, &bn));
+
+  PetscCall(VecGetArray(y, &yarr));
+  PetscCall(PetscArrayzero(chol->wb_t, chol->wb_k));
+  if (n > 0) {
+    PetscCall(MatDenseGetArrayRead(Bl, &barr));
+    PetscCallBLAS("BLASgemv", BLASgemv_("T", &bn, &chol->wb_k, &one, barr, &bldb, yarr, &ione, &zero, chol->wb_t, &ione));
+    PetscCall(MatDenseRestoreArrayRead(Bl, &barr));
+  }
+  if (noise && rank == 0) {
+    const PetscScalar *earr;
+
+    PetscCall(VecSetRandomStandardNormal(chol->wb_e, chol->prand));
+    PetscCall(VecGetArrayRead(chol->wb_e, &earr));
+    for (PetscBLASInt i = 0; i < chol->wb_k; ++i) chol->wb_t[i] += chol->wb_isd[i] * earr[i];
+    PetscCall(VecRestoreArrayRead(chol->wb_e, &earr));
+  }
+  PetscCallMPI(MPI_Allreduce(MPI_IN_PLACE, chol->wb_t, (PetscMPIInt)chol->wb_k, MPIU_SCALAR, MPIU_SUM, PetscObjectComm((PetscObject)pc)));
+  PetscCallBLAS("LAPACKpotrs", LAPACKpotrs_("L", &chol->wb_k, &ione, chol->wb_C, &chol->wb_k, chol->wb_t, &chol->wb_k, &info));
+  PetscCheck(info == 0, PETSC_COMM_SELF, PETSC_ERR_LIB, "LAPACK potrs failed with error %" PetscBLASInt_FMT, info);
+  if (n > 0) {
+    PetscCall(MatDenseGetArrayRead(Wl, &warr));
+    PetscCallBLAS("BLASgemv", BLASgemv_("N", &bn, &chol->wb_k, &mone, warr, &bldw, chol->wb_t, &ione, &one, yarr, &ione));
+    PetscCall(MatDenseRestoreArrayRead(Wl, &warr));
+  }
+  PetscCall(VecRestoreArray(y, &yarr));
+  PetscCall(PetscLogFlops(4. * n * chol->wb_k + 2. * chol->wb_k * chol->wb_k));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* Called once for every sample that was written to y */
+static PetscErrorCode PCCholSamplerFinishSample(PC pc, Vec y)
+{
+  PC_CholSampler chol = pc->data;
+
+  PetscFunctionBeginUser;
+  if (chol->B) PetscCall(CholSamplerWoodburyCorrect(pc, y, PETSC_TRUE));
+  if (chol->scb) PetscCall(chol->scb(chol->sample_index++, y, chol->cbctx));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
 static PetscErrorCode PCApply_CholSampler(PC pc, Vec x, Vec y)
 {
   PC_CholSampler chol = pc->data;
@@ -272,21 +1012,109 @@ static PetscErrorCode PCApply_CholSampler(PC pc, Vec x, Vec y)
   if (chol->is_gamg_coarse) {
     if (rank == 0) {
       PetscCall(VecGetLocalVectorRead(x, chol->xl));
-      PetscCall(MatForwardSolve(chol->F, chol->xl, chol->v));
+      PetscCall(CholSamplerForwardSolve(chol, chol->xl, chol->v));
       PetscCall(VecRestoreLocalVectorRead(x, chol->xl));
       PetscCall(VecSetRandomStandardNormal(chol->r, chol->prand));
       PetscCall(VecAXPY(chol->v, 1., chol->r));
       PetscCall(VecGetLocalVector(y, chol->yl));
-      PetscCall(MatBackwardSolve(chol->F, chol->v, chol->yl));
+      PetscCall(CholSamplerBackwardSolve(chol, chol->v, chol->yl));
       PetscCall(VecRestoreLocalVector(y, chol->yl));
     }
+  } else if (chol->sct) {
+    PetscCall(VecScatterBegin(chol->sct, x, chol->xall, INSERT_VALUES, SCATTER_FORWARD));
+    PetscCall(VecScatterEnd(chol->sct, x, chol->xall, INSERT_VALUES, SCATTER_FORWARD));
+    PetscCall(CholSamplerForwardSolve(chol, chol->xall, chol->v));
+    PetscCall(VecSetRandomStandardNormalCounter(chol->r, chol->key, chol->counter++));
+    PetscCall(VecAXPY(chol->v, 1., chol->r));
+    PetscCall(CholSamplerBackwardSolve(chol, chol->v, chol->xall));
+    PetscCall(CholSamplerRedundantRestrict(chol, y));
   } else {
     PetscCall(CholSamplerForwardSolve(chol, x, chol->v));
     PetscCall(VecSetRandomStandardNormal(chol->r, chol->prand));
     PetscCall(VecAXPY(chol->v, 1., chol->r));
     PetscCall(CholSamplerBackwardSolve(chol, chol->v, y));
   }
-  PetscCall(PCCholSamplerNotifySample(pc, y));
+  PetscCall(PCCholSamplerFinishSample(pc, y));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* Computes m samples with the dense factor at once: the noise of all samples
+   is drawn into the columns of a block, the cached forward solve is added to
+   each column and one BLAS-3 triangular solve with m right hand sides
+   replaces m separate BLAS-2 solves. The samples are then copied to y one by
+   one, and the sample callback is called for each of them. */
+static PetscErrorCode CholSamplerSampleBatch(PC pc, PetscInt m, Vec y)
+{
+  PC_CholSampler chol = pc->data;
+  PetscBLASInt   bm;
+  PetscScalar    one = 1.;
+
+  PetscFunctionBeginUser;
+  if (!chol->blk) PetscCall(PetscMalloc1((size_t)chol->dense_n * chol->batch, &chol->blk));
+  PetscCall(PetscBLASIntCast(m, &bm));
+  for (PetscInt j = 0; j < m; ++j) {
+    PetscCall(VecPlaceArray(chol->v, chol->blk + (size_t)j * chol->dense_n));
+    if (chol->sct) PetscCall(VecSetRandomStandardNormalCounter(chol->v, chol->key, chol->counter++));
+    else PetscCall(VecSetRandomStandardNormal(chol->v, chol->prand));
+    PetscCall(VecAXPY(chol->v, 1., chol->v_cache));
+    PetscCall(VecResetArray(chol->v));
+  }
+  PetscCallBLAS("BLAStrsm", BLAStrsm_("L", "L", "T", "N", &chol->dense_n, &bm, &one, chol->dense_L, &chol->dense_n, chol->blk, &chol->dense_n));
+  PetscCall(PetscLogFlops((PetscLogDouble)chol->dense_n * chol->dense_n * m));
+  for (PetscInt j = 0; j < m; ++j) {
+    PetscCall(VecPlaceArray(chol->v, chol->blk + (size_t)j * chol->dense_n));
+    if (chol->sct) {
+      PetscCall(VecCopy(chol->v, chol->xall));
+      PetscCall(CholSamplerRedundantRestrict(chol, y));
+    } else {
+      PetscCall(VecCopy(chol->v, y));
+    }
+    PetscCall(VecResetArray(chol->v));
+    PetscCall(PCCholSamplerFinishSample(pc, y));
+  }
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* The same with the level-scheduled sparse factor: the m samples are
+   written into a block (by rows, see CholLSBackwardBlock()) and the backward
+   solves are done as one multi-RHS solve. With the GAMG coarse level only
+   rank 0 holds the factor and computes the samples, all ranks call the
+   sample callback. */
+static PetscErrorCode CholSamplerSampleBatchSparse(PC pc, PetscInt m, Vec y)
+{
+  PC_CholSampler chol = pc->data;
+  CholLS         ls   = chol->ls;
+
+  PetscFunctionBeginUser;
+  if (ls) {
+    const PetscScalar *ca, *ra;
+
+    if (!chol->blk) PetscCall(PetscMalloc1((size_t)ls->n * chol->batch, &chol->blk));
+    PetscCall(VecGetArrayRead(chol->v_cache, &ca));
+    for (PetscInt j = 0; j < m; ++j) {
+      if (chol->sct) PetscCall(VecSetRandomStandardNormalCounter(chol->r, chol->key, chol->counter++));
+      else PetscCall(VecSetRandomStandardNormal(chol->r, chol->prand));
+      PetscCall(VecGetArrayRead(chol->r, &ra));
+      for (PetscInt i = 0; i < ls->n; ++i) chol->blk[i * m + j] = ca[i] + ra[i];
+      PetscCall(VecRestoreArrayRead(chol->r, &ra));
+    }
+    PetscCall(VecRestoreArrayRead(chol->v_cache, &ca));
+    PetscCall(CholLSBackwardBlock(ls, m, chol->blk));
+  }
+  for (PetscInt j = 0; j < m; ++j) {
+    if (ls) {
+      Vec          t = chol->is_gamg_coarse ? chol->yl : (chol->sct ? chol->xall : y);
+      PetscScalar *ta;
+
+      if (chol->is_gamg_coarse) PetscCall(VecGetLocalVector(y, chol->yl));
+      PetscCall(VecGetArrayWrite(t, &ta));
+      for (PetscInt i = 0; i < ls->n; ++i) ta[ls->perm[i]] = chol->blk[i * m + j];
+      PetscCall(VecRestoreArrayWrite(t, &ta));
+      if (chol->is_gamg_coarse) PetscCall(VecRestoreLocalVector(y, chol->yl));
+    }
+    if (chol->sct) PetscCall(CholSamplerRedundantRestrict(chol, y));
+    PetscCall(PCCholSamplerFinishSample(pc, y));
+  }
   PetscFunctionReturn(PETSC_SUCCESS);
 }
 
@@ -310,29 +1138,45 @@ static PetscErrorCode PCApplyRichardson_CholSampler(PC pc, Vec b, Vec y, Vec w,
     if (chol->is_gamg_coarse) {
       if (rank == 0) {
         PetscCall(VecGetLocalVectorRead(b, chol->xl));
-        PetscCall(MatForwardSolve(chol->F, chol->xl, chol->v_cache));
+        PetscCall(CholSamplerForwardSolve(chol, chol->xl, chol->v_cache));
         PetscCall(VecRestoreLocalVectorRead(b, chol->xl));
       }
+    } else if (chol->sct) {
+      PetscCall(VecScatterBegin(chol->sct, b, chol->xall, INSERT_VALUES, SCATTER_FORWARD));
+      PetscCall(VecScatterEnd(chol->sct, b, chol->xall, INSERT_VALUES, SCATTER_FORWARD));
+      PetscCall(CholSamplerForwardSolve(chol, chol->xall, chol->v_cache));
     } else {
       PetscCall(CholSamplerForwardSolve(chol, b, chol->v_cache));
     }
-    for (PetscInt it = 0; it < its; ++it) {
-      if (chol->is_gamg_coarse) {
-        if (rank == 0) {
+    if (chol->dense_n && chol->batch > 1) {
+      for (PetscInt it = 0; it < its; it += chol->batch) PetscCall(CholSamplerSampleBatch(pc, PetscMin(chol->batch, its - it), y));
+    } else if (chol->level_schedule && !chol->F && chol->batch > 1) {
+      for (PetscInt it = 0; it < its; it += chol->batch) PetscCall(CholSamplerSampleBatchSparse(pc, PetscMin(chol->batch, its - it), y));
+    } else {
+      for (PetscInt it = 0; it < its; ++it) {
+        if (chol->is_gamg_coarse) {
+          if (rank == 0) {
+            PetscCall(VecCopy(chol->v_cache, chol->v));
+            PetscCall(VecSetRandomStandardNormal(chol->r, chol->prand));
+            PetscCall(VecAXPY(chol->v, 1., chol->r));
+            PetscCall(VecGetLocalVector(y, chol->yl));
+            PetscCall(CholSamplerBackwardSolve(chol, chol->v, chol->yl));
+            PetscCall(VecRestoreLocalVector(y, chol->yl));
+          }
+        } else if (chol->sct) {
+          PetscCall(VecCopy(chol->v_cache, chol->v));
+          PetscCall(VecSetRandomStandardNormalCounter(chol->r, chol->key, chol->counter++));
+          PetscCall(VecAXPY(chol->v, 1., chol->r));
+          PetscCall(CholSamplerBackwardSolve(chol, chol->v, chol->xall));
+          PetscCall(CholSamplerRedundantRestrict(chol, y));
+        } else {
           PetscCall(VecCopy(chol->v_cache, chol->v));
           PetscCall(VecSetRandomStandardNormal(chol->r, chol->prand));
           PetscCall(VecAXPY(chol->v, 1., chol->r));
-          PetscCall(VecGetLocalVector(y, chol->yl));
-          PetscCall(MatBackwardSolve(chol->F, chol->v, chol->yl));
-          PetscCall(VecRestoreLocalVector(y, chol->yl));
+          PetscCall(CholSamplerBackwardSolve(chol, chol->v, y));
         }
-      } else {
-        PetscCall(VecCopy(chol->v_cache, chol->v));
-        PetscCall(VecSetRandomStandardNormal(chol->r, chol->prand));
-        PetscCall(VecAXPY(chol->v, 1., chol->r));
-        PetscCall(CholSamplerBackwardSolve(chol, chol->v, y));
+        PetscCall(PCCholSamplerFinishSample(pc, y));
       }
-      PetscCall(PCCholSamplerNotifySample(pc, y));
     }
   }
   *outits          = its;
@@ -386,8 +1230,18 @@ static PetscErrorCode PCView_CholSampler(PC pc, PetscViewer viewer)
   MatInfo        info;
 
   PetscFunctionBeginUser;
+  if (chol && chol->sct) PetscCall(PetscViewerASCIIPrintf(viewer, "Redundant: every rank holds the full factor\n"));
+  if (chol && chol->B) PetscCall(PetscViewerASCIIPrintf(viewer, "Low-rank part applied with a Woodbury update of rank %" PetscBLASInt_FMT "\n", chol->wb_k));
   if (chol && chol->dense_n) {
     PetscCall(PetscViewerASCIIPrintf(viewer, "Dense Cholesky factor for sequential block of size %" PetscBLASInt_FMT "\n", chol->dense_n));
+    if (chol->batch > 1) PetscCall(PetscViewerASCIIPrintf(viewer, "Samples computed in batches of %" PetscInt_FMT "\n", chol->batch));
+  } else if (chol && chol->ls) {
+    PetscInt nthreads = 1;
+
+#if defined(PARMGMC_HAVE_OPENMP)
+    nthreads = omp_get_max_threads();
+#endif
+    PetscCall(PetscViewerASCIIPrintf(viewer, "Level-scheduled triangular solves: %" PetscInt_FMT " nonzeros in factor, %" PetscInt_FMT " levels, %" PetscInt_FMT " threads\n", chol->ls->Lp[chol->ls->n], chol->ls->nlevels, nthreads));
   } else if (chol && chol->F) {
     PetscCall(MatGetInfo(chol->F, MAT_GLOBAL_SUM, &info));
     PetscCall(PetscViewerASCIIPrintf(viewer, "Nonzeros in factored matrix: allocated %f\n", info.nz_allocated));
@@ -400,21 +1254,336 @@ PetscErrorCode PCCholSamplerSetIsCoarseGAMG(PC pc, PetscBool flag)
   PC_CholSampler chol = pc->data;
 
   PetscFunctionBeginUser;
-  chol->is_gamg_coarse = flag;
+  // The redundant mode replaces the rank 0 extraction
+  chol->is_gamg_coarse = (PetscBool)(flag && !chol->redundant);
   if (flag) chol->st = PARMGMC_DEFAULT_SEQ_CHOLESKY;
   PetscFunctionReturn(PETSC_SUCCESS);
 }
 
+/** @brief Let every rank factorize the whole matrix and compute the whole
+    sample, so that the right hand side only needs to be gathered once and
+    the result is available on every rank without communication. The ranks
+    draw identical noise from a counter-based stream (see
+    VecSetRandomStandardNormalCounter()). Meant for small coarse problems.
+ */
+PetscErrorCode PCCholSamplerSetRedundant(PC pc, PetscBool flag)
+{
+  PC_CholSampler chol = pc->data;
+
+  PetscFunctionBeginUser;
+  chol->redundant = flag;
+  if (flag) {
+    chol->is_gamg_coarse = PETSC_FALSE;
+    chol->st             = PARMGMC_DEFAULT_SEQ_CHOLESKY;
+  }
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Compute `m` samples at a time when the sampler is applied more than
+    once per call (PCApplyRichardson() with more than one iteration) and the
+    factor is dense (see `-pc_cholsampler_dense_threshold`) or the built-in
+    level-scheduled factor (see PCCholSamplerSetLevelScheduling(), also on
+    the coarsest GAMG level). The backward solves of the m samples are then
+    done as one triangular solve with m right hand sides, which reads the
+    factor once instead of m times. The samples are identical to the ones
+    computed one at a time up to rounding. Default is 1.
+
+    A single application (one iteration) is never batched: each call has a
+    new right hand side, so its forward and backward solve cannot be shared
+    with other calls. PCGAMGMC sets the batch size of a Cholesky coarse
+    sampler to the number of coarse iterations.
+ */
+PetscErrorCode PCCholSamplerSetBatchSize(PC pc, PetscInt m)
+{
+  PC_CholSampler chol = pc->data;
+
+  PetscFunctionBeginUser;
+  PetscCheck(m >= 1, PetscObjectComm((PetscObject)pc), PETSC_ERR_ARG_OUTOFRANGE, "Batch size must be at least 1");
+  if (m != chol->batch) PetscCall(PetscFree(chol->blk));
+  chol->batch = m;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Get the batch size, see PCCholSamplerSetBatchSize(). */
+PetscErrorCode PCCholSamplerGetBatchSize(PC pc, PetscInt *m)
+{
+  PC_CholSampler chol = pc->data;
+
+  PetscFunctionBeginUser;
+  *m = chol->batch;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Factor sequential matrices (single rank, redundant mode, or the
+    coarsest GAMG level on rank 0) with a built-in sparse Cholesky
+    factorization in the nested dissection ordering instead of with
+    MatGetFactor(), and do the triangular solves level by level along the
+    elimination tree. The rows (columns) of one level are independent and
+    are distributed over the OpenMP threads of the rank if the library was
+    built with OpenMP, so that the coarse sample can use all cores of the
+    node while the other ranks wait. Default is PETSC_FALSE.
+ */
+PetscErrorCode PCCholSamplerSetLevelScheduling(PC pc, PetscBool flag)
+{
+  PC_CholSampler chol = pc->data;
+
+  PetscFunctionBeginUser;
+  chol->level_schedule = flag;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief For operators of type `MATLRC` (A + B S B^T), factor only A and
+    turn each sample of N(A^-1 b, A^-1) into a sample of the target
+    distribution with a Woodbury (Matheron) update that involves the k x k
+    capacitance matrix S^-1 + B^T A^-1 B. The factor is as sparse as that of
+    A, instead of coupling all unknowns in the support of each column of B.
+    The setup solves with the k columns of B once. Default is PETSC_FALSE,
+    i.e., the matrix A + B S B^T is assembled and factored.
+ */
+PetscErrorCode PCCholSamplerSetWoodbury(PC pc, PetscBool flag)
+{
+  PC_CholSampler chol = pc->data;
+
+  PetscFunctionBeginUser;
+  chol->woodbury = flag;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Computes y = M^-1 x with the factor, where M is the operator of the
+    sampler (including the low-rank part of a `MATLRC` operator), i.e., the
+    mean of the samples for the right hand side x.
+ */
+PetscErrorCode PCCholSamplerApplyInverse(PC pc, Vec x, Vec y)
+{
+  PC_CholSampler chol = pc->data;
+
+  PetscFunctionBeginUser;
+  if (!pc->setupcalled) PetscCall(PCSetUp(pc));
+  PetscCall(CholSamplerSolve(pc, x, y));
+  if (chol->B) PetscCall(CholSamplerWoodburyCorrect(pc, y, PETSC_FALSE));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+static void CholSamplerCountEntry(PetscInt r, PetscInt c, PetscInt rstart, PetscInt rend, PetscInt *dnnz, PetscInt *onnz)
+{
+  if (r < rstart || r >= rend) return;
+  if (c >= rstart && c < rend) dnnz[r - rstart]++;
+  else onnz[r - rstart]++;
+}
+
+/** @brief Computes the entries of the inverse of the operator M of the
+    sampler on the nonzero pattern of its Cholesky factor with the Takahashi
+    recursion (selected inversion), at roughly the cost of one factorization.
+    This includes the diagonal of M^-1, i.e., the exact marginal variances of
+    the samples (see PCCholSamplerGetVariance()). `Z` is returned as a
+    `MATAIJ` matrix with the layout of the operator. The pattern contains
+    that of M, so Z also contains every entry of M^-1 that couples two
+    unknowns which are coupled in M.
+
+    For `MATLRC` operators A + B S B^T (in Woodbury mode), Z is the selected
+    inverse of A and the dense matrix `V` (same row layout) is such that
+    M^-1 = A^-1 - V V^T; otherwise `V` is set to NULL. Both have to be
+    destroyed by the caller; `V` may be NULL if it is not needed.
+
+    Requires a sequential factor, i.e., a single rank, the redundant mode or
+    the coarse GAMG sampler. The factor of the built-in factorization (see
+    PCCholSamplerSetLevelScheduling()) and the dense factor are used directly;
+    otherwise the matrix is factored once more with the built-in
+    factorization, since the factors of external packages are not accessible.
+ */
+PetscErrorCode PCCholSamplerGetSelectedInverse(PC pc, Mat *Z, Mat *V)
+{
+  PC_CholSampler chol = pc->data;
+  MPI_Comm       comm = PetscObjectComm((PetscObject)pc);
+  CholLS         ls   = NULL;
+  PetscScalar   *Zx   = NULL;
+  PetscInt       m, mc, rstart, rend, off = 0, *dnnz, *onnz;
+  PetscMPIInt    size, rank;
+  PetscBool      has;
+
+  PetscFunctionBeginUser;
+  if (!pc->setupcalled) PetscCall(PCSetUp(pc));
+  PetscCallMPI(MPI_Comm_size(comm, &size));
+  PetscCallMPI(MPI_Comm_rank(comm, &rank));
+  PetscCheck(size == 1 || chol->sct || chol->is_gamg_coarse, comm, PETSC_ERR_SUP, "Selected inversion requires a sequential factor (single rank, redundant mode or coarse GAMG sampler)");
+  PetscCall(MatGetOwnershipRange(pc->pmat, &rstart, &rend));
+  PetscCall(MatGetLocalSize(pc->pmat, &m, &mc));
+  if (chol->is_gamg_coarse) off = rstart;
+  has = (PetscBool)(!chol->is_gamg_coarse || rank == 0);
+
+  if (has && chol->dense_n) {
+    PetscBLASInt info;
+
+    PetscCall(PetscMalloc1((size_t)chol->dense_n * chol->dense_n, &Zx));
+    PetscCall(PetscArraycpy(Zx, chol->dense_L, (size_t)chol->dense_n * chol->dense_n));
+    PetscCall(PetscFPTrapPush(PETSC_FP_TRAP_OFF));
+    PetscCallBLAS("LAPACKpotri", LAPACKpotri_("L", &chol->dense_n, Zx, &chol->dense_n, &info));
+    PetscCall(PetscFPTrapPop());
+    PetscCheck(info == 0, PETSC_COMM_SELF, PETSC_ERR_LIB, "LAPACK potri failed with error %" PetscBLASInt_FMT, info);
+  } else if (has) {
+    ls = chol->ls;
+    if (!ls) {
+      Mat       A = pc->pmat, S;
+      IS        rowperm, colperm;
+      PetscBool flag;
+
+      if (chol->B) PetscCall(MatLRCGetMats(pc->pmat, &A, NULL, NULL, NULL));
+      PetscCall(PetscObjectTypeCompare((PetscObject)A, MATLRC, &flag));
+      PetscCheck(!flag, PETSC_COMM_SELF, PETSC_ERR_SUP, "Selected inversion of an assembled low-rank update is not supported, use the Woodbury mode");
+      if (size != 1 && chol->is_gamg_coarse) {
+        PetscCall(MatMPIAIJGetSeqAIJ(A, &S, NULL, NULL));
+        PetscCall(PetscObjectReference((PetscObject)S));
+      } else if (chol->sct) {
+        Mat     *seqs;
+        IS       all;
+        PetscInt N;
+
+        PetscCall(MatGetSize(A, &N, NULL));
+        PetscCall(ISCreateStride(PETSC_COMM_SELF, N, 0, 1, &all));
+        PetscCall(MatCreateSubMatrices(A, 1, &all, &all, MAT_INITIAL_MATRIX, &seqs));
+        S = seqs[0];
+        PetscCall(PetscObjectReference((PetscObject)S));
+        PetscCall(MatDestroySubMatrices(1, &seqs));
+        PetscCall(ISDestroy(&all));
+      } else {
+        S = A;
+        PetscCall(PetscObjectReference((PetscObject)S));
+      }
+      PetscCall(PetscObjectTypeCompare((PetscObject)S, MATSEQAIJ, &flag));
+      PetscCheck(flag, PETSC_COMM_SELF, PETSC_ERR_SUP, "Selected inversion requires a MATSEQAIJ matrix");
+      PetscCall(MatGetOrdering(S, MATORDERINGMETISND, &rowperm, &colperm));
+      PetscCall(CholLSCreate(S, rowperm, &ls));
+      PetscCall(ISDestroy(&rowperm));
+      PetscCall(ISDestroy(&colperm));
+      PetscCall(MatDestroy(&S));
+    }
+    PetscCall(PetscMalloc1(ls->Lp[ls->n], &Zx));
+    PetscCall(CholLSSelectedInverse(ls, Zx));
+  }
+
+  // Z as a symmetric AIJ matrix; in redundant mode every rank inserts its own rows
+  PetscCall(PetscCalloc2(m, &dnnz, m, &onnz));
+  for (PetscInt pass = 0; pass < 2; ++pass) {
+    if (pass == 1) {
+      PetscCall(MatCreate(comm, Z));
+      PetscCall(MatSetSizes(*Z, m, mc, PETSC_DETERMINE, PETSC_DETERMINE));
+      PetscCall(MatSetType(*Z, MATAIJ));
+      PetscCall(MatXAIJSetPreallocation(*Z, 1, dnnz, onnz, NULL, NULL));
+    }
+    if (has && chol->dense_n) {
+      for (PetscInt j = 0; j < chol->dense_n; ++j) {
+        for (PetscInt i = j; i < chol->dense_n; ++i) {
+          const PetscInt r = i + off, c = j + off;
+
+          if (pass == 0) {
+            CholSamplerCountEntry(r, c, rstart, rend, dnnz, onnz);
+            if (i != j) CholSamplerCountEntry(c, r, rstart, rend, dnnz, onnz);
+          } else {
+            if (r >= rstart && r < rend) PetscCall(MatSetValue(*Z, r, c, Zx[i + (size_t)j * chol->dense_n], INSERT_VALUES));
+            if (i != j && c >= rstart && c < rend) PetscCall(MatSetValue(*Z, c, r, Zx[i + (size_t)j * chol->dense_n], INSERT_VALUES));
+          }
+        }
+      }
+    } else if (has) {
+      for (PetscInt j = 0; j < ls->n; ++j) {
+        for (PetscInt p = ls->Lp[j]; p < ls->Lp[j + 1]; ++p) {
+          const PetscInt r = ls->perm[ls->Li[p]] + off, c = ls->perm[j] + off;
+
+          if (pass == 0) {
+            CholSamplerCountEntry(r, c, rstart, rend, dnnz, onnz);
+            if (r != c) CholSamplerCountEntry(c, r, rstart, rend, dnnz, onnz);
+          } else {
+            if (r >= rstart && r < rend) PetscCall(MatSetValue(*Z, r, c, Zx[p], INSERT_VALUES));
+            if (r != c && c >= rstart && c < rend) PetscCall(MatSetValue(*Z, c, r, Zx[p], INSERT_VALUES));
+          }
+        }
+      }
+    }
+  }
+  PetscCall(MatAssemblyBegin(*Z, MAT_FINAL_ASSEMBLY));
+  PetscCall(MatAssemblyEnd(*Z, MAT_FINAL_ASSEMBLY));
+  PetscCall(PetscFree2(dnnz, onnz));
+  PetscCall(PetscFree(Zx));
+  if (ls != chol->ls) PetscCall(CholLSDestroy(&ls));
+
+  if (!V) PetscFunctionReturn(PETSC_SUCCESS);
+  *V = NULL;
+  if (chol->B) {
+    Mat          Vl;
+    PetscScalar *varr, one = 1.;
+    PetscInt     n, ldv;
+    PetscBLASInt bn, bldv;
+
+    // M^-1 = A^-1 - W C^-1 W^T = A^-1 - V V^T with V = W L_C^-T
+    if (!chol->W) PetscCall(CholSamplerSetUpWoodbury(pc));
+    PetscCall(MatDuplicate(chol->W, MAT_COPY_VALUES, V));
+    PetscCall(MatDenseGetLocalMatrix(*V, &Vl));
+    PetscCall(MatGetLocalSize(*V, &n, NULL));
+    PetscCall(MatDenseGetLDA(Vl, &ldv));
+    PetscCall(PetscBLASIntCast(n, &bn));
+    PetscCall(PetscBLASIntCast(ldv, &bldv));
+    if (n > 0) {
+      PetscCall(MatDenseGetArray(Vl, &varr));
+      PetscCallBLAS("BLAStrsm", BLAStrsm_("R", "L", "T", "N", &bn, &chol->wb_k, &one, chol->wb_C, &chol->wb_k, varr, &bldv));
+      PetscCall(MatDenseRestoreArray(Vl, &varr));
+    }
+  }
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Computes the exact marginal variances of the samples, i.e., the
+    diagonal of the inverse of the operator, from the Cholesky factor with
+    selected inversion, see PCCholSamplerGetSelectedInverse(). `var` must
+    have the row layout of the operator.
+ */
+PetscErrorCode PCCholSamplerGetVariance(PC pc, Vec var)
+{
+  Mat Z, V;
+
+  PetscFunctionBeginUser;
+  PetscCall(PCCholSamplerGetSelectedInverse(pc, &Z, &V));
+  PetscCall(MatGetDiagonal(Z, var));
+  if (V) {
+    Mat                Vl;
+    const PetscScalar *varr;
+    PetscScalar       *v;
+    PetscInt           n, k, ldv;
+
+    PetscCall(MatDenseGetLocalMatrix(V, &Vl));
+    PetscCall(MatGetLocalSize(V, &n, NULL));
+    PetscCall(MatGetSize(V, NULL, &k));
+    PetscCall(MatDenseGetLDA(Vl, &ldv));
+    PetscCall(MatDenseGetArrayRead(Vl, &varr));
+    PetscCall(VecGetArray(var, &v));
+    for (PetscInt j = 0; j < k; ++j)
+      for (PetscInt i = 0; i < n; ++i) v[i] -= varr[i + j * ldv] * varr[i + j * ldv];
+    PetscCall(VecRestoreArray(var, &v));
+    PetscCall(MatDenseRestoreArrayRead(Vl, &varr));
+  }
+  PetscCall(MatDestroy(&V));
+  PetscCall(MatDestroy(&Z));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
 static PetscErrorCode PCSetFromOptions_CholSampler(PC pc, PetscOptionItems_ARG PetscOptionsObject)
 {
   PC_CholSampler chol = pc->data;
   PetscBool      flag = PETSC_FALSE;
+  PetscInt       batch;
 
   PetscFunctionBeginUser;
   PetscOptionsHeadBegin(PetscOptionsObject, "Cholesky options");
   PetscCall(PetscOptionsBool("-pc_cholsampler_coarse_gamg", "Sampler is coarse GAMGMC sampler", NULL, flag, &flag, NULL));
   if (flag) PetscCall(PCCholSamplerSetIsCoarseGAMG(pc, PETSC_TRUE));
+  flag = chol->redundant;
+  PetscCall(PetscOptionsBool("-pc_cholsampler_redundant", "Every rank factorizes the whole matrix and computes the whole sample", "PCCholSamplerSetRedundant", flag, &flag, NULL));
+  PetscCall(PCCholSamplerSetRedundant(pc, flag));
   PetscCall(PetscOptionsInt("-pc_cholsampler_dense_threshold", "Sequential blocks of size <= this are factored and solved densely", NULL, chol->dense_threshold, &chol->dense_threshold, NULL));
+  PetscCall(PetscOptionsBool("-pc_cholsampler_level_schedule", "Use the built-in factorization with level-scheduled (threaded) triangular solves", "PCCholSamplerSetLevelScheduling", chol->level_schedule, &chol->level_schedule, NULL));
+  PetscCall(PetscOptionsBool("-pc_cholsampler_woodbury", "For MATLRC, factor only A and correct the samples for the low-rank part", "PCCholSamplerSetWoodbury", chol->woodbury, &chol->woodbury, NULL));
+  batch = chol->batch;
+  PetscCall(PetscOptionsInt("-pc_cholsampler_batch_size", "Number of samples computed with one triangular solve (dense or level-scheduled factor)", "PCCholSamplerSetBatchSize", batch, &batch, NULL));
+  PetscCall(PCCholSamplerSetBatchSize(pc, batch));
   PetscOptionsHeadEnd();
   PetscFunctionReturn(PETSC_SUCCESS);
 }
@@ -431,6 +1600,8 @@ PetscErrorCode PCCreate_CholSampler(PC pc)
   if (size == 1) chol->st = PARMGMC_DEFAULT_SEQ_CHOLESKY;
   else chol->st = PARMGMC_DEFAULT_PAR_CHOLESKY;
   chol->dense_threshold = 64;
+  chol->batch           = 1;
+  chol->woodbury        = PETSC_FALSE;
 
   pc->data                 = chol;
   pc->ops->destroy         = PCDestroy_CholSampler;
@@ -7,8 +7,12 @@
 */
 
 #include "parmgmc/pc/pc_gamgmc.h"
+#include "parmgmc/iact.h"
+#include "parmgmc/mc_sor.h"
 #include "parmgmc/parmgmc.h"
 #include "parmgmc/pc/pc_chols.h"
+#include "parmgmc/pc/pc_mcgibbs.h"
+#include "parmgmc/pc/pc_sorgibbs.h"
 
 #include <petsc/private/pcimpl.h>
 #include <petscerror.h>
@@ -19,6 +23,7 @@
 #include <petscstring.h>
 #include <petscsys.h>
 #include <petscsystypes.h>
+#include <petsctime.h>
 #include <petscvec.h>
 #include <petscviewertypes.h>
 #include <string.h>
@@ -31,6 +36,23 @@
     # Options databse keys
     - `-pc_gamgmc_mg_type` - The type of the underlying multigrid PC. Can be mg or gamg.
       Default is gamg (i.e. algebraic Multigrid Monte Carlo).
+    - `-pc_gamgmc_carry_residual` - Let the multigrid cycle act on the sample
+      directly instead of on the correction (default false, see below).
+    - `-pc_gamgmc_fused_residual` - Let the samplers compute the residual for the
+      restriction while smoothing (default false, see below).
+    - `-pc_gamgmc_agglomerate_eq_limit` - Move coarse levels with fewer than this
+      many rows per rank onto a sub-communicator (default 0, i.e., never; see below).
+    - `-pc_gamgmc_single_precision_levels` - Number of coarse levels whose
+      MulticolorGibbs samplers sweep in single precision (default 0, see below).
+    - `-pc_gamgmc_solve` - Use the hierarchy as a deterministic multigrid
+      preconditioner instead of as a sampler (default false, see below).
+    - `-pc_gamgmc_view_timing` - Log the time spent on each level and print
+      it with PCView() (default false, see below).
+    - `-pc_gamgmc_autotune` - Tune the cycle before the first sample is generated
+      with a greedy, level-by-level search (default false, see below).
+    - `-pc_gamgmc_autotune_samples` - Length of the pilot chains used for tuning
+      (default 200).
+    - `-pc_gamgmc_autotune_view` - Print the tuned configuration.
 
     # Notes
     
@@ -63,6 +85,98 @@
 
     The underlying PCGAMG preconditioner can also be extracted using the function
     `PCGAMGMCGetInternalPC(PC, PC*)`.
+
+    By default each iteration computes the fine-level residual b - A y and
+    applies one cycle to it to obtain the update of y. With
+    `-pc_gamgmc_carry_residual` (or PCGAMGMCSetCarryResidual()) the cycle is
+    instead run in PCMG's Richardson mode on y itself: the fine-level
+    smoothers sample in place, and the residual that the cycle computes after
+    pre-smoothing (which is needed for the restriction anyway) is the only
+    fine-level residual. This saves one fine-level operator application (for
+    `MATLRC` including the dense low-rank term) per sample.
+
+    With `-pc_gamgmc_fused_residual` (or PCGAMGMCSetFusedResidual()) the
+    residual b - A y that PCMG computes after smoothing on each level is taken
+    from the smoother, if it supports this (see PCSetFusedResidual()). The
+    MulticolorGibbs sampler computes it in the same pass over the matrix as
+    its last sweep. For other samplers the residual is computed as usual.
+
+    GAMG reduces the number of active ranks on coarse levels by leaving rows
+    empty, but the samplers on these levels still run on the full
+    communicator so that every rank takes part in every ghost exchange and
+    reduction. With `-pc_gamgmc_agglomerate_eq_limit n` (or
+    PCGAMGMCSetAgglomerationLimit()) each coarse level with N rows is instead
+    smoothed on a sub-communicator of max(1, N / n) ranks: the level matrix
+    (for `MATLRC` including the low-rank factor) is redistributed onto the
+    sub-communicator once during setup, and each application of the smoother
+    only scatters the right hand side and the sample there and back. The
+    sampler on the sub-communicator is configured with the options prefix of
+    the original smoother. On the coarsest level this lets the Cholesky
+    sampler factorize the matrix on a small team of ranks instead of on rank 0
+    alone.
+
+    With `-pc_gamgmc_single_precision_levels d` (or
+    PCGAMGMCSetSinglePrecisionLevels()) the MulticolorGibbs samplers on the d
+    coarsest levels (never on the finest level) read single precision copies
+    of their matrices and exchange their ghost values in single precision,
+    see PCMulticolorGibbsSetSinglePrecision(). The samples, the grid transfer
+    and the residuals stay in double precision, so the target distribution is
+    unchanged; only the coarse corrections are perturbed at the level of
+    single precision rounding.
+
+    The sampling hierarchy can also be used to solve linear systems with the
+    (posterior) precision matrix, e.g., to compute the posterior mean
+    \f$A^{-1} b\f$. PCGAMGMCGetSolverPC() returns a `PCMG` (options prefix
+    `gamgmc_solve_`) that shares the interpolations and the level operators
+    (for `MATLRC` the low-rank updated ones) with the sampler, but smooths
+    with symmetric multicolour SOR sweeps (see MCSORSetSweepType()) instead
+    of random ones. The coarse problem is solved directly, or with ten
+    symmetric sweeps if it is of type `MATLRC`. The cycle is symmetric, so it
+    can be used with CG; PCGAMGMCComputeMean() does exactly that (options
+    prefix `gamgmc_mean_`). The only additional setup cost is the colouring of
+    the level matrices. PCApply() always applies this deterministic cycle,
+    and with `-pc_gamgmc_solve` (or PCGAMGMCSetSolveMode()) it is also used by
+    `KSPRICHARDSON`, so that the PC can be used as a regular preconditioner.
+    The exact mean can also be used as a control variate for sample means:
+    averaging the samples minus the exact mean estimates zero, and its
+    deviation from zero is the sampling error.
+
+    With `-pc_gamgmc_view_timing` (or PCGAMGMCSetTiming()) the smoothing,
+    the residual computation, the restriction and the prolongation on every
+    level, and the sampling on the coarsest level, are logged as separate
+    events (named `GAMGMCSmooth l`, `GAMGMCResid l`, `GAMGMCRestr l`,
+    `GAMGMCProlong l` and `GAMGMCCoarse`) in the log stage `GAMGMC Cycle`.
+    They therefore also show up in `-log_view`. The events are only
+    recorded if PETSc logging is active, i.e., with `-log_view` or after
+    PetscLogDefaultBegin(); the PC does not start the logging itself. PCView()
+    (e.g., `-ksp_view`) prints a table with the time, the flop rate, the
+    volume of the messages sent per second and the share of all message
+    bytes of each event; the numbers can also be obtained with
+    PCGAMGMCGetLevelStats(). The events accumulate over all calls.
+
+    With `-pc_gamgmc_autotune` (or PCGAMGMCSetAutotune()) the cycle is tuned
+    at the beginning of the first PCApplyRichardson() call. Starting from the
+    configuration given in the options database, the number of levels (GAMG
+    only), the sampler on each level (MulticolorGibbs, or SORGibbs with the
+    plain, the pipelined or the node-aware PARSOR sweep), the number of
+    smoothing steps on each level and the cycle type (V or W) are varied one
+    at a time. The search is greedy: the levels are tuned one after the
+    other, and the best choice for one level is kept when the next level is
+    tuned, so not all combinations are tried. Each candidate is rated by the
+    wall time per independent sample, i.e., the time per cycle times the
+    integrated autocorrelation time of a quantity of interest measured on a
+    short pilot chain. The quantity of interest can be set with
+    PCGAMGMCSetAutotuneQOI(), the default is a random linear functional of
+    the sample. The pilot chains start from the initial guess but do not
+    modify it. The chosen
+    configuration can be obtained as options that reproduce it with
+    PCGAMGMCGetAutotunedOptions(). The F-cycle of PCMG is not considered
+    since it does not define a valid sampling iteration.
+
+    The marginal variances of the target distribution can be estimated with
+    PCGAMGMCEstimateVariance(), which computes the coarse part of the
+    variance exactly from the Cholesky factor of a `PCCHOLSAMPLER` coarse
+    level sampler and only samples the remainder on the finest level.
 */
 
 typedef struct _PC_GAMGMC {
@@ -71,12 +185,266 @@ typedef struct _PC_GAMGMC {
   Mat      *As; // The actual matrices used (in case of A+LR this differs from the matrices used to setup the multigrid hierarchy).
   Vec       work; // Holds the cycle correction M(b - A y) during the Richardson iteration.
   PetscBool setup_called;
+  PetscBool carry_residual;
+  PetscBool fused_residual;
+  Mat      *resmats; // Level matrices that carry a pointer to their smoother for PCGAMGMCResidual_Fused
+  PetscInt  nresmats;
+  PetscInt  nlevels; // Number of levels requested from PCGAMG, 0 = use options
+  PetscInt  agglo_eq_limit;
+  PetscInt  sp_levels;
+  PC       *agglopcs; // Smoothers that were replaced by agglomerated samplers (NULL if not agglomerated)
+  PetscInt  nagglopcs;
+
+  /* Solve mode */
+  PetscBool solve;
+  PC        solvepc; // Deterministic multigrid on the same hierarchy
+  KSP       meanksp;
+
+  /* Timing */
+  PetscBool      timing;
+  PetscLogStage  stage;
+  PetscLogEvent *ev; // PCGAMGMC_NPHASES events per level, -1 if the level has no such phase
+  PetscInt       nevlevels;
+  Mat           *timed; // Timed interpolations, NULL on the coarsest level
+  PetscInt       ntimed;
+
+  PetscBool autotune, autotune_view, tuned;
+  PetscInt  autotune_samples;
+  char      tuned_opts[2048];
+
+  char setup_save[PETSC_MAX_PATH_LEN], setup_load[PETSC_MAX_PATH_LEN]; // Files for ParMGMCMatSaveSetup/LoadSetup, empty = unused
+  void     *qoictx;
+  PetscErrorCode (*qoi)(PetscInt, Vec, PetscScalar *, void *);
 
   void *cbctx;
   PetscErrorCode (*scb)(PetscInt, Vec, void *);
   PetscErrorCode (*del_scb)(void *);
 } *PC_GAMGMC;
 
+static PetscErrorCode PCGAMGMCClearFusedResidual(PC_GAMGMC pg)
+{
+  PetscFunctionBeginUser;
+  for (PetscInt l = 0; l < pg->nresmats; ++l) {
+    if (!pg->resmats[l]) continue;
+    PetscCall(PetscObjectCompose((PetscObject)pg->resmats[l], "ParMGMCFusedResidualPC", NULL));
+    PetscCall(MatDestroy(&pg->resmats[l]));
+  }
+  PetscCall(PetscFree(pg->resmats));
+  pg->nresmats = 0;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* Residual function installed with PCMGSetResidual: use the residual that the
+   smoother computed in its last sweep if it is still valid for x and b. */
+static PetscErrorCode PCGAMGMCResidual_Fused(Mat A, Vec b, Vec x, Vec r)
+{
+  PetscContainer container;
+  PetscBool      valid = PETSC_FALSE;
+
+  PetscFunctionBeginUser;
+  PetscCall(PetscObjectQuery((PetscObject)A, "ParMGMCFusedResidualPC", (PetscObject *)&container));
+  if (container) {
+    PC pcs;
+
+    PetscCall(PetscContainerGetPointer(container, (void **)&pcs));
+    PetscCall(PCGetFusedResidual(pcs, b, x, r, &valid));
+  }
+  if (!valid) PetscCall(MatResidual(A, b, x, r));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* Per-level timing (PCGAMGMCSetTiming()). The smoothers are timed with
+   KSP pre- and post-solve hooks, the grid transfers by replacing the
+   interpolations in PCMG with MATSHELLs that forward to the original
+   matrices, and the residuals by the residual function below, which finds
+   its events through the MATSHELL composed with the level matrix. */
+typedef struct _PCGAMGMCTimedTransfer {
+  Mat           P;
+  PetscLogEvent resid, restr, prolong;
+} *PCGAMGMCTimedTransfer;
+
+static PetscErrorCode MatMult_GAMGMCTimed(Mat S, Vec x, Vec y)
+{
+  PCGAMGMCTimedTransfer tt;
+
+  PetscFunctionBeginUser;
+  PetscCall(MatShellGetContext(S, &tt));
+  PetscCall(PetscLogEventBegin(tt->prolong, tt->P, x, y, 0));
+  PetscCall(MatMult(tt->P, x, y));
+  PetscCall(PetscLogEventEnd(tt->prolong, tt->P, x, y, 0));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+static PetscErrorCode MatMultAdd_GAMGMCTimed(Mat S, Vec x, Vec y, Vec z)
+{
+  PCGAMGMCTimedTransfer tt;
+
+  PetscFunctionBeginUser;
+  PetscCall(MatShellGetContext(S, &tt));
+  PetscCall(PetscLogEventBegin(tt->prolong, tt->P, x, y, z));
+  PetscCall(MatMultAdd(tt->P, x, y, z));
+  PetscCall(PetscLogEventEnd(tt->prolong, tt->P, x, y, z));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+static PetscErrorCode MatMultTranspose_GAMGMCTimed(Mat S, Vec x, Vec y)
+{
+  PCGAMGMCTimedTransfer tt;
+
+  PetscFunctionBeginUser;
+  PetscCall(MatShellGetContext(S, &tt));
+  PetscCall(PetscLogEventBegin(tt->restr, tt->P, x, y, 0));
+  PetscCall(MatMultTranspose(tt->P, x, y));
+  PetscCall(PetscLogEventEnd(tt->restr, tt->P, x, y, 0));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+static PetscErrorCode MatMultTransposeAdd_GAMGMCTimed(Mat S, Vec x, Vec y, Vec z)
+{
+  PCGAMGMCTimedTransfer tt;
+
+  PetscFunctionBeginUser;
+  PetscCall(MatShellGetContext(S, &tt));
+  PetscCall(PetscLogEventBegin(tt->restr, tt->P, x, y, z));
+  PetscCall(MatMultTransposeAdd(tt->P, x, y, z));
+  PetscCall(PetscLogEventEnd(tt->restr, tt->P, x, y, z));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+#if PETSC_VERSION_LT(3, 24, 0)
+  #define PCGAMGMC_SHELLOP(f) ((void (*)(void))(f))
+#else
+  #define PCGAMGMC_SHELLOP(f) ((PetscErrorCodeFn *)(f))
+#endif
+
+#if PETSC_VERSION_LT(3, 23, 0)
+static PetscErrorCode PCGAMGMCTimedTransferDestroy(void *ctx)
+{
+  PCGAMGMCTimedTransfer tt = ctx;
+#else
+static PetscErrorCode PCGAMGMCTimedTransferDestroy(void **ctx)
+{
+  PCGAMGMCTimedTransfer tt = *ctx;
+#endif
+
+  PetscFunctionBeginUser;
+  PetscCall(MatDestroy(&tt->P));
+  PetscCall(PetscFree(tt));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+static PetscErrorCode PCGAMGMCResidual_Timed(Mat A, Vec b, Vec x, Vec r)
+{
+  Mat                   S = NULL;
+  PCGAMGMCTimedTransfer tt;
+
+  PetscFunctionBeginUser;
+  PetscCall(PetscObjectQuery((PetscObject)A, "ParMGMCTimedTransfer", (PetscObject *)&S));
+  if (!S) {
+    PetscCall(PCGAMGMCResidual_Fused(A, b, x, r));
+    PetscFunctionReturn(PETSC_SUCCESS);
+  }
+  PetscCall(MatShellGetContext(S, &tt));
+  PetscCall(PetscLogEventBegin(tt->resid, A, b, x, r));
+  PetscCall(PCGAMGMCResidual_Fused(A, b, x, r));
+  PetscCall(PetscLogEventEnd(tt->resid, A, b, x, r));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+static PetscErrorCode PCGAMGMCTimingPreSolve(KSP ksp, Vec b, Vec x, void *ctx)
+{
+  PetscFunctionBeginUser;
+  PetscCall(PetscLogEventBegin(*(PetscLogEvent *)ctx, ksp, b, x, 0));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+static PetscErrorCode PCGAMGMCTimingPostSolve(KSP ksp, Vec b, Vec x, void *ctx)
+{
+  PetscFunctionBeginUser;
+  PetscCall(PetscLogEventEnd(*(PetscLogEvent *)ctx, ksp, b, x, 0));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* Removes the timing hooks and puts the original interpolations back */
+static PetscErrorCode PCGAMGMCClearTiming(PC_GAMGMC pg)
+{
+  PetscFunctionBeginUser;
+  if (!pg->timed) PetscFunctionReturn(PETSC_SUCCESS);
+  for (PetscInt l = 0; l < pg->ntimed; ++l) {
+    KSP ksps;
+
+    PetscCall(PCMGGetSmoother(pg->mg, l, &ksps));
+    PetscCall(KSPSetPreSolve(ksps, NULL, NULL));
+    PetscCall(KSPSetPostSolve(ksps, NULL, NULL));
+    if (pg->timed[l]) {
+      PCGAMGMCTimedTransfer tt;
+      Mat                   Al;
+
+      PetscCall(MatShellGetContext(pg->timed[l], &tt));
+      PetscCall(KSPGetOperators(ksps, &Al, NULL));
+      PetscCall(PetscObjectCompose((PetscObject)Al, "ParMGMCTimedTransfer", NULL));
+      PetscCall(PCMGSetInterpolation(pg->mg, l, tt->P));
+      PetscCall(PCMGSetRestriction(pg->mg, l, tt->P));
+      PetscCall(PCMGSetResidual(pg->mg, l, PCGAMGMCResidual_Fused, Al));
+      PetscCall(MatDestroy(&pg->timed[l]));
+    }
+  }
+  PetscCall(PetscFree(pg->timed));
+  pg->ntimed = 0;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* An agglomerated level sampler: the sampler runs on a sub-communicator of
+   the first nranks ranks, which own the rows of the level in contiguous
+   blocks. The smoother's PC is replaced by a PCSHELL that scatters the
+   vectors to this distribution and back. */
+typedef struct _PCGAMGMCAgglo {
+  MPI_Comm    subcomm; // MPI_COMM_NULL on ranks that do not take part
+  PetscMPIInt nranks;
+  char        type[64]; // Type of the sampler that was replaced
+  KSP         ksp;      // Sampler on the sub-communicator
+  Vec         bred, xred; // Vectors on the full communicator with the agglomerated layout
+  Vec         bsub, xsub; // The same vectors on the sub-communicator (share their arrays)
+  VecScatter  sct;
+} *PCGAMGMCAgglo;
+
+static PetscErrorCode PCGAMGMCAggloDestroy(PC pc)
+{
+  PCGAMGMCAgglo ag;
+
+  PetscFunctionBeginUser;
+  PetscCall(PCShellGetContext(pc, &ag));
+  PetscCall(KSPDestroy(&ag->ksp));
+  PetscCall(VecDestroy(&ag->bsub));
+  PetscCall(VecDestroy(&ag->xsub));
+  PetscCall(VecDestroy(&ag->bred));
+  PetscCall(VecDestroy(&ag->xred));
+  PetscCall(VecScatterDestroy(&ag->sct));
+  if (ag->subcomm != MPI_COMM_NULL) PetscCallMPI(MPI_Comm_free(&ag->subcomm));
+  PetscCall(PetscFree(ag));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* Puts the original samplers back in place of the agglomerated ones, so that
+   a new setup starts from the configuration given in the options. */
+static PetscErrorCode PCGAMGMCClearAgglomeration(PC_GAMGMC pg)
+{
+  PetscFunctionBeginUser;
+  for (PetscInt l = 0; l < pg->nagglopcs; ++l) {
+    PCGAMGMCAgglo ag;
+    char          type[64];
+
+    if (!pg->agglopcs[l]) continue;
+    PetscCall(PCShellGetContext(pg->agglopcs[l], &ag));
+    PetscCall(PetscStrncpy(type, ag->type, sizeof(type)));
+    PetscCall(PCSetType(pg->agglopcs[l], type));
+    PetscCall(PCDestroy(&pg->agglopcs[l]));
+  }
+  PetscCall(PetscFree(pg->agglopcs));
+  pg->nagglopcs = 0;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
 static PetscErrorCode PCDestroy_GAMGMC(PC pc)
 {
   PC_GAMGMC pg = pc->data;
@@ -84,6 +452,12 @@ static PetscErrorCode PCDestroy_GAMGMC(PC pc)
 
   PetscFunctionBeginUser;
   if (pg->del_scb) PetscCall(pg->del_scb(pg->cbctx));
+  PetscCall(PCGAMGMCClearTiming(pg));
+  PetscCall(PetscFree(pg->ev));
+  PetscCall(PCGAMGMCClearFusedResidual(pg));
+  PetscCall(PCGAMGMCClearAgglomeration(pg));
+  PetscCall(PCDestroy(&pg->solvepc));
+  PetscCall(KSPDestroy(&pg->meanksp));
   if (pg->As) {
     PetscCall(PCMGGetLevels(pg->mg, &levels));
     for (PetscInt l = 0; l < levels - 1; ++l) PetscCall(MatDestroy(&(pg->As[l])));
@@ -101,6 +475,7 @@ static PetscErrorCode PCReset_GAMGMC(PC pc)
   PetscInt  levels;
 
   PetscFunctionBeginUser;
+  PetscCall(PCGAMGMCClearTiming(pg));
   if (pg->As) {
     PetscCall(PCMGGetLevels(pg->mg, &levels));
     for (PetscInt l = 0; l < levels - 1; ++l) PetscCall(MatDestroy(&(pg->As[l])));
@@ -108,6 +483,10 @@ static PetscErrorCode PCReset_GAMGMC(PC pc)
     pg->As = NULL;
   }
   PetscCall(VecDestroy(&pg->work));
+  PetscCall(PCGAMGMCClearFusedResidual(pg));
+  PetscCall(PCGAMGMCClearAgglomeration(pg));
+  PetscCall(PCDestroy(&pg->solvepc));
+  PetscCall(KSPDestroy(&pg->meanksp));
   PetscCall(PCReset(pg->mg));
   pg->setup_called = PETSC_FALSE;
   PetscFunctionReturn(PETSC_SUCCESS);
@@ -133,6 +512,99 @@ PetscErrorCode PCGAMGMCSetInternalPC(PC pc, PC mg)
   PetscFunctionReturn(PETSC_SUCCESS);
 }
 
+/** @brief Run the multigrid cycle in PCMG's Richardson mode on the sample
+    itself, so that the fine-level residual is only computed inside the
+    cycle. Default is PETSC_FALSE.
+ */
+PetscErrorCode PCGAMGMCSetCarryResidual(PC pc, PetscBool flg)
+{
+  PC_GAMGMC pg = pc->data;
+
+  PetscFunctionBeginUser;
+  pg->carry_residual = flg;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Take the residual that PCMG restricts to the next coarser level
+    from the smoother, which computes it in the same pass over the matrix as
+    its last sweep (if supported, see PCSetFusedResidual()). Must be called
+    before the first sample is generated. Default is PETSC_FALSE.
+ */
+PetscErrorCode PCGAMGMCSetFusedResidual(PC pc, PetscBool flg)
+{
+  PC_GAMGMC pg = pc->data;
+
+  PetscFunctionBeginUser;
+  pg->fused_residual = flg;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Smooth coarse levels with N rows on a sub-communicator of
+    max(1, N / limit) ranks. Must be called before the first sample is
+    generated. Default is 0 (no agglomeration).
+ */
+PetscErrorCode PCGAMGMCSetAgglomerationLimit(PC pc, PetscInt limit)
+{
+  PC_GAMGMC pg = pc->data;
+
+  PetscFunctionBeginUser;
+  pg->agglo_eq_limit = limit;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Let the MulticolorGibbs samplers on the given number of coarsest
+    levels (excluding the finest level) sweep in single precision. Must be
+    called before the first sample is generated. Default is 0.
+ */
+PetscErrorCode PCGAMGMCSetSinglePrecisionLevels(PC pc, PetscInt levels)
+{
+  PC_GAMGMC pg = pc->data;
+
+  PetscFunctionBeginUser;
+  pg->sp_levels = levels;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Tune the number of levels, the samplers, the number of smoothing
+    steps and the cycle type before the first sample is generated. Default is
+    PETSC_FALSE.
+ */
+PetscErrorCode PCGAMGMCSetAutotune(PC pc, PetscBool flg)
+{
+  PC_GAMGMC pg = pc->data;
+
+  PetscFunctionBeginUser;
+  pg->autotune = flg;
+  pg->tuned    = PETSC_FALSE;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Set the quantity of interest whose integrated autocorrelation time
+    is used to rate configurations during autotuning. The callback is called
+    with the index of the sample in the pilot chain and the sample.
+ */
+PetscErrorCode PCGAMGMCSetAutotuneQOI(PC pc, PetscErrorCode (*qoi)(PetscInt, Vec, PetscScalar *, void *), void *ctx)
+{
+  PC_GAMGMC pg = pc->data;
+
+  PetscFunctionBeginUser;
+  pg->qoi    = qoi;
+  pg->qoictx = ctx;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Get the options that reproduce the configuration chosen by the
+    autotuner (empty if autotuning has not run yet).
+ */
+PetscErrorCode PCGAMGMCGetAutotunedOptions(PC pc, const char **opts)
+{
+  PC_GAMGMC pg = pc->data;
+
+  PetscFunctionBeginUser;
+  *opts = pg->tuned_opts;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
 PetscErrorCode PCGAMGMCSetLevels(PC pc, PetscInt levels)
 {
   PC_GAMGMC pg = pc->data;
@@ -142,6 +614,217 @@ PetscErrorCode PCGAMGMCSetLevels(PC pc, PetscInt levels)
   PetscFunctionReturn(PETSC_SUCCESS);
 }
 
+static PetscErrorCode PCGAMGMC_SetUpFusedResidual(PC pc)
+{
+  PC_GAMGMC pg = pc->data;
+  PetscInt  levels;
+
+  PetscFunctionBeginUser;
+  PetscCall(PCMGGetLevels(pg->mg, &levels));
+  PetscCall(PetscCalloc1(levels, &pg->resmats));
+  pg->nresmats = levels;
+  // No residual is computed on the coarsest level
+  for (PetscInt l = 1; l < levels; ++l) {
+    KSP            ksps;
+    PC             pcs;
+    Mat            Al;
+    PetscContainer container;
+    PetscErrorCode (*f)(PC, PetscBool);
+
+    PetscCall(PCMGGetSmoother(pg->mg, l, &ksps));
+    PetscCall(KSPGetPC(ksps, &pcs));
+    PetscCall(PetscObjectQueryFunction((PetscObject)pcs, "PCSetFusedResidual_C", &f));
+    if (!f) {
+      PetscCall(PetscInfo(pc, "Smoother on level %" PetscInt_FMT " cannot compute fused residuals\n", l));
+      continue;
+    }
+    PetscCall(PCSetFusedResidual(pcs, PETSC_TRUE));
+
+    PetscCall(KSPGetOperators(ksps, &Al, NULL));
+    PetscCall(PetscContainerCreate(PETSC_COMM_SELF, &container));
+    PetscCall(PetscContainerSetPointer(container, pcs));
+    PetscCall(PetscObjectCompose((PetscObject)Al, "ParMGMCFusedResidualPC", (PetscObject)container));
+    PetscCall(PetscContainerDestroy(&container));
+    PetscCall(PetscObjectReference((PetscObject)Al));
+    pg->resmats[l] = Al;
+
+    PetscCall(PCMGSetResidual(pg->mg, l, PCGAMGMCResidual_Fused, Al));
+  }
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+static PetscErrorCode PCApplyRichardson_GAMGMCAgglo(PC pc, Vec b, Vec x, Vec w, PetscReal rtol, PetscReal abstol, PetscReal dtol, PetscInt its, PetscBool guesszero, PetscInt *outits, PCRichardsonConvergedReason *reason)
+{
+  (void)w;
+  (void)rtol;
+  (void)abstol;
+  (void)dtol;
+
+  PCGAMGMCAgglo ag;
+
+  PetscFunctionBeginUser;
+  PetscCall(PCShellGetContext(pc, &ag));
+  PetscCall(VecScatterBegin(ag->sct, b, ag->bred, INSERT_VALUES, SCATTER_FORWARD));
+  PetscCall(VecScatterEnd(ag->sct, b, ag->bred, INSERT_VALUES, SCATTER_FORWARD));
+  if (!guesszero) {
+    PetscCall(VecScatterBegin(ag->sct, x, ag->xred, INSERT_VALUES, SCATTER_FORWARD));
+    PetscCall(VecScatterEnd(ag->sct, x, ag->xred, INSERT_VALUES, SCATTER_FORWARD));
+  }
+
+  if (ag->ksp) {
+    const PetscScalar *barr;
+    PetscScalar       *xarr;
+
+    PetscCall(VecGetArrayRead(ag->bred, &barr));
+    PetscCall(VecGetArray(ag->xred, &xarr));
+    PetscCall(VecPlaceArray(ag->bsub, barr));
+    PetscCall(VecPlaceArray(ag->xsub, xarr));
+    PetscCall(KSPSetInitialGuessNonzero(ag->ksp, !guesszero));
+    PetscCall(KSPSetTolerances(ag->ksp, PETSC_DEFAULT, PETSC_DEFAULT, PETSC_DEFAULT, its));
+    PetscCall(KSPSolve(ag->ksp, ag->bsub, ag->xsub));
+    PetscCall(VecResetArray(ag->xsub));
+    PetscCall(VecResetArray(ag->bsub));
+    PetscCall(VecRestoreArray(ag->xred, &xarr));
+    PetscCall(VecRestoreArrayRead(ag->bred, &barr));
+  }
+
+  PetscCall(VecScatterBegin(ag->sct, ag->xred, x, INSERT_VALUES, SCATTER_REVERSE));
+  PetscCall(VecScatterEnd(ag->sct, ag->xred, x, INSERT_VALUES, SCATTER_REVERSE));
+  *outits = its;
+  *reason = PCRICHARDSON_CONVERGED_ITS;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+static PetscErrorCode PCApply_GAMGMCAgglo(PC pc, Vec b, Vec x)
+{
+  PetscInt                    its;
+  PCRichardsonConvergedReason reason;
+
+  PetscFunctionBeginUser;
+  PetscCall(PCApplyRichardson_GAMGMCAgglo(pc, b, x, NULL, 0, 0, 0, 1, PETSC_TRUE, &its, &reason));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+static PetscErrorCode PCView_GAMGMCAgglo(PC pc, PetscViewer v)
+{
+  PCGAMGMCAgglo ag;
+
+  PetscFunctionBeginUser;
+  PetscCall(PCShellGetContext(pc, &ag));
+  PetscCall(PetscViewerASCIIPrintf(v, "%s sampler agglomerated onto %d rank(s)\n", ag->type, ag->nranks));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* Redistributes the level matrix of the smoother ksps onto the first nranks
+   ranks and replaces the smoother's sampler by one that runs there. */
+static PetscErrorCode PCGAMGMC_AgglomerateLevel(KSP ksps, PetscMPIInt nranks, PC *aggpc)
+{
+  MPI_Comm      comm = PetscObjectComm((PetscObject)ksps);
+  PetscMPIInt   rank;
+  PCGAMGMCAgglo ag;
+  PC            pcs;
+  PCType        ptype;
+  Mat           A, P, Asub = NULL;
+  Vec           x;
+  PetscInt      N, nloc;
+  PetscBool     islrc;
+  const char   *prefix;
+
+  PetscFunctionBeginUser;
+  PetscCallMPI(MPI_Comm_rank(comm, &rank));
+  PetscCall(KSPGetOperators(ksps, &A, NULL));
+  PetscCall(KSPGetPC(ksps, &pcs));
+  PetscCall(PCGetType(pcs, &ptype));
+  PetscCall(PetscObjectTypeCompare((PetscObject)A, MATLRC, &islrc));
+  if (islrc) PetscCall(MatLRCGetMats(A, &P, NULL, NULL, NULL));
+  else P = A;
+
+  PetscCall(PetscNew(&ag));
+  ag->nranks = nranks;
+  PetscCall(PetscStrncpy(ag->type, ptype, sizeof(ag->type)));
+  PetscCallMPI(MPI_Comm_split(comm, rank < nranks ? 0 : MPI_UNDEFINED, rank, &ag->subcomm));
+
+  // Contiguous blocks of rows on the first nranks ranks, so the global ordering is kept
+  PetscCall(MatGetSize(P, &N, NULL));
+  nloc = rank < nranks ? N / nranks + (rank < N % nranks) : 0;
+
+  PetscCall(VecCreateMPI(comm, nloc, N, &ag->xred));
+  PetscCall(VecDuplicate(ag->xred, &ag->bred));
+  PetscCall(MatCreateVecs(P, &x, NULL));
+  PetscCall(VecScatterCreate(x, NULL, ag->xred, NULL, &ag->sct));
+  PetscCall(VecDestroy(&x));
+
+  PetscCall(ParMGMCMatRedistribute(A, ag->subcomm, nloc, nloc, &Asub));
+
+  if (ag->subcomm != MPI_COMM_NULL) {
+    PC        pcsub;
+    PetscBool ischol;
+
+    // The vectors only provide the layout, the arrays are placed during apply
+    PetscCall(VecCreateMPIWithArray(ag->subcomm, 1, nloc, N, NULL, &ag->xsub));
+    PetscCall(VecCreateMPIWithArray(ag->subcomm, 1, nloc, N, NULL, &ag->bsub));
+
+    PetscCall(KSPCreate(ag->subcomm, &ag->ksp));
+    PetscCall(KSPGetOptionsPrefix(ksps, &prefix));
+    PetscCall(KSPSetOptionsPrefix(ag->ksp, prefix));
+    PetscCall(KSPSetType(ag->ksp, KSPRICHARDSON));
+    PetscCall(KSPSetNormType(ag->ksp, KSP_NORM_NONE));
+    PetscCall(KSPSetConvergenceTest(ag->ksp, KSPConvergedSkip, NULL, NULL));
+    PetscCall(KSPSetOperators(ag->ksp, Asub, Asub));
+    PetscCall(KSPGetPC(ag->ksp, &pcsub));
+    PetscCall(PCSetType(pcsub, ag->type));
+    PetscCall(KSPSetFromOptions(ag->ksp));
+    // The rows are distributed over the sub-communicator, not gathered on its first rank
+    PetscCall(PetscObjectTypeCompare((PetscObject)pcsub, PCCHOLSAMPLER, &ischol));
+    if (ischol) PetscCall(PCCholSamplerSetIsCoarseGAMG(pcsub, PETSC_FALSE));
+    PetscCall(KSPSetUp(ag->ksp));
+    PetscCall(MatDestroy(&Asub));
+  }
+
+  PetscCall(PCSetType(pcs, PCSHELL));
+  PetscCall(PCShellSetName(pcs, "agglomerated sampler"));
+  PetscCall(PCShellSetContext(pcs, ag));
+  PetscCall(PCShellSetApply(pcs, PCApply_GAMGMCAgglo));
+  PetscCall(PCShellSetApplyRichardson(pcs, PCApplyRichardson_GAMGMCAgglo));
+  PetscCall(PCShellSetView(pcs, PCView_GAMGMCAgglo));
+  PetscCall(PCShellSetDestroy(pcs, PCGAMGMCAggloDestroy));
+  PetscCall(KSPSetUp(ksps));
+
+  PetscCall(PetscObjectReference((PetscObject)pcs));
+  *aggpc = pcs;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+static PetscErrorCode PCGAMGMC_SetUpAgglomeration(PC pc)
+{
+  PC_GAMGMC   pg = pc->data;
+  PetscMPIInt size;
+  PetscInt    levels;
+
+  PetscFunctionBeginUser;
+  PetscCallMPI(MPI_Comm_size(PetscObjectComm((PetscObject)pc), &size));
+  PetscCall(PCMGGetLevels(pg->mg, &levels));
+  PetscCall(PetscCalloc1(levels, &pg->agglopcs));
+  pg->nagglopcs = levels;
+  // The finest level is never agglomerated
+  for (PetscInt l = 0; l < levels - 1; ++l) {
+    KSP         ksps;
+    Mat         Al;
+    PetscInt    N;
+    PetscMPIInt nranks;
+
+    PetscCall(PCMGGetSmoother(pg->mg, l, &ksps));
+    PetscCall(KSPGetOperators(ksps, &Al, NULL));
+    PetscCall(MatGetSize(Al, &N, NULL));
+    nranks = (PetscMPIInt)PetscMax(1, PetscMin(size, N / pg->agglo_eq_limit));
+    if (nranks == size) continue;
+
+    PetscCall(PetscInfo(pc, "Agglomerating level %" PetscInt_FMT " (%" PetscInt_FMT " rows) onto %d rank(s)\n", l, N, nranks));
+    PetscCall(PCGAMGMC_AgglomerateLevel(ksps, nranks, &pg->agglopcs[l]));
+  }
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
 static PetscErrorCode PCGAMGMC_SetUpHierarchy(PC pc)
 {
   PetscInt  levels;
@@ -195,11 +878,26 @@ static PetscErrorCode PCGAMGMC_SetUpHierarchy(PC pc)
     }
   }
 
+  if (pg->agglo_eq_limit > 0) PetscCall(PCGAMGMC_SetUpAgglomeration(pc));
+
+  for (PetscInt l = 0; l < PetscMin(pg->sp_levels, levels - 1); ++l) {
+    KSP       ksps;
+    PC        pcs;
+    PetscBool ismc;
+
+    PetscCall(PCMGGetSmoother(pg->mg, l, &ksps));
+    PetscCall(KSPGetPC(ksps, &pcs));
+    PetscCall(PetscObjectTypeCompare((PetscObject)pcs, PCMCGIBBS, &ismc));
+    if (ismc) PetscCall(PCMulticolorGibbsSetSinglePrecision(pcs, PETSC_TRUE));
+    else PetscCall(PetscInfo(pc, "Sampler on level %" PetscInt_FMT " has no single precision mode\n", l));
+  }
+
   {
     KSP       ksps;
     PC        pcs;
     PCType    ptype;
     PetscBool ischol;
+    PetscInt  maxits, batch;
     Mat       A;
 
     PetscCall(PCMGGetSmoother(pg->mg, 0, &ksps));
@@ -219,80 +917,666 @@ static PetscErrorCode PCGAMGMC_SetUpHierarchy(PC pc)
       PetscCall(KSPSetOperators(ksps, A, A));
       PetscCall(PCSetUp(pcs));
       PetscCall(PetscObjectDereference((PetscObject)A));
+
+      // Several coarse iterations per cycle share one multi-RHS backward solve
+      PetscCall(KSPGetTolerances(ksps, NULL, NULL, NULL, &maxits));
+      PetscCall(PCCholSamplerGetBatchSize(pcs, &batch));
+      if (maxits > 1 && batch == 1) PetscCall(PCCholSamplerSetBatchSize(pcs, maxits));
     }
   }
+
+  if (pg->fused_residual) PetscCall(PCGAMGMC_SetUpFusedResidual(pc));
   PetscFunctionReturn(PETSC_SUCCESS);
 }
 
-static PetscErrorCode PCApplyRichardson_GAMGMC(PC pc, Vec b, Vec y, Vec w, PetscReal rtol, PetscReal abstol, PetscReal dtol, PetscInt its, PetscBool guesszero, PetscInt *outits, PCRichardsonConvergedReason *reason)
+static PetscErrorCode PCApply_GAMGMCSmoother(PC pc, Vec b, Vec y)
 {
-  (void)rtol;
-  (void)abstol;
-  (void)dtol;
-
-  PC_GAMGMC pg = pc->data;
+  MCSOR mc;
 
   PetscFunctionBeginUser;
-  if (!pg->setup_called) {
-    PetscCall(PCGAMGMC_SetUpHierarchy(pc));
-    pg->setup_called = PETSC_TRUE;
-  }
-  if (!pg->work) PetscCall(MatCreateVecs(pc->mat, &pg->work, NULL));
-
-  for (PetscInt it = 0; it < its; ++it) {
-    if (it == 0 && guesszero) {
-      /* From a zero initial guess the residual is just b, so one cycle gives
-         y = M b directly. */
-      PetscCall(PCApply(pg->mg, b, y));
-    } else {
-      /* Richardson sampling update carrying the state forward:
-             y <- y + M (b - A y).
-         Applying the cycle to the raw rhs b every iteration (y <- M b) instead
-         leaves the chain at a single cycle's approximation of A^{-1} b, which
-         biases the sample mean (most visibly in the smooth modes). */
-      PetscCall(MatMult(pc->mat, y, w));
-      PetscCall(VecAYPX(w, -1., b));
-      PetscCall(PCApply(pg->mg, w, pg->work));
-      PetscCall(VecAXPY(y, 1., pg->work));
-    }
-    if (pg->scb) PetscCall(pg->scb(it, y, pg->cbctx));
-  }
-
-  *outits = its;
-  *reason = PCRICHARDSON_CONVERGED_ITS;
+  PetscCall(PCShellGetContext(pc, &mc));
+  PetscCall(VecZeroEntries(y));
+  PetscCall(MCSORApply(mc, b, y));
   PetscFunctionReturn(PETSC_SUCCESS);
 }
 
-static PetscErrorCode PCView_GAMGMC(PC pc, PetscViewer v)
+static PetscErrorCode PCDestroy_GAMGMCSmoother(PC pc)
 {
-  PC_GAMGMC pg = pc->data;
+  MCSOR mc;
 
   PetscFunctionBeginUser;
-  PetscCall(PCView(pg->mg, v));
+  PetscCall(PCShellGetContext(pc, &mc));
+  PetscCall(MCSORDestroy(&mc));
   PetscFunctionReturn(PETSC_SUCCESS);
 }
 
-static PetscErrorCode PCSetUp_GAMGMC(PC pc)
+/* Builds the deterministic multigrid method on the sampling hierarchy (see
+   PCGAMGMCGetSolverPC()) */
+static PetscErrorCode PCGAMGMCSetUpSolver(PC pc)
 {
   PC_GAMGMC   pg = pc->data;
-  MatType     type;
-  Mat         P;
-  PetscBool   islrc;
+  PetscInt    levels;
   const char *prefix;
 
   PetscFunctionBeginUser;
-  PetscCall(PCSetType(pg->mg, pg->mgtype));
-  PetscCall(PCGetOptionsPrefix(pc, &prefix));
-  PetscCall(PCSetOptionsPrefix(pg->mg, prefix));
-  PetscCall(PCAppendOptionsPrefix(pg->mg, "gamgmc_"));
+  if (!pg->setup_called) {
+    PetscCall(PCGAMGMC_SetUpHierarchy(pc));
+    pg->setup_called = PETSC_TRUE;
+  }
+
+  PetscCall(PCMGGetLevels(pg->mg, &levels));
+  PetscCall(PCCreate(PetscObjectComm((PetscObject)pc), &pg->solvepc));
+  PetscCall(PCSetType(pg->solvepc, PCMG));
+  PetscCall(PCGetOptionsPrefix(pc, &prefix));
+  PetscCall(PCSetOptionsPrefix(pg->solvepc, prefix));
+  PetscCall(PCAppendOptionsPrefix(pg->solvepc, "gamgmc_solve_"));
+  PetscCall(PCMGSetLevels(pg->solvepc, levels, NULL));
+  PetscCall(PCMGSetGalerkin(pg->solvepc, PC_MG_GALERKIN_NONE));
+  for (PetscInt l = 0; l < levels; ++l) {
+    KSP       ksps, kspd;
+    PC        pcd;
+    Mat       Al, Ip;
+    PetscBool islrc;
+
+    // KSPGetOperators also works on levels whose sampler was agglomerated
+    PetscCall(PCMGGetSmoother(pg->mg, l, &ksps));
+    PetscCall(KSPGetOperators(ksps, &Al, NULL));
+    PetscCall(PCMGGetSmoother(pg->solvepc, l, &kspd));
+    PetscCall(KSPSetOperators(kspd, Al, Al));
+    PetscCall(PCMGSetResidual(pg->solvepc, l, PCMGResidualDefault, Al));
+    if (l > 0) {
+      PetscCall(PCMGGetInterpolation(pg->mg, l, &Ip));
+      PetscCall(PCMGSetInterpolation(pg->solvepc, l, Ip));
+    }
+
+    PetscCall(KSPGetPC(kspd, &pcd));
+    PetscCall(PetscObjectTypeCompare((PetscObject)Al, MATLRC, &islrc));
+    if (l == 0 && !islrc) {
+      PetscCall(KSPSetType(kspd, KSPPREONLY));
+      PetscCall(PCSetType(pcd, PCREDUNDANT));
+    } else {
+      MCSOR mc;
+
+      PetscCall(MCSORCreate(Al, &mc));
+      PetscCall(MCSORSetFromOptions(mc));
+      PetscCall(MCSORSetSweepType(mc, SOR_SYMMETRIC_SWEEP));
+      PetscCall(MCSORSetUp(mc));
+      PetscCall(KSPSetType(kspd, KSPRICHARDSON));
+      PetscCall(KSPSetTolerances(kspd, PETSC_DEFAULT, PETSC_DEFAULT, PETSC_DEFAULT, l == 0 ? 10 : 1));
+      PetscCall(PCSetType(pcd, PCSHELL));
+      PetscCall(PCShellSetName(pcd, "symmetric multicolour SOR"));
+      PetscCall(PCShellSetContext(pcd, mc));
+      PetscCall(PCShellSetApply(pcd, PCApply_GAMGMCSmoother));
+      PetscCall(PCShellSetDestroy(pcd, PCDestroy_GAMGMCSmoother));
+    }
+  }
+  PetscCall(PCSetOperators(pg->solvepc, pc->mat, pc->pmat));
+  PetscCall(PCSetFromOptions(pg->solvepc));
+  PetscCall(PCSetUp(pg->solvepc));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Returns a deterministic multigrid preconditioner for the system
+    matrix that reuses the hierarchy of the sampler (see the notes at the top
+    of this file). The PC is owned by `pc` and is destroyed when `pc` is reset.
+ */
+PetscErrorCode PCGAMGMCGetSolverPC(PC pc, PC *solver)
+{
+  PC_GAMGMC pg = pc->data;
+
+  PetscFunctionBeginUser;
+  if (!pc->setupcalled) PetscCall(PCSetUp(pc));
+  if (!pg->solvepc) PetscCall(PCGAMGMCSetUpSolver(pc));
+  *solver = pg->solvepc;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Computes x = A^{-1} b with CG, preconditioned by the deterministic
+    cycle on the sampling hierarchy. With b the right hand side passed to the
+    sampler, x is the mean of the target distribution.
+ */
+PetscErrorCode PCGAMGMCComputeMean(PC pc, Vec b, Vec x)
+{
+  PC_GAMGMC   pg = pc->data;
+  PC          solver;
+  const char *prefix;
+
+  PetscFunctionBeginUser;
+  PetscCall(PCGAMGMCGetSolverPC(pc, &solver));
+  if (!pg->meanksp) {
+    PetscCall(KSPCreate(PetscObjectComm((PetscObject)pc), &pg->meanksp));
+    PetscCall(KSPSetType(pg->meanksp, KSPCG));
+    PetscCall(KSPSetOperators(pg->meanksp, pc->mat, pc->pmat));
+    PetscCall(KSPSetPC(pg->meanksp, solver));
+    PetscCall(KSPSetTolerances(pg->meanksp, 1e-10, PETSC_DEFAULT, PETSC_DEFAULT, PETSC_DEFAULT));
+    PetscCall(PCGetOptionsPrefix(pc, &prefix));
+    PetscCall(KSPSetOptionsPrefix(pg->meanksp, prefix));
+    PetscCall(KSPAppendOptionsPrefix(pg->meanksp, "gamgmc_mean_"));
+    PetscCall(KSPSetFromOptions(pg->meanksp));
+  }
+  PetscCall(KSPSolve(pg->meanksp, b, x));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+static PetscErrorCode PCApply_GAMGMC(PC pc, Vec b, Vec x)
+{
+  PC solver;
+
+  PetscFunctionBeginUser;
+  PetscCall(PCGAMGMCGetSolverPC(pc, &solver));
+  PetscCall(PCApply(solver, b, x));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* Registers the events of levels that do not have any yet and installs the
+   timing hooks on all levels */
+static PetscErrorCode PCGAMGMCSetUpTiming(PC pc)
+{
+  PC_GAMGMC pg = pc->data;
+  PetscInt  levels;
+
+  PetscFunctionBeginUser;
+  if (pg->stage < 0) PetscCall(PetscLogStageRegister("GAMGMC Cycle", &pg->stage));
+  PetscCall(PCMGGetLevels(pg->mg, &levels));
+  if (levels > pg->nevlevels) {
+    PetscCall(PetscRealloc(sizeof(PetscLogEvent) * levels * PCGAMGMC_NPHASES, &pg->ev));
+    for (PetscInt l = pg->nevlevels; l < levels; ++l) {
+      PetscLogEvent *ev = &pg->ev[l * PCGAMGMC_NPHASES];
+      char           name[64];
+
+      for (PetscInt i = 0; i < PCGAMGMC_NPHASES; ++i) ev[i] = -1;
+      if (l == 0) {
+        PetscCall(PetscLogEventRegister("GAMGMCCoarse", PARMGMC_CLASSID, &ev[PCGAMGMC_PHASE_SMOOTH]));
+        continue;
+      }
+      PetscCall(PetscSNPrintf(name, sizeof(name), "GAMGMCSmooth %" PetscInt_FMT, l));
+      PetscCall(PetscLogEventRegister(name, PARMGMC_CLASSID, &ev[PCGAMGMC_PHASE_SMOOTH]));
+      PetscCall(PetscSNPrintf(name, sizeof(name), "GAMGMCResid %" PetscInt_FMT, l));
+      PetscCall(PetscLogEventRegister(name, PARMGMC_CLASSID, &ev[PCGAMGMC_PHASE_RESIDUAL]));
+      PetscCall(PetscSNPrintf(name, sizeof(name), "GAMGMCRestr %" PetscInt_FMT, l));
+      PetscCall(PetscLogEventRegister(name, PARMGMC_CLASSID, &ev[PCGAMGMC_PHASE_RESTRICT]));
+      PetscCall(PetscSNPrintf(name, sizeof(name), "GAMGMCProlong %" PetscInt_FMT, l));
+      PetscCall(PetscLogEventRegister(name, PARMGMC_CLASSID, &ev[PCGAMGMC_PHASE_PROLONG]));
+    }
+    pg->nevlevels = levels;
+  }
+
+  PetscCall(PetscCalloc1(levels, &pg->timed));
+  pg->ntimed = levels;
+  for (PetscInt l = 0; l < levels; ++l) {
+    PetscLogEvent        *ev = &pg->ev[l * PCGAMGMC_NPHASES];
+    PCGAMGMCTimedTransfer tt;
+    KSP                   ksps;
+    Mat                   P, Al;
+    PetscInt              m, n, M, N;
+
+    PetscCall(PCMGGetSmoother(pg->mg, l, &ksps));
+    PetscCall(KSPSetPreSolve(ksps, PCGAMGMCTimingPreSolve, &ev[PCGAMGMC_PHASE_SMOOTH]));
+    PetscCall(KSPSetPostSolve(ksps, PCGAMGMCTimingPostSolve, &ev[PCGAMGMC_PHASE_SMOOTH]));
+    if (l == 0) continue;
+
+    PetscCall(PetscNew(&tt));
+    PetscCall(PCMGGetInterpolation(pg->mg, l, &P));
+    PetscCall(PetscObjectReference((PetscObject)P));
+    tt->P       = P;
+    tt->resid   = ev[PCGAMGMC_PHASE_RESIDUAL];
+    tt->restr   = ev[PCGAMGMC_PHASE_RESTRICT];
+    tt->prolong = ev[PCGAMGMC_PHASE_PROLONG];
+    PetscCall(MatGetLocalSize(P, &m, &n));
+    PetscCall(MatGetSize(P, &M, &N));
+    PetscCall(MatCreateShell(PetscObjectComm((PetscObject)P), m, n, M, N, tt, &pg->timed[l]));
+    PetscCall(MatShellSetOperation(pg->timed[l], MATOP_MULT, PCGAMGMC_SHELLOP(MatMult_GAMGMCTimed)));
+    PetscCall(MatShellSetOperation(pg->timed[l], MATOP_MULT_ADD, PCGAMGMC_SHELLOP(MatMultAdd_GAMGMCTimed)));
+    PetscCall(MatShellSetOperation(pg->timed[l], MATOP_MULT_TRANSPOSE, PCGAMGMC_SHELLOP(MatMultTranspose_GAMGMCTimed)));
+    PetscCall(MatShellSetOperation(pg->timed[l], MATOP_MULT_TRANSPOSE_ADD, PCGAMGMC_SHELLOP(MatMultTransposeAdd_GAMGMCTimed)));
+    PetscCall(MatShellSetContextDestroy(pg->timed[l], PCGAMGMCTimedTransferDestroy));
+    PetscCall(PCMGSetInterpolation(pg->mg, l, pg->timed[l]));
+    PetscCall(PCMGSetRestriction(pg->mg, l, pg->timed[l]));
+
+    PetscCall(KSPGetOperators(ksps, &Al, NULL));
+    PetscCall(PetscObjectCompose((PetscObject)Al, "ParMGMCTimedTransfer", (PetscObject)pg->timed[l]));
+    PetscCall(PCMGSetResidual(pg->mg, l, PCGAMGMCResidual_Timed, Al));
+  }
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Log the phases of the cycle on each level as separate events, see
+    PCGAMGMCGetLevelStats(). PETSc logging must be active (`-log_view` or
+    PetscLogDefaultBegin()) when the cycle is first applied. Default is
+    PETSC_FALSE.
+ */
+PetscErrorCode PCGAMGMCSetTiming(PC pc, PetscBool flg)
+{
+  PC_GAMGMC pg = pc->data;
+
+  PetscFunctionBeginUser;
+  pg->timing = flg;
+  if (!flg) PetscCall(PCGAMGMCClearTiming(pg));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Get the accumulated statistics of one phase of the cycle on the
+    given level (0 is the coarsest level, its smoothing phase is the coarse
+    sampling). `time` is the maximum over all ranks, the flops, the number of
+    messages and the message bytes are summed over all ranks. Phases that do
+    not exist on the level, and all phases if timing is not enabled (see
+    PCGAMGMCSetTiming()), report zero. Pass NULL for values that are not
+    needed. Collective.
+ */
+PetscErrorCode PCGAMGMCGetLevelStats(PC pc, PetscInt level, PCGAMGMCPhase phase, PetscLogDouble *time, PetscLogDouble *flops, PetscLogDouble *messages, PetscLogDouble *bytes)
+{
+  PC_GAMGMC      pg      = pc->data;
+  PetscLogDouble vals[3] = {0}, tmax = 0;
+
+  PetscFunctionBeginUser;
+  PetscCheck(phase >= 0 && phase < PCGAMGMC_NPHASES, PetscObjectComm((PetscObject)pc), PETSC_ERR_ARG_OUTOFRANGE, "Invalid phase");
+  if (level >= 0 && level < pg->nevlevels && pg->ev[level * PCGAMGMC_NPHASES + phase] >= 0) {
+    PetscEventPerfInfo info;
+
+    PetscCall(PetscLogEventGetPerfInfo(pg->stage, pg->ev[level * PCGAMGMC_NPHASES + phase], &info));
+    tmax    = info.time;
+    vals[0] = info.flops;
+    vals[1] = info.numMessages;
+    vals[2] = info.messageLength;
+  }
+  PetscCallMPI(MPI_Allreduce(MPI_IN_PLACE, &tmax, 1, MPI_DOUBLE, MPI_MAX, PetscObjectComm((PetscObject)pc)));
+  PetscCallMPI(MPI_Allreduce(MPI_IN_PLACE, vals, 3, MPI_DOUBLE, MPI_SUM, PetscObjectComm((PetscObject)pc)));
+  if (time) *time = tmax;
+  if (flops) *flops = vals[0];
+  if (messages) *messages = vals[1];
+  if (bytes) *bytes = vals[2];
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+static PetscErrorCode PCGAMGMCViewTiming(PC pc, PetscViewer v)
+{
+  PC_GAMGMC         pg      = pc->data;
+  const char *const names[] = {"Smooth", "Resid", "Restr", "Prolong"};
+  PetscLogDouble   *t, *f, *m, *bytes, total = 0;
+  PetscInt          levels, n;
+
+  PetscFunctionBeginUser;
+  levels = pg->nevlevels;
+  n      = levels * PCGAMGMC_NPHASES;
+  PetscCall(PetscMalloc4(n, &t, n, &f, n, &m, n, &bytes));
+  for (PetscInt l = 0; l < levels; ++l) {
+    for (PetscInt i = 0; i < PCGAMGMC_NPHASES; ++i) {
+      PetscInt k = l * PCGAMGMC_NPHASES + i;
+
+      PetscCall(PCGAMGMCGetLevelStats(pc, l, (PCGAMGMCPhase)i, &t[k], &f[k], &m[k], &bytes[k]));
+      total += bytes[k];
+    }
+  }
+
+  PetscCall(PetscViewerASCIIPrintf(v, "GAMGMC timing (level 0 is the coarsest level):\n"));
+  PetscCall(PetscViewerASCIIPrintf(v, "  Level  Phase        Time [s]   GFlop/s   Msg MB/s   Messages   Msg share\n"));
+  for (PetscInt l = levels - 1; l >= 0; --l) {
+    for (PetscInt i = 0; i < PCGAMGMC_NPHASES; ++i) {
+      PetscInt k = l * PCGAMGMC_NPHASES + i;
+
+      if (pg->ev[k] < 0) continue;
+      PetscCall(PetscViewerASCIIPrintf(v, "  %5" PetscInt_FMT "  %-8s  %11.4e  %8.3f  %9.2f  %9.0f  %9.1f%%\n", l, l == 0 ? "Coarse" : names[i], t[k], t[k] > 0 ? f[k] / t[k] * 1e-9 : 0., t[k] > 0 ? bytes[k] / t[k] * 1e-6 : 0., m[k], total > 0 ? 100 * bytes[k] / total : 0.));
+    }
+  }
+  PetscCall(PetscFree4(t, f, m, bytes));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* Makes sure that the hierarchy and work vectors exist and prepares the
+   cycle for the selected mode. */
+static PetscErrorCode PCGAMGMCPrepareCycle(PC pc)
+{
+  PC_GAMGMC pg = pc->data;
+
+  PetscFunctionBeginUser;
+  if (!pg->setup_called) {
+    PetscCall(PCGAMGMC_SetUpHierarchy(pc));
+    pg->setup_called = PETSC_TRUE;
+  }
+
+  if (pg->carry_residual && pg->mg->ops->applyrichardson) {
+    KSP      ksps;
+    PetscInt levels;
+
+    /* The fine-level smoothers must continue from the current sample */
+    PetscCall(PCMGGetLevels(pg->mg, &levels));
+    PetscCall(PCMGGetSmoother(pg->mg, levels - 1, &ksps));
+    PetscCall(KSPSetInitialGuessNonzero(ksps, PETSC_TRUE));
+  } else {
+    if (pg->carry_residual) PetscCall(PetscInfo(pc, "Inner multigrid PC does not support Richardson mode, falling back to explicit residuals\n"));
+    if (!pg->work) PetscCall(MatCreateVecs(pc->mat, &pg->work, NULL));
+  }
+
+  if (pg->timing && !pg->timed) {
+    PetscBool active;
+
+    PetscCall(PetscLogIsActive(&active));
+    PetscCheck(active, PetscObjectComm((PetscObject)pc), PETSC_ERR_ORDER, "Per-level timing needs active PETSc logging, run with -log_view or call PetscLogDefaultBegin()");
+    PetscCall(PCGAMGMCSetUpTiming(pc));
+  }
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* One iteration of the sampler, i.e., one multigrid cycle */
+static PetscErrorCode PCGAMGMCStep(PC pc, Vec b, Vec y, Vec w, PetscBool zero)
+{
+  PC_GAMGMC pg = pc->data;
+
+  PetscFunctionBeginUser;
+  if (pg->carry_residual && pg->mg->ops->applyrichardson) {
+    PetscInt                    sits;
+    PCRichardsonConvergedReason sreason;
+
+    if (zero) PetscCall(VecZeroEntries(y));
+    /* Zero tolerances, so PCMG does not compute any residual norms */
+    PetscCall(PCApplyRichardson(pg->mg, b, y, w, 0., 0., 0., 1, PETSC_FALSE, &sits, &sreason));
+  } else if (zero) {
+    /* From a zero initial guess the residual is just b, so one cycle gives
+       y = M b directly. */
+    PetscCall(PCApply(pg->mg, b, y));
+  } else {
+    /* Richardson sampling update carrying the state forward:
+           y <- y + M (b - A y).
+       Applying the cycle to the raw rhs b every iteration (y <- M b) instead
+       leaves the chain at a single cycle's approximation of A^{-1} b, which
+       biases the sample mean (most visibly in the smooth modes). */
+    PetscCall(MatMult(pc->mat, y, w));
+    PetscCall(VecAYPX(w, -1., b));
+    PetscCall(PCApply(pg->mg, w, pg->work));
+    PetscCall(VecAXPY(y, 1., pg->work));
+  }
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* The assembled interpolation from level l - 1 to level l */
+static PetscErrorCode PCGAMGMCGetInterpolation(PC_GAMGMC pg, PetscInt l, Mat *P)
+{
+  PetscFunctionBeginUser;
+  if (pg->timed && pg->timed[l]) {
+    PCGAMGMCTimedTransfer tt;
+
+    PetscCall(MatShellGetContext(pg->timed[l], &tt));
+    *P = tt->P;
+  } else PetscCall(PCMGGetInterpolation(pg->mg, l, P));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief Estimates the marginal variances of the target distribution, i.e.,
+    the diagonal of A^{-1}, with a multilevel estimator.
+
+    With the composite interpolation P from the coarsest to the finest level
+    and the (Galerkin) coarse operator A_c = P^T A P, the variance splits into
+
+        diag(A^{-1}) = diag(P A_c^{-1} P^T) + E[e * e],   e = y - P A_c^{-1} P^T A y,
+
+    for samples y ~ N(0, A^{-1}), since e is the A-orthogonal projection of y
+    onto the complement of the coarse space. The first part is computed
+    exactly from the selected inverse of the coarse Cholesky factor (see
+    PCCholSamplerGetSelectedInverse()), which covers the smooth, strongly
+    correlated part of the variance. The second part only contains the
+    rough, weakly correlated part and is estimated with `nsamples` samples of
+    the chain of this sampler (after `nburnin` discarded ones), so far fewer
+    samples are needed than for the plain sample variance.
+
+    The coarse level sampler must be of type `PCCHOLSAMPLER` and must have a
+    sequential factor (e.g. the redundant mode or the coarse level of GAMG).
+    `var` must have the layout of the operator.
+ */
+PetscErrorCode PCGAMGMCEstimateVariance(PC pc, PetscInt nburnin, PetscInt nsamples, Vec var)
+{
+  PC_GAMGMC pg = pc->data;
+  KSP       kspc;
+  PC        cpc;
+  Mat       P = NULL, Z, V, Q;
+  Vec       b, y, w, r, rc, xc, acc;
+  PetscInt  levels, rstart, rend;
+  PetscBool flag;
+
+  PetscFunctionBeginUser;
+  PetscCheck(nsamples > 0, PetscObjectComm((PetscObject)pc), PETSC_ERR_ARG_OUTOFRANGE, "Number of samples must be positive");
+  if (!pc->setupcalled) PetscCall(PCSetUp(pc));
+  PetscCall(PCGAMGMCPrepareCycle(pc));
+  PetscCall(PCMGGetLevels(pg->mg, &levels));
+  PetscCall(PCMGGetSmoother(pg->mg, 0, &kspc));
+  PetscCall(KSPGetPC(kspc, &cpc));
+  PetscCall(PetscObjectTypeCompare((PetscObject)cpc, PCCHOLSAMPLER, &flag));
+  PetscCheck(flag, PetscObjectComm((PetscObject)pc), PETSC_ERR_SUP, "The multilevel variance estimator requires a coarse level sampler of type %s", PCCHOLSAMPLER);
+  if (levels == 1) {
+    PetscCall(PCCholSamplerGetVariance(cpc, var));
+    PetscFunctionReturn(PETSC_SUCCESS);
+  }
+
+  // Composite interpolation from the coarsest to the finest level
+  for (PetscInt l = levels - 1; l > 0; --l) {
+    Mat I, PI;
+
+    PetscCall(PCGAMGMCGetInterpolation(pg, l, &I));
+    if (!P) {
+      PetscCall(PetscObjectReference((PetscObject)I));
+      P = I;
+    } else {
+      PetscCall(MatMatMult(P, I, MAT_INITIAL_MATRIX, PETSC_DETERMINE, &PI));
+      PetscCall(MatDestroy(&P));
+      P = PI;
+    }
+  }
+
+  // Exact coarse part diag(P Z P^T) - diag((P V) (P V)^T). The pattern of the
+  // factor contains all pairs of coarse unknowns that share a fine row of P.
+  PetscCall(PCCholSamplerGetSelectedInverse(cpc, &Z, &V));
+  PetscCall(MatMatMult(P, Z, MAT_INITIAL_MATRIX, PETSC_DETERMINE, &Q));
+  PetscCall(MatGetOwnershipRange(P, &rstart, &rend));
+  for (PetscInt i = rstart; i < rend; ++i) {
+    const PetscInt    *pj, *qj;
+    const PetscScalar *pv, *qv;
+    PetscInt           pn, qn, q = 0;
+    PetscScalar        d = 0;
+
+    PetscCall(MatGetRow(P, i, &pn, &pj, &pv));
+    PetscCall(MatGetRow(Q, i, &qn, &qj, &qv));
+    for (PetscInt p = 0; p < pn; ++p) {
+      while (q < qn && qj[q] < pj[p]) ++q;
+      if (q < qn && qj[q] == pj[p]) d += pv[p] * qv[q];
+    }
+    PetscCall(MatRestoreRow(Q, i, &qn, &qj, &qv));
+    PetscCall(MatRestoreRow(P, i, &pn, &pj, &pv));
+    PetscCall(VecSetValue(var, i, d, INSERT_VALUES));
+  }
+  PetscCall(VecAssemblyBegin(var));
+  PetscCall(VecAssemblyEnd(var));
+  if (V) {
+    Mat                PV, PVl;
+    const PetscScalar *varr;
+    PetscScalar       *v;
+    PetscInt           n, k, ldv;
+
+    PetscCall(MatMatMult(P, V, MAT_INITIAL_MATRIX, PETSC_DETERMINE, &PV));
+    PetscCall(MatDenseGetLocalMatrix(PV, &PVl));
+    PetscCall(MatGetLocalSize(PV, &n, NULL));
+    PetscCall(MatGetSize(PV, NULL, &k));
+    PetscCall(MatDenseGetLDA(PVl, &ldv));
+    PetscCall(MatDenseGetArrayRead(PVl, &varr));
+    PetscCall(VecGetArray(var, &v));
+    for (PetscInt j = 0; j < k; ++j)
+      for (PetscInt i = 0; i < n; ++i) v[i] -= varr[i + j * ldv] * varr[i + j * ldv];
+    PetscCall(VecRestoreArray(var, &v));
+    PetscCall(MatDenseRestoreArrayRead(PVl, &varr));
+    PetscCall(MatDestroy(&PV));
+  }
+  PetscCall(MatDestroy(&Q));
+  PetscCall(MatDestroy(&V));
+  PetscCall(MatDestroy(&Z));
+
+  // Sampled fine remainder E[e * e] from a chain with zero mean
+  PetscCall(MatCreateVecs(pc->mat, &y, &b));
+  PetscCall(VecDuplicate(y, &w));
+  PetscCall(VecDuplicate(y, &r));
+  PetscCall(VecDuplicate(y, &acc));
+  PetscCall(MatCreateVecs(P, &rc, NULL));
+  PetscCall(VecDuplicate(rc, &xc));
+  PetscCall(VecZeroEntries(b));
+  PetscCall(VecZeroEntries(y));
+  PetscCall(VecZeroEntries(acc));
+  for (PetscInt i = 0; i < nburnin + nsamples; ++i) {
+    PetscCall(PCGAMGMCStep(pc, b, y, w, PETSC_FALSE));
+    if (i < nburnin) continue;
+
+    PetscCall(MatMult(pc->mat, y, r));
+    PetscCall(MatMultTranspose(P, r, rc));
+    PetscCall(PCCholSamplerApplyInverse(cpc, rc, xc));
+    PetscCall(MatMult(P, xc, r));
+    PetscCall(VecAYPX(r, -1., y));
+    PetscCall(VecPointwiseMult(r, r, r));
+    PetscCall(VecAXPY(acc, 1., r));
+  }
+  PetscCall(VecAXPY(var, 1. / nsamples, acc));
+
+  PetscCall(VecDestroy(&acc));
+  PetscCall(VecDestroy(&xc));
+  PetscCall(VecDestroy(&rc));
+  PetscCall(VecDestroy(&r));
+  PetscCall(VecDestroy(&w));
+  PetscCall(VecDestroy(&b));
+  PetscCall(VecDestroy(&y));
+  PetscCall(MatDestroy(&P));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+static PetscErrorCode PCView_GAMGMC(PC pc, PetscViewer v)
+{
+  PC_GAMGMC pg = pc->data;
+
+  PetscFunctionBeginUser;
+  if (pg->tuned) PetscCall(PetscViewerASCIIPrintf(v, "Autotuned: %s\n", pg->tuned_opts));
+  if (pg->solve) PetscCall(PetscViewerASCIIPrintf(v, "Solve mode: deterministic cycle on the sampling hierarchy\n"));
+  if (pg->timed) PetscCall(PCGAMGMCViewTiming(pc, v));
+  PetscCall(PCView(pg->mg, v));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* Numeric-only setup, used when the values of the operator changed but its
+   nonzero pattern did not. The aggregates and interpolations are kept and the
+   Galerkin coarse operators are recomputed in place, so the samplers on the
+   levels see the same matrices with new values and take their own numeric
+   setup paths. Sets done to PETSC_FALSE if the hierarchy has to be rebuilt. */
+static PetscErrorCode PCGAMGMC_SetUpNumeric(PC pc, Mat P, PetscBool *done)
+{
+  PC_GAMGMC pg = pc->data;
+  PetscInt  levels;
+  Mat       Pmg;
+  PetscBool isgamg;
+
+  PetscFunctionBeginUser;
+  *done = PETSC_FALSE;
+  if (!pc->setupcalled || pc->flag != SAME_NONZERO_PATTERN || !pg->setup_called) PetscFunctionReturn(PETSC_SUCCESS);
+  PetscCall(PCGetOperators(pg->mg, NULL, &Pmg));
+  if (P != Pmg) PetscFunctionReturn(PETSC_SUCCESS);
+  PetscCall(PCMGGetLevels(pg->mg, &levels));
+  if (pg->As) {
+    if (pg->As[levels - 1] != pc->pmat) PetscFunctionReturn(PETSC_SUCCESS);
+    // The coarse operators can only be recomputed in place if they are products
+    for (PetscInt l = 0; l < levels - 1; ++l) {
+      Mat            Ac;
+      MatProductType ptype;
+
+      PetscCall(MatLRCGetMats(pg->As[l], &Ac, NULL, NULL, NULL));
+      PetscCall(MatProductGetType(Ac, &ptype));
+      if (ptype == MATPRODUCT_UNSPECIFIED) PetscFunctionReturn(PETSC_SUCCESS);
+    }
+  }
+
+  PetscCall(PetscInfo(pc, "Same nonzero pattern, reusing the multigrid hierarchy\n"));
+  PetscCall(PCGAMGMCClearAgglomeration(pg));
+  PetscCall(PCDestroy(&pg->solvepc));
+  PetscCall(KSPDestroy(&pg->meanksp));
+
+  if (!pg->As) {
+    // PCMG recomputes the Galerkin products in place, PCGAMG only if it keeps the interpolation
+    PetscCall(PetscObjectTypeCompare((PetscObject)pg->mg, PCGAMG, &isgamg));
+    if (isgamg) PetscCall(PCGAMGSetReuseInterpolation(pg->mg, PETSC_TRUE));
+    PetscCall(PCSetUp(pg->mg));
+  } else {
+    /* The smoothers work on the MATLRC matrices which PCMG cannot project, so
+       the base matrices and the low-rank factors are updated here and PCMG is
+       kept from setting up again */
+    PetscCall(PCSetReusePreconditioner(pg->mg, PETSC_TRUE));
+    for (PetscInt l = levels - 1; l > 0; --l) {
+      Mat Af, Bf, Ac, Bc, Ip;
+
+      PetscCall(MatLRCGetMats(pg->As[l], &Af, &Bf, NULL, NULL));
+      PetscCall(MatLRCGetMats(pg->As[l - 1], &Ac, &Bc, NULL, NULL));
+      PetscCall(PCMGGetInterpolation(pg->mg, l, &Ip));
+      PetscCall(MatPtAP(Af, Ip, MAT_REUSE_MATRIX, PETSC_DETERMINE, &Ac));
+      PetscCall(MatTransposeMatMult(Ip, Bf, MAT_REUSE_MATRIX, 1, &Bc));
+      PetscCall(PetscObjectStateIncrease((PetscObject)pg->As[l - 1]));
+    }
+    for (PetscInt l = levels - 1; l >= 0; --l) {
+      KSP ksps;
+
+      PetscCall(PCMGGetSmoother(pg->mg, l, &ksps));
+      PetscCall(KSPSetUp(ksps));
+    }
+  }
+
+  if (pg->agglo_eq_limit > 0) PetscCall(PCGAMGMC_SetUpAgglomeration(pc));
+  *done = PETSC_TRUE;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+static PetscErrorCode PCSetUp_GAMGMC(PC pc)
+{
+  PC_GAMGMC   pg = pc->data;
+  MatType     type;
+  Mat         P, *interps = NULL;
+  PetscInt    nlevels;
+  PetscBool   islrc, done;
+  const char *prefix;
+
+  PetscFunctionBeginUser;
+  PetscCall(PCGAMGMCClearTiming(pg));
   PetscCall(MatGetType(pc->pmat, &type));
   PetscCall(PetscStrcmp(type, MATLRC, &islrc));
   if (islrc) PetscCall(MatLRCGetMats(pc->pmat, &P, NULL, NULL, NULL));
   else P = pc->pmat;
+  PetscCall(PCGAMGMC_SetUpNumeric(pc, P, &done));
+  if (done) PetscFunctionReturn(PETSC_SUCCESS);
+
+  PetscCall(PCSetType(pg->mg, pg->mgtype));
+  PetscCall(PCGetOptionsPrefix(pc, &prefix));
+  PetscCall(PCSetOptionsPrefix(pg->mg, prefix));
+  PetscCall(PCAppendOptionsPrefix(pg->mg, "gamgmc_"));
+  PetscCall(PCSetReusePreconditioner(pg->mg, PETSC_FALSE));
+  if (strcmp(pg->mgtype, PCGAMG) == 0) PetscCall(PCGAMGSetReuseInterpolation(pg->mg, PETSC_FALSE));
 
   PetscCall(PCSetOperators(pg->mg, P, P));
   if (strcmp(pg->mgtype, PCMG) == 0) { PetscCall(PCSetDM(pg->mg, pc->dm)); }
 
+  if (pg->setup_load[0]) {
+    PetscBool   exists;
+    PetscViewer viewer;
+
+    PetscCall(PetscTestFile(pg->setup_load, 'r', &exists));
+    if (exists) {
+      PetscCall(PetscViewerBinaryOpen(PetscObjectComm((PetscObject)pc), pg->setup_load, FILE_MODE_READ, &viewer));
+      PetscCall(ParMGMCMatLoadSetup(P, viewer, NULL));
+      PetscCall(PetscViewerDestroy(&viewer));
+    } else PetscCall(PetscInfo(pc, "Setup file %s does not exist, setting up from scratch\n", pg->setup_load));
+  }
+
+  /* If another multigrid PC (e.g. the solver of PCWOODBURY) has already
+     coarsened this matrix, its interpolations are used with PCMG instead of
+     running the aggregation again */
+  if (strcmp(pg->mgtype, PCGAMG) == 0) {
+    PetscCall(ParMGMCMatQueryInterpolations(P, &nlevels, &interps));
+    if (interps && pg->nlevels > 0 && pg->nlevels != nlevels) interps = NULL;
+    if (interps) {
+      PetscCall(PetscInfo(pc, "Reusing the %" PetscInt_FMT " level hierarchy stored on the matrix\n", nlevels));
+      PetscCall(PCSetType(pg->mg, PCMG));
+      PetscCall(PCMGSetLevels(pg->mg, nlevels, NULL));
+      for (PetscInt l = 1; l < nlevels; ++l) PetscCall(PCMGSetInterpolation(pg->mg, l, interps[l]));
+    }
+  }
+
   // Ugly way to set the default "smoother" (=sampler) to be MulticolorGibbs.
   // NOTE: PetscOptionsSetValue does NOT honour the PetscOptionsPrefixPush stack;
   // the option name must be fully qualified (prefix + suffix) manually.
@@ -350,18 +1634,450 @@ static PetscErrorCode PCSetUp_GAMGMC(PC pc)
   }
 
   PetscCall(PCSetFromOptions(pg->mg));
+  if (pg->nlevels > 0 && strcmp(pg->mgtype, PCGAMG) == 0) PetscCall(PCGAMGSetNlevels(pg->mg, pg->nlevels));
   PetscCall(PCSetUp(pg->mg));
+  if (strcmp(pg->mgtype, PCGAMG) == 0 && !interps) PetscCall(ParMGMCMatComposeInterpolations(pg->mg));
+  if (pg->setup_save[0]) {
+    PetscViewer viewer;
+
+    PetscCall(PetscViewerBinaryOpen(PetscObjectComm((PetscObject)pc), pg->setup_save, FILE_MODE_WRITE, &viewer));
+    PetscCall(ParMGMCMatSaveSetup(P, viewer));
+    PetscCall(PetscViewerDestroy(&viewer));
+  }
 
   PetscFunctionReturn(PETSC_SUCCESS);
 }
 
-static PetscErrorCode PCSetFromOptions_GAMGMC(PC pc, PetscOptionItems_ARG PetscOptionsObject)
+/* Autotuning (-pc_gamgmc_autotune).
+
+   The configuration is tuned greedily, one parameter at a time, starting
+   from the configuration given in the options database: first the number of
+   levels (GAMG only), then the sampler on each level, then the number of
+   smoothing steps per level and finally the cycle type. Each candidate is
+   rated by running a short pilot chain and measuring the time per sample
+   multiplied by the integrated autocorrelation time of a quantity of
+   interest, i.e., the time per independent sample. The search is greedy:
+   the samplers are tried on one level after the other, keeping the best one
+   of each level before moving to the next, so combinations are not
+   searched exhaustively. Besides the two sampler types, the pipelined and
+   the node-aware PARSOR sweeps of SORGibbs are candidates (only on levels
+   that are distributed over more than one rank, otherwise they are the
+   same as the plain SORGibbs sampler). */
+typedef struct {
+  PCType    type;
+  PetscBool pipelined, node_aware; // PARSOR options, only used for PCSORGIBBS
+} PCGAMGMCSampler;
+
+static const PCGAMGMCSampler PCGAMGMCAutotuneSamplers[] = {
+  {PCMCGIBBS,  PETSC_FALSE, PETSC_FALSE},
+  {PCSORGIBBS, PETSC_FALSE, PETSC_FALSE},
+  {PCSORGIBBS, PETSC_TRUE,  PETSC_FALSE},
+  {PCSORGIBBS, PETSC_FALSE, PETSC_TRUE },
+};
+
+typedef struct {
+  PetscInt      nlevels;
+  PCMGCycleType cycle;
+  PetscInt     *its;     // Smoothing steps per level (level 0 is the coarsest)
+  PetscInt     *sampler; // Index into PCGAMGMCAutotuneSamplers, -1 if the level's sampler is not tuned
+} PCGAMGMCConfig;
+
+static PetscErrorCode PCGAMGMCConfigDestroy(PCGAMGMCConfig *cfg)
+{
+  PetscFunctionBeginUser;
+  PetscCall(PetscFree2(cfg->its, cfg->sampler));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+static PetscErrorCode PCGAMGMCConfigCopy(const PCGAMGMCConfig *from, PCGAMGMCConfig *to)
+{
+  PetscFunctionBeginUser;
+  if (to->nlevels != from->nlevels) {
+    PetscCall(PCGAMGMCConfigDestroy(to));
+    PetscCall(PetscMalloc2(from->nlevels, &to->its, from->nlevels, &to->sampler));
+  }
+  to->nlevels = from->nlevels;
+  to->cycle   = from->cycle;
+  PetscCall(PetscArraycpy(to->its, from->its, from->nlevels));
+  PetscCall(PetscArraycpy(to->sampler, from->sampler, from->nlevels));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* Reads the current configuration of the hierarchy */
+static PetscErrorCode PCGAMGMCConfigGet(PC pc, PCGAMGMCConfig *cfg)
+{
+  PC_GAMGMC   pg = pc->data;
+  const char *prefix;
+  PetscBool   flg, issor;
+
+  PetscFunctionBeginUser;
+  PetscCall(PCGAMGMCConfigDestroy(cfg));
+  PetscCall(PCMGGetLevels(pg->mg, &cfg->nlevels));
+  PetscCall(PetscMalloc2(cfg->nlevels, &cfg->its, cfg->nlevels, &cfg->sampler));
+  for (PetscInt l = 0; l < cfg->nlevels; ++l) {
+    KSP    ksps;
+    PC     pcs;
+    PCType ptype;
+
+    PetscCall(PCMGGetSmoother(pg->mg, l, &ksps));
+    PetscCall(KSPGetTolerances(ksps, NULL, NULL, NULL, &cfg->its[l]));
+    PetscCall(KSPGetPC(ksps, &pcs));
+    PetscCall(PCGetType(pcs, &ptype));
+    PetscCall(PetscStrcmp(ptype, PCSORGIBBS, &issor));
+    cfg->sampler[l] = -1;
+    for (PetscInt i = 0; i < (PetscInt)PETSC_STATIC_ARRAY_LENGTH(PCGAMGMCAutotuneSamplers); ++i) {
+      PetscCall(PetscStrcmp(ptype, PCGAMGMCAutotuneSamplers[i].type, &flg));
+      if (flg && issor) {
+        PetscBool pipelined, node_aware;
+
+        PetscCall(PCSORGibbsGetPARSOROptions(pcs, &pipelined, &node_aware));
+        flg = pipelined == PCGAMGMCAutotuneSamplers[i].pipelined && node_aware == PCGAMGMCAutotuneSamplers[i].node_aware ? PETSC_TRUE : PETSC_FALSE;
+      }
+      if (flg) cfg->sampler[l] = i;
+    }
+  }
+
+  // PCMG has no getter for the cycle type
+  cfg->cycle = PC_MG_CYCLE_V;
+  PetscCall(PCGetOptionsPrefix(pg->mg, &prefix));
+  PetscCall(PetscOptionsGetEnum(NULL, prefix, "-pc_mg_cycle_type", PCMGCycleTypes, (PetscEnum *)&cfg->cycle, &flg));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+static PetscErrorCode PCGAMGMCConfigApply(PC pc, const PCGAMGMCConfig *cfg)
+{
+  PC_GAMGMC pg = pc->data;
+
+  PetscFunctionBeginUser;
+  PetscCall(PCMGSetCycleType(pg->mg, cfg->cycle));
+  for (PetscInt l = 0; l < cfg->nlevels; ++l) {
+    KSP                    ksps;
+    PC                     pcs;
+    PetscBool              same, issor;
+    const PCGAMGMCSampler *smp;
+
+    PetscCall(PCMGGetSmoother(pg->mg, l, &ksps));
+    PetscCall(KSPSetTolerances(ksps, PETSC_DEFAULT, PETSC_DEFAULT, PETSC_DEFAULT, cfg->its[l]));
+    if (cfg->sampler[l] < 0) continue;
+
+    smp = &PCGAMGMCAutotuneSamplers[cfg->sampler[l]];
+    PetscCall(KSPGetPC(ksps, &pcs));
+    PetscCall(PetscObjectTypeCompare((PetscObject)pcs, smp->type, &same));
+    PetscCall(PetscStrcmp(smp->type, PCSORGIBBS, &issor));
+    if (same && issor) {
+      PetscBool pipelined, node_aware;
+
+      PetscCall(PCSORGibbsGetPARSOROptions(pcs, &pipelined, &node_aware));
+      if (pipelined == smp->pipelined && node_aware == smp->node_aware) continue;
+      // The PARSOR options are only read in the setup
+      PetscCall(PCReset(pcs));
+    } else if (same) continue;
+    PetscCall(PCSetType(pcs, smp->type));
+    if (issor) PetscCall(PCSORGibbsSetPARSOROptions(pcs, smp->pipelined, smp->node_aware));
+    PetscCall(PCSetFusedResidual(pcs, pg->fused_residual));
+    PetscCall(PCSetUp(pcs));
+  }
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* Rebuilds the hierarchy with (at most) the given number of levels */
+static PetscErrorCode PCGAMGMCAutotuneRebuild(PC pc, PetscInt nlevels)
+{
+  PC_GAMGMC pg = pc->data;
+
+  PetscFunctionBeginUser;
+  PetscCall(PCReset_GAMGMC(pc));
+  pg->nlevels = nlevels;
+  PetscCall(PCSetUp_GAMGMC(pc));
+  PetscCall(PCGAMGMCPrepareCycle(pc));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* Time per independent sample of the current configuration, estimated from
+   a pilot chain started at x */
+static PetscErrorCode PCGAMGMCAutotuneEvaluate(PC pc, Vec b, Vec x, Vec w, Vec qv, PetscReal *cost)
+{
+  PC_GAMGMC      pg = pc->data;
+  PetscInt       n  = pg->autotune_samples;
+  PetscScalar   *q, tau;
+  PetscLogDouble t0, t1, t = 0;
+
+  PetscFunctionBeginUser;
+  PetscCall(PCGAMGMCPrepareCycle(pc));
+  for (PetscInt i = 0; i < n / 4; ++i) PetscCall(PCGAMGMCStep(pc, b, x, w, PETSC_FALSE));
+
+  PetscCall(PetscMalloc1(n, &q));
+  for (PetscInt i = 0; i < n; ++i) {
+    PetscCall(PetscTime(&t0));
+    PetscCall(PCGAMGMCStep(pc, b, x, w, PETSC_FALSE));
+    PetscCall(PetscTime(&t1));
+    t += t1 - t0;
+
+    if (pg->qoi) PetscCall(pg->qoi(i, x, &q[i], pg->qoictx));
+    else PetscCall(VecDot(x, qv, &q[i]));
+  }
+  PetscCallMPI(MPI_Allreduce(MPI_IN_PLACE, &t, 1, MPI_DOUBLE, MPI_MAX, PetscObjectComm((PetscObject)pc)));
+  PetscCall(IACT(n, q, &tau, NULL, NULL));
+  PetscCall(PetscFree(q));
+
+  *cost = t / n * PetscMax(PetscRealPart(tau), 1);
+  PetscCall(PetscInfo(pc, "Pilot chain: %g s per sample, IACT %g\n", (double)(t / n), (double)PetscRealPart(tau)));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* Time of one application of each level's sampler */
+static PetscErrorCode PCGAMGMCAutotuneLevelTimes(PC pc, PetscInt nlevels, PetscLogDouble *times)
 {
   PC_GAMGMC pg = pc->data;
 
+  PetscFunctionBeginUser;
+  for (PetscInt l = 0; l < nlevels; ++l) {
+    KSP            ksps;
+    Mat            Al;
+    Vec            bl, xl;
+    PetscLogDouble t0, t1;
+
+    PetscCall(PCMGGetSmoother(pg->mg, l, &ksps));
+    PetscCall(KSPGetOperators(ksps, &Al, NULL));
+    PetscCall(MatCreateVecs(Al, &xl, &bl));
+    PetscCall(VecZeroEntries(bl));
+    PetscCall(VecZeroEntries(xl));
+    PetscCall(KSPSolve(ksps, bl, xl)); // Warm-up
+    PetscCall(PetscTime(&t0));
+    for (PetscInt i = 0; i < 5; ++i) PetscCall(KSPSolve(ksps, bl, xl));
+    PetscCall(PetscTime(&t1));
+    times[l] = (t1 - t0) / 5;
+    PetscCall(VecDestroy(&xl));
+    PetscCall(VecDestroy(&bl));
+  }
+  PetscCallMPI(MPI_Allreduce(MPI_IN_PLACE, times, (PetscMPIInt)nlevels, MPI_DOUBLE, MPI_MAX, PetscObjectComm((PetscObject)pc)));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* Writes the configuration as options that reproduce it */
+static PetscErrorCode PCGAMGMCConfigToOptions(PC pc, const PCGAMGMCConfig *cfg, PetscBool levels, char *opts, size_t len)
+{
+  PC_GAMGMC   pg = pc->data;
+  const char *prefix;
+  char        opt[256];
+
+  PetscFunctionBeginUser;
+  PetscCall(PCGetOptionsPrefix(pg->mg, &prefix));
+  if (!prefix) prefix = "";
+  opts[0] = '\0';
+  if (levels) {
+    PetscCall(PetscSNPrintf(opt, sizeof(opt), "-%spc_mg_levels %" PetscInt_FMT " ", prefix, cfg->nlevels));
+    PetscCall(PetscStrlcat(opts, opt, len));
+  }
+  PetscCall(PetscSNPrintf(opt, sizeof(opt), "-%spc_mg_cycle_type %s", prefix, PCMGCycleTypes[cfg->cycle]));
+  PetscCall(PetscStrlcat(opts, opt, len));
+  for (PetscInt l = 0; l < cfg->nlevels; ++l) {
+    char lprefix[64];
+
+    if (l == 0) PetscCall(PetscSNPrintf(lprefix, sizeof(lprefix), "%smg_coarse_", prefix));
+    else PetscCall(PetscSNPrintf(lprefix, sizeof(lprefix), "%smg_levels_%" PetscInt_FMT "_", prefix, l));
+    PetscCall(PetscSNPrintf(opt, sizeof(opt), " -%sksp_max_it %" PetscInt_FMT, lprefix, cfg->its[l]));
+    PetscCall(PetscStrlcat(opts, opt, len));
+    if (cfg->sampler[l] >= 0) {
+      const PCGAMGMCSampler *smp = &PCGAMGMCAutotuneSamplers[cfg->sampler[l]];
+
+      PetscCall(PetscSNPrintf(opt, sizeof(opt), " -%spc_type %s", lprefix, smp->type));
+      PetscCall(PetscStrlcat(opts, opt, len));
+      if (smp->pipelined) {
+        PetscCall(PetscSNPrintf(opt, sizeof(opt), " -%spc_sorgibbs_pipelined", lprefix));
+        PetscCall(PetscStrlcat(opts, opt, len));
+      }
+      if (smp->node_aware) {
+        PetscCall(PetscSNPrintf(opt, sizeof(opt), " -%spc_sorgibbs_node_aware", lprefix));
+        PetscCall(PetscStrlcat(opts, opt, len));
+      }
+    }
+  }
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+static PetscErrorCode PCGAMGMCAutotune(PC pc, Vec b, Vec y, Vec w)
+{
+  PC_GAMGMC       pg = pc->data;
+  PCGAMGMCConfig  best = {0, PC_MG_CYCLE_V, NULL, NULL}, trial = {0, PC_MG_CYCLE_V, NULL, NULL};
+  PetscReal       bestcost, cost;
+  Vec             x, qv = NULL;
+  PetscBool       isgamg;
+  PetscLogDouble *times;
+  const PetscInt  steps[] = {1, 2, 4};
+
+  PetscFunctionBeginUser;
+  PetscCall(VecDuplicate(y, &x));
+  if (!pg->qoi) {
+    PetscRandom prand;
+
+    // Default quantity of interest: a random linear functional
+    PetscCall(ParMGMCGetPetscRandom(&prand));
+    PetscCall(VecDuplicate(y, &qv));
+    PetscCall(VecSetRandomStandardNormal(qv, prand));
+    PetscCall(VecNormalize(qv, NULL));
+    PetscCall(PetscRandomDestroy(&prand));
+  }
+
+  PetscCall(PCGAMGMCPrepareCycle(pc));
+  PetscCall(PCGAMGMCConfigGet(pc, &best));
+  PetscCall(VecCopy(y, x));
+  PetscCall(PCGAMGMCAutotuneEvaluate(pc, b, x, w, qv, &bestcost));
+
+  // Number of levels, only possible with GAMG (for PCMG the levels are given by the DM)
+  PetscCall(PetscStrcmp(pg->mgtype, PCGAMG, &isgamg));
+  if (isgamg && best.nlevels > 2) {
+    PetscInt nlevels = best.nlevels;
+
+    for (PetscInt nl = best.nlevels - 1; nl >= 2; --nl) {
+      PetscCall(PCGAMGMCAutotuneRebuild(pc, nl));
+      PetscCall(VecCopy(y, x));
+      PetscCall(PCGAMGMCAutotuneEvaluate(pc, b, x, w, qv, &cost));
+      if (cost >= bestcost) break;
+      bestcost = cost;
+      nlevels  = nl;
+    }
+    if (nlevels != pg->nlevels) PetscCall(PCGAMGMCAutotuneRebuild(pc, nlevels));
+    PetscCall(PCGAMGMCConfigGet(pc, &best));
+  }
+
+  // Sampler on each level, greedily from the coarsest to the finest
+  for (PetscInt l = 0; l < best.nlevels; ++l) {
+    KSP         ksps;
+    Mat         Al;
+    PetscMPIInt size;
+
+    if (best.sampler[l] < 0) continue;
+    PetscCall(PCMGGetSmoother(pg->mg, l, &ksps));
+    PetscCall(KSPGetOperators(ksps, &Al, NULL));
+    PetscCallMPI(MPI_Comm_size(PetscObjectComm((PetscObject)Al), &size));
+    for (PetscInt i = 0; i < (PetscInt)PETSC_STATIC_ARRAY_LENGTH(PCGAMGMCAutotuneSamplers); ++i) {
+      if (i == best.sampler[l]) continue;
+      if (size == 1 && (PCGAMGMCAutotuneSamplers[i].pipelined || PCGAMGMCAutotuneSamplers[i].node_aware)) continue;
+      PetscCall(PCGAMGMCConfigCopy(&best, &trial));
+      trial.sampler[l] = i;
+      PetscCall(PCGAMGMCConfigApply(pc, &trial));
+      PetscCall(VecCopy(y, x));
+      PetscCall(PCGAMGMCAutotuneEvaluate(pc, b, x, w, qv, &cost));
+      if (cost < bestcost) {
+        bestcost = cost;
+        PetscCall(PCGAMGMCConfigCopy(&trial, &best));
+      }
+    }
+  }
+
+  // Smoothing steps on each level (an exact coarse sampler needs just one)
+  for (PetscInt l = 0; l < best.nlevels; ++l) {
+    if (l == 0 && best.sampler[l] < 0) continue;
+    for (PetscInt i = 0; i < (PetscInt)PETSC_STATIC_ARRAY_LENGTH(steps); ++i) {
+      if (steps[i] == best.its[l]) continue;
+      PetscCall(PCGAMGMCConfigCopy(&best, &trial));
+      trial.its[l] = steps[i];
+      PetscCall(PCGAMGMCConfigApply(pc, &trial));
+      PetscCall(VecCopy(y, x));
+      PetscCall(PCGAMGMCAutotuneEvaluate(pc, b, x, w, qv, &cost));
+      if (cost < bestcost) {
+        bestcost = cost;
+        PetscCall(PCGAMGMCConfigCopy(&trial, &best));
+      }
+    }
+  }
+
+  // Cycle type
+  PetscCall(PCGAMGMCConfigCopy(&best, &trial));
+  trial.cycle = best.cycle == PC_MG_CYCLE_V ? PC_MG_CYCLE_W : PC_MG_CYCLE_V;
+  PetscCall(PCGAMGMCConfigApply(pc, &trial));
+  PetscCall(VecCopy(y, x));
+  PetscCall(PCGAMGMCAutotuneEvaluate(pc, b, x, w, qv, &cost));
+  if (cost < bestcost) {
+    bestcost = cost;
+    PetscCall(PCGAMGMCConfigCopy(&trial, &best));
+  }
+
+  PetscCall(PCGAMGMCConfigApply(pc, &best));
+  PetscCall(PCGAMGMCConfigToOptions(pc, &best, isgamg, pg->tuned_opts, sizeof(pg->tuned_opts)));
+  PetscCall(PetscMalloc1(best.nlevels, &times));
+  PetscCall(PCGAMGMCAutotuneLevelTimes(pc, best.nlevels, times));
+  if (pg->autotune_view) {
+    MPI_Comm comm = PetscObjectComm((PetscObject)pc);
+
+    PetscCall(PetscPrintf(comm, "PCGAMGMC autotuning: %g s per independent sample\n", (double)bestcost));
+    for (PetscInt l = 0; l < best.nlevels; ++l) PetscCall(PetscPrintf(comm, "  level %" PetscInt_FMT ": %" PetscInt_FMT " step(s), %g s per step\n", l, best.its[l], (double)times[l]));
+    PetscCall(PetscPrintf(comm, "  options: %s\n", pg->tuned_opts));
+  }
+  pg->tuned = PETSC_TRUE;
+
+  PetscCall(PetscFree(times));
+  PetscCall(PCGAMGMCConfigDestroy(&trial));
+  PetscCall(PCGAMGMCConfigDestroy(&best));
+  PetscCall(VecDestroy(&qv));
+  PetscCall(VecDestroy(&x));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+static PetscErrorCode PCApplyRichardson_GAMGMC(PC pc, Vec b, Vec y, Vec w, PetscReal rtol, PetscReal abstol, PetscReal dtol, PetscInt its, PetscBool guesszero, PetscInt *outits, PCRichardsonConvergedReason *reason)
+{
+  (void)rtol;
+  (void)abstol;
+  (void)dtol;
+
+  PC_GAMGMC pg = pc->data;
+
+  PetscFunctionBeginUser;
+  if (pg->autotune && !pg->tuned) {
+    if (guesszero) PetscCall(VecZeroEntries(y));
+    PetscCall(PCGAMGMCAutotune(pc, b, y, w));
+  }
+  PetscCall(PCGAMGMCPrepareCycle(pc));
+
+  if (pg->timed) PetscCall(PetscLogStagePush(pg->stage));
+  for (PetscInt it = 0; it < its; ++it) {
+    PetscCall(PCGAMGMCStep(pc, b, y, w, it == 0 && guesszero));
+    if (pg->scb) PetscCall(pg->scb(it, y, pg->cbctx));
+  }
+  if (pg->timed) PetscCall(PetscLogStagePop());
+
+  *outits = its;
+  *reason = PCRICHARDSON_CONVERGED_ITS;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/** @brief In solve mode PCGAMGMC is a deterministic multigrid preconditioner
+    on the sampling hierarchy, also when used with `KSPRICHARDSON`. Default is
+    PETSC_FALSE (sampling mode).
+ */
+PetscErrorCode PCGAMGMCSetSolveMode(PC pc, PetscBool flg)
+{
+  PC_GAMGMC pg = pc->data;
+
+  PetscFunctionBeginUser;
+  pg->solve                = flg;
+  pc->ops->applyrichardson = flg ? NULL : PCApplyRichardson_GAMGMC;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+static PetscErrorCode PCSetFromOptions_GAMGMC(PC pc, PetscOptionItems_ARG PetscOptionsObject)
+{
+  PC_GAMGMC pg     = pc->data;
+  PetscBool solve  = pg->solve;
+  PetscBool timing = pg->timing;
+
   PetscFunctionBeginUser;
   PetscOptionsHeadBegin(PetscOptionsObject, "PCGAMGMC options");
   PetscCall(PetscOptionsString("-pc_gamgmc_mg_type", "The type of the inner multigrid method", NULL, pg->mgtype, pg->mgtype, sizeof(pg->mgtype), NULL));
+  PetscCall(PetscOptionsBool("-pc_gamgmc_carry_residual", "Run the cycle on the sample instead of on the correction", "PCGAMGMCSetCarryResidual", pg->carry_residual, &pg->carry_residual, NULL));
+  PetscCall(PetscOptionsBool("-pc_gamgmc_fused_residual", "Take the residual for the restriction from the smoother", "PCGAMGMCSetFusedResidual", pg->fused_residual, &pg->fused_residual, NULL));
+  PetscCall(PetscOptionsInt("-pc_gamgmc_agglomerate_eq_limit", "Smooth coarse levels on sub-communicators with at least this many rows per rank", "PCGAMGMCSetAgglomerationLimit", pg->agglo_eq_limit, &pg->agglo_eq_limit, NULL));
+  PetscCall(PetscOptionsInt("-pc_gamgmc_single_precision_levels", "Number of coarse levels that sweep in single precision", "PCGAMGMCSetSinglePrecisionLevels", pg->sp_levels, &pg->sp_levels, NULL));
+  PetscCall(PetscOptionsBool("-pc_gamgmc_solve", "Use the hierarchy as a deterministic preconditioner", "PCGAMGMCSetSolveMode", pg->solve, &solve, NULL));
+  PetscCall(PCGAMGMCSetSolveMode(pc, solve));
+  PetscCall(PetscOptionsBool("-pc_gamgmc_view_timing", "Log the time spent on each level and print it with PCView()", "PCGAMGMCSetTiming", pg->timing, &timing, NULL));
+  if (timing != pg->timing) PetscCall(PCGAMGMCSetTiming(pc, timing));
+  PetscCall(PetscOptionsBool("-pc_gamgmc_autotune", "Tune the cycle before the first sample is generated (greedy search, one level at a time)", "PCGAMGMCSetAutotune", pg->autotune, &pg->autotune, NULL));
+  PetscCall(PetscOptionsInt("-pc_gamgmc_autotune_samples", "Length of the pilot chains used for tuning", NULL, pg->autotune_samples, &pg->autotune_samples, NULL));
+  PetscCall(PetscOptionsBool("-pc_gamgmc_autotune_view", "Print the tuned configuration", NULL, pg->autotune_view, &pg->autotune_view, NULL));
+  PetscCall(PetscOptionsString("-pc_gamgmc_setup_save", "Write the colouring and the hierarchy to this file after setup", "ParMGMCMatSaveSetup", pg->setup_save, pg->setup_save, sizeof(pg->setup_save), NULL));
+  PetscCall(PetscOptionsString("-pc_gamgmc_setup_load", "Read the colouring and the hierarchy from this file (if it exists and matches the matrix)", "ParMGMCMatLoadSetup", pg->setup_load, pg->setup_load, sizeof(pg->setup_load), NULL));
   PetscOptionsHeadEnd();
   PetscFunctionReturn(PETSC_SUCCESS);
 }
@@ -401,10 +2117,14 @@ PetscErrorCode PCCreate_GAMGMC(PC pc)
   pg->scb     = NULL;
   pg->del_scb = NULL;
 
+  pg->autotune_samples = 200;
+  pg->stage            = -1;
+
   pc->data                 = pg;
   pc->ops->setup           = PCSetUp_GAMGMC;
   pc->ops->reset           = PCReset_GAMGMC;
   pc->ops->applyrichardson = PCApplyRichardson_GAMGMC;
+  pc->ops->apply           = PCApply_GAMGMC;
   pc->ops->view            = PCView_GAMGMC;
   pc->ops->destroy         = PCDestroy_GAMGMC;
   pc->ops->setfromoptions  = PCSetFromOptions_GAMGMC;
@@ -10,6 +10,8 @@
     
     # Options database keys
     - `-pc_mcgibbs_omega` - the SOR parameter (default is omega = 1)
+    - `-pc_mcgibbs_single_precision` - sweep with single precision matrix values
+      and ghost exchanges (default false, see MCSORSetSinglePrecision())
 
     # Notes
     This implements a MulticolorGibbs sampler wrapped as a PETSc PC. In parallel this uses
@@ -65,6 +67,7 @@ typedef struct {
   MCSOR       mc;
   MatSORType  type;
   Vec         z;
+  PetscBool   single;
 
   PetscBool first_call;
 
@@ -74,6 +77,11 @@ typedef struct {
 
   PetscErrorCode (*prepare_rhs)(PC, Vec, Vec);
 
+  /* Residual of the last sweep, see PCSetFusedResidual */
+  PetscBool        fused_residual;
+  Vec              r, res_b, res_x;
+  PetscObjectState res_bstate, res_xstate;
+
   void *cbctx;
   PetscErrorCode (*scb)(PetscInt, Vec, void *);
   PetscErrorCode (*del_scb)(void *);
@@ -90,6 +98,7 @@ static PetscErrorCode PCDestroy_MulticolorGibbs(PC pc)
   PetscCall(VecDestroy(&pg->w));
   PetscCall(VecDestroy(&pg->sqrtS));
   PetscCall(VecDestroy(&pg->z));
+  PetscCall(VecDestroy(&pg->r));
   if (pg->del_scb) {
     PetscCall(pg->del_scb(pg->cbctx));
     pg->del_scb = NULL;
@@ -109,6 +118,7 @@ static PetscErrorCode PCReset_MulticolorGibbs(PC pc)
   PetscCall(VecDestroy(&pg->w));
   PetscCall(VecDestroy(&pg->sqrtS));
   PetscCall(VecDestroy(&pg->z));
+  PetscCall(VecDestroy(&pg->r));
   if (pg->del_scb) {
     PetscCall(pg->del_scb(pg->cbctx));
     pg->del_scb = NULL;
@@ -160,27 +170,41 @@ static PetscErrorCode PCApplyRichardson_MulticolorGibbs(PC pc, Vec b, Vec y, Vec
   (void)guesszero;
 
   PC_MulticolorGibbs *pg = pc->data;
+  PetscInt            nsweeps;
+  PetscBool           is_lrc;
 
   PetscFunctionBeginUser;
   if (pg->omega_changed) PetscCall(PCMulticolorGibbsUpdateSqrtDiag(pc));
 
-  for (PetscInt it = 0; it < its; ++it) {
-    if (pg->type == SOR_FORWARD_SWEEP || pg->type == SOR_BACKWARD_SWEEP) {
-      PetscCall(pg->prepare_rhs(pc, b, w));
-      PetscCall(MCSORApply(pg->mc, w, y));
-      /* PetscCall(MatSOR(pg->A, w, 1, SOR_FORWARD_SWEEP, 0, 1, 1, y)); */
-    } else {
-      PetscCall(MCSORSetSweepType(pg->mc, SOR_FORWARD_SWEEP));
-      PetscCall(pg->prepare_rhs(pc, b, w));
-      PetscCall(MCSORApply(pg->mc, w, y));
-      /* PetscCall(MatSOR(pg->A, w, 1, SOR_FORWARD_SWEEP, 0, 1, 1, y)); /\*  *\/ */
-
-      PetscCall(MCSORSetSweepType(pg->mc, SOR_BACKWARD_SWEEP));
-      PetscCall(pg->prepare_rhs(pc, b, w));
-      PetscCall(MCSORApply(pg->mc, w, y));
-      /* PetscCall(MatSOR(pg->A, w, 1, SOR_BACKWARD_SWEEP, 0, 1, 1, y)); */
+  /* For MATLRC operators the low-rank correction of each sweep is a global
+     reduction. MCSORApplyBegin only starts it; the noise for the next sweep
+     is drawn while it is in flight, and the low-rank part of that noise
+     (B eta) is reduced together with the correction. */
+  is_lrc  = pg->prepare_rhs == PrepareRHS_LRC;
+  nsweeps = pg->type == SOR_SYMMETRIC_SWEEP ? 2 * its : its;
+  pg->res_x = NULL;
+  if (pg->fused_residual && !pg->r) PetscCall(VecDuplicate(y, &pg->r));
+  PetscCall(pg->prepare_rhs(pc, b, w));
+  for (PetscInt sweep = 0; sweep < nsweeps; ++sweep) {
+    PetscBool more = sweep + 1 < nsweeps ? PETSC_TRUE : PETSC_FALSE;
+
+    if (pg->type == SOR_SYMMETRIC_SWEEP) PetscCall(MCSORSetSweepType(pg->mc, sweep % 2 == 0 ? SOR_FORWARD_SWEEP : SOR_BACKWARD_SWEEP));
+    if (is_lrc && more) {
+      PetscCall(VecSetRandomStandardNormal(pg->w, pg->prand));
+      PetscCall(VecPointwiseMult(pg->w, pg->w, pg->sqrtS));
     }
-    if (pg->scb) PetscCall(pg->scb(it, y, pg->cbctx));
+    if (pg->fused_residual && !more) PetscCall(MCSORSetResidual(pg->mc, b, pg->r));
+    PetscCall(MCSORApplyBegin(pg->mc, w, y, is_lrc && more ? pg->w : NULL));
+    if (more) PetscCall(PrepareRHS_Default(pc, b, w));
+    PetscCall(MCSORApplyEnd(pg->mc, y, more ? w : NULL));
+
+    if (pg->scb && (pg->type != SOR_SYMMETRIC_SWEEP || sweep % 2 == 1)) PetscCall(pg->scb(pg->type == SOR_SYMMETRIC_SWEEP ? sweep / 2 : sweep, y, pg->cbctx));
+  }
+  if (pg->fused_residual && nsweeps > 0) {
+    pg->res_b = b;
+    pg->res_x = y;
+    PetscCall(PetscObjectStateGet((PetscObject)b, &pg->res_bstate));
+    PetscCall(PetscObjectStateGet((PetscObject)y, &pg->res_xstate));
   }
   *outits = its;
   *reason = PCRICHARDSON_CONVERGED_ITS;
@@ -206,6 +230,7 @@ static PetscErrorCode PCSetFromOptions_MulticolorGibbs(PC pc, PetscOptionItems_A
   flag = PETSC_FALSE;
   PetscCall(PetscOptionsBool("-pc_mcgibbs_symmetric", "MulticolorGibbs symmetric sweep", NULL, pg->type == SOR_SYMMETRIC_SWEEP, &flag, NULL));
   if (flag) pg->type = SOR_SYMMETRIC_SWEEP;
+  PetscCall(PetscOptionsBool("-pc_mcgibbs_single_precision", "Sweep with single precision matrix values", "PCMulticolorGibbsSetSinglePrecision", pg->single, &pg->single, NULL));
   PetscOptionsHeadEnd();
   PetscFunctionReturn(PETSC_SUCCESS);
 }
@@ -217,16 +242,35 @@ static PetscErrorCode PCSetUp_MulticolorGibbs(PC pc)
   Mat                 P = pc->pmat;
 
   PetscFunctionBeginUser;
+  if (pc->setupcalled && pc->flag == SAME_NONZERO_PATTERN && pg->mc && P == pg->A) {
+    /* Only the values have changed: keep the colouring and the ghost
+       scatters, refresh the diagonals and the low-rank data */
+    PetscCall(MCSORUpdateValues(pg->mc));
+    if (pg->sqrtS) {
+      Vec S;
+
+      PetscCall(MatLRCGetMats(P, NULL, NULL, &S, NULL));
+      PetscCall(VecCopy(S, pg->sqrtS));
+      PetscCall(VecSqrtAbs(pg->sqrtS));
+    }
+    pg->res_x         = NULL;
+    pg->omega_changed = PETSC_TRUE;
+    PetscFunctionReturn(PETSC_SUCCESS);
+  }
   if (pc->setupcalled) {
     PetscCall(PetscRandomDestroy(&pg->prand));
     PetscCall(VecDestroy(&pg->sqrtS));
     PetscCall(VecDestroy(&pg->sqrtdiag));
     PetscCall(VecDestroy(&pg->w));
     PetscCall(VecDestroy(&pg->z));
+    PetscCall(VecDestroy(&pg->r));
     PetscCall(MCSORDestroy(&pg->mc));
   }
+  pg->res_x = NULL;
   PetscCall(MCSORCreate(P, &pg->mc));
+  PetscCall(MCSORSetFromOptions(pg->mc));
   PetscCall(MCSORSetSweepType(pg->mc, pg->type));
+  if (pg->single) PetscCall(MCSORSetSinglePrecision(pg->mc, PETSC_TRUE));
   PetscCall(MCSORSetUp(pg->mc));
   PetscCall(MatGetType(P, &type));
   if (strcmp(type, MATSEQAIJ) == 0) {
@@ -262,6 +306,8 @@ static PetscErrorCode PCView_MulticolorGibbs(PC pc, PetscViewer viewer)
   PetscFunctionBeginUser;
   PetscCall(MCSORGetNumColors(pg->mc, &ncolors));
   PetscCall(PetscViewerASCIIPrintf(viewer, "Number of colours: %" PetscInt_FMT "\n", ncolors));
+  if (pg->single) PetscCall(PetscViewerASCIIPrintf(viewer, "Single precision sweeps\n"));
+  PetscCall(MCSORView(pg->mc, viewer));
   PetscFunctionReturn(PETSC_SUCCESS);
 }
 
@@ -287,6 +333,46 @@ PetscErrorCode PCMulticolorGibbsSetSweepType(PC pc, MatSORType type)
   PetscFunctionReturn(PETSC_SUCCESS);
 }
 
+/**
+   @brief Sweep with single precision matrix values and ghost exchanges, see
+   MCSORSetSinglePrecision(). Can be changed after setup. Default is PETSC_FALSE.
+ */
+PetscErrorCode PCMulticolorGibbsSetSinglePrecision(PC pc, PetscBool flg)
+{
+  PC_MulticolorGibbs *pg = pc->data;
+
+  PetscFunctionBeginUser;
+  pg->single = flg;
+  if (pg->mc) PetscCall(MCSORSetSinglePrecision(pg->mc, flg));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+static PetscErrorCode PCSetFusedResidual_MulticolorGibbs(PC pc, PetscBool flg)
+{
+  PC_MulticolorGibbs *pg = pc->data;
+
+  PetscFunctionBeginUser;
+  pg->fused_residual = flg;
+  pg->res_x          = NULL;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+static PetscErrorCode PCGetFusedResidual_MulticolorGibbs(PC pc, Vec b, Vec x, Vec r, PetscBool *valid)
+{
+  PC_MulticolorGibbs *pg = pc->data;
+  PetscObjectState    bstate, xstate;
+
+  PetscFunctionBeginUser;
+  *valid = PETSC_FALSE;
+  if (!pg->r || !pg->res_x || pg->res_x != x || pg->res_b != b) PetscFunctionReturn(PETSC_SUCCESS);
+  PetscCall(PetscObjectStateGet((PetscObject)b, &bstate));
+  PetscCall(PetscObjectStateGet((PetscObject)x, &xstate));
+  if (bstate != pg->res_bstate || xstate != pg->res_xstate) PetscFunctionReturn(PETSC_SUCCESS);
+  PetscCall(VecCopy(pg->r, r));
+  *valid = PETSC_TRUE;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
 static PetscErrorCode PCSetSampleCallback_MulticolorGibbs(PC pc, PetscErrorCode (*cb)(PetscInt, Vec, void *), void *ctx, PetscErrorCode (*deleter)(void *))
 {
   PC_MulticolorGibbs *pg = pc->data;
@@ -323,5 +409,7 @@ PetscErrorCode PCCreate_MulticolorGibbs(PC pc)
   pc->ops->reset           = PCReset_MulticolorGibbs;
   pc->ops->view            = PCView_MulticolorGibbs;
   PetscCall(PCRegisterSetSampleCallback(pc, PCSetSampleCallback_MulticolorGibbs));
+  PetscCall(PetscObjectComposeFunction((PetscObject)pc, "PCSetFusedResidual_C", PCSetFusedResidual_MulticolorGibbs));
+  PetscCall(PetscObjectComposeFunction((PetscObject)pc, "PCGetFusedResidual_C", PCGetFusedResidual_MulticolorGibbs));
   PetscFunctionReturn(PETSC_SUCCESS);
 }
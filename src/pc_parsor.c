@@ -7,6 +7,7 @@
 */
 
 #include "parmgmc/pc/pc_parsor.h"
+#include "parmgmc/nodehalo.h"
 #include "parmgmc/parmgmc.h"
 
 #include <petsc/private/pcimpl.h>
@@ -59,7 +60,8 @@ static PetscErrorCode LocalMatInvertDiagonalForSOR(Mat A, PetscScalar omega, Pet
 
   PetscFunctionBegin;
   PetscCall(MatGetSize(A, &m, NULL));
-  PetscCall(MatGetDiagonalPointers_SeqAIJ(A, &diag));
+  if (*diag_out) diag = *diag_out; // Same nonzero pattern, see PCSetUp_PARSOR
+  else PetscCall(MatGetDiagonalPointers_SeqAIJ(A, &diag));
 
   if (!*idiag_out) PetscCall(MatCreateVecs(A, NULL, idiag_out));
 
@@ -95,6 +97,13 @@ typedef struct {
 
   VecScatter topsct;
   VecScatter botsct;
+
+  /* Node-aware replacements for topsct/botsct (buffer 0 is used for the top,
+     buffer 1 for the bot exchange) */
+  PetscBool    node_aware;
+  NodeHalo     nh;
+  NodeHaloPlan topplan, botplan;
+
   IS         top;
   IS         bot;
   IS         mid;
@@ -138,6 +147,8 @@ typedef struct {
   MPI_Comm         comm;
 
   PetscMPIInt tag;
+
+  PetscInt refct; // Shared between all PCPARSORs on the same matrix, see ParallelSORGet
 } ParallelSORData;
 
 typedef struct {
@@ -146,6 +157,8 @@ typedef struct {
   PetscInt         its;
   Vec              idiag_vec;
   PetscInt        *diag;
+  PetscBool        pipelined;
+  PetscBool        node_aware;
 } *PC_PARSOR;
 
 static PetscErrorCode CreateGhostCommunication(Mat matin, Vec *lvec_out, VecScatter *mvctx_out)
@@ -384,7 +397,12 @@ static PetscErrorCode ParallelSORPartitionNodes(Mat matin, ParallelSORData *pars
   }
   PetscCall(ISCreateGeneral(PetscObjectComm((PetscObject)matin), cnt, from, PETSC_OWN_POINTER, &ix));
   PetscCall(ISCreateGeneral(PETSC_COMM_SELF, cnt, to, PETSC_OWN_POINTER, &iy));
-  PetscCall(VecScatterCreate(xcol, ix, parsor->lvec, iy, &parsor->topsct));
+  if (parsor->node_aware) {
+    PetscCall(NodeHaloCreate(xcol, 2, &parsor->nh));
+    PetscCall(NodeHaloPlanCreate(parsor->nh, 0, xcol, ix, parsor->lvec, iy, &parsor->topplan));
+  } else {
+    PetscCall(VecScatterCreate(xcol, ix, parsor->lvec, iy, &parsor->topsct));
+  }
   PetscCall(ISDestroy(&ix));
   PetscCall(ISDestroy(&iy));
 
@@ -410,7 +428,8 @@ static PetscErrorCode ParallelSORPartitionNodes(Mat matin, ParallelSORData *pars
   }
   PetscCall(ISCreateGeneral(PetscObjectComm((PetscObject)matin), cnt, from, PETSC_OWN_POINTER, &ix));
   PetscCall(ISCreateGeneral(PETSC_COMM_SELF, cnt, to, PETSC_OWN_POINTER, &iy));
-  PetscCall(VecScatterCreate(xcol, ix, parsor->lvec, iy, &parsor->botsct));
+  if (parsor->node_aware) PetscCall(NodeHaloPlanCreate(parsor->nh, 1, xcol, ix, parsor->lvec, iy, &parsor->botplan));
+  else PetscCall(VecScatterCreate(xcol, ix, parsor->lvec, iy, &parsor->botsct));
   PetscCall(ISDestroy(&ix));
   PetscCall(ISDestroy(&iy));
 
@@ -619,12 +638,28 @@ static PetscErrorCode ParallelSORSetUp(Mat matin, ParallelSORData *parsor)
   PetscFunctionReturn(PETSC_SUCCESS);
 }
 
+/* Refreshes the cached pointers to the matrix values; the partition of the
+   nodes and the communication pattern only depend on the nonzero pattern */
+static PetscErrorCode ParallelSORUpdateValues(Mat matin, ParallelSORData *parsor)
+{
+  Mat          A, B;
+  PetscScalar *aa_tmp, *ba_tmp;
+
+  PetscFunctionBegin;
+  PetscCall(MatMPIAIJGetSeqAIJ(matin, &A, &B, NULL));
+  PetscCall(MatSeqAIJGetCSRAndMemType(A, NULL, NULL, &aa_tmp, NULL));
+  PetscCall(MatSeqAIJGetCSRAndMemType(B, NULL, NULL, &ba_tmp, NULL));
+  parsor->aa = aa_tmp;
+  parsor->ba = ba_tmp;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
 static PetscErrorCode ParallelSORDestroy(ParallelSORData *parsor)
 {
   PetscInt nmid;
 
   PetscFunctionBegin;
-  if (!parsor) PetscFunctionReturn(PETSC_SUCCESS);
+  if (!parsor || --parsor->refct > 0) PetscFunctionReturn(PETSC_SUCCESS);
   PetscCall(ISDestroy(&parsor->top));
   PetscCall(ISDestroy(&parsor->bot));
   nmid = parsor->nmid;
@@ -634,6 +669,9 @@ static PetscErrorCode ParallelSORDestroy(ParallelSORData *parsor)
   PetscCall(ISDestroy(&parsor->int2));
   PetscCall(VecScatterDestroy(&parsor->topsct));
   PetscCall(VecScatterDestroy(&parsor->botsct));
+  PetscCall(NodeHaloPlanDestroy(&parsor->topplan));
+  PetscCall(NodeHaloPlanDestroy(&parsor->botplan));
+  PetscCall(NodeHaloDestroy(&parsor->nh));
   PetscCall(VecDestroy(&parsor->lvec));
   PetscCall(PetscFree(parsor->mid_done));
   PetscCall(PetscFree(parsor->mid_node_n_deps));
@@ -663,6 +701,37 @@ static PetscErrorCode ParallelSORDestroy(ParallelSORData *parsor)
   PetscFunctionReturn(PETSC_SUCCESS);
 }
 
+static PetscErrorCode ParallelSORCacheDestroy(void *data)
+{
+  PetscFunctionBegin;
+  PetscCall(ParallelSORDestroy((ParallelSORData *)data));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* The partition of the nodes and the communication pattern only depend on
+   the nonzero pattern, so they are computed once per matrix and shared by
+   all PCPARSORs on it (see ParMGMCMatComposeCache) */
+static PetscErrorCode ParallelSORGet(Mat matin, PetscBool node_aware, ParallelSORData **parsor)
+{
+  const char      *name = node_aware ? "ParallelSORNodeAware" : "ParallelSOR";
+  PetscObjectState state;
+
+  PetscFunctionBegin;
+  PetscCall(MatGetNonzeroState(matin, &state));
+  PetscCall(ParMGMCMatQueryCache(matin, name, state, (void **)parsor));
+  if (*parsor) {
+    PetscCall(ParallelSORUpdateValues(matin, *parsor));
+  } else {
+    PetscCall(PetscNew(parsor));
+    (*parsor)->node_aware = node_aware;
+    (*parsor)->refct      = 1;
+    PetscCall(ParallelSORSetUp(matin, *parsor));
+    PetscCall(ParMGMCMatComposeCache(matin, name, state, *parsor, ParallelSORCacheDestroy));
+  }
+  (*parsor)->refct++;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
 static PetscErrorCode SORLocalForwardSweepIS(const PetscInt *rowptr, const PetscInt *colind, const MatScalar *matvals, const PetscInt *diag, const PetscScalar *idiag, PetscReal omega, IS is, const PetscScalar *b, PetscScalar *x, const PetscInt *browptr, const PetscInt *bcolind, const MatScalar *bmatvals, const PetscScalar *lv)
 {
   PetscInt        isn;
@@ -700,7 +769,7 @@ static PetscErrorCode SORLocalForwardSweepIS(const PetscInt *rowptr, const Petsc
   PetscFunctionReturn(PETSC_SUCCESS);
 }
 
-static PetscErrorCode ParallelSORApply(ParallelSORData *parsor, const PetscInt *diag, const PetscScalar *idiag_arr, Vec bb, PetscReal omega, PetscInt its, PetscBool zero_initial_guess, Vec xx)
+static PetscErrorCode ParallelSORSweepMid(ParallelSORData *parsor, const PetscInt *diag, const PetscScalar *idiag_arr, Vec bb, PetscReal omega, Vec xx)
 {
   const MatScalar   *aa = parsor->aa, *ba = parsor->ba;
   const PetscInt    *arowptr = parsor->arowptr, *acolind = parsor->acolind;
@@ -711,168 +780,229 @@ static PetscErrorCode ParallelSORApply(ParallelSORData *parsor, const PetscInt *
   PetscInt           nmid = parsor->nmid, rstart = parsor->rstart, mid_remaining;
   PetscInt          *mid_send_cursor = parsor->mid_send_cursor;
   PetscInt          *mid_dep_left    = parsor->mid_dep_left;
-  PetscBool          first_iter      = zero_initial_guess;
+  MPI_Comm           comm            = parsor->comm;
 
   PetscFunctionBegin;
+  for (PetscInt i = 0; i < nmid; ++i) {
+    parsor->mid_done[i] = PETSC_FALSE;
+    mid_dep_left[i]     = parsor->mid_node_n_deps[i];
+  }
+  for (PetscInt p = 0; p < parsor->n_mid_send_nbs; ++p) {
+    mid_send_cursor[parsor->mid_send_nbs[p]] = 0;
+    parsor->mid_send_reqs[p]                 = MPI_REQUEST_NULL;
+  }
 
-  while (its--) {
-    PetscCall(VecZeroEntries(parsor->lvec));
-    if (first_iter) {
-      PetscCall(VecZeroEntries(xx));
-    } else {
-      PetscCall(VecScatterBegin(parsor->topsct, xx, parsor->lvec, INSERT_VALUES, SCATTER_FORWARD));
-      PetscCall(VecScatterEnd(parsor->topsct, xx, parsor->lvec, INSERT_VALUES, SCATTER_FORWARD));
-    }
-    first_iter = PETSC_FALSE;
-    {
-      const PetscScalar *lvread;
-      PetscCall(VecGetArrayRead(parsor->lvec, &lvread));
-      PetscCall(VecGetArray(xx, &x));
-      PetscCall(VecGetArrayRead(bb, &b1));
-      PetscCall(SORLocalForwardSweepIS(arowptr, acolind, aa, diag, idiag_arr, omega, parsor->top, b1, x, browptr, bcolind, ba, lvread));
-      PetscCall(VecRestoreArrayRead(bb, &b1));
-      PetscCall(VecRestoreArray(xx, &x));
-      PetscCall(VecRestoreArrayRead(parsor->lvec, &lvread));
-    }
+  for (PetscInt p = 0; p < parsor->n_mid_recv_nbs; ++p) PetscCallMPI(MPI_Irecv(parsor->mid_recv_bufs[p], parsor->mid_recv_buf_size[p] * sizeof(MidIDData), MPI_BYTE, parsor->mid_recv_nbs[p], parsor->tag, comm, &parsor->mid_recv_reqs[p]));
 
-    PetscCall(VecCopy(xx, parsor->xx));
-    PetscCall(VecScatterBegin(parsor->botsct, parsor->xx, parsor->lvec, INSERT_VALUES, SCATTER_FORWARD));
-    PetscCall(VecGetArray(xx, &x));
-    PetscCall(VecGetArrayRead(bb, &b1));
-    PetscCall(SORLocalForwardSweepIS(arowptr, acolind, aa, diag, idiag_arr, omega, parsor->int1, b1, x, NULL, NULL, NULL, NULL));
-    PetscCall(VecRestoreArrayRead(bb, &b1));
-    PetscCall(VecRestoreArray(xx, &x));
-    PetscCall(VecScatterEnd(parsor->botsct, parsor->xx, parsor->lvec, INSERT_VALUES, SCATTER_FORWARD));
-    {
-      MPI_Comm comm = parsor->comm;
+  PetscCall(VecGetArray(xx, &x));
+  PetscCall(VecGetArray(parsor->lvec, &lv));
+  PetscCall(VecGetArrayRead(bb, &b1));
 
-      for (PetscInt i = 0; i < nmid; ++i) {
-        parsor->mid_done[i] = PETSC_FALSE;
-        mid_dep_left[i]     = parsor->mid_node_n_deps[i];
-      }
-      for (PetscInt p = 0; p < parsor->n_mid_send_nbs; ++p) {
-        mid_send_cursor[parsor->mid_send_nbs[p]] = 0;
-        parsor->mid_send_reqs[p]                 = MPI_REQUEST_NULL;
-      }
+  mid_remaining = nmid;
+  while (mid_remaining > 0) {
+    PetscBool progress = PETSC_FALSE;
 
-      for (PetscInt p = 0; p < parsor->n_mid_recv_nbs; ++p) PetscCallMPI(MPI_Irecv(parsor->mid_recv_bufs[p], parsor->mid_recv_buf_size[p] * sizeof(MidIDData), MPI_BYTE, parsor->mid_recv_nbs[p], parsor->tag, comm, &parsor->mid_recv_reqs[p]));
-
-      PetscCall(VecGetArray(xx, &x));
-      PetscCall(VecGetArray(parsor->lvec, &lv));
-      PetscCall(VecGetArrayRead(bb, &b1));
-
-      mid_remaining = nmid;
-      while (mid_remaining > 0) {
-        PetscBool progress = PETSC_FALSE;
-
-        for (PetscInt m = 0; m < nmid; ++m) {
-          if (parsor->mid_done[m]) continue;
-          if (mid_dep_left[m] > 0) continue;
-
-          parsor->mid_done[m] = PETSC_TRUE;
-          mid_remaining--;
-          progress = PETSC_TRUE;
-
-          {
-            PetscInt         row = midnodes[m];
-            PetscScalar      sum = b1[row];
-            const MatScalar *v;
-            const PetscInt  *idx;
-            PetscInt         n;
-
-            n   = diag[row] - arowptr[row];
-            idx = acolind + arowptr[row];
-            v   = aa + arowptr[row];
-            SparseDenseMinusDot(&sum, x, v, idx, n);
-            n   = arowptr[row + 1] - diag[row] - 1;
-            idx = acolind + diag[row] + 1;
-            v   = aa + diag[row] + 1;
-            SparseDenseMinusDot(&sum, x, v, idx, n);
-            n   = browptr[row + 1] - browptr[row];
-            idx = bcolind + browptr[row];
-            v   = ba + browptr[row];
-            SparseDenseMinusDot(&sum, lv, v, idx, n);
-
-            x[row] = (1. - omega) * x[row] + sum * idiag_arr[row];
-
-            for (PetscInt k = 0; k < parsor->mid_local_dep_count[m]; ++k) { mid_dep_left[parsor->mid_local_deps[m][k]]--; }
-
-            {
-              PetscInt global_row = rstart + row;
-              for (PetscInt s = 0; s < parsor->mid_node_n_send_to[m]; ++s) {
-                PetscInt dest = parsor->mid_node_send_to_nb[m][s];
-                PetscInt cur  = mid_send_cursor[dest];
-
-                parsor->mid_send_bufs[dest][cur].id   = global_row;
-                parsor->mid_send_bufs[dest][cur].data = x[row];
-                mid_send_cursor[dest]++;
-              }
-            }
-          }
-        }
+    for (PetscInt m = 0; m < nmid; ++m) {
+      if (parsor->mid_done[m]) continue;
+      if (mid_dep_left[m] > 0) continue;
 
-        for (PetscInt p = 0; p < parsor->n_mid_send_nbs; ++p) {
-          PetscMPIInt dest_rank = parsor->mid_send_nbs[p];
-          if (mid_send_cursor[dest_rank] > 0) {
-            if (parsor->mid_send_reqs[p] != MPI_REQUEST_NULL) PetscCallMPI(MPI_Wait(&parsor->mid_send_reqs[p], MPI_STATUS_IGNORE));
-            PetscCallMPI(MPI_Isend(parsor->mid_send_bufs[dest_rank], mid_send_cursor[dest_rank] * sizeof(MidIDData), MPI_BYTE, dest_rank, parsor->tag, comm, &parsor->mid_send_reqs[p]));
-            mid_send_cursor[dest_rank] = 0;
-          }
-        }
+      parsor->mid_done[m] = PETSC_TRUE;
+      mid_remaining--;
+      progress = PETSC_TRUE;
+
+      {
+        PetscInt         row = midnodes[m];
+        PetscScalar      sum = b1[row];
+        const MatScalar *v;
+        const PetscInt  *idx;
+        PetscInt         n;
+
+        n   = diag[row] - arowptr[row];
+        idx = acolind + arowptr[row];
+        v   = aa + arowptr[row];
+        SparseDenseMinusDot(&sum, x, v, idx, n);
+        n   = arowptr[row + 1] - diag[row] - 1;
+        idx = acolind + diag[row] + 1;
+        v   = aa + diag[row] + 1;
+        SparseDenseMinusDot(&sum, x, v, idx, n);
+        n   = browptr[row + 1] - browptr[row];
+        idx = bcolind + browptr[row];
+        v   = ba + browptr[row];
+        SparseDenseMinusDot(&sum, lv, v, idx, n);
+
+        x[row] = (1. - omega) * x[row] + sum * idiag_arr[row];
 
-        if (progress) continue;
+        for (PetscInt k = 0; k < parsor->mid_local_dep_count[m]; ++k) { mid_dep_left[parsor->mid_local_deps[m][k]]--; }
 
-        if (mid_remaining == 0) break;
         {
-          PetscMPIInt completed, bytes;
-          MPI_Status  mpi_status;
-
-          PetscCallMPI(MPI_Waitany(parsor->n_mid_recv_nbs, parsor->mid_recv_reqs, &completed, &mpi_status));
-          PetscAssert(completed != MPI_UNDEFINED, MPI_COMM_SELF, PETSC_ERR_PLIB, "MPI_Waitany returned undefined index");
-          PetscCallMPI(MPI_Get_count(&mpi_status, MPI_BYTE, &bytes));
-          PetscAssert(bytes % (PetscInt)sizeof(MidIDData) == 0, PETSC_COMM_SELF, PETSC_ERR_PLIB, "Received data size not a multiple of MidIDData");
-          for (PetscInt i = 0; i < bytes / (PetscInt)sizeof(MidIDData); ++i) {
-            PetscInt      gid = parsor->mid_recv_bufs[completed][i].id;
-            PetscScalar   val = parsor->mid_recv_bufs[completed][i].data;
-            PetscInt      lvec_idx;
-            PetscBool     found;
-            PetscHashIter hit;
-
-            PetscCall(PetscHMapIFind(parsor->global_to_lvec, gid, &hit, &found));
-            PetscCheck(found, PETSC_COMM_SELF, PETSC_ERR_PLIB, "Received MID update for global index %" PetscInt_FMT " not found in lvec map", gid);
-            PetscCall(PetscHMapIIterGet(parsor->global_to_lvec, hit, &lvec_idx));
-            lv[lvec_idx] = val;
-
-            for (PetscInt k = 0; k < parsor->lvec_to_mid_count[lvec_idx]; ++k) { mid_dep_left[parsor->lvec_to_mid_nodes[lvec_idx][k]]--; }
+          PetscInt global_row = rstart + row;
+          for (PetscInt s = 0; s < parsor->mid_node_n_send_to[m]; ++s) {
+            PetscInt dest = parsor->mid_node_send_to_nb[m][s];
+            PetscInt cur  = mid_send_cursor[dest];
+
+            parsor->mid_send_bufs[dest][cur].id   = global_row;
+            parsor->mid_send_bufs[dest][cur].data = x[row];
+            mid_send_cursor[dest]++;
           }
-
-          PetscCallMPI(MPI_Irecv(parsor->mid_recv_bufs[completed], parsor->mid_recv_buf_size[completed] * sizeof(MidIDData), MPI_BYTE, parsor->mid_recv_nbs[completed], parsor->tag, comm, &parsor->mid_recv_reqs[completed]));
         }
       }
+    }
 
-      for (PetscInt p = 0; p < parsor->n_mid_send_nbs; ++p) {
+    for (PetscInt p = 0; p < parsor->n_mid_send_nbs; ++p) {
+      PetscMPIInt dest_rank = parsor->mid_send_nbs[p];
+      if (mid_send_cursor[dest_rank] > 0) {
         if (parsor->mid_send_reqs[p] != MPI_REQUEST_NULL) PetscCallMPI(MPI_Wait(&parsor->mid_send_reqs[p], MPI_STATUS_IGNORE));
+        PetscCallMPI(MPI_Isend(parsor->mid_send_bufs[dest_rank], mid_send_cursor[dest_rank] * sizeof(MidIDData), MPI_BYTE, dest_rank, parsor->tag, comm, &parsor->mid_send_reqs[p]));
+        mid_send_cursor[dest_rank] = 0;
       }
-      for (PetscInt p = 0; p < parsor->n_mid_recv_nbs; ++p) {
-        if (parsor->mid_recv_reqs[p] != MPI_REQUEST_NULL) PetscCallMPI(MPI_Cancel(&parsor->mid_recv_reqs[p]));
+    }
+
+    if (progress) continue;
+
+    if (mid_remaining == 0) break;
+    {
+      PetscMPIInt completed, bytes;
+      MPI_Status  mpi_status;
+
+      PetscCallMPI(MPI_Waitany(parsor->n_mid_recv_nbs, parsor->mid_recv_reqs, &completed, &mpi_status));
+      PetscAssert(completed != MPI_UNDEFINED, MPI_COMM_SELF, PETSC_ERR_PLIB, "MPI_Waitany returned undefined index");
+      PetscCallMPI(MPI_Get_count(&mpi_status, MPI_BYTE, &bytes));
+      PetscAssert(bytes % (PetscInt)sizeof(MidIDData) == 0, PETSC_COMM_SELF, PETSC_ERR_PLIB, "Received data size not a multiple of MidIDData");
+      for (PetscInt i = 0; i < bytes / (PetscInt)sizeof(MidIDData); ++i) {
+        PetscInt      gid = parsor->mid_recv_bufs[completed][i].id;
+        PetscScalar   val = parsor->mid_recv_bufs[completed][i].data;
+        PetscInt      lvec_idx;
+        PetscBool     found;
+        PetscHashIter hit;
+
+        PetscCall(PetscHMapIFind(parsor->global_to_lvec, gid, &hit, &found));
+        PetscCheck(found, PETSC_COMM_SELF, PETSC_ERR_PLIB, "Received MID update for global index %" PetscInt_FMT " not found in lvec map", gid);
+        PetscCall(PetscHMapIIterGet(parsor->global_to_lvec, hit, &lvec_idx));
+        lv[lvec_idx] = val;
+
+        for (PetscInt k = 0; k < parsor->lvec_to_mid_count[lvec_idx]; ++k) { mid_dep_left[parsor->lvec_to_mid_nodes[lvec_idx][k]]--; }
       }
 
-      PetscCall(VecRestoreArrayRead(bb, &b1));
-      PetscCall(VecRestoreArray(parsor->lvec, &lv));
-      PetscCall(VecRestoreArray(xx, &x));
-      PetscCheck(mid_remaining == 0, PETSC_COMM_SELF, PETSC_ERR_PLIB, "MID loop ended with %" PetscInt_FMT " nodes remaining", mid_remaining);
+      PetscCallMPI(MPI_Irecv(parsor->mid_recv_bufs[completed], parsor->mid_recv_buf_size[completed] * sizeof(MidIDData), MPI_BYTE, parsor->mid_recv_nbs[completed], parsor->tag, comm, &parsor->mid_recv_reqs[completed]));
     }
-    {
-      const PetscScalar *lvread;
-      PetscCall(VecGetArrayRead(parsor->lvec, &lvread));
-      PetscCall(VecGetArray(xx, &x));
-      PetscCall(VecGetArrayRead(bb, &b1));
-      PetscCall(SORLocalForwardSweepIS(arowptr, acolind, aa, diag, idiag_arr, omega, parsor->int2, b1, x, NULL, NULL, NULL, NULL));
-      PetscCall(SORLocalForwardSweepIS(arowptr, acolind, aa, diag, idiag_arr, omega, parsor->bot, b1, x, browptr, bcolind, ba, lvread));
-      PetscCall(VecRestoreArrayRead(bb, &b1));
-      PetscCall(VecRestoreArray(xx, &x));
-      PetscCall(VecRestoreArrayRead(parsor->lvec, &lvread));
+  }
+
+  for (PetscInt p = 0; p < parsor->n_mid_send_nbs; ++p) {
+    if (parsor->mid_send_reqs[p] != MPI_REQUEST_NULL) PetscCallMPI(MPI_Wait(&parsor->mid_send_reqs[p], MPI_STATUS_IGNORE));
+  }
+  for (PetscInt p = 0; p < parsor->n_mid_recv_nbs; ++p) {
+    if (parsor->mid_recv_reqs[p] != MPI_REQUEST_NULL) PetscCallMPI(MPI_Cancel(&parsor->mid_recv_reqs[p]));
+  }
+
+  PetscCall(VecRestoreArrayRead(bb, &b1));
+  PetscCall(VecRestoreArray(parsor->lvec, &lv));
+  PetscCall(VecRestoreArray(xx, &x));
+  PetscCheck(mid_remaining == 0, PETSC_COMM_SELF, PETSC_ERR_PLIB, "MID loop ended with %" PetscInt_FMT " nodes remaining", mid_remaining);
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+static PetscErrorCode ParallelSORSweepIS(ParallelSORData *parsor, const PetscInt *diag, const PetscScalar *idiag_arr, Vec bb, PetscReal omega, IS is, PetscBool ghosted, Vec xx)
+{
+  const PetscScalar *lvread = NULL, *b1;
+  PetscScalar       *x;
+
+  PetscFunctionBegin;
+  if (ghosted) PetscCall(VecGetArrayRead(parsor->lvec, &lvread));
+  PetscCall(VecGetArray(xx, &x));
+  PetscCall(VecGetArrayRead(bb, &b1));
+  if (ghosted) PetscCall(SORLocalForwardSweepIS(parsor->arowptr, parsor->acolind, parsor->aa, diag, idiag_arr, omega, is, b1, x, parsor->browptr, parsor->bcolind, parsor->ba, lvread));
+  else PetscCall(SORLocalForwardSweepIS(parsor->arowptr, parsor->acolind, parsor->aa, diag, idiag_arr, omega, is, b1, x, NULL, NULL, NULL, NULL));
+  PetscCall(VecRestoreArrayRead(bb, &b1));
+  PetscCall(VecRestoreArray(xx, &x));
+  if (ghosted) PetscCall(VecRestoreArrayRead(parsor->lvec, &lvread));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* Ghost exchange of the values needed by the top (`top` = PETSC_TRUE) or the
+   bot and mid nodes. In node-aware mode the values owned by processors on the
+   same node are read from shared memory; the fence that makes sure they have
+   been published is part of the End call. */
+static PetscErrorCode ParallelSORExchangeBegin(ParallelSORData *parsor, PetscBool top, Vec x)
+{
+  PetscFunctionBegin;
+  if (parsor->nh) {
+    PetscCall(NodeHaloPublish(parsor->nh, top ? 0 : 1, x, NULL));
+    PetscCall(NodeHaloPlanBegin(top ? parsor->topplan : parsor->botplan, x, parsor->lvec));
+  } else {
+    PetscCall(VecScatterBegin(top ? parsor->topsct : parsor->botsct, x, parsor->lvec, INSERT_VALUES, SCATTER_FORWARD));
+  }
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+static PetscErrorCode ParallelSORExchangeEnd(ParallelSORData *parsor, PetscBool top, Vec x)
+{
+  PetscFunctionBegin;
+  if (parsor->nh) {
+    PetscCall(NodeHaloFence(parsor->nh));
+    PetscCall(NodeHaloPlanEnd(top ? parsor->topplan : parsor->botplan, x, parsor->lvec));
+  } else {
+    PetscCall(VecScatterEnd(top ? parsor->topsct : parsor->botsct, x, parsor->lvec, INSERT_VALUES, SCATTER_FORWARD));
+  }
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* Performs `its` forward SOR sweeps.  Each sweep processes the local nodes in
+   the order top, int1, mid, int2, bot, with the top and bot ghost exchanges
+   overlapped with the int1 sweep.
+
+   In pipelined mode, the bot nodes are swept before int2 and the top exchange
+   of the next iteration is posted right after, i.e., as soon as all values a
+   neighbouring processor needs for its top nodes are final. It then completes
+   while int2 is being swept (and while `rhs`/`post` are running). Note that
+   this changes the ordering of the local nodes, so the pipelined and
+   non-pipelined sweeps are different (but both valid) SOR iterations.
+
+   If `rhs` is not NULL, it is called before iteration it > 0 to update the
+   right hand side bb in place (this is used by the samplers to draw fresh
+   noise). If `post` is not NULL, it is called after each iteration with the
+   current iterate. */
+static PetscErrorCode ParallelSORApply(ParallelSORData *parsor, const PetscInt *diag, const PetscScalar *idiag_arr, Vec bb, PetscReal omega, PetscInt its, PetscBool zero_initial_guess, PetscBool pipelined, PetscErrorCode (*rhs)(PetscInt, Vec, void *), PetscErrorCode (*post)(PetscInt, Vec, void *), void *hookctx, Vec xx)
+{
+  PetscBool first_iter = zero_initial_guess;
+
+  PetscFunctionBegin;
+  for (PetscInt it = 0; it < its; ++it) {
+    if (it == 0 || !pipelined) {
+      if (it > 0 && rhs) PetscCall(rhs(it, bb, hookctx));
+      PetscCall(VecZeroEntries(parsor->lvec));
+      if (first_iter) {
+        PetscCall(VecZeroEntries(xx));
+      } else {
+        PetscCall(ParallelSORExchangeBegin(parsor, PETSC_TRUE, xx));
+        PetscCall(ParallelSORExchangeEnd(parsor, PETSC_TRUE, xx));
+      }
+    } else {
+      /* Top exchange was posted at the end of the previous iteration */
+      PetscCall(ParallelSORExchangeEnd(parsor, PETSC_TRUE, parsor->xx));
+    }
+    first_iter = PETSC_FALSE;
+    PetscCall(ParallelSORSweepIS(parsor, diag, idiag_arr, bb, omega, parsor->top, PETSC_TRUE, xx));
+
+    PetscCall(VecCopy(xx, parsor->xx));
+    PetscCall(ParallelSORExchangeBegin(parsor, PETSC_FALSE, parsor->xx));
+    PetscCall(ParallelSORSweepIS(parsor, diag, idiag_arr, bb, omega, parsor->int1, PETSC_FALSE, xx));
+    PetscCall(ParallelSORExchangeEnd(parsor, PETSC_FALSE, parsor->xx));
+    PetscCall(ParallelSORSweepMid(parsor, diag, idiag_arr, bb, omega, xx));
+
+    if (pipelined) {
+      PetscCall(ParallelSORSweepIS(parsor, diag, idiag_arr, bb, omega, parsor->bot, PETSC_TRUE, xx));
+      if (it + 1 < its) {
+        PetscCall(VecZeroEntries(parsor->lvec));
+        PetscCall(VecCopy(xx, parsor->xx));
+        PetscCall(ParallelSORExchangeBegin(parsor, PETSC_TRUE, parsor->xx));
+      }
+      PetscCall(ParallelSORSweepIS(parsor, diag, idiag_arr, bb, omega, parsor->int2, PETSC_FALSE, xx));
+      if (it + 1 < its && rhs) PetscCall(rhs(it + 1, bb, hookctx));
+    } else {
+      PetscCall(ParallelSORSweepIS(parsor, diag, idiag_arr, bb, omega, parsor->int2, PETSC_FALSE, xx));
+      PetscCall(ParallelSORSweepIS(parsor, diag, idiag_arr, bb, omega, parsor->bot, PETSC_TRUE, xx));
     }
+    if (post) PetscCall(post(it, xx, hookctx));
   }
   PetscFunctionReturn(PETSC_SUCCESS);
 }
@@ -884,7 +1014,7 @@ static PetscErrorCode PCApply_PARSOR(PC pc, Vec b, Vec x)
 
   PetscFunctionBegin;
   PetscCall(VecGetArrayRead(parsor->idiag_vec, &idiag_arr));
-  PetscCall(ParallelSORApply(parsor->parsor_data, parsor->diag, idiag_arr, b, parsor->omega, parsor->its, PETSC_TRUE, x));
+  PetscCall(ParallelSORApply(parsor->parsor_data, parsor->diag, idiag_arr, b, parsor->omega, parsor->its, PETSC_TRUE, parsor->pipelined, NULL, NULL, NULL, x));
   PetscCall(VecRestoreArrayRead(parsor->idiag_vec, &idiag_arr));
   PetscFunctionReturn(PETSC_SUCCESS);
 }
@@ -898,7 +1028,29 @@ PetscErrorCode PCPARSORApplySOR(PC pc, Vec b, PetscInt its, PetscBool zero_initi
   PetscValidHeaderSpecific(pc, PC_CLASSID, 1);
   parsor = (PC_PARSOR)pc->data;
   PetscCall(VecGetArrayRead(parsor->idiag_vec, &idiag_arr));
-  PetscCall(ParallelSORApply(parsor->parsor_data, parsor->diag, idiag_arr, b, parsor->omega, its, zero_initial_guess, x));
+  PetscCall(ParallelSORApply(parsor->parsor_data, parsor->diag, idiag_arr, b, parsor->omega, its, zero_initial_guess, parsor->pipelined, NULL, NULL, NULL, x));
+  PetscCall(VecRestoreArrayRead(parsor->idiag_vec, &idiag_arr));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/**
+   @brief Same as PCPARSORApplySOR but calls `rhs` before every iteration
+   it > 0 to update the right hand side b in place and `post` after every
+   iteration with the current iterate x. Either callback can be NULL.
+
+   In pipelined mode (see PCPARSORSetPipelined) both callbacks run while the
+   ghost exchange for the next iteration is in flight.
+ */
+PetscErrorCode PCPARSORApplySORWithHooks(PC pc, Vec b, PetscInt its, PetscBool zero_initial_guess, PetscErrorCode (*rhs)(PetscInt, Vec, void *), PetscErrorCode (*post)(PetscInt, Vec, void *), void *ctx, Vec x)
+{
+  PC_PARSOR          parsor;
+  const PetscScalar *idiag_arr;
+
+  PetscFunctionBegin;
+  PetscValidHeaderSpecific(pc, PC_CLASSID, 1);
+  parsor = (PC_PARSOR)pc->data;
+  PetscCall(VecGetArrayRead(parsor->idiag_vec, &idiag_arr));
+  PetscCall(ParallelSORApply(parsor->parsor_data, parsor->diag, idiag_arr, b, parsor->omega, its, zero_initial_guess, parsor->pipelined, rhs, post, ctx, x));
   PetscCall(VecRestoreArrayRead(parsor->idiag_vec, &idiag_arr));
   PetscFunctionReturn(PETSC_SUCCESS);
 }
@@ -936,6 +1088,7 @@ static PetscErrorCode PCSetUp_PARSOR(PC pc)
   PetscBool is_mpiaij, is_seqaij;
   PetscReal omega_save;
   PetscInt  its_save;
+  Mat       A;
 
   PetscFunctionBegin;
   PetscCall(MatGetType(pc->pmat, &mtype));
@@ -956,25 +1109,30 @@ static PetscErrorCode PCSetUp_PARSOR(PC pc)
 
   PetscCheck(is_mpiaij, PetscObjectComm((PetscObject)pc), PETSC_ERR_SUP, "PCPARSOR only supports MATMPIAIJ and MATSEQAIJ matrices, got %s", mtype);
 
+  /* With a new nonzero pattern the nodes are partitioned again, otherwise
+     only the values (and the inverse diagonal) are refreshed */
+  if (parsor->parsor_data && pc->flag != SAME_NONZERO_PATTERN) PetscCall(PCReset_PARSOR(pc));
+  PetscCall(MatMPIAIJGetSeqAIJ(pc->pmat, &A, NULL, NULL));
   if (!parsor->parsor_data) {
-    Mat A;
-    PetscCall(PetscNew(&parsor->parsor_data));
-    PetscCall(ParallelSORSetUp(pc->pmat, parsor->parsor_data));
-    PetscCall(MatMPIAIJGetSeqAIJ(pc->pmat, &A, NULL, NULL));
+    PetscCall(ParallelSORGet(pc->pmat, parsor->node_aware, &parsor->parsor_data));
     PetscCall(MatSetOption(A, MAT_USE_INODES, PETSC_FALSE));
-    PetscCall(LocalMatInvertDiagonalForSOR(A, parsor->omega, 0., &parsor->diag, &parsor->idiag_vec));
-  }
+  } else PetscCall(ParallelSORUpdateValues(pc->pmat, parsor->parsor_data));
+  PetscCall(LocalMatInvertDiagonalForSOR(A, parsor->omega, 0., &parsor->diag, &parsor->idiag_vec));
   PetscFunctionReturn(PETSC_SUCCESS);
 }
 
 static PetscErrorCode PCSetFromOptions_PARSOR(PC pc, PetscOptionItems_ARG PetscOptionsObject)
 {
   PC_PARSOR parsor = (PC_PARSOR)pc->data;
+  PetscReal omega  = parsor->omega;
 
   PetscFunctionBegin;
   PetscOptionsHeadBegin(PetscOptionsObject, "Parallel SOR options");
-  PetscCall(PetscOptionsReal("-pc_parsor_omega", "Relaxation factor", "PCPARSORSetOmega", parsor->omega, &parsor->omega, NULL));
+  PetscCall(PetscOptionsReal("-pc_parsor_omega", "Relaxation factor", "PCPARSORSetOmega", parsor->omega, &omega, NULL));
+  PetscCall(PCPARSORSetOmega(pc, omega));
   PetscCall(PetscOptionsInt("-pc_parsor_its", "Number of SOR iterations", "PCPARSORSetIterations", parsor->its, &parsor->its, NULL));
+  PetscCall(PetscOptionsBool("-pc_parsor_pipelined", "Overlap the ghost exchange of iteration i+1 with iteration i", "PCPARSORSetPipelined", parsor->pipelined, &parsor->pipelined, NULL));
+  PetscCall(PetscOptionsBool("-pc_parsor_node_aware", "Read ghost values of processors on the same node from shared memory", "PCPARSORSetNodeAware", parsor->node_aware, &parsor->node_aware, NULL));
   PetscOptionsHeadEnd();
   PetscFunctionReturn(PETSC_SUCCESS);
 }
@@ -990,6 +1148,26 @@ static PetscErrorCode PCView_PARSOR(PC pc, PetscViewer viewer)
     PetscCall(PetscViewerASCIIPrintf(viewer, "  Omega: %g\n", (double)parsor->omega));
     PetscCall(PetscViewerASCIIPrintf(viewer, "  Iterations: %" PetscInt_FMT "\n", parsor->its));
     PetscCall(PetscViewerASCIIPrintf(viewer, "  Sweep type: Forward\n"));
+    PetscCall(PetscViewerASCIIPrintf(viewer, "  Pipelined iterations: %s\n", PetscBools[parsor->pipelined]));
+    if (parsor->parsor_data && parsor->parsor_data->nh) {
+      PetscMPIInt nodesize;
+      PetscInt    non[2], noff[2], loc[2], sum[2], max[2];
+      MPI_Comm    comm = PetscObjectComm((PetscObject)pc);
+
+      PetscCall(NodeHaloGetNodeSize(parsor->parsor_data->nh, &nodesize));
+      PetscCall(NodeHaloPlanGetSizes(parsor->parsor_data->topplan, &non[0], &noff[0]));
+      PetscCall(NodeHaloPlanGetSizes(parsor->parsor_data->botplan, &non[1], &noff[1]));
+      loc[0] = non[0] + non[1];
+      loc[1] = noff[0] + noff[1];
+      PetscCallMPI(MPI_Allreduce(loc, sum, 2, MPIU_INT, MPI_SUM, comm));
+      PetscCallMPI(MPI_Allreduce(loc, max, 2, MPIU_INT, MPI_MAX, comm));
+      PetscCallMPI(MPI_Allreduce(MPI_IN_PLACE, &nodesize, 1, MPI_INT, MPI_MAX, comm));
+      PetscCall(PetscViewerASCIIPrintf(viewer, "  Node-aware ghost exchange: up to %d ranks per node\n", nodesize));
+      PetscCall(PetscViewerASCIIPrintf(viewer, "    On-node ghost values: %" PetscInt_FMT " in total, at most %" PetscInt_FMT " per rank\n", sum[0], max[0]));
+      PetscCall(PetscViewerASCIIPrintf(viewer, "    Off-node ghost values: %" PetscInt_FMT " in total, at most %" PetscInt_FMT " per rank\n", sum[1], max[1]));
+    } else {
+      PetscCall(PetscViewerASCIIPrintf(viewer, "  Node-aware ghost exchange: %s\n", PetscBools[parsor->node_aware]));
+    }
   }
   PetscFunctionReturn(PETSC_SUCCESS);
 }
@@ -1001,8 +1179,17 @@ PetscErrorCode PCPARSORSetOmega(PC pc, PetscReal omega)
   PetscFunctionBegin;
   PetscValidHeaderSpecific(pc, PC_CLASSID, 1);
   PetscValidLogicalCollectiveReal(pc, omega, 2);
-  parsor        = (PC_PARSOR)pc->data;
+  parsor = (PC_PARSOR)pc->data;
+  if (omega == parsor->omega) PetscFunctionReturn(PETSC_SUCCESS);
   parsor->omega = omega;
+  /* The scaled inverse diagonal depends on omega. PCSetUp() skips the setup
+     if the operator did not change, so refresh it here. */
+  if (parsor->idiag_vec) {
+    Mat A;
+
+    PetscCall(MatMPIAIJGetSeqAIJ(pc->pmat, &A, NULL, NULL));
+    PetscCall(LocalMatInvertDiagonalForSOR(A, parsor->omega, 0., &parsor->diag, &parsor->idiag_vec));
+  }
   PetscFunctionReturn(PETSC_SUCCESS);
 }
 
@@ -1018,6 +1205,42 @@ PetscErrorCode PCPARSORSetIterations(PC pc, PetscInt its)
   PetscFunctionReturn(PETSC_SUCCESS);
 }
 
+/**
+   @brief Overlap the top ghost exchange of iteration i+1 with the remaining
+   local work of iteration i when more than one iteration is performed per
+   apply. Default is PETSC_FALSE.
+ */
+PetscErrorCode PCPARSORSetPipelined(PC pc, PetscBool flg)
+{
+  PC_PARSOR parsor;
+
+  PetscFunctionBegin;
+  PetscValidHeaderSpecific(pc, PC_CLASSID, 1);
+  PetscValidLogicalCollectiveBool(pc, flg, 2);
+  parsor            = (PC_PARSOR)pc->data;
+  parsor->pipelined = flg;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/**
+   @brief Read the ghost values owned by processors on the same node directly
+   from shared memory instead of sending them as MPI messages. Only the top
+   and bot exchanges are affected, the point-to-point messages of the mid
+   nodes are always sent. Must be called before PCSetUp. Default is
+   PETSC_FALSE.
+ */
+PetscErrorCode PCPARSORSetNodeAware(PC pc, PetscBool flg)
+{
+  PC_PARSOR parsor;
+
+  PetscFunctionBegin;
+  PetscValidHeaderSpecific(pc, PC_CLASSID, 1);
+  PetscValidLogicalCollectiveBool(pc, flg, 2);
+  parsor             = (PC_PARSOR)pc->data;
+  parsor->node_aware = flg;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
 PetscErrorCode PCCreate_PARSOR(PC pc)
 {
   PC_PARSOR parsor;
@@ -0,0 +1,590 @@
+/*  ParMGMC - Implementation of the Multigrid Monte Carlo method in PETSc.
+    Copyright (C) 2024  Nils Friess
+
+    This file is part of ParMGMC which is released under the GNU LESSER GENERAL
+    PUBLIC LICENSE (LGPL). See file LICENSE in the project root folder for full
+    license details.
+*/
+/** @file pc_patchgibbs.c
+    @brief A block Gibbs sampler over small overlapping patches wrapped as a PETSc PC
+
+    # Options database keys
+    - `-pc_patchgibbs_type` - how the patches are built from the matrix: `star`
+      (row i together with its neighbours in the matrix graph, default) or
+      `block` (contiguous blocks of unknowns)
+    - `-pc_patchgibbs_block_size` - size of the patches of type `block`
+      (default is the block size of the matrix)
+
+    # Notes
+    Each sweep visits all patches \f$P\f$ and draws the unknowns of the patch
+    from their conditional distribution given all other unknowns, i.e.,
+
+    \f[
+      y_P \gets y_P + L_P^{-T} (L_P^{-1} (b - A y)_P + z_P), \quad L_P L_P^T = A_{PP},
+    \f]
+
+    with \f$z_P\f$ standard normal. This is the sampling analogue of a patch
+    (ASM star) smoother as used in `examples/ex9.py`, but instead of setting up
+    one PC with its own dense factor per patch, all patches are handled by a
+    single PC. The patches are greedily coloured such that patches of the same
+    colour neither overlap nor are coupled through the matrix; all patches of a
+    colour can then be updated simultaneously while the sweep is still an exact
+    (sequential) block Gibbs sweep. Within each colour, patches of equal size
+    are grouped into a batch. The Cholesky factors of a batch are stored
+    interleaved in one contiguous arena (entry (i, j) of all patches of the
+    batch is contiguous), so the factorisation and the triangular solves run as
+    a single loop nest whose innermost loop runs over the patches and is
+    vectorised. The noise for all patches of a sweep is drawn in one call to
+    VecSetRandomStandardNormal().
+
+    Only implemented for sequential MATAIJ matrices (or MATMPIAIJ matrices on a
+    single rank). In parallel, use it as a subdomain sampler, e.g. for the
+    coarse level via `PCTELESCOPE`.
+
+    This PC supports setting a callback which is called for each sample by calling
+
+        PCSetSampleCallback(pc, SampleCallback, &ctx, NULL);
+ */
+
+#include "parmgmc/pc/pc_patchgibbs.h"
+#include "parmgmc/parmgmc.h"
+
+#include <petsc/private/pcimpl.h>
+#include <petscerror.h>
+#include <petscis.h>
+#include <petsclog.h>
+#include <petscmat.h>
+#include <petscmath.h>
+#include <petscoptions.h>
+#include <petscsys.h>
+#include <petscsystypes.h>
+#include <petscvec.h>
+#include <petscviewer.h>
+#include <string.h>
+#include <mpi.h>
+
+static const char *const PCPatchGibbsTypes[] = {"star", "block", "PCPatchGibbsType", "PC_PATCHGIBBS_", NULL};
+
+/* All patches of one colour that have the same size. Entry k of patch p is
+   stored at k * npatches + p, so that loops over the patches are contiguous. */
+typedef struct {
+  PetscInt     color, size, npatches;
+  PetscInt    *idx;  /* idx[k * npatches + p] is the k-th unknown of patch p */
+  PetscScalar *L;    /* packed lower triangular factors, (i, j) at (i * (i + 1) / 2 + j) * npatches, inverted diagonal */
+  PetscScalar *r;    /* workspace for the residual and the triangular solves */
+  PetscInt     zoff; /* offset of the noise of this batch */
+  PetscInt     nnz;  /* number of matrix entries in the rows of all patches */
+} PatchBatch;
+
+typedef struct {
+  Mat              A;
+  PetscRandom      prand;
+  Vec              z;
+  PCPatchGibbsType type;
+  PetscInt         bs;
+
+  /* User defined patches in CSR format, see PCPatchGibbsSetPatches() */
+  PetscInt  nupatches;
+  PetscInt *uptr, *uidx;
+
+  PetscInt     npatches, ncolors, nbatches, maxsize;
+  PatchBatch  *batches;
+  PetscInt    *idx;
+  PetscScalar *arena;
+
+  void *cbctx;
+  PetscErrorCode (*scb)(PetscInt, Vec, void *);
+  PetscErrorCode (*del_scb)(void *);
+} PC_PatchGibbs;
+
+/* Number of scalars rounded up to whole 64 byte cache lines */
+static PetscInt PatchGibbsPad(PetscInt n)
+{
+  const PetscInt w = (PetscInt)(64 / sizeof(PetscScalar));
+
+  return ((n + w - 1) / w) * w;
+}
+
+static PetscErrorCode PatchBatchFactor(PatchBatch *batch)
+{
+  const PetscInt s = batch->size, m = batch->npatches;
+  PetscScalar   *L = batch->L;
+
+  PetscFunctionBeginUser;
+  for (PetscInt j = 0; j < s; ++j) {
+    PetscScalar *Ljj = L + (j * (j + 1) / 2 + j) * m;
+
+    for (PetscInt k = 0; k < j; ++k) {
+      const PetscScalar *Ljk = L + (j * (j + 1) / 2 + k) * m;
+
+      for (PetscInt i = j; i < s; ++i) {
+        PetscScalar       *Lij = L + (i * (i + 1) / 2 + j) * m;
+        const PetscScalar *Lik = L + (i * (i + 1) / 2 + k) * m;
+
+        PetscPragmaSIMD
+        for (PetscInt p = 0; p < m; ++p) Lij[p] -= Lik[p] * PetscConj(Ljk[p]);
+      }
+    }
+    for (PetscInt p = 0; p < m; ++p) PetscCheck(PetscRealPart(Ljj[p]) > 0, PETSC_COMM_SELF, PETSC_ERR_MAT_CH_ZRPVT, "Patch matrix is not positive definite (patch of size %" PetscInt_FMT ", pivot %" PetscInt_FMT ")", s, j);
+    PetscPragmaSIMD
+    for (PetscInt p = 0; p < m; ++p) Ljj[p] = 1. / PetscSqrtReal(PetscRealPart(Ljj[p]));
+    for (PetscInt i = j + 1; i < s; ++i) {
+      PetscScalar *Lij = L + (i * (i + 1) / 2 + j) * m;
+
+      PetscPragmaSIMD
+      for (PetscInt p = 0; p < m; ++p) Lij[p] *= Ljj[p];
+    }
+  }
+  PetscCall(PetscLogFlops(m * s * s * s / 3.));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* One block Gibbs update of all patches of the batch: y_P += L^-T (L^-1 (b - A y)_P + z_P) */
+static PetscErrorCode PatchBatchSweep(PatchBatch *batch, const PetscInt *ia, const PetscInt *ja, const PetscScalar *aa, const PetscScalar *b, const PetscScalar *z, PetscScalar *y)
+{
+  const PetscInt  s = batch->size, m = batch->npatches;
+  const PetscInt *idx = batch->idx;
+  PetscScalar    *L = batch->L, *r = batch->r;
+
+  PetscFunctionBeginUser;
+  for (PetscInt k = 0; k < s * m; ++k) {
+    const PetscInt v = idx[k];
+    PetscScalar    t = b[v];
+
+    for (PetscInt e = ia[v]; e < ia[v + 1]; ++e) t -= aa[e] * y[ja[e]];
+    r[k] = t;
+  }
+
+  // Forward solve with L
+  for (PetscInt i = 0; i < s; ++i) {
+    PetscScalar       *ri  = r + i * m;
+    const PetscScalar *Lii = L + (i * (i + 1) / 2 + i) * m;
+
+    for (PetscInt k = 0; k < i; ++k) {
+      const PetscScalar *Lik = L + (i * (i + 1) / 2 + k) * m, *rk = r + k * m;
+
+      PetscPragmaSIMD
+      for (PetscInt p = 0; p < m; ++p) ri[p] -= Lik[p] * rk[p];
+    }
+    PetscPragmaSIMD
+    for (PetscInt p = 0; p < m; ++p) ri[p] *= Lii[p];
+  }
+
+  // Add the noise only once the forward solve is complete, the solve must not see it
+  for (PetscInt k = 0; k < s * m; ++k) r[k] += z[k];
+
+  // Backward solve with L^T
+  for (PetscInt i = s - 1; i >= 0; --i) {
+    PetscScalar       *ri  = r + i * m;
+    const PetscScalar *Lii = L + (i * (i + 1) / 2 + i) * m;
+
+    for (PetscInt k = i + 1; k < s; ++k) {
+      const PetscScalar *Lki = L + (k * (k + 1) / 2 + i) * m, *rk = r + k * m;
+
+      PetscPragmaSIMD
+      for (PetscInt p = 0; p < m; ++p) ri[p] -= PetscConj(Lki[p]) * rk[p];
+    }
+    PetscPragmaSIMD
+    for (PetscInt p = 0; p < m; ++p) ri[p] *= Lii[p];
+  }
+
+  for (PetscInt k = 0; k < s * m; ++k) y[idx[k]] += r[k];
+  PetscCall(PetscLogFlops(2. * batch->nnz + 2. * s * s * m));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+static PetscErrorCode PCPatchGibbsSweep(PC pc, Vec b, Vec y)
+{
+  PC_PatchGibbs     *pg = pc->data;
+  PetscInt           n;
+  const PetscInt    *ia, *ja;
+  const PetscScalar *aa, *barr, *zarr;
+  PetscScalar       *yarr;
+  PetscBool          done;
+
+  PetscFunctionBeginUser;
+  PetscCall(VecSetRandomStandardNormal(pg->z, pg->prand));
+  PetscCall(MatGetRowIJ(pg->A, 0, PETSC_FALSE, PETSC_FALSE, &n, &ia, &ja, &done));
+  PetscCall(MatSeqAIJGetArrayRead(pg->A, &aa));
+  PetscCall(VecGetArrayRead(b, &barr));
+  PetscCall(VecGetArrayRead(pg->z, &zarr));
+  PetscCall(VecGetArray(y, &yarr));
+  for (PetscInt i = 0; i < pg->nbatches; ++i) PetscCall(PatchBatchSweep(&pg->batches[i], ia, ja, aa, barr, zarr + pg->batches[i].zoff, yarr));
+  PetscCall(VecRestoreArray(y, &yarr));
+  PetscCall(VecRestoreArrayRead(pg->z, &zarr));
+  PetscCall(VecRestoreArrayRead(b, &barr));
+  PetscCall(MatSeqAIJRestoreArrayRead(pg->A, &aa));
+  PetscCall(MatRestoreRowIJ(pg->A, 0, PETSC_FALSE, PETSC_FALSE, &n, &ia, &ja, &done));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+static PetscErrorCode PCPatchGibbsClear(PC pc)
+{
+  PC_PatchGibbs *pg = pc->data;
+
+  PetscFunctionBeginUser;
+  PetscCall(PetscRandomDestroy(&pg->prand));
+  PetscCall(VecDestroy(&pg->z));
+  PetscCall(PetscFree(pg->batches));
+  PetscCall(PetscFree(pg->idx));
+  PetscCall(PetscFree(pg->arena));
+  pg->npatches = 0;
+  pg->ncolors  = 0;
+  pg->nbatches = 0;
+  pg->maxsize  = 0;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+static PetscErrorCode PCReset_PatchGibbs(PC pc)
+{
+  PC_PatchGibbs *pg = pc->data;
+
+  PetscFunctionBeginUser;
+  PetscCall(PCPatchGibbsClear(pc));
+  if (pg->del_scb) {
+    PetscCall(pg->del_scb(pg->cbctx));
+    pg->del_scb = NULL;
+  }
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+static PetscErrorCode PCDestroy_PatchGibbs(PC pc)
+{
+  PC_PatchGibbs *pg = pc->data;
+
+  PetscFunctionBeginUser;
+  PetscCall(PCReset_PatchGibbs(pc));
+  PetscCall(PetscFree2(pg->uptr, pg->uidx));
+  PetscCall(PetscFree(pg));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+static PetscErrorCode PCApplyRichardson_PatchGibbs(PC pc, Vec b, Vec y, Vec w, PetscReal rtol, PetscReal abstol, PetscReal dtol, PetscInt its, PetscBool guesszero, PetscInt *outits, PCRichardsonConvergedReason *reason)
+{
+  (void)w;
+  (void)rtol;
+  (void)abstol;
+  (void)dtol;
+
+  PC_PatchGibbs *pg = pc->data;
+
+  PetscFunctionBeginUser;
+  if (guesszero) PetscCall(VecZeroEntries(y));
+  for (PetscInt it = 0; it < its; ++it) {
+    PetscCall(PCPatchGibbsSweep(pc, b, y));
+    if (pg->scb) PetscCall(pg->scb(it, y, pg->cbctx));
+  }
+  *outits = its;
+  *reason = PCRICHARDSON_CONVERGED_ITS;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+static PetscErrorCode PCApply_PatchGibbs(PC pc, Vec x, Vec y)
+{
+  PetscFunctionBeginUser;
+  PetscCall(VecZeroEntries(y));
+  PetscCall(PCPatchGibbsSweep(pc, x, y));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+static PetscErrorCode PCSetUp_PatchGibbs(PC pc)
+{
+  PC_PatchGibbs     *pg = pc->data;
+  MatType            type;
+  PetscMPIInt        size;
+  PetscInt           n, np, nb, nidx, narena, *pptr, *pidx, *vptr, *vpat, *pos, *color, *mark, *key, *perm;
+  const PetscInt    *ia, *ja;
+  const PetscScalar *aa;
+  PetscBool          done;
+
+  PetscFunctionBeginUser;
+  PetscCall(PCPatchGibbsClear(pc));
+  PetscCallMPI(MPI_Comm_size(PetscObjectComm((PetscObject)pc->pmat), &size));
+  PetscCall(MatGetType(pc->pmat, &type));
+  PetscCheck(size == 1 && (strcmp(type, MATSEQAIJ) == 0 || strcmp(type, MATMPIAIJ) == 0), PetscObjectComm((PetscObject)pc), PETSC_ERR_SUP, "PCPATCHGIBBS requires a sequential AIJ matrix; in parallel, use it as a subdomain sampler (e.g. within PCTELESCOPE)");
+  if (strcmp(type, MATMPIAIJ) == 0) PetscCall(MatMPIAIJGetSeqAIJ(pc->pmat, &pg->A, NULL, NULL));
+  else pg->A = pc->pmat;
+  PetscCall(MatGetRowIJ(pg->A, 0, PETSC_FALSE, PETSC_FALSE, &n, &ia, &ja, &done));
+  PetscCheck(done, PETSC_COMM_SELF, PETSC_ERR_SUP, "Cannot get the rows of the matrix");
+  PetscCall(MatSeqAIJGetArrayRead(pg->A, &aa));
+
+  // Patches in CSR format
+  if (pg->nupatches > 0) {
+    np = pg->nupatches;
+    PetscCall(PetscMalloc2(np + 1, &pptr, pg->uptr[np], &pidx));
+    PetscCall(PetscArraycpy(pptr, pg->uptr, np + 1));
+    PetscCall(PetscArraycpy(pidx, pg->uidx, pg->uptr[np]));
+  } else if (pg->type == PC_PATCHGIBBS_STAR) {
+    np = n;
+    PetscCall(PetscMalloc2(np + 1, &pptr, ia[n] + n, &pidx));
+    pptr[0] = 0;
+    for (PetscInt i = 0; i < n; ++i) {
+      PetscInt c = pptr[i];
+
+      pidx[c++] = i;
+      for (PetscInt e = ia[i]; e < ia[i + 1]; ++e)
+        if (ja[e] != i) pidx[c++] = ja[e];
+      pptr[i + 1] = c;
+    }
+  } else {
+    PetscInt bs = pg->bs;
+
+    if (bs < 1) PetscCall(MatGetBlockSize(pc->pmat, &bs));
+    np = (n + bs - 1) / bs;
+    PetscCall(PetscMalloc2(np + 1, &pptr, n, &pidx));
+    for (PetscInt p = 0; p < np; ++p) pptr[p] = p * bs;
+    pptr[np] = n;
+    for (PetscInt i = 0; i < n; ++i) pidx[i] = i;
+  }
+
+  PetscCall(PetscMalloc2(n, &pos, n + 1, &vptr));
+  for (PetscInt i = 0; i < n; ++i) pos[i] = -1;
+  for (PetscInt p = 0; p < np; ++p) {
+    PetscCheck(pptr[p + 1] > pptr[p], PETSC_COMM_SELF, PETSC_ERR_ARG_WRONG, "Patch %" PetscInt_FMT " is empty", p);
+    for (PetscInt e = pptr[p]; e < pptr[p + 1]; ++e) {
+      PetscCheck(pidx[e] >= 0 && pidx[e] < n, PETSC_COMM_SELF, PETSC_ERR_ARG_OUTOFRANGE, "Index %" PetscInt_FMT " of patch %" PetscInt_FMT " is out of range", pidx[e], p);
+      PetscCheck(pos[pidx[e]] != p, PETSC_COMM_SELF, PETSC_ERR_ARG_WRONG, "Index %" PetscInt_FMT " appears twice in patch %" PetscInt_FMT, pidx[e], p);
+      pos[pidx[e]] = p;
+    }
+    pg->maxsize = PetscMax(pg->maxsize, pptr[p + 1] - pptr[p]);
+  }
+
+  // Patches containing each unknown
+  PetscCall(PetscMalloc1(pptr[np], &vpat));
+  PetscCall(PetscArrayzero(vptr, n + 1));
+  for (PetscInt e = 0; e < pptr[np]; ++e) vptr[pidx[e] + 1]++;
+  for (PetscInt i = 0; i < n; ++i) vptr[i + 1] += vptr[i];
+  for (PetscInt i = 0; i < n; ++i) pos[i] = vptr[i];
+  for (PetscInt p = 0; p < np; ++p)
+    for (PetscInt e = pptr[p]; e < pptr[p + 1]; ++e) vpat[pos[pidx[e]]++] = p;
+  for (PetscInt i = 0; i < n; ++i) pos[i] = -1;
+
+  /* Greedy colouring: a patch must not share a colour with any patch that
+     contains an unknown of it or a neighbour of one in the matrix graph */
+  PetscCall(PetscMalloc4(np, &color, np, &mark, np, &key, np, &perm));
+  for (PetscInt p = 0; p < np; ++p) {
+    color[p] = -1;
+    mark[p]  = -1;
+  }
+  for (PetscInt p = 0; p < np; ++p) {
+    PetscInt c = 0;
+
+    for (PetscInt e = pptr[p]; e < pptr[p + 1]; ++e) {
+      const PetscInt u = pidx[e];
+
+      for (PetscInt f = vptr[u]; f < vptr[u + 1]; ++f)
+        if (color[vpat[f]] >= 0) mark[color[vpat[f]]] = p;
+      for (PetscInt g = ia[u]; g < ia[u + 1]; ++g)
+        for (PetscInt f = vptr[ja[g]]; f < vptr[ja[g] + 1]; ++f)
+          if (color[vpat[f]] >= 0) mark[color[vpat[f]]] = p;
+    }
+    while (mark[c] == p) ++c;
+    color[p]    = c;
+    pg->ncolors = PetscMax(pg->ncolors, c + 1);
+  }
+
+  // Batches of patches with the same colour and size, ordered by colour
+  for (PetscInt p = 0; p < np; ++p) {
+    key[p]  = color[p] * (pg->maxsize + 1) + pptr[p + 1] - pptr[p];
+    perm[p] = p;
+  }
+  PetscCall(PetscSortIntWithArray(np, key, perm));
+  nb = np > 0 ? 1 : 0;
+  for (PetscInt p = 1; p < np; ++p)
+    if (key[p] != key[p - 1]) ++nb;
+  PetscCall(PetscCalloc1(nb, &pg->batches));
+  nidx   = 0;
+  narena = 0;
+  for (PetscInt p = 0, b = -1; p < np; ++p) {
+    if (p == 0 || key[p] != key[p - 1]) {
+      ++b;
+      pg->batches[b].color = color[perm[p]];
+      pg->batches[b].size  = pptr[perm[p] + 1] - pptr[perm[p]];
+    }
+    pg->batches[b].npatches++;
+  }
+  for (PetscInt b = 0; b < nb; ++b) {
+    PatchBatch    *batch = &pg->batches[b];
+    const PetscInt s = batch->size, m = batch->npatches;
+
+    batch->zoff = nidx;
+    nidx += s * m;
+    narena += PatchGibbsPad(s * (s + 1) / 2 * m) + PatchGibbsPad(s * m);
+  }
+  PetscCall(PetscMalloc1(nidx, &pg->idx));
+  PetscCall(PetscCalloc1(narena, &pg->arena));
+  pg->npatches = np;
+  pg->nbatches = nb;
+
+  nidx   = 0;
+  narena = 0;
+  for (PetscInt b = 0, first = 0; b < nb; ++b) {
+    PatchBatch    *batch = &pg->batches[b];
+    const PetscInt s = batch->size, m = batch->npatches;
+
+    batch->idx = pg->idx + nidx;
+    batch->L   = pg->arena + narena;
+    batch->r   = batch->L + PatchGibbsPad(s * (s + 1) / 2 * m);
+    nidx += s * m;
+    narena += PatchGibbsPad(s * (s + 1) / 2 * m) + PatchGibbsPad(s * m);
+
+    for (PetscInt q = 0; q < m; ++q) {
+      const PetscInt p = perm[first + q];
+
+      for (PetscInt k = 0; k < s; ++k) {
+        const PetscInt v = pidx[pptr[p] + k];
+
+        batch->idx[k * m + q] = v;
+        pos[v]                = k;
+        batch->nnz += ia[v + 1] - ia[v];
+      }
+      // Lower triangle of A_PP
+      for (PetscInt k = 0; k < s; ++k) {
+        const PetscInt v = batch->idx[k * m + q];
+
+        for (PetscInt e = ia[v]; e < ia[v + 1]; ++e) {
+          const PetscInt j = pos[ja[e]];
+
+          if (j >= 0 && j <= k) batch->L[(k * (k + 1) / 2 + j) * m + q] = aa[e];
+        }
+      }
+      for (PetscInt k = 0; k < s; ++k) pos[batch->idx[k * m + q]] = -1;
+    }
+    first += m;
+    PetscCall(PatchBatchFactor(batch));
+  }
+
+  PetscCall(PetscFree4(color, mark, key, perm));
+  PetscCall(PetscFree(vpat));
+  PetscCall(PetscFree2(pos, vptr));
+  PetscCall(PetscFree2(pptr, pidx));
+  PetscCall(MatSeqAIJRestoreArrayRead(pg->A, &aa));
+  PetscCall(MatRestoreRowIJ(pg->A, 0, PETSC_FALSE, PETSC_FALSE, &n, &ia, &ja, &done));
+
+  PetscCall(VecCreateSeq(PETSC_COMM_SELF, nidx, &pg->z));
+  PetscCall(ParMGMCGetPetscRandom(&pg->prand));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+static PetscErrorCode PCSetFromOptions_PatchGibbs(PC pc, PetscOptionItems_ARG PetscOptionsObject)
+{
+  PC_PatchGibbs *pg = pc->data;
+
+  PetscFunctionBeginUser;
+  PetscOptionsHeadBegin(PetscOptionsObject, "PatchGibbs options");
+  PetscCall(PetscOptionsEnum("-pc_patchgibbs_type", "How the patches are built", "PCPatchGibbsSetType", PCPatchGibbsTypes, (PetscEnum)pg->type, (PetscEnum *)&pg->type, NULL));
+  PetscCall(PetscOptionsInt("-pc_patchgibbs_block_size", "Size of the patches of type block", "PCPatchGibbsSetBlockSize", pg->bs, &pg->bs, NULL));
+  PetscOptionsHeadEnd();
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+static PetscErrorCode PCView_PatchGibbs(PC pc, PetscViewer viewer)
+{
+  PC_PatchGibbs *pg = pc->data;
+
+  PetscFunctionBeginUser;
+  if (pg->nupatches > 0) PetscCall(PetscViewerASCIIPrintf(viewer, "User defined patches\n"));
+  else PetscCall(PetscViewerASCIIPrintf(viewer, "Patch type: %s\n", PCPatchGibbsTypes[pg->type]));
+  PetscCall(PetscViewerASCIIPrintf(viewer, "Number of patches: %" PetscInt_FMT " (largest has %" PetscInt_FMT " unknowns)\n", pg->npatches, pg->maxsize));
+  PetscCall(PetscViewerASCIIPrintf(viewer, "Number of colours: %" PetscInt_FMT ", number of batches: %" PetscInt_FMT "\n", pg->ncolors, pg->nbatches));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/**
+   @brief Sets how the patches are built from the matrix, see PCPatchGibbsType.
+   Has no effect if the patches were set with PCPatchGibbsSetPatches(). Must be
+   called before PCSetUp(). Default is PC_PATCHGIBBS_STAR.
+ */
+PetscErrorCode PCPatchGibbsSetType(PC pc, PCPatchGibbsType type)
+{
+  PC_PatchGibbs *pg = pc->data;
+
+  PetscFunctionBeginUser;
+  pg->type = type;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/**
+   @brief Sets the size of the patches of type PC_PATCHGIBBS_BLOCK. Must be
+   called before PCSetUp(). Default is the block size of the matrix.
+ */
+PetscErrorCode PCPatchGibbsSetBlockSize(PC pc, PetscInt bs)
+{
+  PC_PatchGibbs *pg = pc->data;
+
+  PetscFunctionBeginUser;
+  pg->bs = bs;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/**
+   @brief Sets the patches explicitly. Each IS contains the (local) indices of
+   one patch; the patches may overlap. Must be called before PCSetUp().
+ */
+PetscErrorCode PCPatchGibbsSetPatches(PC pc, PetscInt n, const IS patches[])
+{
+  PC_PatchGibbs *pg = pc->data;
+  PetscInt       nidx = 0;
+
+  PetscFunctionBeginUser;
+  for (PetscInt p = 0; p < n; ++p) {
+    PetscInt len;
+
+    PetscCall(ISGetLocalSize(patches[p], &len));
+    nidx += len;
+  }
+  PetscCall(PetscFree2(pg->uptr, pg->uidx));
+  PetscCall(PetscMalloc2(n + 1, &pg->uptr, nidx, &pg->uidx));
+  pg->uptr[0] = 0;
+  for (PetscInt p = 0; p < n; ++p) {
+    const PetscInt *idx;
+    PetscInt        len;
+
+    PetscCall(ISGetLocalSize(patches[p], &len));
+    PetscCall(ISGetIndices(patches[p], &idx));
+    PetscCall(PetscArraycpy(pg->uidx + pg->uptr[p], idx, len));
+    PetscCall(ISRestoreIndices(patches[p], &idx));
+    pg->uptr[p + 1] = pg->uptr[p] + len;
+  }
+  pg->nupatches = n;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+static PetscErrorCode PCSetSampleCallback_PatchGibbs(PC pc, PetscErrorCode (*cb)(PetscInt, Vec, void *), void *ctx, PetscErrorCode (*deleter)(void *))
+{
+  PC_PatchGibbs *pg = pc->data;
+
+  PetscFunctionBeginUser;
+  if (pg->del_scb) {
+    PetscCall(pg->del_scb(pg->cbctx));
+    pg->del_scb = NULL;
+  }
+  pg->scb     = cb;
+  pg->cbctx   = ctx;
+  pg->del_scb = deleter;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+PetscErrorCode PCCreate_PatchGibbs(PC pc)
+{
+  PC_PatchGibbs *pg;
+
+  PetscFunctionBeginUser;
+  PetscCall(PetscNew(&pg));
+  pg->type    = PC_PATCHGIBBS_STAR;
+  pg->bs      = -1;
+  pg->cbctx   = NULL;
+  pg->scb     = NULL;
+  pg->del_scb = NULL;
+
+  pc->data                 = pg;
+  pc->ops->setup           = PCSetUp_PatchGibbs;
+  pc->ops->destroy         = PCDestroy_PatchGibbs;
+  pc->ops->apply           = PCApply_PatchGibbs;
+  pc->ops->applyrichardson = PCApplyRichardson_PatchGibbs;
+  pc->ops->setfromoptions  = PCSetFromOptions_PatchGibbs;
+  pc->ops->reset           = PCReset_PatchGibbs;
+  pc->ops->view            = PCView_PatchGibbs;
+  PetscCall(PCRegisterSetSampleCallback(pc, PCSetSampleCallback_PatchGibbs));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
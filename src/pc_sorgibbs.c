@@ -21,6 +21,53 @@
 #include <stddef.h>
 #include <string.h>
 
+/* Data for the asynchronous (Hogwild) sampler.  Every rank exposes an RMA
+   window holding its ghost values followed by one sweep counter per
+   neighbour it receives ghost values from.  After each local sweep a rank
+   packs the boundary values that its neighbours need and writes them, and
+   then its own sweep count, into the neighbours' windows; the next sweep
+   just reads whatever has arrived.  The only waiting happens when a
+   neighbour's counter lags behind by more than `max_staleness` sweeps.
+
+   The window stays in one passive-target epoch (MPI_Win_lock_all) from the
+   setup until it is freed.  All accesses to it, including the reads of the
+   owner, are MPI_Accumulate / MPI_Get_accumulate calls with MPI_REPLACE and
+   MPI_NO_OP, which are atomic per element and, coming from the same origin,
+   are applied in order.  A neighbour's counter is therefore never newer than
+   its values, and the reads do not race with incoming updates.  Progress is
+   made by the flushes; the sampling calls contain no barriers. */
+typedef struct {
+  MPI_Win      win;
+  PetscScalar *ghosts; /* window memory: nghost values, then nrecv counters; only accessed through RMA */
+  PetscInt     nghost;
+  PetscMPIInt  nrecv, rank;
+  PetscInt    *recvptr; /* ghosts[recvptr[i]..recvptr[i+1]) come from receive neighbour i */
+  PetscScalar *gcopy;   /* private copy of the ghost values the sweep reads */
+  PetscScalar *counts;  /* private copy of the counters */
+  Vec          lvec;    /* wraps gcopy */
+  VecScatter   sct;     /* bulk scatter, only used to initialise the ghosts */
+  PetscInt     nsweeps; /* sweeps since the setup, the counters count the same */
+
+  PetscMPIInt   nsend;
+  PetscMPIInt  *sendranks;
+  PetscInt     *sendptr; /* sendrows[sendptr[i]..sendptr[i+1]) go to sendranks[i] */
+  PetscInt     *sendrows;
+  PetscScalar  *sendbuf; /* packed values, one extra slot per neighbour for the counter */
+  MPI_Datatype *sendtypes;
+  MPI_Aint     *cntdisp; /* position of our counter in the window of sendranks[i] */
+
+  const PetscInt  *ai, *aj, *bi, *bj;
+  const MatScalar *aa, *ba;
+  PetscInt        *diag;
+
+  PetscInt max_staleness;
+
+  /* Statistics, accumulated over all sweeps since the last setup */
+  PetscInt64 nobs, nwaits;
+  PetscReal  sum_staleness;
+  PetscInt   max_observed;
+} SORGibbsAsync;
+
 typedef struct {
   Vec         sqrtdiag;
   Vec         work;
@@ -30,18 +77,26 @@ typedef struct {
   /* For parallel SOR on MPIAIJ matrices */
   PC        parsor_pc;
   PetscBool use_parsor;
+  PetscBool pipelined;
+  PetscBool node_aware;
   PetscInt  sample_index;
+  Vec       rhs; /* RHS of the current PCApplyRichardson call (borrowed) */
+
+  /* Asynchronous Hogwild sampler with one-sided ghost updates */
+  PetscBool      async;
+  PetscInt       max_staleness;
+  SORGibbsAsync *as;
 
   /* MATLRC support: when pc->pmat is A_post = A + B Sigma^{-1} B^T we run
      the SOR sweep on the base AIJ `Asor = A` and apply a Woodbury
      post-correction y -= Bb * (B^T y) after every sweep.  Asor / B are
-     borrowed from the LRC matrix; Bb, sqrtS, wk, zn are owned. */
-  PetscBool is_lrc;
-  Mat       Asor;
-  Mat       B, Bb;
-  Vec       sqrtS;
-  Vec       wk;
-  Vec       zn;
+     borrowed from the LRC matrix; Bb, sqrtS, wk, lrc are owned. */
+  PetscBool     is_lrc;
+  Mat           Asor;
+  Mat           B, Bb;
+  Vec           sqrtS;
+  Vec           wk;
+  LRCCorrection lrc;
 
   void *cbctx;
   PetscErrorCode (*scb)(PetscInt, Vec, void *);
@@ -73,7 +128,7 @@ static PetscErrorCode PCSORGibbsNotifySample(PC pc, Vec y)
   PetscFunctionReturn(PETSC_SUCCESS);
 }
 
-static PetscErrorCode PCSORGibbsSample(PC pc, Vec b, Vec y, Vec w)
+static PetscErrorCode PCSORGibbsPrepareRHS_Diag(PC pc, Vec b, Vec w)
 {
   PC_SORGibbs sorgibbs = pc->data;
 
@@ -81,6 +136,15 @@ static PetscErrorCode PCSORGibbsSample(PC pc, Vec b, Vec y, Vec w)
   PetscCall(VecSetRandomStandardNormal(w, sorgibbs->prand));
   PetscCall(VecPointwiseMult(w, w, sorgibbs->sqrtdiag));
   PetscCall(VecAXPY(w, 1., b));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+static PetscErrorCode PCSORGibbsPrepareRHS(PC pc, Vec b, Vec w)
+{
+  PC_SORGibbs sorgibbs = pc->data;
+
+  PetscFunctionBeginUser;
+  PetscCall(PCSORGibbsPrepareRHS_Diag(pc, b, w));
   /* MATLRC: add the noise B * sqrt(Sigma^{-1}) * eta to the RHS so that
      the chain samples from N(*, A_post^{-1}) instead of N(*, A^{-1}). */
   if (sorgibbs->is_lrc) {
@@ -88,17 +152,387 @@ static PetscErrorCode PCSORGibbsSample(PC pc, Vec b, Vec y, Vec w)
     PetscCall(VecPointwiseMult(sorgibbs->wk, sorgibbs->wk, sorgibbs->sqrtS));
     PetscCall(MatMultAdd(sorgibbs->B, sorgibbs->wk, w, w));
   }
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+static PetscErrorCode PCSORGibbsSweep(PC pc, Vec w, Vec y)
+{
+  PC_SORGibbs sorgibbs = pc->data;
+
+  PetscFunctionBeginUser;
   if (sorgibbs->use_parsor) {
     PetscCall(PCPARSORApplySOR(sorgibbs->parsor_pc, w, 1, PETSC_FALSE, y));
   } else {
     PetscCall(MatSOR(sorgibbs->Asor, w, 1., sorgibbs->type, 0., 1., 1., y));
   }
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+static PetscErrorCode PCSORGibbsSample(PC pc, Vec b, Vec y, Vec w)
+{
+  PC_SORGibbs sorgibbs = pc->data;
+
+  PetscFunctionBeginUser;
+  PetscCall(PCSORGibbsPrepareRHS(pc, b, w));
+  PetscCall(PCSORGibbsSweep(pc, w, y));
   /* MATLRC: Sherman-Morrison-Woodbury post-correction y -= Bb * (B^T y). */
   if (sorgibbs->is_lrc) {
-    PetscCall(MatMultTranspose(sorgibbs->B, y, sorgibbs->wk));
-    PetscCall(MatMult(sorgibbs->Bb, sorgibbs->wk, sorgibbs->zn));
-    PetscCall(VecAXPY(y, -1., sorgibbs->zn));
+    PetscCall(LRCCorrectionBegin(sorgibbs->lrc, y, NULL));
+    PetscCall(LRCCorrectionEnd(sorgibbs->lrc, sorgibbs->Bb, y, NULL));
+  }
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* MATLRC sampling loop in which the reduction B^T y of the post-correction
+   is overlapped with drawing the noise of the next sweep. The low-rank part
+   of that noise (B wk) is reduced in the same message, so each sweep needs a
+   single non-blocking reduction instead of two blocking ones. */
+static PetscErrorCode PCSORGibbsApplyLRC(PC pc, Vec b, Vec y, Vec w, PetscInt its)
+{
+  PC_SORGibbs sorgibbs = pc->data;
+
+  PetscFunctionBeginUser;
+  PetscCall(PCSORGibbsPrepareRHS(pc, b, w));
+  for (PetscInt it = 0; it < its; ++it) {
+    PetscBool more = it + 1 < its ? PETSC_TRUE : PETSC_FALSE;
+
+    PetscCall(PCSORGibbsSweep(pc, w, y));
+    if (more) {
+      PetscCall(VecSetRandomStandardNormal(sorgibbs->wk, sorgibbs->prand));
+      PetscCall(VecPointwiseMult(sorgibbs->wk, sorgibbs->wk, sorgibbs->sqrtS));
+    }
+    PetscCall(LRCCorrectionBegin(sorgibbs->lrc, y, more ? sorgibbs->wk : NULL));
+    if (more) PetscCall(PCSORGibbsPrepareRHS_Diag(pc, b, w));
+    PetscCall(LRCCorrectionEnd(sorgibbs->lrc, sorgibbs->Bb, y, more ? w : NULL));
+    PetscCall(PCSORGibbsNotifySample(pc, y));
+  }
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+static PetscErrorCode SORGibbsAsyncDestroy(SORGibbsAsync **as)
+{
+  PetscFunctionBeginUser;
+  if (!*as) PetscFunctionReturn(PETSC_SUCCESS);
+  for (PetscMPIInt i = 0; i < (*as)->nsend; ++i) PetscCallMPI(MPI_Type_free(&(*as)->sendtypes[i]));
+  PetscCall(PetscFree((*as)->sendtypes));
+  PetscCall(PetscFree((*as)->cntdisp));
+  PetscCall(PetscFree((*as)->sendranks));
+  PetscCall(PetscFree((*as)->sendptr));
+  PetscCall(PetscFree((*as)->sendrows));
+  PetscCall(PetscFree((*as)->sendbuf));
+  PetscCall(PetscFree((*as)->diag));
+  PetscCall(PetscFree3((*as)->recvptr, (*as)->gcopy, (*as)->counts));
+  PetscCall(VecDestroy(&(*as)->lvec));
+  PetscCall(VecScatterDestroy(&(*as)->sct));
+  PetscCallMPI(MPI_Win_unlock_all((*as)->win));
+  PetscCallMPI(MPI_Win_free(&(*as)->win));
+  PetscCall(PetscFree(*as));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+static PetscErrorCode SORGibbsAsyncSetUp(Mat A, PetscInt max_staleness, SORGibbsAsync **as_out)
+{
+  SORGibbsAsync  *as;
+  MPI_Comm        comm = PetscObjectComm((PetscObject)A);
+  PetscMPIInt     rank, size, *slot, *remote_slot, *disps;
+  Mat             Ad, Ao;
+  const PetscInt *colmap, *degree;
+  PetscLayout     layout;
+  PetscSF         sf;
+  PetscInt        nrows, nroots_multi = 0, *leafdata, *rootdata, *perm;
+  PetscScalar    *aa_tmp, *ba_tmp;
+
+  PetscFunctionBeginUser;
+  PetscCheck(max_staleness >= 0, comm, PETSC_ERR_ARG_OUTOFRANGE, "Maximum staleness must be non-negative");
+  PetscCallMPI(MPI_Comm_rank(comm, &rank));
+  PetscCallMPI(MPI_Comm_size(comm, &size));
+  PetscCall(PetscNew(&as));
+  as->max_staleness = max_staleness;
+  as->rank          = rank;
+
+  PetscCall(MatMPIAIJGetSeqAIJ(A, &Ad, &Ao, &colmap));
+  PetscCall(MatGetSize(Ao, NULL, &as->nghost));
+  PetscCall(MatGetLocalSize(A, &nrows, NULL));
+  PetscCall(MatGetLayouts(A, &layout, NULL));
+  PetscCall(MatSeqAIJGetCSRAndMemType(Ad, &as->ai, &as->aj, &aa_tmp, NULL));
+  PetscCall(MatSeqAIJGetCSRAndMemType(Ao, &as->bi, &as->bj, &ba_tmp, NULL));
+  as->aa = aa_tmp;
+  as->ba = ba_tmp;
+  PetscCall(PetscMalloc1(nrows, &as->diag));
+  for (PetscInt i = 0; i < nrows; ++i) {
+    as->diag[i] = -1;
+    for (PetscInt k = as->ai[i]; k < as->ai[i + 1]; ++k) {
+      if (as->aj[k] == i) {
+        as->diag[i] = k;
+        break;
+      }
+    }
+    PetscCheck(as->diag[i] >= 0, PETSC_COMM_SELF, PETSC_ERR_ARG_INCOMP, "Zero diagonal on row %" PetscInt_FMT, i);
+  }
+
+  /* Neighbours we receive ghost values from.  colmap is sorted, so the owners
+     are too, the ghosts of one neighbour are contiguous, and slot[p] is the
+     position of rank p in that list (or -1). */
+  PetscCall(PetscMalloc1(size, &slot));
+  PetscCall(PetscMalloc3(as->nghost + 1, &as->recvptr, as->nghost, &as->gcopy, as->nghost, &as->counts));
+  for (PetscMPIInt p = 0; p < size; ++p) slot[p] = -1;
+  as->nrecv = 0;
+  for (PetscInt j = 0; j < as->nghost; ++j) {
+    PetscMPIInt owner;
+
+    PetscCall(PetscLayoutFindOwner(layout, colmap[j], &owner));
+    if (slot[owner] < 0) {
+      as->recvptr[as->nrecv] = j;
+      slot[owner]            = as->nrecv++;
+    }
+  }
+  as->recvptr[as->nrecv] = as->nghost;
+
+  /* Window: ghost values followed by one counter per receive neighbour.  It is
+     zeroed before the epoch is opened; the barrier at the end of the setup
+     makes sure nobody writes to it before that. */
+  PetscCallMPI(MPI_Win_allocate((MPI_Aint)((as->nghost + as->nrecv) * sizeof(PetscScalar)), sizeof(PetscScalar), MPI_INFO_NULL, comm, &as->ghosts, &as->win));
+  PetscCall(PetscArrayzero(as->ghosts, as->nghost + as->nrecv));
+  PetscCallMPI(MPI_Win_lock_all(0, as->win));
+  PetscCall(VecCreateSeqWithArray(PETSC_COMM_SELF, 1, as->nghost, as->gcopy, &as->lvec));
+  {
+    Vec xcol;
+    IS  from, to;
+
+    PetscCall(MatCreateVecs(A, &xcol, NULL));
+    PetscCall(ISCreateGeneral(comm, as->nghost, colmap, PETSC_COPY_VALUES, &from));
+    PetscCall(ISCreateStride(PETSC_COMM_SELF, as->nghost, 0, 1, &to));
+    PetscCall(VecScatterCreate(xcol, from, as->lvec, to, &as->sct));
+    PetscCall(ISDestroy(&from));
+    PetscCall(ISDestroy(&to));
+    PetscCall(VecDestroy(&xcol));
+  }
+
+  /* Tell every rank where its counter lives in our window (and how many ghost
+     values precede the counters). */
+  PetscCall(PetscMalloc1(2 * size, &remote_slot));
+  {
+    PetscMPIInt *sendinfo;
+
+    PetscCall(PetscMalloc1(2 * size, &sendinfo));
+    for (PetscMPIInt p = 0; p < size; ++p) {
+      sendinfo[2 * p]     = slot[p];
+      sendinfo[2 * p + 1] = (PetscMPIInt)as->nghost;
+    }
+    PetscCallMPI(MPI_Alltoall(sendinfo, 2, MPI_INT, remote_slot, 2, MPI_INT, comm));
+    PetscCall(PetscFree(sendinfo));
+  }
+
+  /* For every owned row, find the (rank, ghost index) pairs that hold a copy
+     of it: gather the leaf coordinates of the ghost SF onto the roots. */
+  PetscCall(PetscSFCreate(comm, &sf));
+  PetscCall(PetscSFSetGraphLayout(sf, layout, as->nghost, NULL, PETSC_OWN_POINTER, colmap));
+  PetscCall(PetscSFComputeDegreeBegin(sf, &degree));
+  PetscCall(PetscSFComputeDegreeEnd(sf, &degree));
+  for (PetscInt i = 0; i < nrows; ++i) nroots_multi += degree[i];
+  PetscCall(PetscMalloc1(2 * as->nghost, &leafdata));
+  PetscCall(PetscMalloc1(2 * nroots_multi, &rootdata));
+  for (PetscInt j = 0; j < as->nghost; ++j) {
+    leafdata[2 * j]     = rank;
+    leafdata[2 * j + 1] = j;
+  }
+  PetscCall(PetscSFGatherBegin(sf, MPIU_2INT, leafdata, rootdata));
+  PetscCall(PetscSFGatherEnd(sf, MPIU_2INT, leafdata, rootdata));
+
+  /* Group the (row, target rank, target index) triples by target rank */
+  {
+    PetscInt *rows, *ranks, *tidx, *cnt, k = 0;
+
+    PetscCall(PetscMalloc4(nroots_multi, &rows, nroots_multi, &ranks, nroots_multi, &tidx, nroots_multi, &perm));
+    for (PetscInt i = 0; i < nrows; ++i) {
+      for (PetscInt d = 0; d < degree[i]; ++d, ++k) {
+        rows[k]  = i;
+        ranks[k] = rootdata[2 * k];
+        tidx[k]  = rootdata[2 * k + 1];
+        perm[k]  = k;
+      }
+    }
+    PetscCall(PetscSortIntWithArray(nroots_multi, ranks, perm));
+    PetscCall(PetscCalloc1(size, &cnt));
+    for (k = 0; k < nroots_multi; ++k) cnt[ranks[k]]++;
+    as->nsend = 0;
+    for (PetscMPIInt p = 0; p < size; ++p)
+      if (cnt[p]) as->nsend++;
+    PetscCall(PetscMalloc1(as->nsend, &as->sendranks));
+    PetscCall(PetscMalloc1(as->nsend + 1, &as->sendptr));
+    PetscCall(PetscMalloc1(as->nsend, &as->sendtypes));
+    PetscCall(PetscMalloc1(as->nsend, &as->cntdisp));
+    PetscCall(PetscMalloc1(nroots_multi, &as->sendrows));
+    PetscCall(PetscMalloc1(nroots_multi + as->nsend, &as->sendbuf));
+    PetscCall(PetscMalloc1(nroots_multi + 1, &disps));
+    as->sendptr[0] = 0;
+    for (PetscMPIInt p = 0, n = 0; p < size; ++p) {
+      if (!cnt[p]) continue;
+      PetscAssert(remote_slot[2 * p] >= 0, PETSC_COMM_SELF, PETSC_ERR_PLIB, "Rank %d has ghost values from us but no counter slot", p);
+      as->sendranks[n]   = p;
+      as->sendptr[n + 1] = as->sendptr[n] + cnt[p];
+      for (PetscInt q = as->sendptr[n]; q < as->sendptr[n + 1]; ++q) {
+        as->sendrows[q]            = rows[perm[q]];
+        disps[q - as->sendptr[n]] = (PetscMPIInt)tidx[perm[q]];
+      }
+      /* Counter goes after the ghost values in the target's window */
+      as->cntdisp[n] = remote_slot[2 * p + 1] + remote_slot[2 * p];
+      PetscCallMPI(MPI_Type_create_indexed_block((PetscMPIInt)cnt[p], 1, disps, MPIU_SCALAR, &as->sendtypes[n]));
+      PetscCallMPI(MPI_Type_commit(&as->sendtypes[n]));
+      n++;
+    }
+    PetscCall(PetscFree(disps));
+    PetscCall(PetscFree(cnt));
+    PetscCall(PetscFree4(rows, ranks, tidx, perm));
+  }
+
+  PetscCall(PetscFree(leafdata));
+  PetscCall(PetscFree(rootdata));
+  PetscCall(PetscSFDestroy(&sf));
+  PetscCall(PetscFree(remote_slot));
+  PetscCall(PetscFree(slot));
+  PetscCallMPI(MPI_Barrier(comm));
+  *as_out = as;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* Wait until no receive neighbour lags more than max_staleness sweeps behind
+   sweep number `sweep`, record the staleness of the ghost values used and
+   copy them into gcopy.  The counters are read before the values, so the
+   values are at least as new as the counters say.  Neighbours that have not
+   published anything yet keep the values of the initial scatter. */
+static PetscErrorCode SORGibbsAsyncWait(SORGibbsAsync *as, PetscInt sweep)
+{
+  PetscBool waited = PETSC_FALSE;
+
+  PetscFunctionBeginUser;
+  while (PETSC_TRUE) {
+    PetscInt maxstale = 0;
+
+    PetscCallMPI(MPI_Get_accumulate(NULL, 0, MPIU_SCALAR, as->counts, as->nrecv, MPIU_SCALAR, as->rank, as->nghost, as->nrecv, MPIU_SCALAR, MPI_NO_OP, as->win));
+    PetscCallMPI(MPI_Win_flush(as->rank, as->win));
+    for (PetscMPIInt i = 0; i < as->nrecv; ++i) {
+      PetscInt stale = sweep - (PetscInt)PetscRealPart(as->counts[i]);
+      if (stale > maxstale) maxstale = stale;
+    }
+    if (maxstale <= as->max_staleness) {
+      for (PetscMPIInt i = 0; i < as->nrecv; ++i) {
+        PetscInt stale = PetscMax(0, sweep - (PetscInt)PetscRealPart(as->counts[i]));
+        as->sum_staleness += stale;
+        as->nobs++;
+      }
+      as->max_observed = PetscMax(as->max_observed, maxstale);
+      break;
+    }
+    if (!waited) {
+      as->nwaits++;
+      waited = PETSC_TRUE;
+    }
+  }
+
+  for (PetscMPIInt i = 0; i < as->nrecv; ++i) {
+    PetscMPIInt len = (PetscMPIInt)(as->recvptr[i + 1] - as->recvptr[i]);
+
+    if (PetscRealPart(as->counts[i]) < 1) continue;
+    PetscCallMPI(MPI_Get_accumulate(NULL, 0, MPIU_SCALAR, as->gcopy + as->recvptr[i], len, MPIU_SCALAR, as->rank, as->recvptr[i], len, MPIU_SCALAR, MPI_NO_OP, as->win));
+  }
+  PetscCallMPI(MPI_Win_flush(as->rank, as->win));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+static PetscErrorCode SORGibbsAsyncSweep(SORGibbsAsync *as, Vec w, Vec y)
+{
+  const PetscScalar *b;
+  PetscScalar       *x;
+  PetscInt           n;
+
+  PetscFunctionBeginUser;
+  PetscCall(VecGetLocalSize(y, &n));
+  PetscCall(VecGetArrayRead(w, &b));
+  PetscCall(VecGetArray(y, &x));
+  for (PetscInt i = 0; i < n; ++i) {
+    PetscScalar sum = b[i];
+
+    for (PetscInt k = as->ai[i]; k < as->ai[i + 1]; ++k)
+      if (k != as->diag[i]) sum -= as->aa[k] * x[as->aj[k]];
+    for (PetscInt k = as->bi[i]; k < as->bi[i + 1]; ++k) sum -= as->ba[k] * as->gcopy[as->bj[k]];
+    x[i] = sum / as->aa[as->diag[i]];
+  }
+  PetscCall(PetscLogFlops(2.0 * (as->ai[n] + as->bi[n])));
+  PetscCall(VecRestoreArray(y, &x));
+  PetscCall(VecRestoreArrayRead(w, &b));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* Publish the boundary values of sweep number `sweep` (1-based) into the
+   neighbours' windows, the counter after the values.  The send buffer is
+   reused, so the previous round of updates must have completed locally
+   first. */
+static PetscErrorCode SORGibbsAsyncPublish(SORGibbsAsync *as, PetscInt sweep, Vec y)
+{
+  const PetscScalar *x;
+
+  PetscFunctionBeginUser;
+  PetscCallMPI(MPI_Win_flush_local_all(as->win));
+  PetscCall(VecGetArrayRead(y, &x));
+  for (PetscMPIInt i = 0; i < as->nsend; ++i) {
+    PetscScalar *buf = as->sendbuf + as->sendptr[i] + i;
+    PetscInt     cnt = as->sendptr[i + 1] - as->sendptr[i];
+
+    for (PetscInt q = 0; q < cnt; ++q) buf[q] = x[as->sendrows[as->sendptr[i] + q]];
+    buf[cnt] = (PetscScalar)sweep;
+    PetscCallMPI(MPI_Accumulate(buf, (PetscMPIInt)cnt, MPIU_SCALAR, as->sendranks[i], 0, 1, as->sendtypes[i], MPI_REPLACE, as->win));
+    PetscCallMPI(MPI_Accumulate(buf + cnt, 1, MPIU_SCALAR, as->sendranks[i], as->cntdisp[i], 1, MPIU_SCALAR, MPI_REPLACE, as->win));
+  }
+  PetscCall(VecRestoreArrayRead(y, &x));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* The ghost values are initialised with a scatter in the first call only.
+   In later calls they are the neighbours' latest published values, which is
+   where the previous call left off. */
+static PetscErrorCode PCSORGibbsApplyAsync(PC pc, Vec b, Vec y, Vec w, PetscInt its)
+{
+  PC_SORGibbs    sorgibbs = pc->data;
+  SORGibbsAsync *as       = sorgibbs->as;
+
+  PetscFunctionBeginUser;
+  if (as->nsweeps == 0) {
+    PetscCall(VecScatterBegin(as->sct, y, as->lvec, INSERT_VALUES, SCATTER_FORWARD));
+    PetscCall(VecScatterEnd(as->sct, y, as->lvec, INSERT_VALUES, SCATTER_FORWARD));
   }
+
+  for (PetscInt it = 0; it < its; ++it) {
+    PetscCall(PCSORGibbsPrepareRHS(pc, b, w));
+    PetscCall(SORGibbsAsyncWait(as, as->nsweeps));
+    PetscCall(SORGibbsAsyncSweep(as, w, y));
+    PetscCall(SORGibbsAsyncPublish(as, ++as->nsweeps, y));
+    PetscCall(PCSORGibbsNotifySample(pc, y));
+  }
+  /* Deliver the last values before returning, so that neighbours that are
+     still sweeping do not have to wait for the next call */
+  PetscCallMPI(MPI_Win_flush_all(as->win));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* Hooks for PCPARSORApplySORWithHooks: draw the noise for the next
+   iteration and report the sample of the current one.  */
+static PetscErrorCode SORGibbsNextRHS(PetscInt it, Vec w, void *ctx)
+{
+  PC          pc       = ctx;
+  PC_SORGibbs sorgibbs = pc->data;
+
+  PetscFunctionBeginUser;
+  (void)it;
+  PetscCall(PCSORGibbsPrepareRHS(pc, sorgibbs->rhs, w));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+static PetscErrorCode SORGibbsPostIteration(PetscInt it, Vec y, void *ctx)
+{
+  PetscFunctionBeginUser;
+  (void)it;
+  PetscCall(PCSORGibbsNotifySample((PC)ctx, y));
   PetscFunctionReturn(PETSC_SUCCESS);
 }
 
@@ -107,6 +541,7 @@ static PetscErrorCode PCApply_SORGibbs(PC pc, Vec b, Vec y)
   PC_SORGibbs sorgibbs = pc->data;
 
   PetscFunctionBeginUser;
+  PetscCheck(!sorgibbs->as, PetscObjectComm((PetscObject)pc), PETSC_ERR_SUP, "The asynchronous sampler can only be used with KSPRICHARDSON");
   PetscCall(VecZeroEntries(y));
   PetscCall(PCSORGibbsSample(pc, b, y, sorgibbs->work));
   PetscFunctionReturn(PETSC_SUCCESS);
@@ -123,9 +558,24 @@ static PetscErrorCode PCApplyRichardson_SORGibbs(PC pc, Vec b, Vec y, Vec w, Pet
 
   PetscFunctionBeginUser;
   sorgibbs->sample_index = 0;
-  for (PetscInt it = 0; it < its; ++it) {
-    PetscCall(PCSORGibbsSample(pc, b, y, w));
-    PetscCall(PCSORGibbsNotifySample(pc, y));
+  if (sorgibbs->as) {
+    PetscCall(PCSORGibbsApplyAsync(pc, b, y, w, its));
+  } else if (sorgibbs->use_parsor && !sorgibbs->is_lrc) {
+    /* Let PARSOR run all iterations in one go so that (in pipelined mode) the
+       ghost exchange of the next iteration overlaps with the end of the
+       current one. Not possible for MATLRC since the post-correction changes
+       all entries of y after every sweep. */
+    sorgibbs->rhs = b;
+    PetscCall(PCSORGibbsPrepareRHS(pc, b, w));
+    PetscCall(PCPARSORApplySORWithHooks(sorgibbs->parsor_pc, w, its, PETSC_FALSE, SORGibbsNextRHS, SORGibbsPostIteration, pc, y));
+    sorgibbs->rhs = NULL;
+  } else if (sorgibbs->is_lrc) {
+    PetscCall(PCSORGibbsApplyLRC(pc, b, y, w, its));
+  } else {
+    for (PetscInt it = 0; it < its; ++it) {
+      PetscCall(PCSORGibbsSample(pc, b, y, w));
+      PetscCall(PCSORGibbsNotifySample(pc, y));
+    }
   }
 
   *outits = its;
@@ -145,7 +595,8 @@ static PetscErrorCode PCReset_SORGibbs(PC pc)
   PetscCall(MatDestroy(&sorgibbs->Bb));
   PetscCall(VecDestroy(&sorgibbs->sqrtS));
   PetscCall(VecDestroy(&sorgibbs->wk));
-  PetscCall(VecDestroy(&sorgibbs->zn));
+  PetscCall(LRCCorrectionDestroy(&sorgibbs->lrc));
+  PetscCall(SORGibbsAsyncDestroy(&sorgibbs->as));
   sorgibbs->use_parsor = PETSC_FALSE;
   sorgibbs->is_lrc     = PETSC_FALSE;
   sorgibbs->B          = NULL;
@@ -169,7 +620,8 @@ static PetscErrorCode PCDestroy_SORGibbs(PC pc)
   PetscCall(MatDestroy(&sorgibbs->Bb));
   PetscCall(VecDestroy(&sorgibbs->sqrtS));
   PetscCall(VecDestroy(&sorgibbs->wk));
-  PetscCall(VecDestroy(&sorgibbs->zn));
+  PetscCall(LRCCorrectionDestroy(&sorgibbs->lrc));
+  PetscCall(SORGibbsAsyncDestroy(&sorgibbs->as));
   if (sorgibbs->del_scb) {
     PetscCall(sorgibbs->del_scb(sorgibbs->cbctx));
     sorgibbs->del_scb = NULL;
@@ -178,21 +630,95 @@ static PetscErrorCode PCDestroy_SORGibbs(PC pc)
   PetscFunctionReturn(PETSC_SUCCESS);
 }
 
+/* Copies the locally owned part of S into sqrtS and takes the square root.
+   S is gathered first, so it may be distributed or replicated. */
+static PetscErrorCode SORGibbsSetSqrtS(PC_SORGibbs sorgibbs, Vec S)
+{
+  const PetscScalar *Sarr;
+  PetscScalar       *sqrtSarr;
+  PetscInt           istart, iend;
+  Vec                Sall;
+  VecScatter         sct;
+
+  PetscFunctionBeginUser;
+  PetscCall(VecScatterCreateToAll(S, &sct, &Sall));
+  PetscCall(VecScatterBegin(sct, S, Sall, INSERT_VALUES, SCATTER_FORWARD));
+  PetscCall(VecScatterEnd(sct, S, Sall, INSERT_VALUES, SCATTER_FORWARD));
+  PetscCall(VecGetOwnershipRange(sorgibbs->sqrtS, &istart, &iend));
+  PetscCall(VecGetArrayRead(Sall, &Sarr));
+  PetscCall(VecGetArray(sorgibbs->sqrtS, &sqrtSarr));
+  for (PetscInt i = istart; i < iend; ++i) sqrtSarr[i - istart] = Sarr[i];
+  PetscCall(VecRestoreArrayRead(Sall, &Sarr));
+  PetscCall(VecRestoreArray(sorgibbs->sqrtS, &sqrtSarr));
+  PetscCall(VecScatterDestroy(&sct));
+  PetscCall(VecDestroy(&Sall));
+  PetscCall(VecSqrtAbs(sorgibbs->sqrtS));
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/* Numeric-only setup, used when the values of the operator changed but its
+   nonzero pattern (and the matrices it is made of) did not. The parallel SOR
+   partition, the asynchronous communication pattern and all work vectors are
+   kept; only the diagonal, the low-rank data and the Woodbury matrix are
+   recomputed. */
+static PetscErrorCode PCSetUp_SORGibbs_Numeric(PC pc, PetscBool *done)
+{
+  PC_SORGibbs sorgibbs = pc->data;
+  Mat         Asor = pc->pmat, B = NULL;
+  Vec         S    = NULL;
+
+  PetscFunctionBeginUser;
+  *done = PETSC_FALSE;
+  if (!pc->setupcalled || pc->flag != SAME_NONZERO_PATTERN || !sorgibbs->sqrtdiag) PetscFunctionReturn(PETSC_SUCCESS);
+  if (sorgibbs->is_lrc) PetscCall(MatLRCGetMats(pc->pmat, &Asor, &B, &S, NULL));
+  if (Asor != sorgibbs->Asor || B != sorgibbs->B) PetscFunctionReturn(PETSC_SUCCESS);
+
+  PetscCall(MatGetDiagonal(sorgibbs->Asor, sorgibbs->sqrtdiag));
+  PetscCall(VecSqrtAbs(sorgibbs->sqrtdiag));
+  if (sorgibbs->as) {
+    Mat          Ad, Ao;
+    PetscScalar *aa_tmp, *ba_tmp;
+
+    PetscCall(MatMPIAIJGetSeqAIJ(sorgibbs->Asor, &Ad, &Ao, NULL));
+    PetscCall(MatSeqAIJGetCSRAndMemType(Ad, NULL, NULL, &aa_tmp, NULL));
+    PetscCall(MatSeqAIJGetCSRAndMemType(Ao, NULL, NULL, &ba_tmp, NULL));
+    sorgibbs->as->aa = aa_tmp;
+    sorgibbs->as->ba = ba_tmp;
+  }
+  if (sorgibbs->use_parsor) {
+    PetscCall(PCPARSORSetOmega(sorgibbs->parsor_pc, 1.0));
+    PetscCall(PCSetUp(sorgibbs->parsor_pc));
+  }
+  if (sorgibbs->is_lrc) {
+    PetscCall(SORGibbsSetSqrtS(sorgibbs, S));
+    PetscCall(MatDestroy(&sorgibbs->Bb));
+    PetscCall(LRCCorrectionDestroy(&sorgibbs->lrc));
+    PetscCall(MCSORBuildLRCCorrection(SORGibbsDetSOR, sorgibbs, sorgibbs->Asor, sorgibbs->B, S, &sorgibbs->Bb));
+    PetscCall(LRCCorrectionCreate(sorgibbs->B, &sorgibbs->lrc));
+  }
+  *done = PETSC_TRUE;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
 static PetscErrorCode PCSetUp_SORGibbs(PC pc)
 {
   PC_SORGibbs sorgibbs = pc->data;
   MatType     mtype;
-  PetscBool   is_mpiaij, is_lrc;
+  PetscBool   is_mpiaij, is_lrc, done;
   Vec         S = NULL;
 
   PetscFunctionBeginUser;
+  PetscCall(PCSetUp_SORGibbs_Numeric(pc, &done));
+  if (done) PetscFunctionReturn(PETSC_SUCCESS);
+
   /* Tear down per-setup state so PCSetUp can be re-run on a new operator. */
   PetscCall(VecDestroy(&sorgibbs->sqrtdiag));
   PetscCall(VecDestroy(&sorgibbs->work));
   PetscCall(MatDestroy(&sorgibbs->Bb));
   PetscCall(VecDestroy(&sorgibbs->sqrtS));
   PetscCall(VecDestroy(&sorgibbs->wk));
-  PetscCall(VecDestroy(&sorgibbs->zn));
+  PetscCall(LRCCorrectionDestroy(&sorgibbs->lrc));
+  PetscCall(SORGibbsAsyncDestroy(&sorgibbs->as));
   sorgibbs->B    = NULL;
   sorgibbs->Asor = NULL;
 
@@ -205,23 +731,11 @@ static PetscErrorCode PCSetUp_SORGibbs(PC pc)
     sorgibbs->is_lrc = PETSC_TRUE;
     PetscCall(MatLRCGetMats(pc->pmat, &sorgibbs->Asor, &sorgibbs->B, &S, NULL));
     /* MATLRC stores S as a sequential (replicated) vec.  We need parallel
-       size-k workspaces matching B's column layout so MatMultTranspose
-       (used in the post-correction below) sees consistent local dims. */
+       size-k workspaces matching B's column layout for the low-rank noise
+       B * sqrt(S) * eta. */
     PetscCall(MatCreateVecs(sorgibbs->B, &sorgibbs->wk, NULL));
     PetscCall(VecDuplicate(sorgibbs->wk, &sorgibbs->sqrtS));
-    {
-      const PetscScalar *Sarr;
-      PetscScalar       *sqrtSarr;
-      PetscInt           istart, iend;
-
-      PetscCall(VecGetOwnershipRange(sorgibbs->sqrtS, &istart, &iend));
-      PetscCall(VecGetArrayRead(S, &Sarr));
-      PetscCall(VecGetArray(sorgibbs->sqrtS, &sqrtSarr));
-      for (PetscInt i = istart; i < iend; ++i) sqrtSarr[i - istart] = Sarr[i];
-      PetscCall(VecRestoreArrayRead(S, &Sarr));
-      PetscCall(VecRestoreArray(sorgibbs->sqrtS, &sqrtSarr));
-    }
-    PetscCall(VecSqrtAbs(sorgibbs->sqrtS));
+    PetscCall(SORGibbsSetSqrtS(sorgibbs, S));
   } else {
     sorgibbs->is_lrc = PETSC_FALSE;
     sorgibbs->Asor   = pc->pmat;
@@ -239,13 +753,22 @@ static PetscErrorCode PCSetUp_SORGibbs(PC pc)
   /* PCPARSOR path: true parallel Gauss-Seidel for MPIAIJ + forward sweep. */
   PetscCall(MatGetType(sorgibbs->Asor, &mtype));
   PetscCall(PetscStrcmp(mtype, MATMPIAIJ, &is_mpiaij));
-  if (is_mpiaij && sorgibbs->type == SOR_FORWARD_SWEEP) {
+  if (sorgibbs->async && !is_mpiaij) PetscCall(PetscInfo(pc, "Matrix is not MPIAIJ, asynchronous sampler falls back to the standard sweep\n"));
+  if (sorgibbs->async && is_mpiaij) {
+    PetscCheck(!sorgibbs->is_lrc, PetscObjectComm((PetscObject)pc), PETSC_ERR_SUP, "Asynchronous SOR Gibbs does not support MATLRC");
+    PetscCall(SORGibbsAsyncSetUp(sorgibbs->Asor, sorgibbs->max_staleness, &sorgibbs->as));
+    sorgibbs->use_parsor = PETSC_FALSE;
+  } else if (is_mpiaij && sorgibbs->type == SOR_FORWARD_SWEEP) {
     sorgibbs->use_parsor = PETSC_TRUE;
     if (!sorgibbs->parsor_pc) {
       PetscCall(PCCreate(PetscObjectComm((PetscObject)pc), &sorgibbs->parsor_pc));
       PetscCall(PCSetType(sorgibbs->parsor_pc, PCPARSOR));
     }
     PetscCall(PCSetOperators(sorgibbs->parsor_pc, sorgibbs->Asor, sorgibbs->Asor));
+    PetscCall(PCPARSORSetPipelined(sorgibbs->parsor_pc, sorgibbs->pipelined));
+    PetscCall(PCPARSORSetNodeAware(sorgibbs->parsor_pc, sorgibbs->node_aware));
+    // The noise is scaled for a Gibbs sweep, i.e., SOR with omega = 1
+    PetscCall(PCPARSORSetOmega(sorgibbs->parsor_pc, 1.0));
     PetscCall(PCSetUp(sorgibbs->parsor_pc));
   } else {
     sorgibbs->use_parsor = PETSC_FALSE;
@@ -256,7 +779,7 @@ static PetscErrorCode PCSetUp_SORGibbs(PC pc)
      actual sampling sweep will use, so the iteration matrix matches. */
   if (sorgibbs->is_lrc) {
     PetscCall(MCSORBuildLRCCorrection(SORGibbsDetSOR, sorgibbs, sorgibbs->Asor, sorgibbs->B, S, &sorgibbs->Bb));
-    PetscCall(MatCreateVecs(sorgibbs->Bb, NULL, &sorgibbs->zn));
+    PetscCall(LRCCorrectionCreate(sorgibbs->B, &sorgibbs->lrc));
   }
   PetscFunctionReturn(PETSC_SUCCESS);
 }
@@ -273,6 +796,10 @@ static PetscErrorCode PCSetFromOptions_SORGibbs(PC pc, PetscOptionItems_ARG Pets
   flag = PETSC_FALSE;
   PetscCall(PetscOptionsBool("-pc_sorgibbs_local_forward", "SOR Gibbs local forward sweep (Hogwild sampler)", NULL, sorgibbs->type == SOR_LOCAL_FORWARD_SWEEP, &flag, NULL));
   if (flag) sorgibbs->type = SOR_LOCAL_FORWARD_SWEEP;
+  PetscCall(PetscOptionsBool("-pc_sorgibbs_async", "Asynchronous Hogwild sampler with one-sided ghost updates (MPIAIJ only)", "PCSORGibbsSetAsync", sorgibbs->async, &sorgibbs->async, NULL));
+  PetscCall(PetscOptionsInt("-pc_sorgibbs_async_max_staleness", "Maximum number of sweeps a neighbour's ghost values may lag behind", "PCSORGibbsSetAsync", sorgibbs->max_staleness, &sorgibbs->max_staleness, NULL));
+  PetscCall(PetscOptionsBool("-pc_sorgibbs_pipelined", "Pipeline consecutive parallel SOR sweeps (only used with MPIAIJ matrices)", "PCSORGibbsSetPARSOROptions", sorgibbs->pipelined, &sorgibbs->pipelined, NULL));
+  PetscCall(PetscOptionsBool("-pc_sorgibbs_node_aware", "Read ghost values of processors on the same node from shared memory (only used with MPIAIJ matrices)", "PCSORGibbsSetPARSOROptions", sorgibbs->node_aware, &sorgibbs->node_aware, NULL));
   PetscOptionsHeadEnd();
   PetscFunctionReturn(PETSC_SUCCESS);
 }
@@ -300,6 +827,108 @@ static PetscErrorCode PCView_SORGibbs(PC pc, PetscViewer viewer)
   PetscAssert(sorgibbs->type == SOR_FORWARD_SWEEP || sorgibbs->type == SOR_LOCAL_FORWARD_SWEEP, PETSC_COMM_WORLD, PETSC_ERR_PLIB, "Forgot to add sweep in PCView_SORGibbs");
   if (sorgibbs->type == SOR_FORWARD_SWEEP) PetscCall(PetscViewerASCIIPrintf(viewer, "Sweep type: Forward\n"));
   if (sorgibbs->type == SOR_LOCAL_FORWARD_SWEEP) PetscCall(PetscViewerASCIIPrintf(viewer, "Sweep type: Local forward (a.k.a Hogwild sampler)\n"));
+  if (sorgibbs->use_parsor) PetscCall(PetscViewerASCIIPrintf(viewer, "Pipelined parallel SOR: %s\n", PetscBools[sorgibbs->pipelined]));
+  if (sorgibbs->use_parsor) PetscCall(PetscViewerASCIIPrintf(viewer, "Node-aware ghost exchange: %s\n", PetscBools[sorgibbs->node_aware]));
+  if (sorgibbs->async) {
+    PetscInt  maxstale;
+    PetscReal meanstale;
+    PetscInt  nwaits;
+
+    PetscCall(PetscViewerASCIIPrintf(viewer, "Asynchronous (one-sided) ghost updates, max. staleness %" PetscInt_FMT "\n", sorgibbs->max_staleness));
+    if (sorgibbs->as) {
+      PetscCall(PCSORGibbsGetAsyncStats(pc, &maxstale, &meanstale, &nwaits));
+      PetscCall(PetscViewerASCIIPrintf(viewer, "Observed staleness: mean %g, max %" PetscInt_FMT ", sweeps that had to wait %" PetscInt_FMT "\n", (double)meanstale, maxstale, nwaits));
+    }
+  }
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/**
+   @brief Use the asynchronous Hogwild sampler: every rank sweeps over its
+   rows without synchronising with its neighbours and publishes its boundary
+   values with one-sided updates. Ghost values used by a sweep may be up to
+   `max_staleness` (>= 0) sweeps old. This is not an exact sampler (the chain
+   is slightly biased) but removes all synchronisation from the sweeps. Only
+   supported with `KSPRICHARDSON`. Collective.
+ */
+PetscErrorCode PCSORGibbsSetAsync(PC pc, PetscBool flg, PetscInt max_staleness)
+{
+  PC_SORGibbs sorgibbs = pc->data;
+
+  PetscFunctionBeginUser;
+  PetscValidHeaderSpecific(pc, PC_CLASSID, 1);
+  PetscValidLogicalCollectiveBool(pc, flg, 2);
+  PetscValidLogicalCollectiveInt(pc, max_staleness, 3);
+  PetscCheck(max_staleness >= 0, PetscObjectComm((PetscObject)pc), PETSC_ERR_ARG_OUTOFRANGE, "Maximum staleness must be non-negative");
+  sorgibbs->async         = flg;
+  sorgibbs->max_staleness = max_staleness;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/**
+   @brief Options of the parallel SOR (PCPARSOR) sweep that is used for
+   `MATMPIAIJ` matrices: pipeline consecutive sweeps (see
+   PCPARSORSetPipelined()) and read the ghost values of processors on the
+   same node from shared memory (see PCPARSORSetNodeAware()). Must be called
+   before PCSetUp. Collective.
+ */
+PetscErrorCode PCSORGibbsSetPARSOROptions(PC pc, PetscBool pipelined, PetscBool node_aware)
+{
+  PC_SORGibbs sorgibbs = pc->data;
+
+  PetscFunctionBeginUser;
+  PetscValidHeaderSpecific(pc, PC_CLASSID, 1);
+  PetscValidLogicalCollectiveBool(pc, pipelined, 2);
+  PetscValidLogicalCollectiveBool(pc, node_aware, 3);
+  sorgibbs->pipelined  = pipelined;
+  sorgibbs->node_aware = node_aware;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/**
+   @brief Get the options set with PCSORGibbsSetPARSOROptions(). Both
+   arguments may be NULL.
+ */
+PetscErrorCode PCSORGibbsGetPARSOROptions(PC pc, PetscBool *pipelined, PetscBool *node_aware)
+{
+  PC_SORGibbs sorgibbs = pc->data;
+
+  PetscFunctionBeginUser;
+  PetscValidHeaderSpecific(pc, PC_CLASSID, 1);
+  if (pipelined) *pipelined = sorgibbs->pipelined;
+  if (node_aware) *node_aware = sorgibbs->node_aware;
+  PetscFunctionReturn(PETSC_SUCCESS);
+}
+
+/**
+   @brief Staleness statistics of the asynchronous sampler accumulated over all
+   sweeps since the last setup (collective). The staleness of a ghost value is
+   the number of sweeps the neighbour that owns it is behind.
+
+   Output
+     `maxstale`  - maximum staleness observed on any rank
+     `meanstale` - mean staleness over all ranks, sweeps and neighbours
+     `nwaits`    - total number of sweeps that had to wait for a neighbour
+ */
+PetscErrorCode PCSORGibbsGetAsyncStats(PC pc, PetscInt *maxstale, PetscReal *meanstale, PetscInt *nwaits)
+{
+  PC_SORGibbs sorgibbs = pc->data;
+  PetscReal   loc[2] = {0, 0}, glob[2];
+  PetscInt    lmax = 0, lwaits = 0;
+  MPI_Comm    comm = PetscObjectComm((PetscObject)pc);
+
+  PetscFunctionBeginUser;
+  PetscValidHeaderSpecific(pc, PC_CLASSID, 1);
+  if (sorgibbs->as) {
+    loc[0] = sorgibbs->as->sum_staleness;
+    loc[1] = (PetscReal)sorgibbs->as->nobs;
+    lmax   = sorgibbs->as->max_observed;
+    lwaits = (PetscInt)sorgibbs->as->nwaits;
+  }
+  PetscCallMPI(MPI_Allreduce(loc, glob, 2, MPIU_REAL, MPI_SUM, comm));
+  if (maxstale) PetscCallMPI(MPI_Allreduce(&lmax, maxstale, 1, MPIU_INT, MPI_MAX, comm));
+  if (nwaits) PetscCallMPI(MPI_Allreduce(&lwaits, nwaits, 1, MPIU_INT, MPI_SUM, comm));
+  if (meanstale) *meanstale = glob[1] > 0 ? glob[0] / glob[1] : 0;
   PetscFunctionReturn(PETSC_SUCCESS);
 }
 
@@ -309,8 +938,9 @@ PetscErrorCode PCCreate_SORGibbs(PC pc)
 
   PetscFunctionBeginUser;
   PetscCall(PetscNew(&sorgibbs));
-  pc->data       = sorgibbs;
-  sorgibbs->type = SOR_FORWARD_SWEEP;
+  pc->data                = sorgibbs;
+  sorgibbs->type          = SOR_FORWARD_SWEEP;
+  sorgibbs->max_staleness = 2;
 
   pc->ops->apply           = PCApply_SORGibbs;
   pc->ops->applyrichardson = PCApplyRichardson_SORGibbs;
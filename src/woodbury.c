@@ -1,4 +1,5 @@
 #include "parmgmc/pc/woodbury.h"
+#include "parmgmc/mc_sor.h"
 #include "parmgmc/parmgmc.h"
 
 #include <petsc/private/pcimpl.h>
@@ -11,7 +12,8 @@ typedef struct {
 
   Mat B, G;
 
-  Vec wk, sqrtS, zn, swork;
+  Vec           wk, sqrtS, swork;
+  LRCCorrection lrc;
 
   void *cbctx;
   PetscErrorCode (*scb)(PetscInt, Vec, void *);
@@ -74,7 +76,7 @@ static PetscErrorCode PCWoodburyBuildLRCCorrection(PC pc)
   PetscCall(KSPMatSolve(ksp, Id, Sb)); // Sb = (S^-1 + B^T M_A^-1 B)^-1
 
   PetscCall(MatMatMult(C, Sb, MAT_INITIAL_MATRIX, 1, &wb->G)); // G = C * Sb
-  PetscCall(MatCreateVecs(wb->G, NULL, &wb->zn));
+  PetscCall(LRCCorrectionCreate(wb->B, &wb->lrc));
 
   PetscCall(KSPDestroy(&ksp));
   PetscCall(VecDestroy(&Si));
@@ -93,7 +95,7 @@ static PetscErrorCode PCReset_Woodbury(PC pc)
   PetscCall(PetscRandomDestroy(&wb->prand));
   PetscCall(VecDestroy(&wb->wk));
   PetscCall(VecDestroy(&wb->sqrtS));
-  PetscCall(VecDestroy(&wb->zn));
+  PetscCall(LRCCorrectionDestroy(&wb->lrc));
   PetscCall(VecDestroy(&wb->swork));
   PetscCall(MatDestroy(&wb->G));
   if (wb->solver) PetscCall(PCReset(wb->solver));
@@ -110,7 +112,7 @@ static PetscErrorCode PCDestroy_Woodbury(PC pc)
   PetscCall(PetscRandomDestroy(&wb->prand));
   PetscCall(VecDestroy(&wb->wk));
   PetscCall(VecDestroy(&wb->sqrtS));
-  PetscCall(VecDestroy(&wb->zn));
+  PetscCall(LRCCorrectionDestroy(&wb->lrc));
   PetscCall(VecDestroy(&wb->swork));
   PetscCall(MatDestroy(&wb->G));
   PetscCall(PCDestroy(&wb->solver));
@@ -150,7 +152,7 @@ static PetscErrorCode PCSetUp_Woodbury(PC pc)
   PetscCheck(wb->solver && wb->sampler, PetscObjectComm((PetscObject)pc), PETSC_ERR_SUP, "Must provide sampler and solver");
   PetscCall(VecDestroy(&wb->wk));
   PetscCall(VecDestroy(&wb->sqrtS));
-  PetscCall(VecDestroy(&wb->zn));
+  PetscCall(LRCCorrectionDestroy(&wb->lrc));
   PetscCall(VecDestroy(&wb->swork));
   PetscCall(MatDestroy(&wb->G));
   wb->B = NULL;
@@ -178,6 +180,13 @@ static PetscErrorCode PCSetUp_Woodbury(PC pc)
   PetscCall(PCSetOperators(wb->solver, A, A));
   PetscCall(PCSetOperators(wb->sampler, A, A));
   PetscCall(PCSetUp(wb->solver));
+  {
+    PetscBool isgamg;
+
+    // A PCGAMGMC sampler on A can reuse the hierarchy of the solver
+    PetscCall(PetscObjectTypeCompare((PetscObject)wb->solver, PCGAMG, &isgamg));
+    if (isgamg) PetscCall(ParMGMCMatComposeInterpolations(wb->solver));
+  }
   PetscCall(PCSetUp(wb->sampler));
   PetscCall(PCWoodburyBuildLRCCorrection(pc));
   PetscCall(PCDestroy(&wb->solver));
@@ -268,15 +277,23 @@ static PetscErrorCode PCApplyRichardson_Woodbury(PC pc, Vec b, Vec y, Vec w, Pet
   PCRichardsonConvergedReason sreason;
 
   PetscFunctionBegin;
+  PetscCall(VecSetRandomStandardNormal(wb->wk, wb->prand));
+  PetscCall(VecPointwiseMult(wb->wk, wb->wk, wb->sqrtS));
+  PetscCall(MatMultAdd(wb->B, wb->wk, b, w));
   for (PetscInt it = 0; it < its; ++it) {
-    PetscCall(VecSetRandomStandardNormal(wb->wk, wb->prand));
-    PetscCall(VecPointwiseMult(wb->wk, wb->wk, wb->sqrtS));
-    PetscCall(MatMultAdd(wb->B, wb->wk, b, w));
+    PetscBool more = it + 1 < its ? PETSC_TRUE : PETSC_FALSE;
+
     PetscCall(PCApplyRichardson(wb->sampler, w, y, wb->swork, 0., 0., 0., 1, PETSC_FALSE, &sits, &sreason));
 
-    PetscCall(MatMultTranspose(wb->B, y, wb->wk));
-    PetscCall(MatMult(wb->G, wb->wk, wb->zn));
-    PetscCall(VecAXPY(y, -1., wb->zn));
+    /* Correction y -= G B^T y; the low-rank noise of the next iteration is
+       reduced in the same (non-blocking) message. */
+    if (more) {
+      PetscCall(VecSetRandomStandardNormal(wb->wk, wb->prand));
+      PetscCall(VecPointwiseMult(wb->wk, wb->wk, wb->sqrtS));
+    }
+    PetscCall(LRCCorrectionBegin(wb->lrc, y, more ? wb->wk : NULL));
+    if (more) PetscCall(VecCopy(b, w));
+    PetscCall(LRCCorrectionEnd(wb->lrc, wb->G, y, more ? w : NULL));
 
     if (wb->scb) PetscCall(wb->scb(it, y, wb->cbctx));
   }